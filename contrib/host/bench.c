@@ -0,0 +1,462 @@
+/* bench.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Micro-benchmarks for FanPico control path running on host.
+ *
+ * Usage: fanpico-bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+#include "cJSON.h"
+
+#include "fanpico.h"
+
+
+/* Functions without prototypes in fanpico.h */
+void clear_state(struct fanpico_state *s);
+void update_outputs(struct fanpico_state *state, const struct fanpico_config *config);
+cJSON *config_to_json(const struct fanpico_config *cfg);
+int json_to_config(cJSON *config, struct fanpico_config *cfg);
+void clear_config(struct fanpico_config *cfg);
+
+static struct fanpico_state state;
+static volatile double sink;
+static int saved_stdout = -1;
+
+
+static uint64_t bench_time_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Hide output from firmware code while benchmark is running. */
+static void mute_stdout(bool mute)
+{
+	fflush(stdout);
+	if (mute) {
+		int fd = open("/dev/null", O_WRONLY);
+		saved_stdout = dup(STDOUT_FILENO);
+		dup2(fd, STDOUT_FILENO);
+		close(fd);
+	} else if (saved_stdout >= 0) {
+		dup2(saved_stdout, STDOUT_FILENO);
+		close(saved_stdout);
+		saved_stdout = -1;
+	}
+}
+
+static void report(const char *name, uint64_t elapsed, long iterations)
+{
+	printf("%-28s %10ld %12.1f ns/op\n", name, iterations,
+		(double)elapsed / iterations);
+}
+
+
+static void bench_pwm_map(long n)
+{
+	const struct pwm_map *map = &cfg->fans[0].map;
+
+	for (long i = 0; i < n; i++)
+		sink = pwm_map(map, i % 101);
+}
+
+static void bench_tacho_map(long n)
+{
+	const struct tacho_map *map = &cfg->mbfans[0].map;
+
+	for (long i = 0; i < n; i++)
+		sink = tacho_map(map, i % 5000);
+}
+
+static void bench_sensor_get_duty(long n)
+{
+	const struct temp_map *map = &cfg->sensors[0].map;
+
+	for (long i = 0; i < n; i++)
+		sink = sensor_get_duty(map, 20.0 + (i % 300) / 10.0);
+}
+
+static void bench_calculate_pwm_duty(long n)
+{
+	for (long i = 0; i < n; i++)
+		sink = calculate_pwm_duty(&state, cfg, i % FAN_COUNT);
+}
+
+static void bench_calculate_tacho_freq(long n)
+{
+	for (long i = 0; i < n; i++)
+		sink = calculate_tacho_freq(&state, cfg, i % MBFAN_COUNT);
+}
+
+static void bench_filter(enum signal_filter_types type, const char *args, long n)
+{
+	char tmp[64];
+	void *ctx;
+
+	strncpy(tmp, args, sizeof(tmp) - 1);
+	tmp[sizeof(tmp) - 1] = 0;
+	if (!(ctx = filter_parse_args(type, tmp)))
+		return;
+	for (long i = 0; i < n; i++)
+		sink = filter(type, ctx, (i * 7) % 100);
+	free(ctx);
+}
+
+static void bench_filter_lossypeak(long n)
+{
+	bench_filter(FILTER_LOSSYPEAK, "2.5,5", n);
+}
+
+static void bench_filter_sma(long n)
+{
+	bench_filter(FILTER_SMA, "10", n);
+}
+
+static void bench_snprintf_float(long n)
+{
+	char buf[16];
+
+	for (long i = 0; i < n; i++) {
+		snprintf(buf, sizeof(buf), "%.1f", (float)(i % 100000) / 7.0f);
+		sink += buf[0];
+	}
+}
+
+static void bench_float_to_str(long n)
+{
+	char buf[16];
+
+	for (long i = 0; i < n; i++) {
+		float_to_str(buf, sizeof(buf), (float)(i % 100000) / 7.0f, 0, 1);
+		sink += buf[0];
+	}
+}
+
+static void bench_fixed_to_str(long n)
+{
+	char buf[16];
+
+	for (long i = 0; i < n; i++) {
+		fixed_to_str(buf, sizeof(buf), i % 1000000, 3, 0, 1);
+		sink += buf[0];
+	}
+}
+
+/* Verify that float_to_str() output matches snprintf() output. */
+static int check_float_to_str(long n)
+{
+	char buf1[64], buf2[64];
+	long errors = 0, count = 0;
+	uint32_t seed = 1;
+
+	for (long i = 0; i < n; i++) {
+		uint32_t bits;
+		float f;
+		double val;
+
+		/* Random (float) bit patterns, small values, and exact ties... */
+		seed = seed * 1664525 + 1013904223;
+		bits = seed;
+		memcpy(&f, &bits, sizeof(f));
+		switch (i % 3) {
+		case 0:
+			val = f;
+			break;
+		case 1:
+			val = (double)((int32_t)bits % 1000000) / 1000.0;
+			break;
+		default:
+			val = (double)((int32_t)bits % 100000) / 1024.0;
+		}
+
+		for (int d = 0; d <= 3; d++) {
+			int w = (i % 2 ? 8 : 0);
+
+			snprintf(buf1, sizeof(buf1), "%*.*f", w, d, val);
+			float_to_str(buf2, sizeof(buf2), val, w, d);
+			count++;
+			if (strcmp(buf1, buf2)) {
+				if (errors++ < 10)
+					printf("float_to_str mismatch: %.17g (%d decimals): '%s' != '%s'\n",
+						val, d, buf2, buf1);
+			}
+		}
+	}
+	printf("float_to_str: %ld conversions checked against snprintf(), %ld mismatches\n\n",
+		count, errors);
+
+	return (errors > 0 ? 1 : 0);
+}
+
+/* Verify fixed_to_str() output (also for values that do not fit in 32bits). */
+static int check_fixed_to_str(long n)
+{
+	char buf1[64], buf2[64], frac[32];
+	long errors = 0, count = 0;
+	uint64_t seed = 1;
+
+	for (long i = 0; i < n; i++) {
+		int64_t val;
+
+		/* Random 64bit values, small values, and values around 2^32... */
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		switch (i % 3) {
+		case 0:
+			val = (int64_t)(seed >> (seed % 40));
+			break;
+		case 1:
+			val = (int64_t)(seed >> 32) % 1000000;
+			break;
+		default:
+			val = (int64_t)UINT32_MAX - 5000 + (int64_t)(seed >> 32) % 10000;
+		}
+		if (seed & 1)
+			val = -val;
+
+		for (int d = 0; d <= 3; d++) {
+			uint64_t u = (val < 0 ? -(uint64_t)val : val);
+			uint64_t div = 1;
+			uint64_t q;
+
+			/* Reference: round half away from zero, then print integer
+			   and fractional parts separately */
+			for (int j = d; j < 3; j++)
+				div *= 10;
+			q = (u + div / 2) / div;
+			div = 1;
+			for (int j = 0; j < d; j++)
+				div *= 10;
+			snprintf(frac, sizeof(frac), ".%0*llu", d, (unsigned long long)(q % div));
+			snprintf(buf1, sizeof(buf1), "%s%llu%s", (val < 0 && q > 0 ? "-" : ""),
+				(unsigned long long)(q / div), (d > 0 ? frac : ""));
+			fixed_to_str(buf2, sizeof(buf2), val, 3, 0, d);
+			count++;
+			if (strcmp(buf1, buf2)) {
+				if (errors++ < 10)
+					printf("fixed_to_str mismatch: %lld (%d decimals): '%s' != '%s'\n",
+						(long long)val, d, buf2, buf1);
+			}
+		}
+	}
+	printf("fixed_to_str: %ld conversions checked, %ld mismatches\n\n",
+		count, errors);
+
+	return (errors > 0 ? 1 : 0);
+}
+
+static void bench_update_outputs(long n)
+{
+	for (long i = 0; i < n; i++) {
+		state.mbfan_duty[0] = i % 101;
+		state.temp[0] = 20.0 + (i % 300) / 10.0;
+		update_outputs(&state, cfg);
+	}
+}
+
+static void bench_process_command(long n)
+{
+	static const char *cmds[] = {
+		"MEAS:FAN1?",
+		"CONF:FAN2:PWMMAP?",
+		"MEAS:TEMP1?",
+		"CONF:MBFAN1:SOURCE?",
+	};
+	char buf[64];
+
+	mute_stdout(true);
+	for (long i = 0; i < n; i++) {
+		strncpy(buf, cmds[i % 4], sizeof(buf));
+		process_command(&state, (struct fanpico_config *)cfg, buf);
+	}
+	mute_stdout(false);
+}
+
+static void bench_config_json(long n)
+{
+	struct fanpico_config *tmp = calloc(1, sizeof(struct fanpico_config));
+
+	if (!tmp)
+		return;
+	mute_stdout(true);
+	for (long i = 0; i < n; i++) {
+		cJSON *json = config_to_json(cfg);
+		char *str = cJSON_PrintUnformatted(json);
+		cJSON_Delete(json);
+		json = cJSON_Parse(str);
+		cJSON_free(str);
+		clear_config(tmp);
+		json_to_config(json, tmp);
+		cJSON_Delete(json);
+	}
+	mute_stdout(false);
+	free(tmp);
+}
+
+/* Generate configuration JSON output (as in save_config()) */
+static void config_save(long n, bool arena)
+{
+	enum mem_subsystems owner = mem_set_owner(MEM_CONFIG);
+
+	for (long i = 0; i < n; i++) {
+		cJSON *json;
+		char *str;
+
+		if (arena)
+			mem_arena_claim(MEM_CONFIG);
+		json = config_to_json(cfg);
+		str = mem_json_print(json);
+		sink += strlen(str);
+		cJSON_free(str);
+		cJSON_Delete(json);
+		if (arena)
+			mem_arena_release(MEM_CONFIG);
+	}
+	mem_set_owner(owner);
+}
+
+static void bench_config_save_heap(long n)
+{
+	config_save(n, false);
+}
+
+static void bench_config_save_arena(long n)
+{
+	config_save(n, true);
+}
+
+/* Parse configuration JSON (as in read_config()) */
+static void config_load(long n, bool arena)
+{
+	struct fanpico_config *tmp = calloc(1, sizeof(struct fanpico_config));
+	enum mem_subsystems owner;
+	cJSON *json;
+	char *str;
+
+	if (!tmp)
+		return;
+	json = config_to_json(cfg);
+	str = cJSON_Print(json);
+	cJSON_Delete(json);
+
+	mute_stdout(true);
+	owner = mem_set_owner(MEM_CONFIG);
+	for (long i = 0; i < n; i++) {
+		if (arena)
+			mem_arena_claim(MEM_CONFIG);
+		json = cJSON_Parse(str);
+		clear_config(tmp);
+		json_to_config(json, tmp);
+		cJSON_Delete(json);
+		if (arena)
+			mem_arena_release(MEM_CONFIG);
+	}
+	mem_set_owner(owner);
+	mute_stdout(false);
+	cJSON_free(str);
+	free(tmp);
+}
+
+static void bench_config_load_heap(long n)
+{
+	config_load(n, false);
+}
+
+static void bench_config_load_arena(long n)
+{
+	config_load(n, true);
+}
+
+
+struct benchmark {
+	const char *name;
+	void (*func)(long n);
+	long divisor;   /* run slower benchmarks with fewer iterations */
+};
+
+static const struct benchmark benchmarks[] = {
+	{ "pwm_map",                bench_pwm_map,               1 },
+	{ "tacho_map",              bench_tacho_map,             1 },
+	{ "sensor_get_duty",        bench_sensor_get_duty,       1 },
+	{ "calculate_pwm_duty",     bench_calculate_pwm_duty,    1 },
+	{ "calculate_tacho_freq",   bench_calculate_tacho_freq,  1 },
+	{ "filter(lossypeak)",      bench_filter_lossypeak,      1 },
+	{ "filter(sma)",            bench_filter_sma,            1 },
+	{ "snprintf(%.1f)",         bench_snprintf_float,        1 },
+	{ "float_to_str",           bench_float_to_str,          1 },
+	{ "fixed_to_str",           bench_fixed_to_str,          1 },
+	{ "update_outputs",         bench_update_outputs,        10 },
+	{ "process_command",        bench_process_command,       100 },
+	{ "config json round-trip", bench_config_json,           1000 },
+	{ "config save (heap)",     bench_config_save_heap,      1000 },
+	{ "config save (arena)",    bench_config_save_arena,     1000 },
+	{ "config load (heap)",     bench_config_load_heap,      1000 },
+	{ "config load (arena)",    bench_config_load_arena,     1000 },
+	{ NULL, NULL, 0 }
+};
+
+
+int main(int argc, char **argv)
+{
+	long iterations = 1000000;
+
+	if (argc > 1)
+		iterations = atol(argv[1]);
+	if (iterations < 1000)
+		iterations = 1000;
+
+	/* Initialize firmware modules with default configuration */
+	mem_init();
+	mute_stdout(true);
+	lfs_setup(false);
+	read_config();
+	setup_pwm_outputs();
+	setup_pwm_inputs();
+	setup_tacho_outputs();
+	clear_state(&state);
+	mute_stdout(false);
+
+	if (check_float_to_str(iterations) || check_fixed_to_str(iterations))
+		return 1;
+
+	printf("%-28s %10s %15s\n", "Benchmark", "Iterations", "Time");
+	for (int i = 0; benchmarks[i].name; i++) {
+		long n = iterations / benchmarks[i].divisor;
+		uint64_t t_start = bench_time_ns();
+
+		benchmarks[i].func(n);
+		report(benchmarks[i].name, bench_time_ns() - t_start, n);
+	}
+
+	return 0;
+}
+
+
+/* eof */
@@ -0,0 +1,204 @@
+/* flash_host.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host version of src/flash.c: "flash filesystem" is a directory
+ * on host (FANPICO_FLASH_DIR environment variable, default: ./flash).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "pico/stdlib.h"
+
+#include "fanpico.h"
+
+#define FS_SIZE  (256*1024)
+
+
+static const char *flash_path(const char *filename, char *buf, size_t size)
+{
+	const char *dir = getenv("FANPICO_FLASH_DIR");
+
+	if (!dir)
+		dir = "flash";
+	while (*filename == '/')
+		filename++;
+	snprintf(buf, size, "%s/%s", dir, filename);
+
+	return buf;
+}
+
+
+void lfs_setup(bool multicore)
+{
+	char path[512];
+
+	flash_path("", path, sizeof(path));
+	if (mkdir(path, 0755) < 0 && errno != EEXIST)
+		log_msg(LOG_ERR, "Cannot create flash directory \"%s\": %d", path, errno);
+}
+
+int flash_format(bool multicore)
+{
+	char path[512];
+	char file[1024];
+	struct dirent *de;
+	DIR *dir;
+
+	if (!(dir = opendir(flash_path("", path, sizeof(path))))) {
+		log_msg(LOG_ERR, "Unable to format flash filesystem: %d", errno);
+		return 1;
+	}
+	while ((de = readdir(dir))) {
+		if (de->d_type != DT_REG)
+			continue;
+		snprintf(file, sizeof(file), "%s/%s", path, de->d_name);
+		unlink(file);
+	}
+	closedir(dir);
+
+	return 0;
+}
+
+int flash_read_file(char **bufptr, uint32_t *sizeptr, const char *filename)
+{
+	char path[512];
+	struct stat st;
+	FILE *fp;
+	int res = 0;
+
+	if (!bufptr || !sizeptr || !filename)
+		return -42;
+
+	*bufptr = NULL;
+	*sizeptr = 0;
+
+	if (!(fp = fopen(flash_path(filename, path, sizeof(path)), "r"))) {
+		log_msg(LOG_DEBUG, "Cannot open file \"%s\": %d", filename, errno);
+		return -3;
+	}
+	if (fstat(fileno(fp), &st) == 0 && st.st_size > 0) {
+		if (!(*bufptr = malloc(st.st_size))) {
+			res = -4;
+		} else {
+			*sizeptr = fread(*bufptr, 1, st.st_size, fp);
+			if (*sizeptr < st.st_size) {
+				log_msg(LOG_ERR, "Error reading file \"%s\": %u",
+					filename, *sizeptr);
+				res = -5;
+			}
+		}
+	}
+	fclose(fp);
+
+	return res;
+}
+
+int flash_write_file(const char *buf, uint32_t size, const char *filename)
+{
+	char path[512];
+	FILE *fp;
+	int res = 0;
+
+	if (!buf || !filename)
+		return -42;
+
+	if (!(fp = fopen(flash_path(filename, path, sizeof(path)), "w"))) {
+		log_msg(LOG_ERR, "Failed to create file \"%s\": %d", filename, errno);
+		return -2;
+	}
+	if (fwrite(buf, 1, size, fp) < size) {
+		log_msg(LOG_ERR, "Failed to write to file \"%s\"", filename);
+		res = -3;
+	} else {
+		log_msg(LOG_INFO, "File \"%s\" successfully created: %u bytes",
+			filename, size);
+	}
+	fclose(fp);
+
+	return res;
+}
+
+int flash_delete_file(const char *filename)
+{
+	char path[512];
+
+	if (!filename)
+		return -42;
+
+	if (unlink(flash_path(filename, path, sizeof(path))) < 0) {
+		log_msg(LOG_ERR, "File \"%s\" not found: %d", filename, errno);
+		return -2;
+	}
+
+	return 0;
+}
+
+int flash_get_fs_info(size_t *size, size_t *free, size_t *files,
+		size_t *directories, size_t *filesizetotal)
+{
+	char path[512];
+	char file[1024];
+	struct dirent *de;
+	struct stat st;
+	size_t f_count = 0;
+	size_t total = 0;
+	DIR *dir;
+
+	if (!size || !free)
+		return -1;
+
+	if (!(dir = opendir(flash_path("", path, sizeof(path)))))
+		return -2;
+	while ((de = readdir(dir))) {
+		snprintf(file, sizeof(file), "%s/%s", path, de->d_name);
+		if (stat(file, &st) == 0 && S_ISREG(st.st_mode)) {
+			f_count++;
+			total += st.st_size;
+		}
+	}
+	closedir(dir);
+
+	*size = FS_SIZE;
+	*free = (total < FS_SIZE ? FS_SIZE - total : 0);
+	if (files)
+		*files = f_count;
+	if (directories)
+		*directories = 0;
+	if (filesizetotal)
+		*filesizetotal = total;
+
+	return 0;
+}
+
+void print_rp2040_flashinfo()
+{
+	printf("Host build: flash filesystem directory \"%s\"\n",
+		getenv("FANPICO_FLASH_DIR") ? getenv("FANPICO_FLASH_DIR") : "flash");
+}
+
+
+/* eof */
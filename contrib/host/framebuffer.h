@@ -0,0 +1,51 @@
+/* framebuffer.h
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Drawing primitives for the display library replacements
+ * (lcd_host.c and oled_host.c).
+ */
+
+#ifndef FANPICO_FRAMEBUFFER_H
+#define FANPICO_FRAMEBUFFER_H 1
+
+#include "hal.h"
+
+/* Cell size of the built-in 5x7 font (including spacing) */
+#define FB_FONT_WIDTH  6
+#define FB_FONT_HEIGHT 8
+
+int fb_init(struct hal_framebuffer *fb, uint16_t width, uint16_t height);
+void fb_free(struct hal_framebuffer *fb);
+void fb_pixel(struct hal_framebuffer *fb, int x, int y, uint16_t color);
+void fb_fill_rect(struct hal_framebuffer *fb, int x, int y, int w, int h, uint16_t color);
+void fb_rect(struct hal_framebuffer *fb, int x, int y, int w, int h, uint16_t color);
+void fb_line(struct hal_framebuffer *fb, int x1, int y1, int x2, int y2, uint16_t color);
+void fb_ellipse(struct hal_framebuffer *fb, int cx, int cy, int rx, int ry, uint16_t color, bool fill);
+int fb_char(struct hal_framebuffer *fb, int x, int y, char c, int cell_w, int cell_h,
+	uint16_t fg, int bg);
+int fb_bmp(struct hal_framebuffer *fb, const uint8_t *bmp, int x, int y, int transparent,
+	uint32_t *pixels);
+
+/* Time to send 'bits' over a bus running at 'bus_hz' */
+void fb_bus_transfer(uint64_t bits, uint32_t bus_hz);
+
+#endif /* FANPICO_FRAMEBUFFER_H */
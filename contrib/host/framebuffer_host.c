@@ -0,0 +1,688 @@
+/* framebuffer_host.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * RGB565 framebuffer drawing (text, lines, rectangles, ellipses and
+ * BMP images) and PNG encoding of framebuffers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+
+#include "framebuffer.h"
+
+
+/* Classic 5x7 font for characters 0x20..0x7e (one byte per column,
+ * bit 0 is the top row). Glyph shapes differ from the fonts in display
+ * libraries, but character cell sizes are the same, so text placement
+ * (and overlaps) on screen match the real display.
+ */
+static const uint8_t font5x7[][5] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 }, /*   */
+	{ 0x00, 0x00, 0x5f, 0x00, 0x00 }, /* ! */
+	{ 0x00, 0x07, 0x00, 0x07, 0x00 }, /* " */
+	{ 0x14, 0x7f, 0x14, 0x7f, 0x14 }, /* # */
+	{ 0x24, 0x2a, 0x7f, 0x2a, 0x12 }, /* $ */
+	{ 0x23, 0x13, 0x08, 0x64, 0x62 }, /* % */
+	{ 0x36, 0x49, 0x55, 0x22, 0x50 }, /* & */
+	{ 0x00, 0x05, 0x03, 0x00, 0x00 }, /* ' */
+	{ 0x00, 0x1c, 0x22, 0x41, 0x00 }, /* ( */
+	{ 0x00, 0x41, 0x22, 0x1c, 0x00 }, /* ) */
+	{ 0x14, 0x08, 0x3e, 0x08, 0x14 }, /* * */
+	{ 0x08, 0x08, 0x3e, 0x08, 0x08 }, /* + */
+	{ 0x00, 0x50, 0x30, 0x00, 0x00 }, /* , */
+	{ 0x08, 0x08, 0x08, 0x08, 0x08 }, /* - */
+	{ 0x00, 0x60, 0x60, 0x00, 0x00 }, /* . */
+	{ 0x20, 0x10, 0x08, 0x04, 0x02 }, /* / */
+	{ 0x3e, 0x51, 0x49, 0x45, 0x3e }, /* 0 */
+	{ 0x00, 0x42, 0x7f, 0x40, 0x00 }, /* 1 */
+	{ 0x42, 0x61, 0x51, 0x49, 0x46 }, /* 2 */
+	{ 0x21, 0x41, 0x45, 0x4b, 0x31 }, /* 3 */
+	{ 0x18, 0x14, 0x12, 0x7f, 0x10 }, /* 4 */
+	{ 0x27, 0x45, 0x45, 0x45, 0x39 }, /* 5 */
+	{ 0x3c, 0x4a, 0x49, 0x49, 0x30 }, /* 6 */
+	{ 0x01, 0x71, 0x09, 0x05, 0x03 }, /* 7 */
+	{ 0x36, 0x49, 0x49, 0x49, 0x36 }, /* 8 */
+	{ 0x06, 0x49, 0x49, 0x29, 0x1e }, /* 9 */
+	{ 0x00, 0x36, 0x36, 0x00, 0x00 }, /* : */
+	{ 0x00, 0x56, 0x36, 0x00, 0x00 }, /* ; */
+	{ 0x08, 0x14, 0x22, 0x41, 0x00 }, /* < */
+	{ 0x14, 0x14, 0x14, 0x14, 0x14 }, /* = */
+	{ 0x00, 0x41, 0x22, 0x14, 0x08 }, /* > */
+	{ 0x02, 0x01, 0x51, 0x09, 0x06 }, /* ? */
+	{ 0x32, 0x49, 0x79, 0x41, 0x3e }, /* @ */
+	{ 0x7e, 0x11, 0x11, 0x11, 0x7e }, /* A */
+	{ 0x7f, 0x49, 0x49, 0x49, 0x36 }, /* B */
+	{ 0x3e, 0x41, 0x41, 0x41, 0x22 }, /* C */
+	{ 0x7f, 0x41, 0x41, 0x22, 0x1c }, /* D */
+	{ 0x7f, 0x49, 0x49, 0x49, 0x41 }, /* E */
+	{ 0x7f, 0x09, 0x09, 0x09, 0x01 }, /* F */
+	{ 0x3e, 0x41, 0x49, 0x49, 0x7a }, /* G */
+	{ 0x7f, 0x08, 0x08, 0x08, 0x7f }, /* H */
+	{ 0x00, 0x41, 0x7f, 0x41, 0x00 }, /* I */
+	{ 0x20, 0x40, 0x41, 0x3f, 0x01 }, /* J */
+	{ 0x7f, 0x08, 0x14, 0x22, 0x41 }, /* K */
+	{ 0x7f, 0x40, 0x40, 0x40, 0x40 }, /* L */
+	{ 0x7f, 0x02, 0x0c, 0x02, 0x7f }, /* M */
+	{ 0x7f, 0x04, 0x08, 0x10, 0x7f }, /* N */
+	{ 0x3e, 0x41, 0x41, 0x41, 0x3e }, /* O */
+	{ 0x7f, 0x09, 0x09, 0x09, 0x06 }, /* P */
+	{ 0x3e, 0x41, 0x51, 0x21, 0x5e }, /* Q */
+	{ 0x7f, 0x09, 0x19, 0x29, 0x46 }, /* R */
+	{ 0x46, 0x49, 0x49, 0x49, 0x31 }, /* S */
+	{ 0x01, 0x01, 0x7f, 0x01, 0x01 }, /* T */
+	{ 0x3f, 0x40, 0x40, 0x40, 0x3f }, /* U */
+	{ 0x1f, 0x20, 0x40, 0x20, 0x1f }, /* V */
+	{ 0x3f, 0x40, 0x38, 0x40, 0x3f }, /* W */
+	{ 0x63, 0x14, 0x08, 0x14, 0x63 }, /* X */
+	{ 0x07, 0x08, 0x70, 0x08, 0x07 }, /* Y */
+	{ 0x61, 0x51, 0x49, 0x45, 0x43 }, /* Z */
+	{ 0x00, 0x7f, 0x41, 0x41, 0x00 }, /* [ */
+	{ 0x02, 0x04, 0x08, 0x10, 0x20 }, /* \ */
+	{ 0x00, 0x41, 0x41, 0x7f, 0x00 }, /* ] */
+	{ 0x04, 0x02, 0x01, 0x02, 0x04 }, /* ^ */
+	{ 0x40, 0x40, 0x40, 0x40, 0x40 }, /* _ */
+	{ 0x00, 0x01, 0x02, 0x04, 0x00 }, /* ` */
+	{ 0x20, 0x54, 0x54, 0x54, 0x78 }, /* a */
+	{ 0x7f, 0x48, 0x44, 0x44, 0x38 }, /* b */
+	{ 0x38, 0x44, 0x44, 0x44, 0x20 }, /* c */
+	{ 0x38, 0x44, 0x44, 0x48, 0x7f }, /* d */
+	{ 0x38, 0x54, 0x54, 0x54, 0x18 }, /* e */
+	{ 0x08, 0x7e, 0x09, 0x01, 0x02 }, /* f */
+	{ 0x0c, 0x52, 0x52, 0x52, 0x3e }, /* g */
+	{ 0x7f, 0x08, 0x04, 0x04, 0x78 }, /* h */
+	{ 0x00, 0x44, 0x7d, 0x40, 0x00 }, /* i */
+	{ 0x20, 0x40, 0x44, 0x3d, 0x00 }, /* j */
+	{ 0x7f, 0x10, 0x28, 0x44, 0x00 }, /* k */
+	{ 0x00, 0x41, 0x7f, 0x40, 0x00 }, /* l */
+	{ 0x7c, 0x04, 0x18, 0x04, 0x78 }, /* m */
+	{ 0x7c, 0x08, 0x04, 0x04, 0x78 }, /* n */
+	{ 0x38, 0x44, 0x44, 0x44, 0x38 }, /* o */
+	{ 0x7c, 0x14, 0x14, 0x14, 0x08 }, /* p */
+	{ 0x08, 0x14, 0x14, 0x18, 0x7c }, /* q */
+	{ 0x7c, 0x08, 0x04, 0x04, 0x08 }, /* r */
+	{ 0x48, 0x54, 0x54, 0x54, 0x20 }, /* s */
+	{ 0x04, 0x3f, 0x44, 0x40, 0x20 }, /* t */
+	{ 0x3c, 0x40, 0x40, 0x20, 0x7c }, /* u */
+	{ 0x1c, 0x20, 0x40, 0x20, 0x1c }, /* v */
+	{ 0x3c, 0x40, 0x30, 0x40, 0x3c }, /* w */
+	{ 0x44, 0x28, 0x10, 0x28, 0x44 }, /* x */
+	{ 0x0c, 0x50, 0x50, 0x50, 0x3c }, /* y */
+	{ 0x44, 0x64, 0x54, 0x4c, 0x44 }, /* z */
+	{ 0x00, 0x08, 0x36, 0x41, 0x00 }, /* { */
+	{ 0x00, 0x00, 0x7f, 0x00, 0x00 }, /* | */
+	{ 0x00, 0x41, 0x36, 0x08, 0x00 }, /* } */
+	{ 0x10, 0x08, 0x08, 0x10, 0x08 }, /* ~ */
+};
+
+/* Glyph drawn for characters not in the font */
+static const uint8_t font5x7_unknown[5] = { 0x7f, 0x41, 0x41, 0x41, 0x7f };
+
+static bool bus_timing = false;
+static uint64_t bus_time_ns = 0;
+
+
+int fb_init(struct hal_framebuffer *fb, uint16_t width, uint16_t height)
+{
+	uint16_t *pixels = calloc((size_t)width * height, sizeof(uint16_t));
+
+	if (!pixels)
+		return -1;
+	free(fb->pixels);
+	fb->pixels = pixels;
+	fb->width = width;
+	fb->height = height;
+
+	return 0;
+}
+
+void fb_free(struct hal_framebuffer *fb)
+{
+	free(fb->pixels);
+	fb->pixels = NULL;
+	fb->width = fb->height = 0;
+}
+
+void fb_pixel(struct hal_framebuffer *fb, int x, int y, uint16_t color)
+{
+	if (x < 0 || y < 0 || x >= fb->width || y >= fb->height)
+		return;
+	fb->pixels[y * fb->width + x] = color;
+}
+
+void fb_fill_rect(struct hal_framebuffer *fb, int x, int y, int w, int h, uint16_t color)
+{
+	int x2 = x + w;
+	int y2 = y + h;
+
+	if (x < 0)
+		x = 0;
+	if (y < 0)
+		y = 0;
+	if (x2 > fb->width)
+		x2 = fb->width;
+	if (y2 > fb->height)
+		y2 = fb->height;
+
+	for (int j = y; j < y2; j++) {
+		uint16_t *p = &fb->pixels[j * fb->width];
+		for (int i = x; i < x2; i++)
+			p[i] = color;
+	}
+}
+
+void fb_rect(struct hal_framebuffer *fb, int x, int y, int w, int h, uint16_t color)
+{
+	if (w < 1 || h < 1)
+		return;
+	fb_fill_rect(fb, x, y, w, 1, color);
+	fb_fill_rect(fb, x, y + h - 1, w, 1, color);
+	fb_fill_rect(fb, x, y, 1, h, color);
+	fb_fill_rect(fb, x + w - 1, y, 1, h, color);
+}
+
+void fb_line(struct hal_framebuffer *fb, int x1, int y1, int x2, int y2, uint16_t color)
+{
+	int dx = abs(x2 - x1);
+	int dy = -abs(y2 - y1);
+	int sx = (x1 < x2 ? 1 : -1);
+	int sy = (y1 < y2 ? 1 : -1);
+	int err = dx + dy;
+
+	while (1) {
+		fb_pixel(fb, x1, y1, color);
+		if (x1 == x2 && y1 == y2)
+			break;
+		if (2 * err >= dy) {
+			err += dy;
+			x1 += sx;
+		}
+		if (2 * err <= dx) {
+			err += dx;
+			y1 += sy;
+		}
+	}
+}
+
+void fb_ellipse(struct hal_framebuffer *fb, int cx, int cy, int rx, int ry, uint16_t color, bool fill)
+{
+	int prev = -1;
+
+	if (rx < 0 || ry < 0)
+		return;
+
+	for (int dy = ry; dy >= 0; dy--) {
+		double f = (ry > 0 ? (double)dy / ry : 0.0);
+		int dx = lround(rx * sqrt(1.0 - f * f));
+
+		if (fill) {
+			fb_fill_rect(fb, cx - dx, cy - dy, 2 * dx + 1, 1, color);
+			fb_fill_rect(fb, cx - dx, cy + dy, 2 * dx + 1, 1, color);
+		} else {
+			/* connect to previous row, so that outline has no gaps */
+			int from = (prev < 0 ? dx : prev + 1);
+			if (from > dx)
+				from = dx;
+			for (int i = from; i <= dx; i++) {
+				fb_pixel(fb, cx - i, cy - dy, color);
+				fb_pixel(fb, cx + i, cy - dy, color);
+				fb_pixel(fb, cx - i, cy + dy, color);
+				fb_pixel(fb, cx + i, cy + dy, color);
+			}
+			prev = dx;
+		}
+	}
+}
+
+/* Draw character using cell size of the given font (6x8, 8x8, 12x16,
+ * 16x16, 16x32). Larger fonts are scaled up versions of 6x8 or 8x8 cell.
+ * If 'bg' is negative, background is not drawn (transparent).
+ */
+int fb_char(struct hal_framebuffer *fb, int x, int y, char c, int cell_w, int cell_h,
+	uint16_t fg, int bg)
+{
+	const uint8_t *glyph = font5x7_unknown;
+	int base_w = (cell_w % 8 == 0 ? 8 : FB_FONT_WIDTH);
+	int offset = (base_w == 8 ? 1 : 0);
+	int sx = cell_w / base_w;
+	int sy = cell_h / FB_FONT_HEIGHT;
+
+	if (sx < 1)
+		sx = 1;
+	if (sy < 1)
+		sy = 1;
+	if (c >= 0x20 && c <= 0x7e)
+		glyph = font5x7[c - 0x20];
+
+	for (int py = 0; py < cell_h; py++) {
+		int row = py / sy;
+
+		for (int px = 0; px < cell_w; px++) {
+			int col = px / sx - offset;
+			bool set = (col >= 0 && col < 5 && row < 8 && (glyph[col] & (1 << row)));
+
+			if (set)
+				fb_pixel(fb, x + px, y + py, fg);
+			else if (bg >= 0)
+				fb_pixel(fb, x + px, y + py, bg);
+		}
+	}
+
+	return cell_w;
+}
+
+
+static inline uint16_t rgb565(uint8_t r, uint8_t g, uint8_t b)
+{
+	return ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+}
+
+static inline uint32_t le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+struct bmp_draw {
+	struct hal_framebuffer *fb;
+	int x;
+	int y;
+	int height;
+	bool bottom_up;
+	int transparent;
+	uint32_t pixels;
+};
+
+static void bmp_pixel(struct bmp_draw *d, int col, int row, uint16_t color)
+{
+	int y = (d->bottom_up ? d->height - 1 - row : row);
+
+	if (d->transparent >= 0 && color == d->transparent)
+		return;
+	fb_pixel(d->fb, d->x + col, d->y + y, color);
+	d->pixels++;
+}
+
+/* Draw BMP image (8bit with palette, either uncompressed or RLE8 compressed,
+ * or 16/24bit uncompressed). Color 'transparent' is not drawn, unless
+ * it is negative. Returns -1 if image is not supported.
+ */
+int fb_bmp(struct hal_framebuffer *fb, const uint8_t *bmp, int x, int y, int transparent,
+	uint32_t *pixels)
+{
+	struct bmp_draw d;
+	uint16_t palette[256];
+	uint32_t offset, dib_size, compression, colors;
+	int32_t width, height;
+	uint16_t bpp;
+	const uint8_t *p;
+
+	if (!bmp || bmp[0] != 'B' || bmp[1] != 'M')
+		return -1;
+	offset = le32(bmp + 10);
+	dib_size = le32(bmp + 14);
+	width = (int32_t)le32(bmp + 18);
+	height = (int32_t)le32(bmp + 22);
+	bpp = le16(bmp + 28);
+	compression = le32(bmp + 30);
+	colors = le32(bmp + 46);
+	if (width <= 0 || height == 0)
+		return -1;
+
+	d.fb = fb;
+	d.x = x;
+	d.y = y;
+	d.bottom_up = (height > 0);
+	d.height = abs(height);
+	d.transparent = transparent;
+	d.pixels = 0;
+
+	if (bpp == 8) {
+		if (colors == 0 || colors > 256)
+			colors = 256;
+		p = bmp + 14 + dib_size;
+		for (int i = 0; i < colors; i++, p += 4)
+			palette[i] = rgb565(p[2], p[1], p[0]);
+	}
+
+	p = bmp + offset;
+	if (bpp == 8 && compression == 1) {
+		/* RLE8 */
+		int col = 0, row = 0;
+		while (row < d.height) {
+			uint8_t count = *p++;
+			uint8_t val = *p++;
+
+			if (count > 0) {
+				for (int i = 0; i < count; i++)
+					bmp_pixel(&d, col++, row, palette[val]);
+			} else if (val == 0) {
+				col = 0;
+				row++;
+			} else if (val == 1) {
+				break;
+			} else if (val == 2) {
+				col += p[0];
+				row += p[1];
+				p += 2;
+			} else {
+				for (int i = 0; i < val; i++)
+					bmp_pixel(&d, col++, row, palette[p[i]]);
+				p += val + (val & 1);
+			}
+		}
+	} else if (compression == 0 || (bpp == 16 && compression == 3)) {
+		uint32_t stride = ((width * bpp + 31) / 32) * 4;
+
+		for (int row = 0; row < d.height; row++) {
+			const uint8_t *r = p + row * stride;
+			for (int col = 0; col < width; col++) {
+				uint16_t color, v;
+
+				switch (bpp) {
+				case 8:
+					color = palette[r[col]];
+					break;
+				case 16:
+					v = le16(r + col * 2);
+					if (compression == 0) /* RGB555 */
+						v = ((v & 0x7fe0) << 1) | (v & 0x1f);
+					color = v;
+					break;
+				case 24:
+					color = rgb565(r[col * 3 + 2], r[col * 3 + 1], r[col * 3]);
+					break;
+				default:
+					return -1;
+				}
+				bmp_pixel(&d, col, row, color);
+			}
+		}
+	} else {
+		return -1;
+	}
+
+	if (pixels)
+		*pixels = d.pixels;
+
+	return 0;
+}
+
+
+void hal_display_set_bus_timing(bool enabled)
+{
+	bus_timing = enabled;
+	bus_time_ns = 0;
+}
+
+void fb_bus_transfer(uint64_t bits, uint32_t bus_hz)
+{
+	if (!bus_timing || bus_hz == 0)
+		return;
+
+	bus_time_ns += bits * 1000000000ULL / bus_hz;
+	if (bus_time_ns >= 1000) {
+		busy_wait_us(bus_time_ns / 1000);
+		bus_time_ns %= 1000;
+	}
+}
+
+
+/*
+ * PNG encoding. Image data is compressed using fixed Huffman codes,
+ * and repeated pixels are encoded as matches against previous pixel
+ * or the pixel above, which is enough for display screenshots.
+ * Output only depends on the image, so images can be compared
+ * byte by byte.
+ */
+
+struct png_buf {
+	uint8_t *data;
+	size_t len;
+	size_t size;
+	bool error;
+	uint32_t bits;
+	int bit_count;
+};
+
+static void png_put(struct png_buf *b, const void *data, size_t len)
+{
+	if (b->error || len == 0)
+		return;
+	if (b->len + len > b->size) {
+		size_t size = (b->size > 0 ? b->size * 2 : 4096);
+		while (size < b->len + len)
+			size *= 2;
+		uint8_t *n = realloc(b->data, size);
+		if (!n) {
+			b->error = true;
+			return;
+		}
+		b->data = n;
+		b->size = size;
+	}
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+static void png_put32(struct png_buf *b, uint32_t val)
+{
+	uint8_t d[4] = { val >> 24, val >> 16, val >> 8, val };
+
+	png_put(b, d, 4);
+}
+
+static void put_bits(struct png_buf *b, uint32_t val, int n)
+{
+	b->bits |= val << b->bit_count;
+	b->bit_count += n;
+	while (b->bit_count >= 8) {
+		uint8_t c = b->bits;
+		png_put(b, &c, 1);
+		b->bits >>= 8;
+		b->bit_count -= 8;
+	}
+}
+
+/* Huffman codes are stored starting from the most significant bit */
+static void put_huff(struct png_buf *b, uint32_t code, int n)
+{
+	uint32_t r = 0;
+
+	for (int i = 0; i < n; i++)
+		r |= ((code >> i) & 1) << (n - 1 - i);
+	put_bits(b, r, n);
+}
+
+static void deflate_symbol(struct png_buf *b, int sym)
+{
+	if (sym < 144)
+		put_huff(b, 0x30 + sym, 8);
+	else if (sym < 256)
+		put_huff(b, 0x190 + sym - 144, 9);
+	else if (sym < 280)
+		put_huff(b, sym - 256, 7);
+	else
+		put_huff(b, 0xc0 + sym - 280, 8);
+}
+
+static void deflate_match(struct png_buf *b, int len, int dist)
+{
+	static const uint16_t len_base[] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const uint8_t len_extra[] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t dist_base[] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+		8193, 12289, 16385, 24577 };
+	static const uint8_t dist_extra[] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	int i;
+
+	i = count_of(len_base) - 1;
+	while (len_base[i] > len)
+		i--;
+	deflate_symbol(b, 257 + i);
+	put_bits(b, len - len_base[i], len_extra[i]);
+
+	i = count_of(dist_base) - 1;
+	while (dist_base[i] > dist)
+		i--;
+	put_huff(b, i, 5);
+	put_bits(b, dist - dist_base[i], dist_extra[i]);
+}
+
+static uint32_t png_crc(const uint8_t *buf, size_t len)
+{
+	uint32_t crc = 0xffffffff;
+
+	for (size_t i = 0; i < len; i++) {
+		crc ^= buf[i];
+		for (int j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+
+	return ~crc;
+}
+
+static void png_chunk(struct png_buf *b, const char *type, const uint8_t *data, size_t len)
+{
+	size_t start;
+
+	png_put32(b, len);
+	start = b->len;
+	png_put(b, type, 4);
+	png_put(b, data, len);
+	if (!b->error)
+		png_put32(b, png_crc(b->data + start, len + 4));
+}
+
+uint8_t *hal_framebuffer_png(const struct hal_framebuffer *fb, size_t *len)
+{
+	static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	struct png_buf png, z;
+	size_t stride, raw_len, pos;
+	uint32_t s1 = 1, s2 = 0;
+	uint8_t ihdr[13], *raw;
+
+	if (!fb || !fb->pixels || !len)
+		return NULL;
+
+	/* Scanlines: filter type (none) + RGB888 pixels */
+	stride = 1 + fb->width * 3;
+	raw_len = stride * fb->height;
+	if (!(raw = malloc(raw_len)))
+		return NULL;
+	for (int y = 0; y < fb->height; y++) {
+		uint8_t *r = raw + y * stride;
+		*r++ = 0;
+		for (int x = 0; x < fb->width; x++) {
+			uint16_t c = fb->pixels[y * fb->width + x];
+			*r++ = ((c >> 11) & 0x1f) * 255 / 31;
+			*r++ = ((c >> 5) & 0x3f) * 255 / 63;
+			*r++ = (c & 0x1f) * 255 / 31;
+		}
+	}
+
+	/* zlib stream with single (fixed Huffman) deflate block */
+	memset(&z, 0, sizeof(z));
+	png_put(&z, "\x78\x01", 2);
+	put_bits(&z, 1, 1);
+	put_bits(&z, 1, 2);
+	pos = 0;
+	while (pos < raw_len) {
+		const size_t dists[] = { 3, stride };
+		size_t best_len = 0, best_dist = 0;
+		size_t max = raw_len - pos;
+
+		if (max > 258)
+			max = 258;
+		for (int i = 0; i < count_of(dists); i++) {
+			size_t d = dists[i], l = 0;
+			if (d > pos || d > 32768)
+				continue;
+			while (l < max && raw[pos + l] == raw[pos + l - d])
+				l++;
+			if (l > best_len) {
+				best_len = l;
+				best_dist = d;
+			}
+		}
+		if (best_len >= 3) {
+			deflate_match(&z, best_len, best_dist);
+			pos += best_len;
+		} else {
+			deflate_symbol(&z, raw[pos++]);
+		}
+	}
+	deflate_symbol(&z, 256);
+	if (z.bit_count > 0)
+		put_bits(&z, 0, 8 - z.bit_count);
+	for (size_t i = 0; i < raw_len; i++) {
+		s1 = (s1 + raw[i]) % 65521;
+		s2 = (s2 + s1) % 65521;
+	}
+	png_put32(&z, (s2 << 16) | s1);
+	free(raw);
+
+	ihdr[0] = fb->width >> 24;
+	ihdr[1] = fb->width >> 16;
+	ihdr[2] = fb->width >> 8;
+	ihdr[3] = fb->width;
+	ihdr[4] = fb->height >> 24;
+	ihdr[5] = fb->height >> 16;
+	ihdr[6] = fb->height >> 8;
+	ihdr[7] = fb->height;
+	ihdr[8] = 8;  /* bit depth */
+	ihdr[9] = 2;  /* color type: RGB */
+	ihdr[10] = 0; /* compression */
+	ihdr[11] = 0; /* filter */
+	ihdr[12] = 0; /* interlace */
+
+	memset(&png, 0, sizeof(png));
+	png_put(&png, signature, sizeof(signature));
+	png_chunk(&png, "IHDR", ihdr, sizeof(ihdr));
+	png_chunk(&png, "IDAT", z.data, z.len);
+	png_chunk(&png, "IEND", NULL, 0);
+	free(z.data);
+
+	if (z.error || png.error) {
+		free(png.data);
+		return NULL;
+	}
+	*len = png.len;
+
+	return png.data;
+}
+
+
+/* eof */
@@ -0,0 +1,53 @@
+# corpus.cmake
+#
+# Generate seed corpus for the fuzz targets:
+#
+#   command/  commands from examples in commands.md
+#   mqtt/     same commands as MQTT command topic payloads
+#   filter/   filter settings (name,args) from FILTER command examples
+#   config/   default configuration (default_config.json)
+#
+# Usage: cmake -DFANPICO_DIR=<dir> -DCORPUS_DIR=<dir> -P corpus.cmake
+#
+
+function(add_seed target data)
+  string(SHA1 name "${data}")
+  file(WRITE ${CORPUS_DIR}/${target}/${name} "${data}")
+endfunction()
+
+file(REMOVE_RECURSE ${CORPUS_DIR})
+file(MAKE_DIRECTORY ${CORPUS_DIR}/command ${CORPUS_DIR}/mqtt
+  ${CORPUS_DIR}/filter ${CORPUS_DIR}/config)
+
+# Split commands.md into lines (protecting ';' from CMake list handling)
+file(READ ${FANPICO_DIR}/commands.md doc)
+string(REPLACE ";" "<semicolon>" doc "${doc}")
+string(REPLACE "\n" ";" lines "${doc}")
+
+set(code_block FALSE)
+foreach(line IN LISTS lines)
+  string(REPLACE "<semicolon>" ";" line "${line}")
+  if(line MATCHES "^```")
+    if(code_block)
+      set(code_block FALSE)
+    else()
+      set(code_block TRUE)
+    endif()
+    continue()
+  endif()
+  if(NOT code_block)
+    continue()
+  endif()
+  # Example blocks contain commands and their output, only use commands
+  if(line MATCHES "^(\\*[A-Za-z]+\\??|[A-Za-z]+:[A-Za-z0-9:*?]*)( .*)?$")
+    add_seed(command "${line}")
+    add_seed(mqtt "${line}")
+    add_seed(mqtt "CMD:${line}\r\n")
+    if(line MATCHES ":FILTER ([^ ]+)$")
+      add_seed(filter "${CMAKE_MATCH_1}")
+    endif()
+  endif()
+endforeach()
+
+file(READ ${FANPICO_DIR}/src/default_config.json json)
+add_seed(config "${json}")
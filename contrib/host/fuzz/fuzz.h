@@ -0,0 +1,55 @@
+/* fuzz.h
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FANPICO_FUZZ_H
+#define FANPICO_FUZZ_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include "cJSON.h"
+
+#include "fanpico.h"
+
+
+/* Symbols without declarations in fanpico.h */
+extern const char fanpico_default_config[];
+void clear_state(struct fanpico_state *s);
+void clear_config(struct fanpico_config *cfg);
+cJSON *config_to_json(const struct fanpico_config *cfg);
+int json_to_config(cJSON *config, struct fanpico_config *cfg);
+
+/* libFuzzer entry points */
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/* Jump buffer used when firmware code reboots (*RST, SYS:UPGRADE). */
+extern jmp_buf fuzz_reboot;
+
+extern struct fanpico_state fuzz_state;
+
+void fuzz_setup();
+void fuzz_reset_config();
+void fuzz_free_filters(struct fanpico_config *config);
+char* fuzz_strndup(const uint8_t *data, size_t size, size_t max_len);
+void fuzz_command(char *cmd);
+
+#endif /* FANPICO_FUZZ_H */
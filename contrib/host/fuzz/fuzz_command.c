@@ -1,5 +1,5 @@
-/* square_wave_gen.h
-   Copyright (C) 2021-2022 Timo Kokkonen <tjko@iki.fi>
+/* fuzz_command.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
 
    SPDX-License-Identifier: GPL-3.0-or-later
 
@@ -19,16 +19,39 @@
    along with FanPico. If not, see <https://www.gnu.org/licenses/>.
 */
 
-#ifndef SQUARE_WAVE_GEN_H
-#define SQUARE_WAVE_GEN_H 1
+/*
+ * Fuzz target for the SCPI command parser (process_command()).
+ *
+ * Input is a command line (as received from console or telnet/ssh),
+ * possibly with multiple commands separated by ';'.
+ */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
 
-uint square_wave_gen_load_program(PIO pio);
-void square_wave_gen_program_init(PIO pio, uint sm, uint offset, uint pin);
-void square_wave_gen_enabled(PIO pio, uint sm, bool enabled);
-void square_wave_gen_set_period(PIO pio, uint sm, uint32_t period);
-void square_wave_gen_set_freq(PIO pio, uint sm, double freq);
+#include "fuzz.h"
 
-#endif /* SQUARE_WAVE_GEN_H */
+/* Same as console input buffer size */
+#define MAX_COMMAND_LEN 1024
 
 
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	fuzz_setup();
+	return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	char *cmd = fuzz_strndup(data, size, MAX_COMMAND_LEN);
+
+	fuzz_command(cmd);
+	fuzz_reset_config();
+	free(cmd);
+
+	return 0;
+}
+
+
+/* eof */
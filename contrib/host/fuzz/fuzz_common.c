@@ -0,0 +1,134 @@
+/* fuzz_common.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Common setup for the fuzz targets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "fuzz.h"
+
+
+jmp_buf fuzz_reboot;
+struct fanpico_state fuzz_state;
+
+
+static void fuzz_reboot_callback()
+{
+	longjmp(fuzz_reboot, 1);
+}
+
+
+void fuzz_setup()
+{
+	static bool setup_done = false;
+	static char flash_dir[] = "/tmp/fanpico-fuzz-XXXXXX";
+
+	if (setup_done)
+		return;
+	setup_done = true;
+
+	/* Keep configuration saved by commands (CONF:SAVE) out of
+	   current directory. */
+	if (!getenv("FANPICO_FLASH_DIR") && mkdtemp(flash_dir))
+		setenv("FANPICO_FLASH_DIR", flash_dir, 1);
+
+	hal_set_simulated_time(true);
+	hal_set_reboot_callback(fuzz_reboot_callback);
+	mem_init();
+	lfs_setup(false);
+	read_config();
+	clear_state(&fuzz_state);
+}
+
+
+/* Release signal filter contexts (clear_config() does not free them). */
+void fuzz_free_filters(struct fanpico_config *config)
+{
+	void **ctx[SENSOR_MAX_COUNT + VSENSOR_MAX_COUNT + FAN_MAX_COUNT
+		+ ZONE_MAX_COUNT + MBFAN_MAX_COUNT];
+	int n = 0;
+
+	for (int i = 0; i < SENSOR_MAX_COUNT; i++)
+		ctx[n++] = &config->sensors[i].filter_ctx;
+	for (int i = 0; i < VSENSOR_MAX_COUNT; i++)
+		ctx[n++] = &config->vsensors[i].filter_ctx;
+	for (int i = 0; i < FAN_MAX_COUNT; i++)
+		ctx[n++] = &config->fans[i].filter_ctx;
+	for (int i = 0; i < ZONE_MAX_COUNT; i++)
+		ctx[n++] = &config->zones[i].filter_ctx;
+	for (int i = 0; i < MBFAN_MAX_COUNT; i++)
+		ctx[n++] = &config->mbfans[i].filter_ctx;
+
+	for (int i = 0; i < n; i++) {
+		mem_free(MEM_FILTERS, *ctx[i]);
+		*ctx[i] = NULL;
+	}
+}
+
+
+/* Reset configuration to firmware defaults (and clear state), so that
+ * every input starts from the same state. */
+void fuzz_reset_config()
+{
+	struct fanpico_config *config = (struct fanpico_config *)cfg;
+	cJSON *json;
+
+	fuzz_free_filters(config);
+	clear_config(config);
+	if ((json = cJSON_Parse(fanpico_default_config))) {
+		json_to_config(json, config);
+		cJSON_Delete(json);
+	}
+	clear_state(&fuzz_state);
+}
+
+
+/* Return input as a (newly allocated) NUL terminated string. */
+char* fuzz_strndup(const uint8_t *data, size_t size, size_t max_len)
+{
+	char *s;
+
+	if (size > max_len)
+		size = max_len;
+	if (!(s = malloc(size + 1)))
+		abort();
+	memcpy(s, data, size);
+	s[size] = 0;
+
+	return s;
+}
+
+
+/* Run SCPI command(s) as received from console. Reboot requests
+ * return here. */
+void fuzz_command(char *cmd)
+{
+	if (setjmp(fuzz_reboot) == 0)
+		process_command(&fuzz_state, (struct fanpico_config *)cfg, cmd);
+}
+
+
+/* eof */
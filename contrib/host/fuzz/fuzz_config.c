@@ -0,0 +1,77 @@
+/* fuzz_config.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Fuzz target for configuration parsing (json_to_config()) as done in
+ * read_config(). Parsed configuration is also converted back to JSON
+ * (as done when saving configuration).
+ *
+ * Input is configuration file (fanpico.cfg) contents.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+
+#include "fuzz.h"
+
+/* Configuration files larger than this cannot be saved in flash */
+#define MAX_CONFIG_LEN (64 * 1024)
+
+static struct fanpico_config config;
+
+
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	fuzz_setup();
+	return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	char *buf, *out;
+	cJSON *json;
+
+	if (size > MAX_CONFIG_LEN)
+		return 0;
+
+	buf = fuzz_strndup(data, size, size);
+	json = cJSON_Parse(buf);
+	free(buf);
+	if (!json)
+		return 0;
+
+	clear_config(&config);
+	json_to_config(json, &config);
+	cJSON_Delete(json);
+
+	if ((json = config_to_json(&config))) {
+		if ((out = cJSON_Print(json)))
+			cJSON_free(out);
+		cJSON_Delete(json);
+	}
+	fuzz_free_filters(&config);
+
+	return 0;
+}
+
+
+/* eof */
@@ -0,0 +1,72 @@
+/* fuzz_filter.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Fuzz target for signal filter argument parsing (filter_parse_args()).
+ *
+ * Input is filter name and arguments, as in FILTER commands
+ * (for example "sma,10"). Parsed filter is also run against a fixed
+ * input signal.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+
+#include "fuzz.h"
+
+#define MAX_FILTER_LEN 256
+
+
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	fuzz_setup();
+	return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	const float input[] = { 0.0, 100.0, -40.0, 25.5, 1e9, -1e9, 0.0, 50.0 };
+	enum signal_filter_types type;
+	char *buf, *args, *s;
+	void *ctx;
+
+	buf = fuzz_strndup(data, size, MAX_FILTER_LEN);
+	if ((args = strchr(buf, ',')))
+		*args++ = 0;
+	type = str2filter(buf);
+
+	if ((ctx = filter_parse_args(type, args ? args : ""))) {
+		if ((s = filter_print_args(type, ctx)))
+			free(s);
+		for (int i = 0; i < 64; i++)
+			filter(type, ctx, input[i % count_of(input)]);
+		mem_free(MEM_FILTERS, ctx);
+	}
+	free(buf);
+
+	return 0;
+}
+
+
+/* eof */
@@ -0,0 +1,64 @@
+/* fuzz_mqtt.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Fuzz target for MQTT command topic handling: payload is parsed
+ * (mqtt_parse_command()) as done in mqtt_incoming_data_cb(), and accepted
+ * command is then run as done in fanpico_mqtt_scpi_command().
+ *
+ * Input is the message payload. Each input is run with SCPI commands
+ * both disallowed (only WRITE: commands accepted) and allowed
+ * (mqtt_allow_scpi).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+
+#include "fuzz.h"
+
+
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	fuzz_setup();
+	return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	char cmd[MQTT_CMD_MAX_LEN];
+
+	/* MQTT payload length is 16bit (u16_t) */
+	if (size > UINT16_MAX)
+		return 0;
+
+	for (int allow_scpi = 0; allow_scpi < 2; allow_scpi++) {
+		if (mqtt_parse_command(data, size, allow_scpi, cmd, sizeof(cmd)))
+			continue;
+		fuzz_command(cmd);
+		fuzz_reset_config();
+	}
+
+	return 0;
+}
+
+
+/* eof */
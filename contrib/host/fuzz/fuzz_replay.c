@@ -0,0 +1,118 @@
+/* fuzz_replay.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Run inputs through a fuzz target without libFuzzer: for compilers
+ * without -fsanitize=fuzzer support, and for running the seed corpus
+ * as a test. Arguments are input files or directories (all files in
+ * directory are run). Options (e.g. -runs=0) are ignored, so that same
+ * command line works with libFuzzer built targets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "fuzz.h"
+
+
+static int run_file(const char *filename)
+{
+	FILE *fp;
+	uint8_t *buf;
+	long size;
+
+	if (!(fp = fopen(filename, "rb"))) {
+		fprintf(stderr, "%s: cannot open file\n", filename);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	if (size < 0 || !(buf = malloc(size + 1)) || fread(buf, 1, size, fp) != size) {
+		fprintf(stderr, "%s: read failed\n", filename);
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	LLVMFuzzerTestOneInput(buf, size);
+	free(buf);
+
+	return 0;
+}
+
+static int run_dir(const char *dirname)
+{
+	DIR *dir;
+	struct dirent *de;
+	char filename[4096];
+	int count = 0;
+
+	if (!(dir = opendir(dirname))) {
+		fprintf(stderr, "%s: cannot open directory\n", dirname);
+		return -1;
+	}
+	while ((de = readdir(dir))) {
+		if (de->d_name[0] == '.')
+			continue;
+		snprintf(filename, sizeof(filename), "%s/%s", dirname, de->d_name);
+		if (run_file(filename) < 0) {
+			count = -1;
+			break;
+		}
+		count++;
+	}
+	closedir(dir);
+
+	return count;
+}
+
+
+int main(int argc, char **argv)
+{
+	struct stat st;
+	int count = 0;
+	int res;
+
+	LLVMFuzzerInitialize(&argc, &argv);
+
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] == '-')
+			continue;
+		if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode))
+			res = run_dir(argv[i]);
+		else
+			res = (run_file(argv[i]) < 0 ? -1 : 1);
+		if (res < 0)
+			return 1;
+		count += res;
+	}
+
+	fprintf(stderr, "%s: %d inputs\n", argv[0], count);
+
+	return (count > 0 ? 0 : 1);
+}
+
+
+/* eof */
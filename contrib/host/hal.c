@@ -0,0 +1,1076 @@
+/* hal.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Emulation of the Pico SDK functions used by FanPico control path,
+ * for running firmware code on a Linux host.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "hal.h"
+
+#define HAL_GPIO_COUNT 30
+#define HAL_SYS_CLOCK 125000000
+#define HAL_ADC_INPUTS 5
+
+
+/* Time */
+
+static bool sim_time = false;
+static uint64_t sim_time_us = 1;
+static uint64_t boot_time_us = 0;
+static hal_time_callback_t time_callback = NULL;
+static bool in_time_callback = false;
+
+static uint64_t host_time_us()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void hal_set_simulated_time(bool enabled)
+{
+	sim_time = enabled;
+}
+
+void hal_set_time_callback(hal_time_callback_t callback)
+{
+	time_callback = callback;
+}
+
+void hal_set_time_us(uint64_t t)
+{
+	if (t > sim_time_us)
+		sim_time_us = t;
+}
+
+void hal_advance_time_us(uint64_t us)
+{
+	uint64_t t_to = sim_time_us + us;
+
+	/* Firmware code called from the callback (interrupt handlers) must not
+	   recursively advance time. */
+	if (time_callback && !in_time_callback) {
+		in_time_callback = true;
+		time_callback(sim_time_us, t_to);
+		in_time_callback = false;
+	}
+	sim_time_us = t_to;
+}
+
+absolute_time_t get_absolute_time()
+{
+	if (sim_time)
+		return sim_time_us;
+
+	if (!boot_time_us)
+		boot_time_us = host_time_us() - 1;
+	return host_time_us() - boot_time_us;
+}
+
+uint64_t time_us_64()
+{
+	return get_absolute_time();
+}
+
+uint32_t time_us_32()
+{
+	return get_absolute_time();
+}
+
+void sleep_us(uint64_t us)
+{
+	if (sim_time) {
+		hal_advance_time_us(us);
+		return;
+	}
+
+	struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+	nanosleep(&ts, NULL);
+}
+
+void sleep_ms(uint32_t ms)
+{
+	sleep_us((uint64_t)ms * 1000);
+}
+
+void busy_wait_us(uint64_t us)
+{
+	if (sim_time) {
+		hal_advance_time_us(us);
+		return;
+	}
+
+	uint64_t t_end = get_absolute_time() + us;
+	while (get_absolute_time() < t_end)
+		;
+}
+
+void busy_wait_us_32(uint32_t us)
+{
+	busy_wait_us(us);
+}
+
+void busy_wait_ms(uint32_t ms)
+{
+	busy_wait_us((uint64_t)ms * 1000);
+}
+
+void tight_loop_contents()
+{
+}
+
+
+/* Synchronization (firmware code runs in a single host thread) */
+
+void mutex_init(mutex_t *mtx)
+{
+	mtx->owner = -1;
+	mtx->count = 0;
+}
+
+void mutex_enter_blocking(mutex_t *mtx)
+{
+	mtx->owner = get_core_num();
+	mtx->count++;
+}
+
+bool mutex_enter_timeout_us(mutex_t *mtx, uint32_t timeout_us)
+{
+	mutex_enter_blocking(mtx);
+	return true;
+}
+
+bool mutex_enter_timeout_ms(mutex_t *mtx, uint32_t timeout_ms)
+{
+	mutex_enter_blocking(mtx);
+	return true;
+}
+
+bool mutex_try_enter(mutex_t *mtx, uint32_t *owner_out)
+{
+	mutex_enter_blocking(mtx);
+	return true;
+}
+
+void mutex_exit(mutex_t *mtx)
+{
+	mtx->owner = -1;
+}
+
+uint32_t save_and_disable_interrupts()
+{
+	return 0;
+}
+
+void restore_interrupts(uint32_t status)
+{
+}
+
+static spin_lock_t hal_spin_locks[32];
+static uint hal_spin_locks_claimed = 0;
+
+spin_lock_t *spin_lock_instance(uint lock_num)
+{
+	return &hal_spin_locks[lock_num & 31];
+}
+
+uint spin_lock_claim_unused(bool required)
+{
+	if (hal_spin_locks_claimed >= 32) {
+		if (required)
+			panic("No spin locks are available");
+		return -1;
+	}
+	return hal_spin_locks_claimed++;
+}
+
+uint32_t spin_lock_blocking(spin_lock_t *lock)
+{
+	*lock = 1;
+	return 0;
+}
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq)
+{
+	*lock = 0;
+}
+
+
+static uint hal_core_num = 0;
+
+uint get_core_num()
+{
+	return hal_core_num;
+}
+
+void hal_set_core_num(uint core)
+{
+	hal_core_num = core;
+}
+
+
+/* Stdio */
+
+bool stdio_init_all()
+{
+	return true;
+}
+
+bool stdio_usb_init()
+{
+	return true;
+}
+
+bool stdio_usb_connected()
+{
+	return true;
+}
+
+void stdio_uart_init_full(uart_inst_t *uart, uint baud_rate, int tx_pin, int rx_pin)
+{
+}
+
+int getchar_timeout_us(uint32_t timeout_us)
+{
+	struct pollfd fds = { STDIN_FILENO, POLLIN, 0 };
+	unsigned char c;
+
+	if (poll(&fds, 1, timeout_us / 1000) < 1)
+		return PICO_ERROR_TIMEOUT;
+	if (read(STDIN_FILENO, &c, 1) != 1)
+		return PICO_ERROR_TIMEOUT;
+
+	return c;
+}
+
+
+/* GPIO */
+
+struct hal_gpio {
+	bool out;
+	bool value;
+	enum gpio_function func;
+	uint32_t irq_events;
+};
+
+static struct hal_gpio gpio[HAL_GPIO_COUNT];
+static gpio_irq_callback_t gpio_callback = NULL;
+
+void gpio_init(uint pin)
+{
+	assert(pin < HAL_GPIO_COUNT);
+	gpio[pin].out = false;
+	gpio[pin].value = false;
+	gpio[pin].func = GPIO_FUNC_SIO;
+}
+
+void gpio_set_dir(uint pin, bool out)
+{
+	gpio[pin].out = out;
+}
+
+void gpio_put(uint pin, bool value)
+{
+	if (gpio[pin].out)
+		gpio[pin].value = value;
+}
+
+bool gpio_get(uint pin)
+{
+	return gpio[pin].value;
+}
+
+void gpio_set_function(uint pin, enum gpio_function fn)
+{
+	gpio[pin].func = fn;
+}
+
+void gpio_pull_up(uint pin)
+{
+}
+
+void gpio_pull_down(uint pin)
+{
+}
+
+void gpio_disable_pulls(uint pin)
+{
+}
+
+void gpio_set_irq_enabled(uint pin, uint32_t events, bool enabled)
+{
+	if (enabled)
+		gpio[pin].irq_events |= events;
+	else
+		gpio[pin].irq_events &= ~events;
+}
+
+void gpio_set_irq_enabled_with_callback(uint pin, uint32_t events, bool enabled,
+					gpio_irq_callback_t callback)
+{
+	gpio_set_irq_enabled(pin, events, enabled);
+	gpio_callback = callback;
+}
+
+void hal_gpio_set_input(uint pin, bool value)
+{
+	uint32_t event;
+
+	assert(pin < HAL_GPIO_COUNT);
+	if (gpio[pin].value == value)
+		return;
+	gpio[pin].value = value;
+
+	event = (value ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL) & gpio[pin].irq_events;
+	if (event && gpio_callback)
+		gpio_callback(pin, event);
+}
+
+bool hal_gpio_output(uint pin)
+{
+	return gpio[pin].value;
+}
+
+
+/* PWM */
+
+struct hal_pwm_slice {
+	pwm_config config;
+	bool enabled;
+	uint16_t level[2];
+	bool invert[2];         /* output polarity */
+	uint32_t phase;         /* counter phase offset (retard - advance) */
+	double count;           /* counter value when slice was last stopped */
+	uint64_t t_enabled;     /* time when slice was last enabled */
+	float input_duty;       /* duty cycle of signal on channel B input */
+};
+
+static struct hal_pwm_slice pwm[NUM_PWM_SLICES];
+pwm_hw_t hal_pwm_hw;
+
+static double pwm_count_rate(const struct hal_pwm_slice *s)
+{
+	double rate = HAL_SYS_CLOCK / (s->config.div > 0 ? s->config.div : 1.0);
+
+	if (s->config.mode == PWM_DIV_B_HIGH)
+		rate *= s->input_duty;
+	else if (s->config.mode != PWM_DIV_FREE_RUNNING)
+		rate = 0;
+
+	return rate;
+}
+
+static double pwm_current_count(const struct hal_pwm_slice *s)
+{
+	double count = s->count;
+
+	if (s->enabled)
+		count += pwm_count_rate(s) * (get_absolute_time() - s->t_enabled) / 1000000.0;
+
+	return count;
+}
+
+pwm_config pwm_get_default_config()
+{
+	pwm_config c;
+
+	c.div = 1.0;
+	c.mode = PWM_DIV_FREE_RUNNING;
+	c.phase_correct = false;
+	c.top = 0xffff;
+
+	return c;
+}
+
+void pwm_config_set_clkdiv(pwm_config *c, float div)
+{
+	c->div = div;
+}
+
+void pwm_config_set_clkdiv_int(pwm_config *c, uint div)
+{
+	c->div = div;
+}
+
+void pwm_config_set_clkdiv_mode(pwm_config *c, enum pwm_clkdiv_mode mode)
+{
+	c->mode = mode;
+}
+
+void pwm_config_set_phase_correct(pwm_config *c, bool phase_correct)
+{
+	c->phase_correct = phase_correct;
+}
+
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap)
+{
+	c->top = wrap;
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start)
+{
+	struct hal_pwm_slice *s = &pwm[slice_num];
+
+	s->config = *c;
+	s->level[0] = s->level[1] = 0;
+	s->count = 0;
+	s->enabled = false;
+	pwm_set_enabled(slice_num, start);
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled)
+{
+	struct hal_pwm_slice *s = &pwm[slice_num];
+
+	if (s->enabled == enabled)
+		return;
+	if (enabled) {
+		s->t_enabled = get_absolute_time();
+	} else {
+		s->count = pwm_current_count(s);
+	}
+	s->enabled = enabled;
+}
+
+void pwm_set_mask_enabled(uint32_t mask)
+{
+	for (int i = 0; i < NUM_PWM_SLICES; i++)
+		pwm_set_enabled(i, (mask & (1 << i)) ? true : false);
+}
+
+void pwm_set_counter(uint slice_num, uint16_t c)
+{
+	struct hal_pwm_slice *s = &pwm[slice_num];
+
+	s->count = c;
+	s->t_enabled = get_absolute_time();
+}
+
+uint16_t pwm_get_counter(uint slice_num)
+{
+	const struct hal_pwm_slice *s = &pwm[slice_num];
+
+	return (uint64_t)pwm_current_count(s) % ((uint32_t)s->config.top + 1);
+}
+
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level)
+{
+	pwm[slice_num].level[chan & 1] = level;
+}
+
+void pwm_set_gpio_level(uint pin, uint16_t level)
+{
+	pwm_set_chan_level(pwm_gpio_to_slice_num(pin), pwm_gpio_to_channel(pin), level);
+}
+
+void pwm_set_both_levels(uint slice_num, uint16_t level_a, uint16_t level_b)
+{
+	pwm[slice_num].level[0] = level_a;
+	pwm[slice_num].level[1] = level_b;
+}
+
+void pwm_set_wrap(uint slice_num, uint16_t wrap)
+{
+	pwm[slice_num].config.top = wrap;
+}
+
+void pwm_set_output_polarity(uint slice_num, bool a, bool b)
+{
+	pwm[slice_num].invert[0] = a;
+	pwm[slice_num].invert[1] = b;
+}
+
+static uint32_t pwm_period_counts(const struct hal_pwm_slice *s)
+{
+	return ((uint32_t)s->config.top + 1) * (s->config.phase_correct ? 2 : 1);
+}
+
+void pwm_retard_count(uint slice_num)
+{
+	struct hal_pwm_slice *s = &pwm[slice_num];
+
+	s->phase = (s->phase + 1) % pwm_period_counts(s);
+}
+
+void pwm_advance_count(uint slice_num)
+{
+	struct hal_pwm_slice *s = &pwm[slice_num];
+
+	s->phase = (s->phase + pwm_period_counts(s) - 1) % pwm_period_counts(s);
+}
+
+uint pwm_get_dreq(uint slice_num)
+{
+	return 24 + slice_num;
+}
+
+/* DMA control block (written to alias 0 registers of a DMA channel) */
+struct hal_dma_ctrl_block {
+	const volatile void *read_addr;
+	volatile void *write_addr;
+	uint32_t transfer_count;
+	uint32_t ctrl_trig;
+};
+
+/* Average output level over a DMA control block chain that keeps
+   updating compare register of the PWM slice. Returns -1 if slice
+   is not updated by DMA. */
+static double pwm_dma_level(uint slice_num, uint chan)
+{
+	const struct hal_dma_channel *ctrl = NULL;
+	const struct hal_dma_ctrl_block *b;
+	double sum = 0.0;
+	int i, n = 0;
+
+	for (i = 0; i < NUM_DMA_CHANNELS && !ctrl; i++) {
+		const struct hal_dma_channel *ch = &dma_hw->ch[i];
+		for (int j = 0; j < NUM_DMA_CHANNELS; j++) {
+			if (ch->busy && ch->write_addr == &dma_hw->ch[j].read_addr) {
+				ctrl = ch;
+				break;
+			}
+		}
+	}
+	if (!ctrl)
+		return -1.0;
+
+	/* Chain ends with a block that restarts control channel */
+	b = (const struct hal_dma_ctrl_block*)ctrl->read_addr;
+	for (i = 0; i < 4096 && b[i].write_addr != &ctrl->read_addr; i++) {
+		if (b[i].write_addr == &pwm_hw->slice[slice_num].cc) {
+			sum += (*(const uint32_t*)b[i].read_addr >> (chan ? 16 : 0)) & 0xffff;
+			n++;
+		}
+	}
+
+	return (n > 0 ? sum / n : -1.0);
+}
+
+float hal_pwm_output_duty(uint pin)
+{
+	uint slice_num = pwm_gpio_to_slice_num(pin);
+	const struct hal_pwm_slice *s = &pwm[slice_num];
+	double level = pwm_dma_level(slice_num, pwm_gpio_to_channel(pin));
+	float duty;
+
+	if (level < 0.0)
+		level = s->level[pwm_gpio_to_channel(pin)];
+	duty = level * 100.0 / ((uint32_t)s->config.top + 1);
+	if (duty > 100.0)
+		duty = 100.0;
+
+	return (s->invert[pwm_gpio_to_channel(pin)] ? 100.0 - duty : duty);
+}
+
+/* Phase (in degrees) of center of the output pulse relative to
+   slices without any phase offset. */
+float hal_pwm_output_phase(uint pin)
+{
+	const struct hal_pwm_slice *s = &pwm[pwm_gpio_to_slice_num(pin)];
+	float phase = s->phase * 360.0 / pwm_period_counts(s);
+
+	if (s->invert[pwm_gpio_to_channel(pin)])
+		phase += 180.0;
+
+	return fmodf(phase, 360.0);
+}
+
+void hal_pwm_set_input_duty(uint pin, float duty)
+{
+	struct hal_pwm_slice *s = &pwm[pwm_gpio_to_slice_num(pin)];
+
+	/* Keep counter continuous when input signal changes. */
+	if (s->enabled) {
+		s->count = pwm_current_count(s);
+		s->t_enabled = get_absolute_time();
+	}
+	s->input_duty = (duty < 0 ? 0 : (duty > 100 ? 100 : duty)) / 100.0;
+}
+
+
+/* Clocks */
+
+uint32_t clock_get_hz(enum clock_index clk_index)
+{
+	if (clk_index == clk_usb || clk_index == clk_adc)
+		return 48000000;
+	if (clk_index == clk_ref)
+		return 12000000;
+
+	return HAL_SYS_CLOCK;
+}
+
+
+/* ADC */
+
+static uint16_t adc_value[HAL_ADC_INPUTS];
+static uint adc_input = 0;
+
+void adc_init()
+{
+}
+
+void adc_gpio_init(uint pin)
+{
+	gpio[pin].func = GPIO_FUNC_NULL;
+}
+
+void adc_select_input(uint input)
+{
+	assert(input < HAL_ADC_INPUTS);
+	adc_input = input;
+}
+
+uint16_t adc_read()
+{
+	return adc_value[adc_input];
+}
+
+void adc_set_temp_sensor_enabled(bool enable)
+{
+}
+
+void hal_adc_set_value(uint input, uint16_t value)
+{
+	assert(input < HAL_ADC_INPUTS);
+	adc_value[input] = value & 0x0fff;
+}
+
+
+/* PIO */
+
+struct hal_pio hal_pio[2];
+
+uint pio_add_program(PIO pio, const pio_program_t *program)
+{
+	uint offset = pio->used_programs;
+
+	pio->used_programs += program->length;
+	assert(pio->used_programs <= 32);
+
+	return offset;
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program)
+{
+	return (pio->used_programs + program->length <= 32);
+}
+
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+	return -1;
+}
+
+void pio_gpio_init(PIO pio, uint pin)
+{
+	gpio[pin].func = (pio == pio0 ? GPIO_FUNC_PIO0 : GPIO_FUNC_PIO1);
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config)
+{
+	struct hal_pio_sm *s = &pio->sm[sm];
+
+	memset(s, 0, sizeof(*s));
+	s->pin = config->sideset_base;
+	s->clkdiv = config->clkdiv;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled)
+{
+	pio->sm[sm].enabled = enabled;
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out)
+{
+	for (int i = 0; i < pin_count; i++)
+		gpio[pin_base + i].out = is_out;
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data)
+{
+	pio->sm[sm].x = data;
+	pio->sm[sm].tx_count++;
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data)
+{
+	pio_sm_put(pio, sm, data);
+}
+
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm)
+{
+	return false;
+}
+
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm)
+{
+	return true;
+}
+
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm)
+{
+	return 0;
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm)
+{
+}
+
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div)
+{
+	pio->sm[sm].clkdiv = div;
+}
+
+pio_sm_config pio_get_default_sm_config()
+{
+	pio_sm_config c;
+
+	c.clkdiv = 1.0;
+	c.sideset_base = 0;
+
+	return c;
+}
+
+void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base)
+{
+	c->sideset_base = sideset_base;
+}
+
+void sm_config_set_clkdiv(pio_sm_config *c, float div)
+{
+	c->clkdiv = div;
+}
+
+void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold)
+{
+	c->out_shift_right = shift_right;
+	c->autopull = autopull;
+	c->pull_threshold = pull_threshold;
+}
+
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx)
+{
+	return (pio == pio0 ? 0 : 8) + (is_tx ? 0 : 4) + sm;
+}
+
+float hal_pio_sm_output_freq(PIO pio, uint sm)
+{
+	const struct hal_pio_sm *s = &pio->sm[sm];
+	const struct hal_dma_channel *ch = NULL;
+	const uint32_t *buf;
+	uint64_t cycles = 0;
+	int i, n, pulses = 0;
+
+	if (!s->enabled)
+		return 0.0;
+
+	/* Find DMA channel feeding the state machine */
+	for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+		if (dma_hw->ch[i].busy && dma_hw->ch[i].write_addr == &pio->txf[sm]) {
+			ch = &dma_hw->ch[i];
+			break;
+		}
+	}
+	if (!ch || ch->config.ring_size_bits == 0)
+		return 0.0;
+
+	/* tacho_gen.pio: high phase is 'high + 2' and low phase 'low + 6'
+	   clock cycles, no pulse if 'high' is 0. */
+	buf = (const uint32_t*)ch->read_addr;
+	n = (1 << ch->config.ring_size_bits) / sizeof(uint32_t) / 2;
+	for (i = 0; i < n; i++) {
+		if (buf[i * 2] > 0) {
+			cycles += buf[i * 2] + 2;
+			pulses++;
+		}
+		cycles += buf[i * 2 + 1] + 6;
+	}
+	if (pulses == 0 || cycles == 0)
+		return 0.0;
+
+	return HAL_SYS_CLOCK / (s->clkdiv > 0 ? s->clkdiv : 1.0) * pulses / cycles;
+}
+
+
+/* DMA */
+
+dma_hw_t hal_dma;
+
+int dma_claim_unused_channel(bool required)
+{
+	for (int i = 0; i < NUM_DMA_CHANNELS; i++) {
+		if (!dma_hw->ch[i].claimed) {
+			dma_hw->ch[i].claimed = true;
+			return i;
+		}
+	}
+	assert(!required);
+
+	return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+	dma_channel_config c;
+
+	memset(&c, 0, sizeof(c));
+	c.size = DMA_SIZE_32;
+	c.read_increment = true;
+	c.write_increment = false;
+	c.dreq = 0x3f;
+	c.chain_to = channel;
+
+	return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size)
+{
+	c->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+	c->read_increment = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+	c->write_increment = incr;
+}
+
+void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits)
+{
+	c->ring_write = write;
+	c->ring_size_bits = size_bits;
+}
+
+void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+	c->dreq = dreq;
+}
+
+void channel_config_set_chain_to(dma_channel_config *c, uint chain_to)
+{
+	c->chain_to = chain_to;
+}
+
+uint32_t channel_config_get_ctrl_value(const dma_channel_config *c)
+{
+	return 1 | (c->size << 2) | (c->read_increment << 4) | (c->write_increment << 5)
+		| (c->ring_size_bits << 6) | (c->ring_write << 10)
+		| (c->chain_to << 11) | (c->dreq << 15);
+}
+
+void dma_channel_abort(uint channel)
+{
+	assert(channel < NUM_DMA_CHANNELS);
+	dma_hw->ch[channel].busy = false;
+}
+
+void dma_channel_unclaim(uint channel)
+{
+	assert(channel < NUM_DMA_CHANNELS);
+	dma_hw->ch[channel].claimed = false;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+			volatile void *write_addr, const volatile void *read_addr,
+			uint transfer_count, bool trigger)
+{
+	struct hal_dma_channel *ch = &dma_hw->ch[channel];
+
+	assert(channel < NUM_DMA_CHANNELS);
+	ch->config = *config;
+	ch->write_addr = write_addr;
+	ch->read_addr = read_addr;
+	ch->transfer_count = transfer_count;
+	if (trigger)
+		ch->busy = true;
+}
+
+
+/* RTC (runs on emulated time, so that it also follows simulated time) */
+
+static time_t rtc_base = 0;
+static uint64_t rtc_base_us = 0;
+static bool rtc_started = false;
+
+void rtc_init()
+{
+	if (!rtc_started) {
+		rtc_base = time(NULL);
+		rtc_base_us = get_absolute_time();
+	}
+	rtc_started = true;
+}
+
+bool rtc_set_datetime(const datetime_t *t)
+{
+	struct tm tm;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = t->year - 1900;
+	tm.tm_mon = t->month - 1;
+	tm.tm_mday = t->day;
+	tm.tm_hour = t->hour;
+	tm.tm_min = t->min;
+	tm.tm_sec = t->sec;
+	rtc_base = timegm(&tm);
+	rtc_base_us = get_absolute_time();
+
+	return true;
+}
+
+bool rtc_get_datetime(datetime_t *t)
+{
+	time_t now = rtc_base + (get_absolute_time() - rtc_base_us) / 1000000;
+	struct tm tm;
+
+	if (!rtc_started)
+		return false;
+
+	gmtime_r(&now, &tm);
+	t->year = tm.tm_year + 1900;
+	t->month = tm.tm_mon + 1;
+	t->day = tm.tm_mday;
+	t->dotw = tm.tm_wday;
+	t->hour = tm.tm_hour;
+	t->min = tm.tm_min;
+	t->sec = tm.tm_sec;
+
+	return true;
+}
+
+bool rtc_running()
+{
+	return rtc_started;
+}
+
+
+/* Multicore */
+
+void multicore_launch_core1(void (*entry)(void))
+{
+	/* Second core is not emulated, simulations call core1 code directly. */
+}
+
+void multicore_reset_core1()
+{
+}
+
+void multicore_lockout_victim_init()
+{
+}
+
+
+/* Watchdog */
+
+static watchdog_hw_t watchdog_regs;
+static vreg_and_chip_reset_hw_t vreg_and_chip_reset_regs;
+watchdog_hw_t *watchdog_hw = &watchdog_regs;
+vreg_and_chip_reset_hw_t *vreg_and_chip_reset_hw = &vreg_and_chip_reset_regs;
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug)
+{
+	watchdog_hw->ctrl = 1;
+}
+
+void watchdog_update()
+{
+}
+
+static hal_reboot_callback_t reboot_callback = NULL;
+
+void hal_set_reboot_callback(hal_reboot_callback_t callback)
+{
+	reboot_callback = callback;
+}
+
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms)
+{
+	printf("[watchdog_reboot]\n");
+	if (reboot_callback)
+		reboot_callback();
+	exit(0);
+}
+
+bool watchdog_caused_reboot()
+{
+	return false;
+}
+
+bool watchdog_enable_caused_reboot()
+{
+	return false;
+}
+
+
+/* Misc */
+
+void panic(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "*** PANIC ***\n");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	abort();
+}
+
+void reset_usb_boot(uint32_t usb_activity_gpio_pin_mask, uint32_t disable_interface_mask)
+{
+	printf("[reset_usb_boot]\n");
+	if (reboot_callback)
+		reboot_callback();
+	exit(0);
+}
+
+void pico_get_unique_board_id(pico_unique_board_id_t *id_out)
+{
+	for (int i = 0; i < PICO_UNIQUE_BOARD_ID_SIZE_BYTES; i++)
+		id_out->id[i] = 0xe6 - i;
+}
+
+uint32_t get_rand_32()
+{
+	return ((uint32_t)random() << 16) ^ random();
+}
+
+uint64_t get_rand_64()
+{
+	return ((uint64_t)get_rand_32() << 32) | get_rand_32();
+}
+
+
+/* eof */
@@ -0,0 +1,95 @@
+/* bb_spi_lcd.h
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host build: subset of bb_spi_lcd library API used by src/display_lcd.c,
+ * drawing is done into a framebuffer (lcd_host.c).
+ */
+
+#ifndef FANPICO_BB_SPI_LCD_H
+#define FANPICO_BB_SPI_LCD_H 1
+
+#include "hal.h"
+
+enum {
+	LCD_INVALID = 0,
+	LCD_ILI9341,
+	LCD_ILI9342,
+	LCD_ST7789,
+	LCD_ILI9486,
+	LCD_HX8357,
+};
+
+enum {
+	LCD_ORIENTATION_0 = 0,
+	LCD_ORIENTATION_90,
+	LCD_ORIENTATION_180,
+	LCD_ORIENTATION_270,
+};
+
+enum {
+	FONT_6x8 = 0,
+	FONT_8x8,
+	FONT_12x16,
+	FONT_16x16,
+	FONT_16x32,
+};
+
+#define FLAGS_NONE    0
+#define FLAGS_SWAP_RB 1
+#define FLAGS_INVERT  2
+#define FLAGS_16BIT   4
+#define FLAGS_SWAP_X  8
+
+#define DRAW_TO_LCD   1
+
+/* Custom init sequence: delay (ms) follows */
+#define LCD_DELAY     0xff
+
+typedef struct tagSPILCD {
+	int iLCDType;
+	int iLCDFlags;
+	int iOrientation;
+	int iWidth;
+	int iHeight;
+	int iCurrentWidth;
+	int iCurrentHeight;
+	int32_t iSPIFreq;
+	const uint8_t *pCustomInit;
+	int iCustomInitLen;
+} SPILCD;
+
+int spilcdInit(SPILCD *pLCD, int iLCDType, int iFlags, int32_t iSPIFreq, int iCSPin, int iDCPin,
+	int iResetPin, int iLEDPin, int iMISOPin, int iMOSIPin, int iCLKPin);
+void spilcdCustomInit(SPILCD *pLCD, const uint8_t *pInitList, int iInitLen,
+	int iInvertOffset, int iRGBOffset);
+int spilcdSetOrientation(SPILCD *pLCD, int iOrientation);
+int spilcdFill(SPILCD *pLCD, unsigned short usData, int iFlags);
+void spilcdRectangle(SPILCD *pLCD, int x, int y, int w, int h, unsigned short usColor1,
+	unsigned short usColor2, int bFill, int iFlags);
+void spilcdEllipse(SPILCD *pLCD, int32_t centerX, int32_t centerY, int32_t radiusX,
+	int32_t radiusY, unsigned short color, int bFilled, int iFlags);
+int spilcdWriteString(SPILCD *pLCD, int x, int y, char *szText, int usFGColor, int usBGColor,
+	int iFontSize, int iFlags);
+int spilcdDrawBMP(SPILCD *pLCD, const uint8_t *pBMP, int iDestX, int iDestY, int bStretch,
+	int iTransparent, int iFlags);
+
+#endif /* FANPICO_BB_SPI_LCD_H */
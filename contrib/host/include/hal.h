@@ -0,0 +1,494 @@
+/* hal.h
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host (Linux) replacement for the subset of Pico SDK used by FanPico.
+ *
+ * All pico/... and hardware/... headers in this directory just include
+ * this file. Hardware is emulated with plain state arrays that can be
+ * inspected and driven using the hal_*() functions declared at the end.
+ */
+
+#ifndef FANPICO_HAL_H
+#define FANPICO_HAL_H 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+
+
+typedef unsigned int uint;
+
+#define PICO_OK             0
+#define PICO_ERROR_GENERIC -1
+#define PICO_ERROR_TIMEOUT -1
+
+#define __not_in_flash_func(f) f
+#define __time_critical_func(f) f
+#define __uninitialized_ram(v) v
+#define __unused __attribute__((unused))
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+#define SRAM_BASE 0x20000000
+#define SRAM_END  0x20042000
+#define PICO_BOARD "host"
+#define PICO_SDK_VERSION_STRING "host"
+#define PICO_CMAKE_BUILD_TYPE "host"
+
+
+/* pico/platform.h, pico/binary_info.h */
+
+void panic(const char *fmt, ...) __attribute__((noreturn));
+#define bi_decl(...)
+
+
+/* pico/time.h */
+
+typedef uint64_t absolute_time_t;
+#define ABSOLUTE_TIME_INITIALIZED_VAR(name, value) name = value
+
+absolute_time_t get_absolute_time();
+uint64_t time_us_64();
+uint32_t time_us_32();
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void busy_wait_us(uint64_t us);
+void busy_wait_us_32(uint32_t us);
+void busy_wait_ms(uint32_t ms);
+void tight_loop_contents();
+
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+static inline uint32_t to_ms_since_boot(absolute_time_t t) { return t / 1000; }
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+static inline void update_us_since_boot(absolute_time_t *t, uint64_t us) { *t = us; }
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+	return (int64_t)(to - from);
+}
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) { return t + us; }
+static inline absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms) { return t + ms * 1000ULL; }
+static inline absolute_time_t make_timeout_time_us(uint64_t us) { return get_absolute_time() + us; }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return get_absolute_time() + ms * 1000ULL; }
+
+
+/* pico/sync.h */
+
+typedef struct mutex {
+	int owner;
+	uint32_t count;
+} mutex_t;
+
+#define auto_init_mutex(name) mutex_t name = { -1, 0 }
+
+void mutex_init(mutex_t *mtx);
+void mutex_enter_blocking(mutex_t *mtx);
+bool mutex_enter_timeout_us(mutex_t *mtx, uint32_t timeout_us);
+bool mutex_enter_timeout_ms(mutex_t *mtx, uint32_t timeout_ms);
+bool mutex_try_enter(mutex_t *mtx, uint32_t *owner_out);
+void mutex_exit(mutex_t *mtx);
+
+uint32_t save_and_disable_interrupts();
+void restore_interrupts(uint32_t status);
+uint get_core_num();
+
+typedef volatile uint32_t spin_lock_t;
+
+spin_lock_t *spin_lock_instance(uint lock_num);
+uint spin_lock_claim_unused(bool required);
+uint32_t spin_lock_blocking(spin_lock_t *lock);
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq);
+
+
+/* pico/stdio.h */
+
+typedef struct uart_inst uart_inst_t;
+#define uart0 ((uart_inst_t *)0)
+#define uart1 ((uart_inst_t *)1)
+
+bool stdio_init_all();
+void stdio_uart_init_full(uart_inst_t *uart, uint baud_rate, int tx_pin, int rx_pin);
+bool stdio_usb_init();
+bool stdio_usb_connected();
+int getchar_timeout_us(uint32_t timeout_us);
+
+
+/* hardware/gpio.h */
+
+#define GPIO_IN  false
+#define GPIO_OUT true
+
+enum gpio_function {
+	GPIO_FUNC_XIP = 0,
+	GPIO_FUNC_SPI = 1,
+	GPIO_FUNC_UART = 2,
+	GPIO_FUNC_I2C = 3,
+	GPIO_FUNC_PWM = 4,
+	GPIO_FUNC_SIO = 5,
+	GPIO_FUNC_PIO0 = 6,
+	GPIO_FUNC_PIO1 = 7,
+	GPIO_FUNC_NULL = 0x1f,
+};
+
+enum gpio_irq_level {
+	GPIO_IRQ_LEVEL_LOW = 0x1u,
+	GPIO_IRQ_LEVEL_HIGH = 0x2u,
+	GPIO_IRQ_EDGE_FALL = 0x4u,
+	GPIO_IRQ_EDGE_RISE = 0x8u,
+};
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_pull_up(uint gpio);
+void gpio_pull_down(uint gpio);
+void gpio_disable_pulls(uint gpio);
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled,
+					gpio_irq_callback_t callback);
+
+
+/* hardware/pwm.h */
+
+#define NUM_PWM_SLICES 8
+
+enum pwm_clkdiv_mode {
+	PWM_DIV_FREE_RUNNING,
+	PWM_DIV_B_HIGH,
+	PWM_DIV_B_RISING,
+	PWM_DIV_B_FALLING,
+};
+
+enum pwm_chan {
+	PWM_CHAN_A = 0,
+	PWM_CHAN_B = 1,
+};
+
+typedef struct {
+	float div;
+	enum pwm_clkdiv_mode mode;
+	bool phase_correct;
+	uint16_t top;
+} pwm_config;
+
+typedef struct {
+	struct {
+		uint32_t csr;
+		uint32_t div;
+		uint32_t ctr;
+		uint32_t cc;
+		uint32_t top;
+	} slice[NUM_PWM_SLICES];
+} pwm_hw_t;
+
+extern pwm_hw_t hal_pwm_hw;
+#define pwm_hw (&hal_pwm_hw)
+
+static inline uint pwm_gpio_to_slice_num(uint gpio) { return (gpio >> 1) & 7; }
+static inline uint pwm_gpio_to_channel(uint gpio) { return gpio & 1; }
+
+pwm_config pwm_get_default_config();
+void pwm_config_set_clkdiv(pwm_config *c, float div);
+void pwm_config_set_clkdiv_int(pwm_config *c, uint div);
+void pwm_config_set_clkdiv_mode(pwm_config *c, enum pwm_clkdiv_mode mode);
+void pwm_config_set_phase_correct(pwm_config *c, bool phase_correct);
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap);
+void pwm_init(uint slice_num, pwm_config *c, bool start);
+void pwm_set_enabled(uint slice_num, bool enabled);
+void pwm_set_mask_enabled(uint32_t mask);
+void pwm_set_counter(uint slice_num, uint16_t c);
+uint16_t pwm_get_counter(uint slice_num);
+void pwm_set_gpio_level(uint gpio, uint16_t level);
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level);
+void pwm_set_both_levels(uint slice_num, uint16_t level_a, uint16_t level_b);
+void pwm_set_wrap(uint slice_num, uint16_t wrap);
+void pwm_set_output_polarity(uint slice_num, bool a, bool b);
+void pwm_retard_count(uint slice_num);
+void pwm_advance_count(uint slice_num);
+uint pwm_get_dreq(uint slice_num);
+
+
+/* hardware/clocks.h */
+
+enum clock_index {
+	clk_gpout0 = 0,
+	clk_ref = 4,
+	clk_sys = 5,
+	clk_peri = 6,
+	clk_usb = 7,
+	clk_adc = 8,
+	clk_rtc = 9,
+};
+
+uint32_t clock_get_hz(enum clock_index clk_index);
+
+
+/* hardware/adc.h */
+
+void adc_init();
+void adc_gpio_init(uint gpio);
+void adc_select_input(uint input);
+uint16_t adc_read();
+void adc_set_temp_sensor_enabled(bool enable);
+
+
+/* hardware/pio.h */
+
+#define NUM_PIO_STATE_MACHINES 4
+
+typedef struct pio_program {
+	const uint16_t *instructions;
+	uint8_t length;
+	int8_t origin;
+} pio_program_t;
+
+typedef struct {
+	float clkdiv;
+	uint sideset_base;
+	bool out_shift_right;
+	bool autopull;
+	uint pull_threshold;
+} pio_sm_config;
+
+struct hal_pio_sm {
+	bool enabled;
+	uint pin;
+	float clkdiv;
+	uint32_t x;          /* last value pulled from TX FIFO */
+	uint32_t tx_count;   /* number of words written to TX FIFO */
+};
+
+typedef struct hal_pio {
+	uint used_programs;
+	struct hal_pio_sm sm[NUM_PIO_STATE_MACHINES];
+	uint32_t txf[NUM_PIO_STATE_MACHINES];  /* TX FIFO (DMA write target) */
+} *PIO;
+
+extern struct hal_pio hal_pio[2];
+#define pio0 (&hal_pio[0])
+#define pio1 (&hal_pio[1])
+
+uint pio_add_program(PIO pio, const pio_program_t *program);
+bool pio_can_add_program(PIO pio, const pio_program_t *program);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_gpio_init(PIO pio, uint pin);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data);
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm);
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div);
+pio_sm_config pio_get_default_sm_config();
+void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base);
+void sm_config_set_clkdiv(pio_sm_config *c, float div);
+void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold);
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
+
+
+/* hardware/dma.h */
+
+#define NUM_DMA_CHANNELS 12
+#define DREQ_FORCE 0x3f
+
+enum dma_channel_transfer_size {
+	DMA_SIZE_8 = 0,
+	DMA_SIZE_16 = 1,
+	DMA_SIZE_32 = 2
+};
+
+typedef struct {
+	enum dma_channel_transfer_size size;
+	bool read_increment;
+	bool write_increment;
+	bool ring_write;
+	uint ring_size_bits;
+	uint dreq;
+	uint chain_to;
+} dma_channel_config;
+
+struct hal_dma_channel {
+	/* same order as the (alias 0) hardware registers */
+	const volatile void *read_addr;
+	volatile void *write_addr;
+	uint32_t transfer_count;
+	uint32_t ctrl_trig;
+	uint32_t al3_read_addr_trig;
+	bool claimed;
+	bool busy;
+	dma_channel_config config;
+};
+
+typedef struct {
+	struct hal_dma_channel ch[NUM_DMA_CHANNELS];
+} dma_hw_t;
+
+extern dma_hw_t hal_dma;
+#define dma_hw (&hal_dma)
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits);
+void channel_config_set_dreq(dma_channel_config *c, uint dreq);
+void channel_config_set_chain_to(dma_channel_config *c, uint chain_to);
+uint32_t channel_config_get_ctrl_value(const dma_channel_config *c);
+void dma_channel_abort(uint channel);
+void dma_channel_unclaim(uint channel);
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+			volatile void *write_addr, const volatile void *read_addr,
+			uint transfer_count, bool trigger);
+
+
+/* hardware/rtc.h, pico/util/datetime.h */
+
+typedef struct {
+	int16_t year;
+	int8_t month;
+	int8_t day;
+	int8_t dotw;
+	int8_t hour;
+	int8_t min;
+	int8_t sec;
+} datetime_t;
+
+void rtc_init();
+bool rtc_set_datetime(const datetime_t *t);
+bool rtc_get_datetime(datetime_t *t);
+bool rtc_running();
+
+
+/* pico/multicore.h */
+
+void multicore_launch_core1(void (*entry)(void));
+void multicore_reset_core1();
+void multicore_lockout_victim_init();
+
+
+/* hardware/watchdog.h */
+
+typedef struct {
+	unsigned long ctrl;
+	unsigned long reason;
+	unsigned long scratch[8];
+} watchdog_hw_t;
+
+typedef struct {
+	unsigned long vreg;
+	unsigned long bod;
+	unsigned long chip_reset;
+} vreg_and_chip_reset_hw_t;
+
+extern watchdog_hw_t *watchdog_hw;
+extern vreg_and_chip_reset_hw_t *vreg_and_chip_reset_hw;
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+void watchdog_update();
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms);
+bool watchdog_caused_reboot();
+bool watchdog_enable_caused_reboot();
+
+
+/* pico/bootrom.h, pico/unique_id.h, pico/rand.h */
+
+#define PICO_UNIQUE_BOARD_ID_SIZE_BYTES 8
+
+typedef struct {
+	uint8_t id[PICO_UNIQUE_BOARD_ID_SIZE_BYTES];
+} pico_unique_board_id_t;
+
+void reset_usb_boot(uint32_t usb_activity_gpio_pin_mask, uint32_t disable_interface_mask);
+void pico_get_unique_board_id(pico_unique_board_id_t *id_out);
+uint32_t get_rand_32();
+uint64_t get_rand_64();
+
+
+/*
+ * Functions for controlling the emulated hardware.
+ */
+
+/* Use simulated time: time only advances when hal_advance_time_us() is called
+   (or when firmware code calls sleep/busy_wait functions). */
+void hal_set_simulated_time(bool enabled);
+void hal_advance_time_us(uint64_t us);
+
+/* Callback that is called every time simulated time advances from 't_from'
+   to 't_to'. Callback can generate input events at exact times inside this
+   interval by calling hal_set_time_us() before changing inputs. */
+typedef void (*hal_time_callback_t)(uint64_t t_from, uint64_t t_to);
+void hal_set_time_callback(hal_time_callback_t callback);
+void hal_set_time_us(uint64_t t);
+
+/* Callback that is called when firmware reboots (watchdog_reboot() or
+   reset_usb_boot()), instead of exiting the program. Callback must not
+   return (it can longjmp() back to the caller of firmware code). */
+typedef void (*hal_reboot_callback_t)(void);
+void hal_set_reboot_callback(hal_reboot_callback_t callback);
+
+/* Select core number returned by get_core_num() (firmware code for
+   both cores runs in a single host thread). */
+void hal_set_core_num(uint core);
+
+/* Set level of an input pin, calls GPIO interrupt callback if enabled. */
+void hal_gpio_set_input(uint gpio, bool value);
+bool hal_gpio_output(uint gpio);
+
+/* PWM output/input emulation. */
+float hal_pwm_output_duty(uint gpio);
+float hal_pwm_output_phase(uint gpio);
+void hal_pwm_set_input_duty(uint gpio, float duty);
+
+/* Set raw value returned by ADC for given input (0..4). */
+void hal_adc_set_value(uint input, uint16_t value);
+
+/* Average frequency of a tachometer generator (PIO state machine) output. */
+float hal_pio_sm_output_freq(PIO pio, uint sm);
+
+/* Display emulation: LCD (bb_spi_lcd) and OLED (ss_oled) drawing functions
+   render into RGB565 framebuffers (NULL until display is initialized). */
+struct hal_framebuffer {
+	uint16_t width;
+	uint16_t height;
+	uint16_t *pixels;
+};
+
+const struct hal_framebuffer *hal_lcd_framebuffer();
+const struct hal_framebuffer *hal_oled_framebuffer();
+
+/* Encode framebuffer as PNG image. Returns malloc()ed buffer (or NULL). */
+uint8_t *hal_framebuffer_png(const struct hal_framebuffer *fb, size_t *len);
+
+/* Charge time it takes to send pixel data to display over SPI/I2C bus
+   (busy_wait_us()), when enabled. */
+void hal_display_set_bus_timing(bool enabled);
+
+#endif /* FANPICO_HAL_H */
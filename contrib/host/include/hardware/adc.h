@@ -0,0 +1,2 @@
+/* Host build: adc.h */
+#include "hal.h"
@@ -0,0 +1,2 @@
+/* Host build: clocks.h */
+#include "hal.h"
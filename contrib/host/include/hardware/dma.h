@@ -0,0 +1,2 @@
+/* Host build: dma.h */
+#include "hal.h"
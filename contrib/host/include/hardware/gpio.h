@@ -0,0 +1,2 @@
+/* Host build: gpio.h */
+#include "hal.h"
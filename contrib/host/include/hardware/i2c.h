@@ -0,0 +1,2 @@
+/* Host build: i2c.h */
+#include "hal.h"
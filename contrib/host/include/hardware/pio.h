@@ -0,0 +1,2 @@
+/* Host build: pio.h */
+#include "hal.h"
@@ -0,0 +1,2 @@
+/* Host build: pwm.h */
+#include "hal.h"
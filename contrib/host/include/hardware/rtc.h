@@ -0,0 +1,2 @@
+/* Host build: rtc.h */
+#include "hal.h"
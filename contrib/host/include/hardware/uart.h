@@ -0,0 +1,2 @@
+/* Host build: uart.h */
+#include "hal.h"
@@ -0,0 +1,2 @@
+/* Host build: vreg.h */
+#include "hal.h"
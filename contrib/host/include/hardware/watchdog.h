@@ -0,0 +1,2 @@
+/* Host build: watchdog.h */
+#include "hal.h"
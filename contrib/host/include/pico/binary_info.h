@@ -0,0 +1,2 @@
+/* Host build: binary_info.h */
+#include "hal.h"
@@ -0,0 +1,2 @@
+/* Host build: bootrom.h */
+#include "hal.h"
@@ -0,0 +1,2 @@
+/* Host build: multicore.h */
+#include "hal.h"
@@ -0,0 +1,2 @@
+/* Host build: mutex.h */
+#include "hal.h"
@@ -0,0 +1,2 @@
+/* Host build: rand.h */
+#include "hal.h"
@@ -0,0 +1,2 @@
+/* Host build: stdlib.h */
+#include "hal.h"
@@ -0,0 +1,2 @@
+/* Host build: sync.h */
+#include "hal.h"
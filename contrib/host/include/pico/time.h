@@ -0,0 +1,2 @@
+/* Host build: time.h */
+#include "hal.h"
@@ -0,0 +1,2 @@
+/* Host build: unique_id.h */
+#include "hal.h"
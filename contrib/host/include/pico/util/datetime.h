@@ -0,0 +1,2 @@
+/* Host build: datetime.h */
+#include "hal.h"
@@ -0,0 +1,80 @@
+/* ss_oled.h
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host build: subset of ss_oled library API used by src/display_oled.c,
+ * drawing is done into a framebuffer (oled_host.c).
+ */
+
+#ifndef FANPICO_SS_OLED_H
+#define FANPICO_SS_OLED_H 1
+
+#include "hal.h"
+
+enum {
+	OLED_128x128 = 1,
+	OLED_128x32,
+	OLED_128x64,
+	OLED_132x64,
+	OLED_64x32,
+	OLED_96x16,
+	OLED_72x40,
+};
+
+enum {
+	OLED_NOT_FOUND = -1,
+	OLED_SSD1306_3C,
+	OLED_SSD1306_3D,
+	OLED_SH1106_3C,
+	OLED_SH1106_3D,
+	OLED_SH1107_3C,
+	OLED_SH1107_3D,
+};
+
+enum {
+	FONT_6x8 = 0,
+	FONT_8x8,
+	FONT_12x16,
+	FONT_16x16,
+	FONT_16x32,
+};
+
+typedef struct ssoleds {
+	int oled_type;
+	int oled_x;
+	int oled_y;
+	int oled_flip;
+	int oled_invert;
+	uint8_t ucContrast;
+	uint8_t *ucScreen;
+	int32_t iSpeed;
+} SSOLED;
+
+int oledInit(SSOLED *pOLED, int iType, int iAddr, int bFlip, int bInvert, int bWire,
+	int iSDAPin, int iSCLPin, int iResetPin, int32_t iSpeed);
+void oledSetBackBuffer(SSOLED *pOLED, uint8_t *pBuffer);
+void oledSetContrast(SSOLED *pOLED, unsigned char ucContrast);
+void oledFill(SSOLED *pOLED, unsigned char ucData, int bRender);
+int oledWriteString(SSOLED *pOLED, int iScrollX, int x, int y, char *szMsg, int iSize,
+	int bInvert, int bRender);
+void oledDrawLine(SSOLED *pOLED, int x1, int y1, int x2, int y2, int bRender);
+
+#endif /* FANPICO_SS_OLED_H */
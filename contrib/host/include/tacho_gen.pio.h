@@ -0,0 +1,40 @@
+/* tacho_gen.pio.h
+ *
+ * Host build replacement for header generated by pioasm from
+ * src/tacho_gen.pio. Program is not executed on host, emulated
+ * state machine output is calculated from DMA ring buffer contents.
+ */
+
+#ifndef TACHO_GEN_PIO_H
+#define TACHO_GEN_PIO_H 1
+
+#include "hal.h"
+
+#define tacho_gen_wrap_target 0
+#define tacho_gen_wrap 7
+
+static const uint16_t tacho_gen_program_instructions[] = {
+	0x80a0, //  0: pull   block
+	0x6040, //  1: out    y, 32
+	0x0065, //  2: jmp    !y, 5
+	0xb842, //  3: nop                    side 1
+	0x0084, //  4: jmp    y--, 4
+	0x90a0, //  5: pull   block           side 0
+	0x6040, //  6: out    y, 32
+	0x0087, //  7: jmp    y--, 7
+};
+
+static const struct pio_program tacho_gen_program = {
+	.instructions = tacho_gen_program_instructions,
+	.length = 8,
+	.origin = -1,
+};
+
+static inline pio_sm_config tacho_gen_program_get_default_config(uint offset)
+{
+	pio_sm_config c = pio_get_default_sm_config();
+
+	return c;
+}
+
+#endif /* TACHO_GEN_PIO_H */
@@ -0,0 +1,171 @@
+/* lcd_host.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host replacement for bb_spi_lcd library: draws into a framebuffer
+ * (in current orientation, as seen on the screen). Panel specific flags
+ * (color order, inversion, mirroring) only compensate for panel wiring,
+ * so these are ignored.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "bb_spi_lcd.h"
+#include "framebuffer.h"
+
+/* Column/row address set and memory write commands sent before pixel data */
+#define LCD_WINDOW_BYTES 11
+
+static struct hal_framebuffer lcd_fb;
+static const uint8_t font_cells[][2] = {
+	[FONT_6x8] = { 6, 8 },
+	[FONT_8x8] = { 8, 8 },
+	[FONT_12x16] = { 12, 16 },
+	[FONT_16x16] = { 16, 16 },
+	[FONT_16x32] = { 16, 32 },
+};
+
+
+static void lcd_transfer(SPILCD *pLCD, uint32_t windows, uint64_t pixels)
+{
+	fb_bus_transfer((windows * LCD_WINDOW_BYTES + pixels * 2) * 8, pLCD->iSPIFreq);
+}
+
+const struct hal_framebuffer *hal_lcd_framebuffer()
+{
+	return (lcd_fb.pixels ? &lcd_fb : NULL);
+}
+
+int spilcdInit(SPILCD *pLCD, int iLCDType, int iFlags, int32_t iSPIFreq, int iCSPin, int iDCPin,
+	int iResetPin, int iLEDPin, int iMISOPin, int iMOSIPin, int iCLKPin)
+{
+	switch (iLCDType) {
+	case LCD_ILI9341:
+	case LCD_ST7789:
+		pLCD->iWidth = 240;
+		pLCD->iHeight = 320;
+		break;
+	case LCD_ILI9342:
+		pLCD->iWidth = 320;
+		pLCD->iHeight = 240;
+		break;
+	case LCD_ILI9486:
+	case LCD_HX8357:
+		pLCD->iWidth = 320;
+		pLCD->iHeight = 480;
+		break;
+	default:
+		return -1;
+	}
+	pLCD->iLCDType = iLCDType;
+	pLCD->iLCDFlags = iFlags;
+	pLCD->iSPIFreq = iSPIFreq;
+	pLCD->iOrientation = LCD_ORIENTATION_0;
+	pLCD->iCurrentWidth = pLCD->iWidth;
+	pLCD->iCurrentHeight = pLCD->iHeight;
+
+	return fb_init(&lcd_fb, pLCD->iCurrentWidth, pLCD->iCurrentHeight);
+}
+
+void spilcdCustomInit(SPILCD *pLCD, const uint8_t *pInitList, int iInitLen,
+	int iInvertOffset, int iRGBOffset)
+{
+	pLCD->pCustomInit = pInitList;
+	pLCD->iCustomInitLen = iInitLen;
+}
+
+int spilcdSetOrientation(SPILCD *pLCD, int iOrientation)
+{
+	bool swap = (iOrientation == LCD_ORIENTATION_90 || iOrientation == LCD_ORIENTATION_270);
+
+	pLCD->iOrientation = iOrientation;
+	pLCD->iCurrentWidth = (swap ? pLCD->iHeight : pLCD->iWidth);
+	pLCD->iCurrentHeight = (swap ? pLCD->iWidth : pLCD->iHeight);
+
+	return fb_init(&lcd_fb, pLCD->iCurrentWidth, pLCD->iCurrentHeight);
+}
+
+int spilcdFill(SPILCD *pLCD, unsigned short usData, int iFlags)
+{
+	fb_fill_rect(&lcd_fb, 0, 0, lcd_fb.width, lcd_fb.height, usData);
+	lcd_transfer(pLCD, 1, lcd_fb.width * lcd_fb.height);
+
+	return 0;
+}
+
+void spilcdRectangle(SPILCD *pLCD, int x, int y, int w, int h, unsigned short usColor1,
+	unsigned short usColor2, int bFill, int iFlags)
+{
+	if (bFill) {
+		fb_fill_rect(&lcd_fb, x, y, w, h, usColor1);
+		lcd_transfer(pLCD, 1, w * h);
+	} else {
+		fb_rect(&lcd_fb, x, y, w, h, usColor1);
+		lcd_transfer(pLCD, 4, 2 * (w + h));
+	}
+}
+
+void spilcdEllipse(SPILCD *pLCD, int32_t centerX, int32_t centerY, int32_t radiusX,
+	int32_t radiusY, unsigned short color, int bFilled, int iFlags)
+{
+	uint32_t rows = 2 * radiusY + 1;
+
+	fb_ellipse(&lcd_fb, centerX, centerY, radiusX, radiusY, color, bFilled);
+	if (bFilled)
+		lcd_transfer(pLCD, rows, rows * (2 * radiusX + 1) * 785 / 1000);
+	else
+		lcd_transfer(pLCD, 2 * rows, 2 * rows);
+}
+
+int spilcdWriteString(SPILCD *pLCD, int x, int y, char *szText, int usFGColor, int usBGColor,
+	int iFontSize, int iFlags)
+{
+	int w, h;
+
+	if (!szText || iFontSize < FONT_6x8 || iFontSize > FONT_16x32)
+		return -1;
+	w = font_cells[iFontSize][0];
+	h = font_cells[iFontSize][1];
+
+	while (*szText && x < lcd_fb.width) {
+		x += fb_char(&lcd_fb, x, y, *szText++, w, h, usFGColor, usBGColor);
+		lcd_transfer(pLCD, 1, w * h);
+	}
+
+	return 0;
+}
+
+int spilcdDrawBMP(SPILCD *pLCD, const uint8_t *pBMP, int iDestX, int iDestY, int bStretch,
+	int iTransparent, int iFlags)
+{
+	uint32_t pixels = 0;
+	int res;
+
+	res = fb_bmp(&lcd_fb, pBMP, iDestX, iDestY, iTransparent, &pixels);
+	lcd_transfer(pLCD, 1, pixels);
+
+	return res;
+}
+
+
+/* eof */
@@ -0,0 +1,185 @@
+/* oled_host.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host replacement for ss_oled library: draws into a (monochrome)
+ * framebuffer. Text rows (y) are in 8 pixel pages, as in ss_oled.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "ss_oled.h"
+#include "framebuffer.h"
+
+#define OLED_ON  0xffff
+#define OLED_OFF 0x0000
+
+/* Address and page/column commands sent before display data */
+#define OLED_WRITE_BYTES 5
+
+static struct hal_framebuffer oled_fb;
+static struct hal_framebuffer oled_panel;
+static bool oled_flip = false;
+
+
+static void oled_transfer(SSOLED *pOLED, int bRender, uint32_t writes, uint64_t bytes)
+{
+	/* I2C: 9 clocks per byte (ACK) */
+	if (bRender)
+		fb_bus_transfer((writes * OLED_WRITE_BYTES + bytes) * 9, pOLED->iSpeed);
+}
+
+static inline uint16_t oled_color(SSOLED *pOLED, bool on)
+{
+	return (on ^ (pOLED->oled_invert ? true : false) ? OLED_ON : OLED_OFF);
+}
+
+/* Framebuffer as seen on the panel (flipped display is rotated 180 degrees) */
+const struct hal_framebuffer *hal_oled_framebuffer()
+{
+	size_t len = (size_t)oled_fb.width * oled_fb.height;
+
+	if (!oled_fb.pixels)
+		return NULL;
+	if (!oled_flip)
+		return &oled_fb;
+	if (oled_panel.width != oled_fb.width || oled_panel.height != oled_fb.height) {
+		if (fb_init(&oled_panel, oled_fb.width, oled_fb.height))
+			return NULL;
+	}
+	for (size_t i = 0; i < len; i++)
+		oled_panel.pixels[i] = oled_fb.pixels[len - 1 - i];
+
+	return &oled_panel;
+}
+
+int oledInit(SSOLED *pOLED, int iType, int iAddr, int bFlip, int bInvert, int bWire,
+	int iSDAPin, int iSCLPin, int iResetPin, int32_t iSpeed)
+{
+	int res;
+
+	memset(pOLED, 0, sizeof(*pOLED));
+	pOLED->oled_type = iType;
+	pOLED->oled_flip = bFlip;
+	pOLED->oled_invert = bInvert;
+	pOLED->iSpeed = iSpeed;
+
+	switch (iType) {
+	case OLED_128x128:
+		pOLED->oled_x = 128;
+		pOLED->oled_y = 128;
+		res = OLED_SH1107_3C;
+		break;
+	case OLED_132x64:
+		/* SH1106 has 132 columns of memory, 128 are visible */
+		pOLED->oled_x = 128;
+		pOLED->oled_y = 64;
+		res = OLED_SH1106_3C;
+		break;
+	case OLED_128x64:
+		pOLED->oled_x = 128;
+		pOLED->oled_y = 64;
+		res = OLED_SSD1306_3C;
+		break;
+	default:
+		return OLED_NOT_FOUND;
+	}
+
+	oled_flip = bFlip;
+	if (fb_init(&oled_fb, pOLED->oled_x, pOLED->oled_y))
+		return OLED_NOT_FOUND;
+	fb_fill_rect(&oled_fb, 0, 0, oled_fb.width, oled_fb.height, oled_color(pOLED, false));
+
+	return res;
+}
+
+void oledSetBackBuffer(SSOLED *pOLED, uint8_t *pBuffer)
+{
+	pOLED->ucScreen = pBuffer;
+}
+
+void oledSetContrast(SSOLED *pOLED, unsigned char ucContrast)
+{
+	pOLED->ucContrast = ucContrast;
+}
+
+void oledFill(SSOLED *pOLED, unsigned char ucData, int bRender)
+{
+	fb_fill_rect(&oled_fb, 0, 0, oled_fb.width, oled_fb.height,
+		oled_color(pOLED, ucData != 0));
+	oled_transfer(pOLED, bRender, pOLED->oled_y / 8, pOLED->oled_x * pOLED->oled_y / 8);
+}
+
+int oledWriteString(SSOLED *pOLED, int iScrollX, int x, int y, char *szMsg, int iSize,
+	int bInvert, int bRender)
+{
+	int w, h;
+	uint16_t fg, bg;
+
+	switch (iSize) {
+	case FONT_6x8:
+		w = 6;
+		h = 8;
+		break;
+	case FONT_8x8:
+		w = 8;
+		h = 8;
+		break;
+	case FONT_12x16:
+		w = 12;
+		h = 16;
+		break;
+	case FONT_16x16:
+		w = 16;
+		h = 16;
+		break;
+	case FONT_16x32:
+		w = 16;
+		h = 32;
+		break;
+	default:
+		return -1;
+	}
+	if (!szMsg)
+		return -1;
+	fg = oled_color(pOLED, !bInvert);
+	bg = oled_color(pOLED, bInvert);
+
+	while (*szMsg && x < oled_fb.width) {
+		x += fb_char(&oled_fb, x, y * 8, *szMsg++, w, h, fg, bg);
+		oled_transfer(pOLED, bRender, h / 8, w * h / 8);
+	}
+
+	return 0;
+}
+
+void oledDrawLine(SSOLED *pOLED, int x1, int y1, int x2, int y2, int bRender)
+{
+	int pages = abs(y2 / 8 - y1 / 8) + 1;
+
+	fb_line(&oled_fb, x1, y1, x2, y2, oled_color(pOLED, true));
+	oled_transfer(pOLED, bRender, pages, pages * (abs(x2 - x1) + 1));
+}
+
+
+/* eof */
@@ -0,0 +1,319 @@
+/* preview.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Display preview: runs display code (src/display*.c) in simulated time
+ * with synthetic (but deterministic) fan and sensor readings, and saves
+ * screen contents as PNG image, or compares it against a golden image.
+ *
+ * Core0 scheduler is run with the same network and display tasks as
+ * the firmware, and time it takes to send pixel data to the display
+ * is charged to the display task, so scheduler statistics show how
+ * much display updates delay other tasks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+
+#include "fanpico.h"
+
+/* Network poll interval histogram bucket limits (us) */
+static const uint32_t net_buckets[] = { 2000, 5000, 10000, 20000, 50000, 100000 };
+#define NET_BUCKETS (count_of(net_buckets) + 1)
+
+static bool full_redraw = false;
+static uint64_t net_last = 0;
+static uint64_t net_max = 0;
+static uint32_t net_hist[NET_BUCKETS];
+
+
+static double preview_time()
+{
+	return to_us_since_boot(get_absolute_time()) / 1000000.0;
+}
+
+/* Readings that change slowly over time (so that trend graphs have something to show) */
+static void preview_state(struct fanpico_state *st)
+{
+	double t = preview_time();
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		st->fan_duty[i] = 30.0 + 5 * i + 10.0 * sin(t / 20.0 + i);
+		st->fan_freq[i] = (st->fan_duty[i] * 20.0) * 2 / 60.0;
+	}
+	for (int i = 0; i < MBFAN_COUNT; i++) {
+		st->mbfan_duty[i] = 40.0 + 10 * i + 5.0 * sin(t / 15.0 + i);
+		st->mbfan_freq[i] = st->fan_freq[i];
+	}
+	for (int i = 0; i < SENSOR_COUNT; i++)
+		st->temp[i] = 30.0 + 2 * i + 8.0 * sin(t / 30.0 + i);
+	for (int i = 0; i < VSENSOR_COUNT; i++)
+		st->vtemp[i] = 40.0 + i + 4.0 * sin(t / 25.0 + i);
+}
+
+static bool preview_task_network()
+{
+	uint64_t t_now = time_us_64();
+	uint32_t t_start = perf_begin(PERF_NETWORK);
+	int i = 0;
+
+	if (net_last > 0) {
+		uint64_t t = t_now - net_last;
+		while (i < count_of(net_buckets) && t >= net_buckets[i])
+			i++;
+		net_hist[i]++;
+		if (t > net_max)
+			net_max = t;
+	}
+	net_last = t_now;
+
+	network_poll();
+	perf_end(PERF_NETWORK, t_start);
+
+	return false;
+}
+
+/* Same as task_display() in fanpico.c (unless full_redraw is set, then
+   whole frame is drawn in a single call, as without incremental drawing) */
+static bool preview_task_display()
+{
+	static bool drawing = false;
+	uint32_t t_start = perf_begin(PERF_DISPLAY);
+
+	if (!drawing) {
+		preview_state((struct fanpico_state *)fanpico_state);
+		display_status(fanpico_state, cfg);
+	}
+	drawing = (display_poll() ? true : false);
+	while (full_redraw && drawing)
+		drawing = (display_poll() ? true : false);
+	perf_end(PERF_DISPLAY, t_start);
+
+	return drawing;
+}
+
+static void reset_stats()
+{
+	display_reset_stats();
+	sched_reset_stats();
+	perf_reset();
+	net_last = net_max = 0;
+	memset(net_hist, 0, sizeof(net_hist));
+}
+
+static void print_net_stats()
+{
+	uint32_t total = 0;
+
+	for (int i = 0; i < NET_BUCKETS; i++)
+		total += net_hist[i];
+	printf("Network poll interval (period 1000 us):\n");
+	for (int i = 0; i < NET_BUCKETS; i++) {
+		if (i < count_of(net_buckets))
+			printf("  < %6lu us: %8lu", (unsigned long)net_buckets[i], (unsigned long)net_hist[i]);
+		else
+			printf(" >= %6lu us: %8lu", (unsigned long)net_buckets[i - 1], (unsigned long)net_hist[i]);
+		printf(" (%.3f%%)\n", (total > 0 ? 100.0 * net_hist[i] / total : 0.0));
+	}
+	printf("  max: %llu us\n", (unsigned long long)net_max);
+}
+
+static int write_file(const char *filename, const uint8_t *buf, size_t len)
+{
+	FILE *fp;
+
+	if (!(fp = fopen(filename, "wb"))) {
+		fprintf(stderr, "cannot create: %s\n", filename);
+		return -1;
+	}
+	if (fwrite(buf, 1, len, fp) != len) {
+		fprintf(stderr, "write failed: %s\n", filename);
+		fclose(fp);
+		return -2;
+	}
+	fclose(fp);
+
+	return 0;
+}
+
+/* Returns 0 if file contents match buffer */
+static int compare_file(const char *filename, const uint8_t *buf, size_t len)
+{
+	FILE *fp;
+	uint8_t *data;
+	size_t n;
+	int res;
+
+	if (!(fp = fopen(filename, "rb"))) {
+		fprintf(stderr, "cannot open: %s\n", filename);
+		return -1;
+	}
+	if (!(data = malloc(len + 1))) {
+		fclose(fp);
+		return -2;
+	}
+	n = fread(data, 1, len + 1, fp);
+	fclose(fp);
+	res = (n == len && !memcmp(data, buf, len) ? 0 : 1);
+	free(data);
+
+	return res;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [options]\n\n"
+		"  -c <cmd>     run SCPI command(s) before initializing display\n"
+		"               (e.g. \"SYS:SPI 1;DISP lcd=ILI9341\")\n"
+		"  -t <sec>     run display updates for given (simulated) time (default: 10)\n"
+		"  -w <sec>     reset statistics after given time (exclude initial screen)\n"
+		"  -b           draw whole frame in one call (disable incremental drawing)\n"
+		"  -o <file>    write screen image (PNG)\n"
+		"  -g <file>    compare screen image against golden image (PNG)\n"
+		"  -s           show display and scheduler statistics\n"
+		"  -v           show firmware log messages\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *start_cmd = NULL;
+	const char *out_file = NULL;
+	const char *golden_file = NULL;
+	const struct hal_framebuffer *fb;
+	datetime_t t = { 2024, 1, 1, 1, 12, 0, 0 };
+	char cmd[256];
+	double run_time = 10.0;
+	double warmup = 0.0;
+	bool stats = false;
+	bool verbose = false;
+	uint64_t t_stop, t_warmup;
+	uint8_t *png;
+	size_t png_len;
+	int opt, res = 0;
+
+	while ((opt = getopt(argc, argv, "c:t:w:o:g:bsvh")) != -1) {
+		switch (opt) {
+		case 'c':
+			start_cmd = optarg;
+			break;
+		case 't':
+			run_time = atof(optarg);
+			break;
+		case 'w':
+			warmup = atof(optarg);
+			break;
+		case 'b':
+			full_redraw = true;
+			break;
+		case 'o':
+			out_file = optarg;
+			break;
+		case 'g':
+			golden_file = optarg;
+			break;
+		case 's':
+			stats = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	hal_set_simulated_time(true);
+	hal_display_set_bus_timing(true);
+	mem_init();
+	rtc_init();
+	rtc_set_datetime(&t);
+
+	set_log_level(verbose ? LOG_INFO : LOG_ERR);
+	lfs_setup(false);
+	read_config();
+	set_log_level(verbose ? LOG_INFO : LOG_ERR);
+
+	if (start_cmd) {
+		strncopy(cmd, start_cmd, sizeof(cmd));
+		process_command(fanpico_state, (struct fanpico_config *)cfg, cmd);
+	}
+
+	display_init();
+	if (!hal_lcd_framebuffer() && !hal_oled_framebuffer()) {
+		fprintf(stderr, "no display initialized (check SYS:SPI and SYS:DISP settings)\n");
+		exit(2);
+	}
+
+	/* Core0 tasks as in fanpico.c */
+	sched_add_task("network", preview_task_network, 1, 1, 10);
+	sched_add_task("display", preview_task_display, 3, 1000, 500);
+	reset_stats();
+
+	t_warmup = get_absolute_time() + warmup * 1000000;
+	t_stop = get_absolute_time() + run_time * 1000000;
+	while (get_absolute_time() < t_stop) {
+		if (t_warmup > 0 && get_absolute_time() >= t_warmup) {
+			reset_stats();
+			t_warmup = 0;
+		}
+		if (!sched_run())
+			hal_advance_time_us(10);
+	}
+	/* Finish current frame */
+	while (display_poll())
+		;
+
+	fb = (cfg->spi_active ? hal_lcd_framebuffer() : hal_oled_framebuffer());
+	if (!(png = hal_framebuffer_png(fb, &png_len))) {
+		fprintf(stderr, "failed to encode image\n");
+		exit(3);
+	}
+	if (out_file && write_file(out_file, png, png_len))
+		res = 4;
+	if (golden_file) {
+		if (compare_file(golden_file, png, png_len)) {
+			fprintf(stderr, "screen image (%ux%u) differs from: %s\n",
+				fb->width, fb->height, golden_file);
+			res = 5;
+		}
+	}
+	free(png);
+
+	if (stats) {
+		printf("Display (%ux%u):\n", fb->width, fb->height);
+		display_print_stats();
+		printf("\n");
+		sched_print();
+		printf("\n");
+		print_net_stats();
+	}
+
+	return res;
+}
+
+
+/* eof */
@@ -0,0 +1,675 @@
+/* sim.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Fan/thermal plant simulator for evaluating FanPico configurations
+ * (fan curves, filters, ...) on a host.
+ *
+ * Runs core1 main loop (core1_loop()) in simulated time, while plant model
+ * generates tacho signals, temperature sensor ADC readings and
+ * motherboard PWM signals.
+ *
+ * Plant model:
+ *  - fans: first order spin-up (time constant 'tau'), RPM vs duty curve
+ *    (max_rpm * (duty/100)^gamma), stall below 'min_duty' and need at
+ *    least 'start_duty' to start from standstill, 'ppr' tacho pulses per
+ *    revolution, power consumption scales with cube of RPM.
+ *  - thermal: single lumped heat capacity heated by load profile and cooled
+ *    by airflow (conductance to ambient increases linearly with airflow).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+#include "cJSON.h"
+
+#include "fanpico.h"
+
+
+#define SIM_LOOP_TIME_US  100     /* simulated duration of one core1 loop */
+#define SIM_SAMPLE_US     100000  /* metrics sampling interval */
+#define MAX_LOAD_STEPS    32
+
+/* Functions without prototypes in fanpico.h */
+void clear_config(struct fanpico_config *cfg);
+int json_to_config(cJSON *config, struct fanpico_config *cfg);
+
+extern uint8_t fan_gpio_pwm_map[FAN_MAX_COUNT];
+extern uint8_t mbfan_gpio_pwm_map[MBFAN_MAX_COUNT];
+extern uint8_t fan_gpio_tacho_map[FAN_MAX_COUNT];
+extern uint8_t sensor_adc_map[SENSOR_MAX_COUNT];
+
+
+struct sim_fan {
+	/* parameters */
+	double max_rpm;
+	double min_duty;
+	double start_duty;
+	double gamma;
+	double tau;
+	double power;
+	double airflow;
+	int ppr;
+
+	/* state */
+	double rpm;
+	double phase;      /* position within current half cycle of tacho signal (0..1) */
+	bool level;
+	bool spinning;
+
+	/* metrics */
+	double energy;
+	double duty_sum;
+	double duty_sum2;
+	double rpm_sum;
+	double rpm_err_sum;
+	uint32_t rpm_err_count;
+	uint32_t duty_changes;
+	double last_duty;
+};
+
+struct load_step {
+	double t;          /* start time (seconds) */
+	double load;       /* heat load (W) */
+	double mb_duty;    /* motherboard PWM duty (%) */
+};
+
+struct sim_plant {
+	double ambient;
+	double heat_capacity;
+	double g_min;
+	double g_max;
+	double adc_noise;
+	int sensor;
+	struct sim_fan fans[FAN_MAX_COUNT];
+	struct load_step load[MAX_LOAD_STEPS];
+	int load_steps;
+
+	/* state */
+	double temp;
+	int step;
+};
+
+struct step_metrics {
+	double t_start;
+	double temp_start;
+	double temp_min;
+	double temp_max;
+};
+
+
+static struct sim_plant plant;
+static struct step_metrics step_metrics[MAX_LOAD_STEPS];
+static uint32_t samples = 0;
+
+
+static double json_number(cJSON *item, const char *name, double def)
+{
+	cJSON *r = cJSON_GetObjectItem(item, name);
+
+	return (r ? cJSON_GetNumberValue(r) : def);
+}
+
+static void plant_defaults(struct sim_plant *p)
+{
+	memset(p, 0, sizeof(*p));
+	p->ambient = 25.0;
+	p->heat_capacity = 2000.0;
+	p->g_min = 1.5;
+	p->g_max = 8.0;
+	p->adc_noise = 0.0;
+	p->sensor = 0;
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		struct sim_fan *f = &p->fans[i];
+
+		f->max_rpm = 2000.0;
+		f->min_duty = 20.0;
+		f->start_duty = 30.0;
+		f->gamma = 1.0;
+		f->tau = 2.0;
+		f->power = 2.5;
+		f->airflow = 1.0;
+		f->ppr = 2;
+	}
+
+	p->load[0] = (struct load_step){ 0.0, 50.0, 30.0 };
+	p->load[1] = (struct load_step){ 300.0, 150.0, 60.0 };
+	p->load[2] = (struct load_step){ 600.0, 80.0, 40.0 };
+	p->load_steps = 3;
+}
+
+static cJSON *read_json_file(const char *filename)
+{
+	cJSON *json;
+	char *buf;
+	long len;
+	FILE *fp;
+
+	if (!(fp = fopen(filename, "r"))) {
+		fprintf(stderr, "cannot open: %s\n", filename);
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	rewind(fp);
+	if (!(buf = calloc(1, len + 1)) || fread(buf, 1, len, fp) != len) {
+		fprintf(stderr, "cannot read: %s\n", filename);
+		fclose(fp);
+		free(buf);
+		return NULL;
+	}
+	fclose(fp);
+	if (!(json = cJSON_Parse(buf)))
+		fprintf(stderr, "%s: invalid JSON\n", filename);
+	free(buf);
+
+	return json;
+}
+
+static int plant_read_json(struct sim_plant *p, const char *filename)
+{
+	cJSON *json, *item, *r;
+	int i;
+
+	if (!(json = read_json_file(filename)))
+		return -1;
+
+	p->ambient = json_number(json, "ambient", p->ambient);
+	p->heat_capacity = json_number(json, "heat_capacity", p->heat_capacity);
+	p->g_min = json_number(json, "conductance_min", p->g_min);
+	p->g_max = json_number(json, "conductance_max", p->g_max);
+	p->adc_noise = json_number(json, "adc_noise", p->adc_noise);
+	p->sensor = json_number(json, "sensor", p->sensor + 1) - 1;
+	if (p->sensor < 0 || p->sensor >= SENSOR_COUNT)
+		p->sensor = 0;
+
+	if ((r = cJSON_GetObjectItem(json, "fans"))) {
+		cJSON_ArrayForEach(item, r) {
+			int fan = json_number(item, "fan", 0) - 1;
+			if (fan < 0 || fan >= FAN_COUNT)
+				continue;
+			struct sim_fan *f = &p->fans[fan];
+			f->max_rpm = json_number(item, "max_rpm", f->max_rpm);
+			f->min_duty = json_number(item, "min_duty", f->min_duty);
+			f->start_duty = json_number(item, "start_duty", f->start_duty);
+			f->gamma = json_number(item, "gamma", f->gamma);
+			f->tau = json_number(item, "tau", f->tau);
+			f->power = json_number(item, "power", f->power);
+			f->airflow = json_number(item, "airflow", f->airflow);
+			f->ppr = json_number(item, "ppr", f->ppr);
+			if (f->ppr < 1)
+				f->ppr = 1;
+			if (f->tau < 0.01)
+				f->tau = 0.01;
+		}
+	}
+
+	if ((r = cJSON_GetObjectItem(json, "load"))) {
+		i = 0;
+		cJSON_ArrayForEach(item, r) {
+			if (i >= MAX_LOAD_STEPS || cJSON_GetArraySize(item) < 2)
+				break;
+			p->load[i].t = cJSON_GetNumberValue(cJSON_GetArrayItem(item, 0));
+			p->load[i].load = cJSON_GetNumberValue(cJSON_GetArrayItem(item, 1));
+			p->load[i].mb_duty = (cJSON_GetArraySize(item) > 2 ?
+					cJSON_GetNumberValue(cJSON_GetArrayItem(item, 2)) : 0.0);
+			i++;
+		}
+		if (i > 0)
+			p->load_steps = i;
+	}
+
+	cJSON_Delete(json);
+	return 0;
+}
+
+static int read_config_json(const char *filename)
+{
+	cJSON *json;
+	int res;
+
+	if (!(json = read_json_file(filename)))
+		return -1;
+
+	clear_config((struct fanpico_config *)cfg);
+	res = json_to_config(json, (struct fanpico_config *)cfg);
+	cJSON_Delete(json);
+
+	return (res < 0 ? -4 : 0);
+}
+
+
+static double gaussian()
+{
+	double u1 = (random() + 1.0) / (RAND_MAX + 2.0);
+	double u2 = (random() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2.0 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+/* Convert temperature into ADC reading, using sensor configuration
+   (inverse of get_temperature()). */
+static uint16_t temp_to_adc(const struct sensor_input *s, double temp)
+{
+	double t, r, volt, raw;
+
+	t = (temp - s->temp_offset) / (s->temp_coefficient != 0 ? s->temp_coefficient : 1.0);
+	if (s->type == TEMP_INTERNAL) {
+		volt = 0.706 - (t - 27.0) * 0.001721;
+		raw = volt / (ADC_REF_VOLTAGE / ADC_MAX_VALUE);
+	} else {
+		r = s->thermistor_nominal * exp(s->beta_coefficient *
+						(1.0 / (t + 273.15) - 1.0 / (s->temp_nominal + 273.15)));
+		raw = ADC_MAX_VALUE * r / (r + SENSOR_SERIES_RESISTANCE);
+	}
+	if (plant.adc_noise > 0)
+		raw += gaussian() * plant.adc_noise;
+	raw = round(raw);
+
+	return (raw < 0 ? 0 : (raw > ADC_MAX_VALUE - 1 ? ADC_MAX_VALUE - 1 : raw));
+}
+
+static void update_sensors()
+{
+	for (int i = 0; i < SENSOR_COUNT; i++) {
+		double t = (i == plant.sensor ? plant.temp : plant.ambient);
+		hal_adc_set_value(sensor_adc_map[i], temp_to_adc(&cfg->sensors[i], t));
+	}
+}
+
+static double fan_target_rpm(struct sim_fan *f, double duty)
+{
+	if (f->spinning) {
+		if (duty < f->min_duty)
+			f->spinning = false;
+	} else {
+		if (duty >= f->start_duty)
+			f->spinning = true;
+	}
+	if (!f->spinning)
+		return 0.0;
+
+	return f->max_rpm * pow(duty / 100.0, f->gamma);
+}
+
+/* Tacho signal level seen on fan's tacho input pin. */
+static void update_tacho_pins()
+{
+#if TACHO_READ_MULTIPLEX > 0
+	uint port = (hal_gpio_output(FAN_TACHO_READ_S0_PIN) ? 1 : 0)
+		| (hal_gpio_output(FAN_TACHO_READ_S1_PIN) ? 2 : 0)
+		| (hal_gpio_output(FAN_TACHO_READ_S2_PIN) ? 4 : 0);
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		if (fan_gpio_tacho_map[i] == port) {
+			hal_gpio_set_input(FAN_TACHO_READ_PIN, plant.fans[i].level);
+			break;
+		}
+	}
+#else
+	for (int i = 0; i < FAN_COUNT; i++)
+		hal_gpio_set_input(fan_gpio_tacho_map[i], plant.fans[i].level);
+#endif
+}
+
+static void advance_fans(double dt)
+{
+	for (int i = 0; i < FAN_COUNT; i++) {
+		struct sim_fan *f = &plant.fans[i];
+		f->phase += dt * 2.0 * f->rpm / 60.0 * f->ppr;
+	}
+}
+
+/* Time callback: integrate plant model from t_from to t_to and generate
+   tacho signal edges at correct times. */
+static void plant_step(uint64_t t_from, uint64_t t_to)
+{
+	const struct load_step *load = &plant.load[plant.step];
+	double dt = (t_to - t_from) / 1000000.0;
+	double airflow = 0.0, airflow_max = 0.0;
+	double t = t_from / 1000000.0;
+	double t_end = t_to / 1000000.0;
+
+	/* Fan speed (assumed constant during short time step) and power */
+	for (int i = 0; i < FAN_COUNT; i++) {
+		struct sim_fan *f = &plant.fans[i];
+		double duty = hal_pwm_output_duty(fan_gpio_pwm_map[i]);
+		double target = fan_target_rpm(f, duty);
+
+		f->rpm += (target - f->rpm) * (dt < f->tau ? dt / f->tau : 1.0);
+		if (f->rpm < 1.0 && target == 0.0)
+			f->rpm = 0.0;
+		f->energy += f->power * pow(f->rpm / f->max_rpm, 3) * dt;
+		airflow += f->airflow * f->rpm / f->max_rpm;
+		airflow_max += f->airflow;
+	}
+
+	/* Thermal model */
+	double g = plant.g_min + (plant.g_max - plant.g_min)
+		* (airflow_max > 0 ? airflow / airflow_max : 0);
+	plant.temp += (load->load - g * (plant.temp - plant.ambient)) * dt / plant.heat_capacity;
+
+	/* Tacho edges in time order */
+	update_tacho_pins();
+	while (1) {
+		int next = -1;
+		double next_dt = t_end - t;
+
+		for (int i = 0; i < FAN_COUNT; i++) {
+			const struct sim_fan *f = &plant.fans[i];
+			if (f->rpm <= 0.0)
+				continue;
+			double edge_dt = (1.0 - f->phase) / (2.0 * f->rpm / 60.0 * f->ppr);
+			if (edge_dt <= next_dt) {
+				next_dt = edge_dt;
+				next = i;
+			}
+		}
+		if (next < 0)
+			break;
+
+		advance_fans(next_dt);
+		t += next_dt;
+		plant.fans[next].phase = 0.0;
+		plant.fans[next].level = !plant.fans[next].level;
+		hal_set_time_us(t * 1000000.0);
+		update_tacho_pins();
+	}
+	advance_fans(t_end - t);
+}
+
+static void set_load_step(int step)
+{
+	const struct load_step *load = &plant.load[step];
+
+	plant.step = step;
+	for (int i = 0; i < MBFAN_COUNT; i++)
+		hal_pwm_set_input_duty(mbfan_gpio_pwm_map[i], load->mb_duty);
+
+	step_metrics[step].t_start = load->t;
+	step_metrics[step].temp_start = plant.temp;
+	step_metrics[step].temp_min = plant.temp;
+	step_metrics[step].temp_max = plant.temp;
+}
+
+static void sample(const struct fanpico_state *st, double t, FILE *csv)
+{
+	struct step_metrics *m = &step_metrics[plant.step];
+
+	samples++;
+	if (plant.temp < m->temp_min)
+		m->temp_min = plant.temp;
+	if (plant.temp > m->temp_max)
+		m->temp_max = plant.temp;
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		struct sim_fan *f = &plant.fans[i];
+		double duty = st->fan_duty[i];
+		double rpm = st->fan_freq[i] * 60.0 / (cfg->fans[i].rpm_factor > 0 ? cfg->fans[i].rpm_factor : 2);
+
+		f->duty_sum += duty;
+		f->duty_sum2 += duty * duty;
+		f->rpm_sum += f->rpm;
+		if (duty != f->last_duty)
+			f->duty_changes++;
+		f->last_duty = duty;
+		if (t > 5.0) {
+			f->rpm_err_sum += fabs(rpm - f->rpm);
+			f->rpm_err_count++;
+		}
+	}
+
+	if (csv) {
+		fprintf(csv, "%.1f,%.1f,%.3f,%.2f", t, plant.load[plant.step].load,
+			plant.temp, st->temp[plant.sensor]);
+		for (int i = 0; i < FAN_COUNT; i++) {
+			fprintf(csv, ",%.1f,%.0f,%.0f", st->fan_duty[i], plant.fans[i].rpm,
+				st->fan_freq[i] * 60.0 / (cfg->fans[i].rpm_factor > 0 ? cfg->fans[i].rpm_factor : 2));
+		}
+		fprintf(csv, "\n");
+	}
+}
+
+/* Plant temperature history (one sample every SIM_SAMPLE_US) used
+   for calculating settling times. */
+static double *temp_history = NULL;
+static size_t temp_history_len = 0;
+
+static void report(double sim_time, double band)
+{
+	double total_energy = 0.0;
+
+	printf("Simulated time: %.0f s, samples: %u\n\n", sim_time, samples);
+
+	printf("Load step response (plant temperature, settling band +/- %.2f C):\n", band);
+	printf("%4s %8s %8s %8s %8s %10s %12s\n",
+		"Step", "Start(s)", "Load(W)", "T0(C)", "Tend(C)", "Overshoot", "Settling(s)");
+	for (int s = 0; s < plant.load_steps; s++) {
+		struct step_metrics *m = &step_metrics[s];
+		double t_end = (s + 1 < plant.load_steps ? plant.load[s + 1].t : sim_time);
+		size_t i_start = m->t_start * 1000000 / SIM_SAMPLE_US;
+		size_t i_end = t_end * 1000000 / SIM_SAMPLE_US;
+		double overshoot, settling = 0.0;
+		double final;
+
+		if (plant.load[s].t >= sim_time) {
+			printf("%4d %8.0f %8.1f %8s\n", s + 1, plant.load[s].t,
+				plant.load[s].load, "not reached");
+			continue;
+		}
+		if (i_end > temp_history_len)
+			i_end = temp_history_len;
+		if (i_start >= i_end)
+			continue;
+		final = temp_history[i_end - 1];
+
+		if (final >= m->temp_start)
+			overshoot = m->temp_max - final;
+		else
+			overshoot = final - m->temp_min;
+
+		for (size_t i = i_end; i > i_start; i--) {
+			if (fabs(temp_history[i - 1] - final) > band) {
+				settling = (i - i_start) * (SIM_SAMPLE_US / 1000000.0);
+				break;
+			}
+		}
+
+		printf("%4d %8.0f %8.1f %8.2f %8.2f %10.2f %12.1f\n",
+			s + 1, m->t_start, plant.load[s].load, m->temp_start, final,
+			overshoot, settling);
+	}
+
+	printf("\nFans:\n");
+	printf("%4s %10s %12s %10s %10s %12s %10s\n",
+		"Fan", "Duty(%)", "DutyStdDev", "Changes", "RPM", "TachoErr", "Energy(J)");
+	for (int i = 0; i < FAN_COUNT; i++) {
+		struct sim_fan *f = &plant.fans[i];
+		double mean = f->duty_sum / samples;
+		double var = f->duty_sum2 / samples - mean * mean;
+
+		printf("%4d %10.1f %12.2f %10u %10.0f %12.1f %10.1f\n",
+			i + 1, mean, sqrt(var > 0 ? var : 0), f->duty_changes,
+			f->rpm_sum / samples,
+			(f->rpm_err_count ? f->rpm_err_sum / f->rpm_err_count : 0),
+			f->energy);
+		total_energy += f->energy;
+	}
+	printf("\nTotal fan energy: %.1f J (%.3f Wh)\n", total_energy, total_energy / 3600.0);
+}
+
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [options] [config.json]\n\n"
+		"  -p <file>    plant model parameters (JSON)\n"
+		"  -t <sec>     simulation length (default: last load step + 300s)\n"
+		"  -b <C>       settling band (default: 0.5)\n"
+		"  -o <file>    write time series (CSV)\n"
+		"  -c <cmd>     run SCPI command(s) at start of simulation\n"
+		"  -e <cmd>     run SCPI command(s) at end of simulation\n"
+		"  -v           show firmware log messages\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *plant_file = NULL;
+	const char *csv_file = NULL;
+	const char *start_cmd = NULL;
+	const char *end_cmd = NULL;
+	char cmd[256];
+	double sim_time = 0.0;
+	double band = 0.5;
+	bool verbose = false;
+	uint64_t t_sample, t_stop;
+	FILE *csv = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:t:b:o:c:e:vh")) != -1) {
+		switch (opt) {
+		case 'p':
+			plant_file = optarg;
+			break;
+		case 't':
+			sim_time = atof(optarg);
+			break;
+		case 'b':
+			band = atof(optarg);
+			break;
+		case 'o':
+			csv_file = optarg;
+			break;
+		case 'c':
+			start_cmd = optarg;
+			break;
+		case 'e':
+			end_cmd = optarg;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	hal_set_simulated_time(true);
+	srandom(1);
+	mem_init();
+
+	plant_defaults(&plant);
+	if (plant_file && plant_read_json(&plant, plant_file))
+		exit(2);
+	if (sim_time <= 0)
+		sim_time = plant.load[plant.load_steps - 1].t + 300.0;
+	plant.temp = plant.ambient;
+
+	set_log_level(verbose ? LOG_INFO : LOG_ERR);
+	lfs_setup(false);
+	read_config();
+	if (optind < argc && read_config_json(argv[optind]))
+		exit(3);
+	set_log_level(verbose ? LOG_INFO : LOG_ERR);
+
+	if (csv_file) {
+		if (!(csv = fopen(csv_file, "w"))) {
+			fprintf(stderr, "cannot create: %s\n", csv_file);
+			exit(4);
+		}
+		fprintf(csv, "time,load,temp,sensor");
+		for (int i = 0; i < FAN_COUNT; i++)
+			fprintf(csv, ",fan%d_duty,fan%d_rpm,fan%d_rpm_measured", i + 1, i + 1, i + 1);
+		fprintf(csv, "\n");
+	}
+
+	temp_history_len = sim_time * 1000000 / SIM_SAMPLE_US + 1;
+	if (!(temp_history = calloc(temp_history_len, sizeof(double))))
+		exit(5);
+
+	/* Initialize hardware as in setup() */
+	setup_pwm_inputs();
+	setup_pwm_outputs();
+	setup_tacho_inputs();
+	setup_tacho_outputs();
+	update_sensors();
+	set_load_step(0);
+
+	hal_set_time_callback(plant_step);
+	core1_setup();
+
+	if (start_cmd) {
+		strncopy(cmd, start_cmd, sizeof(cmd));
+		update_system_state();
+		process_command(fanpico_state, (struct fanpico_config *)cfg, cmd);
+	}
+
+	t_sample = get_absolute_time();
+	t_stop = t_sample + sim_time * 1000000;
+	while (get_absolute_time() < t_stop) {
+		uint64_t t_now = get_absolute_time() - 1;
+		double t = t_now / 1000000.0;
+
+		if (plant.step + 1 < plant.load_steps && t >= plant.load[plant.step + 1].t)
+			set_load_step(plant.step + 1);
+
+		/* core1 (and tacho interrupts enabled on core1) */
+		hal_set_core_num(1);
+		update_sensors();
+		core1_loop();
+		hal_advance_time_us(SIM_LOOP_TIME_US);
+		hal_set_core_num(0);
+
+		if (get_absolute_time() - t_sample >= SIM_SAMPLE_US) {
+			size_t i = t_now / SIM_SAMPLE_US;
+			t_sample += SIM_SAMPLE_US;
+			update_system_state();
+			/* core0 picks up fan calibration results */
+			fancal_apply_results((struct fanpico_config *)cfg);
+			if (i < temp_history_len)
+				temp_history[i] = plant.temp;
+			sample(fanpico_state, t, (i % 10 == 0 ? csv : NULL));
+		}
+	}
+
+	temp_history_len = sim_time * 1000000 / SIM_SAMPLE_US;
+	report(sim_time, band);
+
+	if (end_cmd) {
+		strncopy(cmd, end_cmd, sizeof(cmd));
+		printf("\n");
+		process_command(fanpico_state, (struct fanpico_config *)cfg, cmd);
+	}
+
+	if (csv)
+		fclose(csv);
+	free(temp_history);
+
+	return 0;
+}
+
+
+/* eof */
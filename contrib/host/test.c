@@ -0,0 +1,590 @@
+/* test.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Unit tests for FanPico control path running on host (run by ctest).
+ *
+ * Usage: fanpico-test <test> [trace.csv]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+
+#include "fanpico.h"
+
+
+/* Functions without prototypes in fanpico.h */
+void clear_state(struct fanpico_state *s);
+void clear_config(struct fanpico_config *cfg);
+
+static struct fanpico_state state;
+static struct fanpico_config config;
+static int failures = 0;
+
+
+#define CHECK(cond, ...) do {						\
+		if (!(cond)) {						\
+			printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+			printf(__VA_ARGS__);				\
+			printf("\n");					\
+			failures++;					\
+		}							\
+	} while (0)
+
+#define CHECK_NEAR(val, expected, eps) do {				\
+		double v_ = (val);					\
+		if (fabs(v_ - (expected)) > (eps)) {			\
+			printf("%s:%d: check failed: %s = %f (expected %f)\n", \
+				__FILE__, __LINE__, #val, v_, (double)(expected)); \
+			failures++;					\
+		}							\
+	} while (0)
+
+
+static void set_pwm_map(struct pwm_map *map, int points, const float *xy)
+{
+	map->points = points;
+	for (int i = 0; i < points; i++) {
+		map->pwm[i][0] = xy[i * 2];
+		map->pwm[i][1] = xy[i * 2 + 1];
+	}
+}
+
+static void set_tacho_map(struct tacho_map *map, int points, const uint16_t *xy)
+{
+	map->points = points;
+	for (int i = 0; i < points; i++) {
+		map->tacho[i][0] = xy[i * 2];
+		map->tacho[i][1] = xy[i * 2 + 1];
+	}
+}
+
+static void set_temp_map(struct temp_map *map, int points, const float *xy)
+{
+	map->points = points;
+	for (int i = 0; i < points; i++) {
+		map->temp[i][0] = xy[i * 2];
+		map->temp[i][1] = xy[i * 2 + 1];
+	}
+}
+
+/* Reset configuration and state to a known baseline: fans and mbfans
+ * use linear 1:1 mapping without limits. */
+static void test_setup()
+{
+	const float pwm_linear[] = { 0, 0, 100, 100 };
+	const uint16_t tacho_linear[] = { 0, 0, 10000, 10000 };
+
+	clear_config(&config);
+	clear_state(&state);
+	for (int i = 0; i < FAN_COUNT; i++) {
+		struct fan_output *f = &config.fans[i];
+
+		f->max_pwm = 100.0;
+		f->pwm_coefficient = 1.0;
+		set_pwm_map(&f->map, 2, pwm_linear);
+	}
+	for (int i = 0; i < MBFAN_COUNT; i++) {
+		struct mb_input *m = &config.mbfans[i];
+
+		m->max_rpm = 10000;
+		m->rpm_coefficient = 1.0;
+		set_tacho_map(&m->map, 2, tacho_linear);
+	}
+}
+
+
+static void test_map()
+{
+	const float pwm_xy[] = { 0, 20, 50, 50, 100, 100 };
+	const uint16_t tacho_xy[] = { 500, 0, 1500, 1000, 3000, 1600 };
+	const float temp_xy[] = { 20.0, 10.0, 30.0, 50.0, 40.0, 100.0 };
+	struct pwm_map pmap;
+	struct tacho_map tmap;
+	struct temp_map smap;
+
+	set_pwm_map(&pmap, 3, pwm_xy);
+	CHECK_NEAR(pwm_map(&pmap, -10.0), 20.0, 1e-9);
+	CHECK_NEAR(pwm_map(&pmap, 0.0), 20.0, 1e-9);
+	CHECK_NEAR(pwm_map(&pmap, 25.0), 35.0, 1e-9);
+	CHECK_NEAR(pwm_map(&pmap, 50.0), 50.0, 1e-9);
+	CHECK_NEAR(pwm_map(&pmap, 62.5), 62.5, 1e-9);
+	CHECK_NEAR(pwm_map(&pmap, 99.9), 99.9, 1e-6);
+	CHECK_NEAR(pwm_map(&pmap, 150.0), 100.0, 1e-9);
+
+	set_tacho_map(&tmap, 3, tacho_xy);
+	CHECK_NEAR(tacho_map(&tmap, 0.0), 0.0, 1e-9);
+	CHECK_NEAR(tacho_map(&tmap, 1000.0), 500.0, 1e-9);
+	CHECK_NEAR(tacho_map(&tmap, 1500.0), 1000.0, 1e-9);
+	CHECK_NEAR(tacho_map(&tmap, 2250.0), 1300.0, 1e-9);
+	CHECK_NEAR(tacho_map(&tmap, 5000.0), 1600.0, 1e-9);
+
+	set_temp_map(&smap, 3, temp_xy);
+	CHECK_NEAR(sensor_get_duty(&smap, 15.0), 10.0, 1e-9);
+	CHECK_NEAR(sensor_get_duty(&smap, 25.0), 30.0, 1e-6);
+	CHECK_NEAR(sensor_get_duty(&smap, 35.0), 75.0, 1e-6);
+	CHECK_NEAR(sensor_get_duty(&smap, 45.0), 100.0, 1e-9);
+
+	/* Map is monotonic between the points */
+	for (double x = 0.0, prev = -1.0; x <= 100.0; x += 0.5) {
+		double y = pwm_map(&pmap, x);
+
+		CHECK(y >= prev, "pwm_map(%f) = %f < %f", x, y, prev);
+		prev = y;
+	}
+}
+
+
+static void *parse_filter(enum signal_filter_types type, const char *args)
+{
+	char tmp[64];
+
+	strncopy(tmp, args, sizeof(tmp));
+	return filter_parse_args(type, tmp);
+}
+
+static void test_filters()
+{
+	const float sma_in[] = { 10, 20, 30, 40, 50, 50, 50, 50 };
+	const float sma_out[] = { 10, 15, 20, 25, 35, 42.5, 47.5, 50 };
+	void *ctx;
+	char *s;
+
+	CHECK(str2filter("none") == FILTER_NONE, "none");
+	CHECK(str2filter("lossypeak") == FILTER_LOSSYPEAK, "lossypeak");
+	CHECK(str2filter("sma") == FILTER_SMA, "sma");
+	for (int i = 0; i <= FILTER_ENUM_MAX; i++)
+		CHECK(str2filter(filter2str(i)) == i, "filter %d", i);
+
+	/* Invalid arguments are rejected */
+	CHECK(parse_filter(FILTER_SMA, "") == NULL, "empty");
+	CHECK(parse_filter(FILTER_SMA, "1") == NULL, "window too small");
+	CHECK(parse_filter(FILTER_SMA, "33") == NULL, "window too large");
+	CHECK(parse_filter(FILTER_SMA, "abc") == NULL, "not a number");
+	CHECK(parse_filter(FILTER_LOSSYPEAK, "-1,1") == NULL, "negative decay");
+	CHECK(parse_filter(FILTER_LOSSYPEAK, "1") == NULL, "missing delay");
+
+	/* Simple moving average */
+	ctx = parse_filter(FILTER_SMA, "4");
+	CHECK(ctx != NULL, "sma 4");
+	if (ctx) {
+		s = filter_print_args(FILTER_SMA, ctx);
+		CHECK(s && !strcmp(s, "4"), "sma args '%s'", s);
+		free(s);
+		for (int i = 0; i < sizeof(sma_in) / sizeof(sma_in[0]); i++)
+			CHECK_NEAR(filter(FILTER_SMA, ctx, sma_in[i]), sma_out[i], 1e-4);
+		mem_free(MEM_FILTERS, ctx);
+	}
+
+	/* Lossy peak detector: decay 10/s after 1s delay */
+	ctx = parse_filter(FILTER_LOSSYPEAK, "10,1");
+	CHECK(ctx != NULL, "lossypeak 10,1");
+	if (ctx) {
+		CHECK_NEAR(filter(FILTER_LOSSYPEAK, ctx, 80), 80.0, 1e-4);
+		hal_advance_time_us(500000);
+		CHECK_NEAR(filter(FILTER_LOSSYPEAK, ctx, 20), 80.0, 1e-4);
+		hal_advance_time_us(1000000);
+		CHECK_NEAR(filter(FILTER_LOSSYPEAK, ctx, 20), 75.0, 1e-4);
+		hal_advance_time_us(1000000);
+		CHECK_NEAR(filter(FILTER_LOSSYPEAK, ctx, 20), 65.0, 1e-4);
+		hal_advance_time_us(10000000);
+		CHECK_NEAR(filter(FILTER_LOSSYPEAK, ctx, 20), 20.0, 1e-4);
+		CHECK_NEAR(filter(FILTER_LOSSYPEAK, ctx, 90), 90.0, 1e-4);
+		mem_free(MEM_FILTERS, ctx);
+	}
+}
+
+
+static void test_pwm()
+{
+	const float pwm_xy[] = { 0, 20, 100, 100 };
+	struct fan_output *f = &config.fans[0];
+
+	test_setup();
+
+	/* Fixed source */
+	f->s_type = PWM_FIXED;
+	f->s_id = 40;
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 40.0, 1e-6);
+
+	/* Coefficient and offset */
+	f->pwm_coefficient = 0.5;
+	f->offset = 10.0;
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 30.0, 1e-6);
+	f->pwm_coefficient = 1.0;
+	f->offset = 0.0;
+
+	/* Min/max limits */
+	f->min_pwm = 45.0;
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 45.0, 1e-6);
+	f->min_pwm = 0.0;
+	f->max_pwm = 35.5;
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 35.5, 1e-6);
+	f->max_pwm = 100.0;
+
+	/* Motherboard PWM input through a map */
+	f->s_type = PWM_MB;
+	f->s_id = 1;
+	set_pwm_map(&f->map, 2, pwm_xy);
+	state.mbfan_duty[1] = 0.0;
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 20.0, 1e-6);
+	state.mbfan_duty[1] = 50.0;
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 60.0, 1e-6);
+
+	/* Sensor source with hysteresis applied temperature */
+	f->s_type = PWM_SENSOR;
+	f->s_id = 0;
+	set_temp_map(&config.sensors[0].map, 2, (const float[]){ 20.0, 0.0, 50.0, 100.0 });
+	state.temp_hyst[0] = 35.0;
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 60.0, 1e-4);
+
+	/* Zone members use zone control signal */
+	config.zones[0].s_type = PWM_FIXED;
+	config.zones[0].s_id = 70;
+	f->zone = 0;
+	state.zone_duty[0] = calculate_zone_duty(&state, &config, 0);
+	CHECK_NEAR(state.zone_duty[0], 70.0, 1e-6);
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 76.0, 1e-4);
+}
+
+
+static void test_feedforward()
+{
+	struct fan_output *f = &config.fans[0];
+	struct temp_slope slope;
+
+	test_setup();
+
+	/* Rate of change (C/min) from linear ramp (0.1C per 2s sample),
+	   with more samples than fit in the ring buffer */
+	memset(&slope, 0, sizeof(slope));
+	temp_slope_add(&slope, 30.0, 1000);
+	temp_slope_add(&slope, 30.1, 3000);
+	CHECK_NEAR(temp_slope_rate(&slope), 0.0, 1e-9);
+	for (int i = 2; i < TEMP_SLOPE_SAMPLES * 2; i++) {
+		temp_slope_add(&slope, 30.0 + 0.1 * i, 1000 + 2000 * i);
+		CHECK_NEAR(temp_slope_rate(&slope), 3.0, 1e-3);
+	}
+
+	/* Falling temperature */
+	memset(&slope, 0, sizeof(slope));
+	for (int i = 0; i < TEMP_SLOPE_SAMPLES; i++)
+		temp_slope_add(&slope, 40.0 - 0.2 * i, 2000 * i);
+	CHECK_NEAR(temp_slope_rate(&slope), -6.0, 1e-3);
+	CHECK_NEAR(sensor_feed_forward(temp_slope_rate(&slope), 5.0, 20.0), 0.0, 1e-9);
+
+	/* Gain and max limit */
+	CHECK_NEAR(sensor_feed_forward(3.0, 0.0, 20.0), 0.0, 1e-9);
+	CHECK_NEAR(sensor_feed_forward(3.0, 5.0, 20.0), 15.0, 1e-9);
+	CHECK_NEAR(sensor_feed_forward(6.0, 5.0, 20.0), 20.0, 1e-9);
+
+	/* Feed-forward added to sensor duty cycle */
+	f->s_type = PWM_SENSOR;
+	f->s_id = 0;
+	set_temp_map(&config.sensors[0].map, 2, (const float[]){ 20.0, 0.0, 50.0, 100.0 });
+	config.sensors[0].ff_gain = 5.0;
+	config.sensors[0].ff_max = 20.0;
+	state.temp_hyst[0] = 35.0;
+	state.temp_rate[0] = 3.0;
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 65.0, 1e-4);
+	state.temp_rate[0] = 10.0;
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 70.0, 1e-4);
+	state.temp_rate[0] = -6.0;
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 50.0, 1e-4);
+
+	/* Total duty cycle does not exceed 100% */
+	state.temp_hyst[0] = 47.0;
+	state.temp_rate[0] = 10.0;
+	CHECK_NEAR(calculate_pwm_duty(&state, &config, 0), 100.0, 1e-4);
+}
+
+
+static void test_tacho()
+{
+	struct mb_input *m = &config.mbfans[0];
+
+	test_setup();
+
+	/* Fixed RPM, 2 pulses per revolution */
+	m->s_type = TACHO_FIXED;
+	m->s_id = 1200;
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 40.0, 1e-6);
+	m->rpm_factor = 4;
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 80.0, 1e-6);
+	m->rpm_factor = 2;
+
+	/* Min/max limits and coefficient */
+	m->min_rpm = 1500;
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 50.0, 1e-6);
+	m->min_rpm = 0;
+	m->rpm_coefficient = 0.5;
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 20.0, 1e-6);
+	m->rpm_coefficient = 1.0;
+
+	/* Single fan */
+	m->s_type = TACHO_FAN;
+	m->s_id = 2;
+	state.fan_freq[2] = 30.0;  /* 900 RPM */
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 30.0, 1e-6);
+
+	/* Groups of fans */
+	memset(m->sources, 0, sizeof(m->sources));
+	m->sources[0] = m->sources[1] = m->sources[2] = 1;
+	state.fan_freq[0] = 20.0;
+	state.fan_freq[1] = 40.0;
+	m->s_type = TACHO_MIN;
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 20.0, 1e-6);
+	m->s_type = TACHO_MAX;
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 40.0, 1e-6);
+	m->s_type = TACHO_AVG;
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 30.0, 1e-6);
+	m->s_type = TACHO_WORST;
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 20.0, 1e-6);
+
+	/* Stalled source fan is reported as 0 RPM (if enabled) */
+	state.fan_failed[1] = true;
+	m->s_type = TACHO_MAX;
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 40.0, 1e-6);
+	m->stall_alarm = true;
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 0.0, 1e-6);
+	state.fan_failed[1] = false;
+	m->stall_alarm = false;
+
+	/* Hold last good value over signal dropout */
+	m->s_type = TACHO_FAN;
+	m->s_id = 2;
+	m->hold_time = 1000;
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 30.0, 1e-6);
+	state.fan_freq[2] = 0.0;
+	hal_advance_time_us(500000);
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 30.0, 1e-6);
+	hal_advance_time_us(1000000);
+	CHECK_NEAR(calculate_tacho_freq(&state, &config, 0), 0.0, 1e-6);
+}
+
+
+/* Recorded sensor trace (time (s), temperature (C)) */
+struct trace_sample {
+	double t;
+	double temp;
+};
+
+static struct trace_sample *trace = NULL;
+static int trace_len = 0;
+
+static int read_trace(const char *filename)
+{
+	char line[128];
+	double t, temp;
+	FILE *fp;
+	int size = 0;
+
+	if (!filename || !(fp = fopen(filename, "r"))) {
+		printf("cannot open trace: %s\n", (filename ? filename : "(none)"));
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%lf,%lf", &t, &temp) != 2)
+			continue;
+		if (trace_len >= size) {
+			size = (size > 0 ? size * 2 : 1024);
+			if (!(trace = realloc(trace, size * sizeof(struct trace_sample))))
+				break;
+		}
+		trace[trace_len].t = t;
+		trace[trace_len].temp = temp;
+		trace_len++;
+	}
+	fclose(fp);
+
+	return (trace && trace_len > 1 ? 0 : -1);
+}
+
+/* Count direction reversals in a sequence of values. */
+static int count_reversals(const double *val, int len)
+{
+	int count = 0, dir = 0;
+
+	for (int i = 1; i < len; i++) {
+		int d = (val[i] > val[i - 1] ? 1 : (val[i] < val[i - 1] ? -1 : 0));
+
+		if (d == 0)
+			continue;
+		if (dir != 0 && d != dir)
+			count++;
+		dir = d;
+	}
+	return count;
+}
+
+/* Replay recorded sensor trace through sensor based fan control:
+ * output must follow slew rate and dwell limits, and hysteresis
+ * must suppress output toggling caused by sensor noise. */
+static void test_traces(const char *filename)
+{
+	const float temp_xy[] = { 25.0, 20.0, 45.0, 100.0 };
+	const double band = 0.5;
+	struct fan_output *f = &config.fans[0];
+	uint64_t t0 = time_us_64();
+	double *duty, *duty_hyst;
+	double prev, out, hyst, dt;
+	double t_up = -1.0;
+	int limited = 0, held = 0, decreased = 0;
+	int rev, rev_hyst;
+
+	if (read_trace(filename)) {
+		failures++;
+		return;
+	}
+	duty = calloc(trace_len, sizeof(double));
+	duty_hyst = calloc(trace_len, sizeof(double));
+	if (!duty || !duty_hyst) {
+		failures++;
+		return;
+	}
+
+	test_setup();
+	f->s_type = PWM_SENSOR;
+	f->s_id = 0;
+	set_temp_map(&config.sensors[0].map, 2, temp_xy);
+
+	/* Slew rate limits */
+	f->slew_up = 2.0;
+	f->slew_down = 0.5;
+	prev = -1.0;
+	for (int i = 0; i < trace_len; i++) {
+		hal_set_time_us(t0 + trace[i].t * 1000000);
+		state.temp_hyst[0] = trace[i].temp;
+		duty[i] = calculate_pwm_duty(&state, &config, 0);
+		out = fan_output_limits(&state, &config, 0, duty[i]);
+		if (prev >= 0.0) {
+			dt = trace[i].t - trace[i - 1].t;
+			CHECK(out - prev <= f->slew_up * dt + 1e-6,
+				"t=%.1f: increase %f > %f", trace[i].t, out - prev, f->slew_up * dt);
+			CHECK(prev - out <= f->slew_down * dt + 1e-6,
+				"t=%.1f: decrease %f > %f", trace[i].t, prev - out, f->slew_down * dt);
+			if (fabs(out - duty[i]) > 1e-6)
+				limited++;
+		}
+		prev = out;
+	}
+	CHECK(limited > 0, "slew rate limits not exercised by trace");
+
+	/* Minimum dwell time after increase */
+	test_setup();
+	f->s_type = PWM_SENSOR;
+	f->s_id = 0;
+	f->min_dwell = 30;
+	t0 = time_us_64() + 1000000;
+	prev = -1.0;
+	for (int i = 0; i < trace_len; i++) {
+		hal_set_time_us(t0 + trace[i].t * 1000000);
+		out = fan_output_limits(&state, &config, 0, duty[i]);
+		if (prev >= 0.0) {
+			if (out > prev)
+				t_up = trace[i].t;
+			if (out < prev) {
+				CHECK(trace[i].t - t_up >= f->min_dwell,
+					"t=%.1f: decrease %.1fs after increase", trace[i].t,
+					trace[i].t - t_up);
+				decreased++;
+			}
+			if (duty[i] < prev && out == prev)
+				held++;
+		}
+		prev = out;
+	}
+	CHECK(held > 0, "dwell not exercised by trace");
+	CHECK(decreased > 0, "no decreases in trace");
+
+	/* Hysteresis */
+	hyst = trace[0].temp;
+	for (int i = 0; i < trace_len; i++) {
+		hyst = temp_hysteresis(hyst, trace[i].temp, band);
+		CHECK(hyst >= trace[i].temp && hyst - trace[i].temp <= band + 1e-9,
+			"t=%.1f: temp %f, hysteresis %f", trace[i].t, trace[i].temp, hyst);
+		duty_hyst[i] = sensor_get_duty(&config.sensors[0].map, hyst);
+	}
+	rev = count_reversals(duty, trace_len);
+	rev_hyst = count_reversals(duty_hyst, trace_len);
+	printf("output reversals: %d without hysteresis, %d with %.1fC hysteresis\n",
+		rev, rev_hyst, band);
+	CHECK(rev_hyst * 10 < rev, "hysteresis did not suppress toggling (%d vs %d)",
+		rev_hyst, rev);
+
+	free(duty);
+	free(duty_hyst);
+}
+
+
+struct test {
+	const char *name;
+	void (*func)(const char *arg);
+};
+
+static const struct test tests[] = {
+	{ "map", test_map },
+	{ "filters", test_filters },
+	{ "pwm", test_pwm },
+	{ "feedforward", test_feedforward },
+	{ "tacho", test_tacho },
+	{ "traces", test_traces },
+	{ NULL, NULL }
+};
+
+
+int main(int argc, char **argv)
+{
+	const struct test *t;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <test> [trace.csv]\n\nTests:", argv[0]);
+		for (t = tests; t->name; t++)
+			fprintf(stderr, " %s", t->name);
+		fprintf(stderr, "\n");
+		return 2;
+	}
+
+	hal_set_simulated_time(true);
+	hal_advance_time_us(1000000);
+	set_log_level(LOG_ERR);
+	mem_init();
+
+	for (t = tests; t->name; t++) {
+		if (!strcmp(t->name, argv[1]))
+			break;
+	}
+	if (!t->name) {
+		fprintf(stderr, "Unknown test: %s\n", argv[1]);
+		return 2;
+	}
+
+	t->func(argc > 2 ? argv[2] : NULL);
+	printf("%s: %s (%d failures)\n", t->name, (failures ? "FAILED" : "OK"), failures);
+
+	return (failures ? 1 : 0);
+}
+
+
+/* eof */
@@ -0,0 +1,138 @@
+/* util_host.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host versions of functions in src/util_rp2040.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "pico/unique_id.h"
+
+#include "fanpico.h"
+
+
+uint32_t get_stack_pointer()
+{
+	volatile uint32_t marker = 0;
+
+	return (uint32_t)(uintptr_t)&marker;
+}
+
+uint32_t get_stack_free()
+{
+	return 0;
+}
+
+void stack_paint()
+{
+}
+
+uint32_t stack_used_max(uint core)
+{
+	return 0;
+}
+
+void print_rp2040_meminfo()
+{
+	printf("Host build: no RP2040 memory information available\n");
+}
+
+void watchdog_disable()
+{
+	watchdog_hw->ctrl = 0;
+}
+
+void print_irqinfo()
+{
+}
+
+const char *rp2040_model_str()
+{
+	return "HOST";
+}
+
+const char *pico_serial_str()
+{
+	static char buf[PICO_UNIQUE_BOARD_ID_SIZE_BYTES * 2 + 1];
+	pico_unique_board_id_t board_id;
+
+	memset(&board_id, 0, sizeof(board_id));
+	pico_get_unique_board_id(&board_id);
+	for (int i = 0; i < PICO_UNIQUE_BOARD_ID_SIZE_BYTES; i++)
+		snprintf(&buf[i*2], 3,"%02x", board_id.id[i]);
+
+	return buf;
+}
+
+int time_passed(absolute_time_t *t, uint32_t ms)
+{
+	absolute_time_t t_now = get_absolute_time();
+
+	if (t == NULL)
+		return -1;
+
+	if (to_us_since_boot(*t) == 0 ||
+	    to_us_since_boot(delayed_by_ms(*t, ms)) < to_us_since_boot(t_now)) {
+		*t = t_now;
+		return 1;
+	}
+
+	return 0;
+}
+
+int getstring_timeout_ms(char *str, uint32_t maxlen, uint32_t timeout)
+{
+	absolute_time_t t_timeout = get_absolute_time();
+	char *p;
+	int res = 0;
+	int len;
+
+	if (!str || maxlen < 2)
+		return -1;
+
+	len = strnlen(str, maxlen);
+	if (len >= maxlen)
+		return -2;
+	p = str + len;
+
+	while ((p - str) < (maxlen - 1) ) {
+		if (time_passed(&t_timeout, timeout)) {
+			break;
+		}
+		int c = getchar_timeout_us(1000);
+		if (c == PICO_ERROR_TIMEOUT)
+			continue;
+		if (c == 10 || c == 13) {
+			res = 1;
+			break;
+		}
+		*p++ = c;
+	}
+	*p = 0;
+
+	return res;
+}
+
+
+/* eof */
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+#
+# trace2json.py
+#
+# Convert FanPico event trace dump (output of SYS:TRACE:DUMP? command)
+# to Chrome trace event format (JSON), that can be viewed using
+# Perfetto (https://ui.perfetto.dev/) or chrome://tracing
+#
+# Input can be a capture of the console/telnet session (anything outside
+# the BEGIN/END markers is ignored), or the decoded binary dump.
+#
+# Usage:
+#   trace2json.py [-o trace.json] [dump.txt]
+#
+
+import sys
+import re
+import json
+import base64
+import struct
+import argparse
+
+
+MAGIC = b'FPTR'
+TYPES = { 0: 'B', 1: 'E', 2: 'i' }
+
+
+def read_dump(data):
+    """Extract binary trace dump from captured console output."""
+    if data.startswith(MAGIC):
+        return data
+    text = data.decode('utf-8', errors='replace')
+    m = re.search(r'-----BEGIN FANPICO TRACE-----(.*?)-----END FANPICO TRACE-----',
+                  text, re.S)
+    if not m:
+        raise ValueError('no trace dump found')
+    buf = b''
+    for line in m.group(1).splitlines():
+        line = line.strip()
+        if line:
+            buf += base64.b64decode(line)
+    return buf
+
+
+def parse_dump(buf):
+    """Parse binary trace dump, return (event names, events per core)."""
+    if buf[0:4] != MAGIC:
+        raise ValueError('invalid trace dump (bad magic)')
+    version, cores, name_count, t_now = struct.unpack_from('<HBBQ', buf, 4)
+    if version != 1:
+        raise ValueError('unsupported trace dump version: %d' % version)
+    pos = 16
+    names = []
+    for i in range(name_count):
+        l = buf[pos]
+        names.append(buf[pos + 1:pos + 1 + l].decode())
+        pos += 1 + l
+
+    events = {}
+    for i in range(cores):
+        core, total, count = struct.unpack_from('<BII', buf, pos)
+        pos += 9
+        ev = []
+        for j in range(count):
+            t, id, type, arg = struct.unpack_from('<IBBH', buf, pos)
+            pos += 8
+            # Convert 32bit timestamps to 64bit (relative to time of the dump)
+            ev.append((t_now - ((t_now - t) & 0xffffffff), id, type, arg))
+        events[core] = (total, ev)
+        if total > count:
+            sys.stderr.write('core%d: %d events lost (buffer wrapped)\n'
+                             % (core, total - count))
+    return names, events
+
+
+def to_chrome_trace(names, events):
+    t_first = min([ev[0][0] for total, ev in events.values() if ev], default=0)
+    trace = []
+
+    for core in sorted(events):
+        trace.append({ 'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': core,
+                       'args': { 'name': 'core%d' % core } })
+        open_events = {}
+        for t, id, type, arg in events[core][1]:
+            name = names[id] if id < len(names) else 'event%d' % id
+            ph = TYPES.get(type, 'i')
+            if ph == 'B':
+                open_events[id] = open_events.get(id, 0) + 1
+            elif ph == 'E':
+                # Skip end events for which beginning was lost
+                if open_events.get(id, 0) < 1:
+                    continue
+                open_events[id] -= 1
+            e = { 'name': name, 'ph': ph, 'ts': t - t_first,
+                  'pid': 1, 'tid': core, 'args': { 'arg': arg } }
+            if ph == 'i':
+                e['s'] = 't'
+            trace.append(e)
+
+    return { 'traceEvents': trace, 'displayTimeUnit': 'ms' }
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Convert FanPico trace dump to Chrome/Perfetto trace (JSON)')
+    parser.add_argument('-o', '--output', help='output file (default: stdout)')
+    parser.add_argument('input', nargs='?', help='trace dump (default: stdin)')
+    args = parser.parse_args()
+
+    if args.input:
+        with open(args.input, 'rb') as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    try:
+        names, events = parse_dump(read_dump(data))
+    except (ValueError, IndexError, struct.error) as e:
+        sys.exit('trace2json.py: %s' % e)
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    json.dump(to_chrome_trace(names, events), out)
+    out.write('\n')
+    if args.output:
+        out.close()
+
+
+if __name__ == '__main__':
+    main()
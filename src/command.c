@@ -24,6 +24,7 @@
 #include <time.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 #include <wctype.h>
 #include <assert.h>
 #include "pico/stdlib.h"
@@ -33,8 +34,10 @@
 #include "pico/rand.h"
 #include "hardware/watchdog.h"
 #include "hardware/rtc.h"
+#include "hardware/pio.h"
 #include "cJSON.h"
 #include "fanpico.h"
+#include "tacho_gen.h"
 #ifdef WIFI_SUPPORT
 #include "lwip/ip_addr.h"
 #include "lwip/stats.h"
@@ -76,6 +79,27 @@ extern const char fanpico_credits_text[];
 
 typedef int (*validate_str_func_t)(const char *args);
 
+/* Format PWM duty cycle (%) for query responses. Whole values are shown
+   without decimals (as before fractional PWM values were supported). */
+char* pwm_to_str(char *buf, size_t size, float val)
+{
+	int decimals = ((int)roundf(val * 10) % 10 ? 1 : 0);
+
+	return float_to_str(buf, size, val, 0, decimals);
+}
+
+/* Parse port number (1..n) following command name (e.g. "FAN1") and
+   return it as an array index. Returns -1 if number is not valid. */
+int port_index(const char *s)
+{
+	int val;
+
+	if (!str_to_int(s, &val, 10) || val < 1)
+		return -1;
+
+	return val - 1;
+}
+
 int string_setting(const char *cmd, const char *args, int query, char *prev_cmd,
 		char *var, size_t var_len, const char *name, validate_str_func_t validate_func)
 {
@@ -306,6 +330,97 @@ int cmd_led(const char *cmd, const char *args, int query, char *prev_cmd)
 	return 0;
 }
 
+int cmd_pwm_dither(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	return bool_setting(cmd, args, query, prev_cmd,
+			&conf->pwm_dither, "PWM output dithering");
+}
+
+int cmd_pwm_phase(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	uint16_t phase[FAN_MAX_COUNT / 2];
+	char *arg, *t, *saveptr;
+	int i, count, val;
+	int ret = 0;
+
+	if (query) {
+		if (conf->pwm_phase_auto) {
+			printf("AUTO\n");
+		} else {
+			for (i = 0; i < FAN_COUNT / 2; i++)
+				printf("%s%u", (i > 0 ? "," : ""), conf->pwm_phase[i]);
+			printf("\n");
+		}
+		return 0;
+	}
+
+	if (!strncasecmp(args, "auto", 5)) {
+		if (!conf->pwm_phase_auto)
+			log_msg(LOG_NOTICE, "PWM output phases: AUTO");
+		conf->pwm_phase_auto = true;
+	} else {
+		memset(phase, 0, sizeof(phase));
+		if (strncasecmp(args, "off", 4)) {
+			if (!(arg = strdup(args)))
+				return 1;
+			count = 0;
+			t = strtok_r(arg, ",", &saveptr);
+			while (t && ret == 0) {
+				if (count < FAN_COUNT / 2 && str_to_int(t, &val, 10)
+					&& val >= 0 && val < 360)
+					phase[count++] = val;
+				else
+					ret = 2;
+				t = strtok_r(NULL, ",", &saveptr);
+			}
+			free(arg);
+			if (ret || count < 1) {
+				log_msg(LOG_WARNING, "Invalid PWM output phases: %s", args);
+				return 2;
+			}
+		}
+		log_msg(LOG_NOTICE, "PWM output phases: %s", args);
+		conf->pwm_phase_auto = false;
+		memcpy(conf->pwm_phase, phase, sizeof(conf->pwm_phase));
+	}
+
+	return ret;
+}
+
+int cmd_fan_fail(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	char *arg, *t, *saveptr;
+	int val[2], count = 0;
+
+	if (query) {
+		printf("%u,%u\n", conf->fan_fail_duty, conf->fan_fail_boost);
+		return 0;
+	}
+
+	val[1] = conf->fan_fail_boost;
+	arg = strdup(args);
+	t = strtok_r(arg, ",", &saveptr);
+	while (t && count < 2) {
+		if (!str_to_int(t, &val[count], 10))
+			break;
+		count++;
+		t = strtok_r(NULL, ",", &saveptr);
+	}
+	free(arg);
+
+	if (count < 1 || t || val[0] < 0 || val[0] > 100
+		|| val[1] < 0 || val[1] > 100) {
+		log_msg(LOG_WARNING, "invalid fan failure compensation settings: %s", args);
+		return 2;
+	}
+	log_msg(LOG_NOTICE, "Set fan failure compensation: %u,%u -> %d,%d",
+		conf->fan_fail_duty, conf->fan_fail_boost, val[0], val[1]);
+	conf->fan_fail_duty = val[0];
+	conf->fan_fail_boost = val[1];
+
+	return 0;
+}
+
 int cmd_mbfans(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	if (!query)
@@ -408,6 +523,21 @@ int cmd_echo(const char *cmd, const char *args, int query, char *prev_cmd)
 			&conf->local_echo, "Command Echo");
 }
 
+int cmd_boot(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	if (!query)
+		return 1;
+
+	print_boot_times();
+	return 0;
+}
+
+int cmd_boot_fast(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	return bool_setting(cmd, args, query, prev_cmd,
+			&conf->fast_boot, "Fast Boot");
+}
+
 int cmd_display_type(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	return string_setting(cmd, args, query, prev_cmd,
@@ -433,6 +563,16 @@ int cmd_display_layout_r(const char *cmd, const char *args, int query, char *pre
 			"Display Layout (Right)", NULL);
 }
 
+int cmd_display_stats(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	if (query) {
+		display_print_stats();
+	} else {
+		display_reset_stats();
+	}
+	return 0;
+}
+
 int cmd_reset(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	const char *msg[] = {
@@ -497,42 +637,43 @@ int cmd_read(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int i;
 	double rpm, pwm;
+	char s1[16], s2[16], s3[16];
 
 	if (!query)
 		return 1;
 
 	for (i = 0; i < MBFAN_COUNT; i++) {
 		rpm = st->mbfan_freq[i] * 60 / conf->mbfans[i].rpm_factor;
-		printf("mbfan%d,\"%s\",%.0lf,%.2f,%.1f\n", i+1,
+		printf("mbfan%d,\"%s\",%s,%s,%s\n", i+1,
 			conf->mbfans[i].name,
-			rpm,
-			st->mbfan_freq[i],
-			st->mbfan_duty[i]);
+			float_to_str(s1, sizeof(s1), rpm, 0, 0),
+			float_to_str(s2, sizeof(s2), st->mbfan_freq[i], 0, 2),
+			float_to_str(s3, sizeof(s3), st->mbfan_duty[i], 0, 1));
 	}
 
 	for (i = 0; i < FAN_COUNT; i++) {
 		rpm = st->fan_freq[i] * 60 / conf->fans[i].rpm_factor;
-		printf("fan%d,\"%s\",%.0lf,%.2f,%.1f\n", i+1,
+		printf("fan%d,\"%s\",%s,%s,%s\n", i+1,
 			conf->fans[i].name,
-			rpm,
-			st->fan_freq[i],
-			st->fan_duty[i]);
+			float_to_str(s1, sizeof(s1), rpm, 0, 0),
+			float_to_str(s2, sizeof(s2), st->fan_freq[i], 0, 2),
+			float_to_str(s3, sizeof(s3), st->fan_duty[i], 0, 1));
 	}
 
 	for (i = 0; i < SENSOR_COUNT; i++) {
 		pwm = sensor_get_duty(&conf->sensors[i].map, st->temp[i]);
-		printf("sensor%d,\"%s\",%.1lf,%.1f\n", i+1,
+		printf("sensor%d,\"%s\",%s,%s\n", i+1,
 			conf->sensors[i].name,
-			st->temp[i],
-			pwm);
+			float_to_str(s1, sizeof(s1), st->temp[i], 0, 1),
+			float_to_str(s2, sizeof(s2), pwm, 0, 1));
 	}
 
 	for (i = 0; i < VSENSOR_COUNT; i++) {
 		pwm = sensor_get_duty(&conf->vsensors[i].map, st->vtemp[i]);
-		printf("vsensor%d,\"%s\",%.1lf,%.1f\n", i+1,
+		printf("vsensor%d,\"%s\",%s,%s\n", i+1,
 			conf->vsensors[i].name,
-			st->vtemp[i],
-			pwm);
+			float_to_str(s1, sizeof(s1), st->vtemp[i], 0, 1),
+			float_to_str(s2, sizeof(s2), pwm, 0, 1));
 	}
 
 	return 0;
@@ -542,7 +683,7 @@ int cmd_fan_name(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int fan;
 
-	fan = atoi(&prev_cmd[3]) - 1;
+	fan = port_index(&prev_cmd[3]);
 	if (fan >= 0 && fan < FAN_COUNT) {
 		if (query) {
 			printf("%s\n", conf->fans[fan].name);
@@ -558,19 +699,21 @@ int cmd_fan_name(const char *cmd, const char *args, int query, char *prev_cmd)
 
 int cmd_fan_min_pwm(const char *cmd, const char *args, int query, char *prev_cmd)
 {
-	int fan, val;
+	int fan;
+	float val;
+	char buf[16];
 
-	fan = atoi(&prev_cmd[3]) - 1;
+	fan = port_index(&prev_cmd[3]);
 	if (fan >= 0 && fan < FAN_COUNT) {
 		if (query) {
-			printf("%d\n", conf->fans[fan].min_pwm);
-		} else if (str_to_int(args, &val, 10)) {
-			if (val >= 0 && val <= 100) {
-				log_msg(LOG_NOTICE, "fan%d: change min PWM %d%% --> %d%%", fan + 1,
+			printf("%s\n", pwm_to_str(buf, sizeof(buf), conf->fans[fan].min_pwm));
+		} else if (str_to_float(args, &val)) {
+			if (val >= 0.0 && val <= 100.0) {
+				log_msg(LOG_NOTICE, "fan%d: change min PWM %.1f%% --> %.1f%%", fan + 1,
 					conf->fans[fan].min_pwm, val);
 				conf->fans[fan].min_pwm = val;
 			} else {
-				log_msg(LOG_WARNING, "fan%d: invalid new value for min PWM: %d", fan + 1,
+				log_msg(LOG_WARNING, "fan%d: invalid new value for min PWM: %.1f", fan + 1,
 					val);
 				return 2;
 			}
@@ -582,19 +725,21 @@ int cmd_fan_min_pwm(const char *cmd, const char *args, int query, char *prev_cmd
 
 int cmd_fan_max_pwm(const char *cmd, const char *args, int query, char *prev_cmd)
 {
-	int fan, val;
+	int fan;
+	float val;
+	char buf[16];
 
-	fan = atoi(&prev_cmd[3]) - 1;
+	fan = port_index(&prev_cmd[3]);
 	if (fan >= 0 && fan < FAN_COUNT) {
 		if (query) {
-			printf("%d\n", conf->fans[fan].max_pwm);
-		} else if (str_to_int(args, &val, 10)) {
-			if (val >= 0 && val <= 100) {
-				log_msg(LOG_NOTICE, "fan%d: change max PWM %d%% --> %d%%", fan + 1,
+			printf("%s\n", pwm_to_str(buf, sizeof(buf), conf->fans[fan].max_pwm));
+		} else if (str_to_float(args, &val)) {
+			if (val >= 0.0 && val <= 100.0) {
+				log_msg(LOG_NOTICE, "fan%d: change max PWM %.1f%% --> %.1f%%", fan + 1,
 					conf->fans[fan].max_pwm, val);
 				conf->fans[fan].max_pwm = val;
 			} else {
-				log_msg(LOG_WARNING, "fan%d: invalid new value for max PWM: %d", fan + 1,
+				log_msg(LOG_WARNING, "fan%d: invalid new value for max PWM: %.1f", fan + 1,
 					val);
 				return 2;
 			}
@@ -609,7 +754,7 @@ int cmd_fan_pwm_coef(const char *cmd, const char *args, int query, char *prev_cm
 	int fan;
 	float val;
 
-	fan = atoi(&prev_cmd[3]) - 1;
+	fan = port_index(&prev_cmd[3]);
 	if (fan >= 0 && fan < FAN_COUNT) {
 		if (query) {
 			printf("%f\n", conf->fans[fan].pwm_coefficient);
@@ -632,13 +777,14 @@ int cmd_fan_pwm_coef(const char *cmd, const char *args, int query, char *prev_cm
 int cmd_fan_pwm_map(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int fan, i, count;
-	int val;
+	float val;
 	char *arg, *t, *saveptr;
 	struct pwm_map *map;
 	struct pwm_map new_map;
+	char buf[16];
 	int ret = 0;
 
-	fan = atoi(&prev_cmd[3]) - 1;
+	fan = port_index(&prev_cmd[3]);
 	if (fan < 0 || fan >= FAN_COUNT)
 		return 1;
 	map = &conf->fans[fan].map;
@@ -648,20 +794,21 @@ int cmd_fan_pwm_map(const char *cmd, const char *args, int query, char *prev_cmd
 		for (i = 0; i < map->points; i++) {
 			if (i > 0)
 				printf(",");
-			printf("%u,%u", map->pwm[i][0], map->pwm[i][1]);
+			printf("%s,", pwm_to_str(buf, sizeof(buf), map->pwm[i][0]));
+			printf("%s", pwm_to_str(buf, sizeof(buf), map->pwm[i][1]));
 		}
 		printf("\n");
 	} else {
 		arg = strdup(args);
 		count = 0;
 		t = strtok_r(arg, ",", &saveptr);
-		while (t) {
-			val = atoi(t);
+		while (t && count < MAX_MAP_POINTS * 2) {
+			val = atof(t);
 			new_map.pwm[count / 2][count % 2] = val;
 			count++;
 			t = strtok_r(NULL, ",", &saveptr);
 		}
-		if ((count >= 4) && (count % 2 == 0)) {
+		if ((count >= 4) && (count % 2 == 0) && !t) {
 			new_map.points = count / 2;
 			*map = new_map;
 		} else {
@@ -683,7 +830,7 @@ int cmd_fan_filter(const char *cmd, const char *args, int query, char *prev_cmd)
 	enum signal_filter_types new_filter;
 	void *new_ctx;
 
-	fan = atoi(&prev_cmd[3]) - 1;
+	fan = port_index(&prev_cmd[3]);
 	if (fan < 0 || fan >= FAN_COUNT)
 		return 1;
 
@@ -701,12 +848,12 @@ int cmd_fan_filter(const char *cmd, const char *args, int query, char *prev_cmd)
 		param = strdup(args);
 		if ((tok = strtok_r(param, ",", &saveptr)) != NULL) {
 			new_filter = str2filter(tok);
-			tok += strlen(tok) + 1;
+			tok = strtok_r(NULL, "", &saveptr);
 			new_ctx = filter_parse_args(new_filter, tok);
 			if (new_filter == FILTER_NONE || new_ctx != NULL) {
 				f->filter = new_filter;
 				if (f->filter_ctx)
-					free(f->filter_ctx);
+					mem_free(MEM_FILTERS, f->filter_ctx);
 				f->filter_ctx = new_ctx;
 			} else {
 				ret = 1;
@@ -718,17 +865,255 @@ int cmd_fan_filter(const char *cmd, const char *args, int query, char *prev_cmd)
 	return ret;
 }
 
+int fancal_command(int fan, const char *args)
+{
+	if (!args || args[0] == 0 || !strncasecmp(args, "start", 6)) {
+		fancal_start(fan);
+	} else if (!strncasecmp(args, "stop", 5)) {
+		fancal_stop(fan);
+	} else {
+		return 2;
+	}
+	return 0;
+}
+
+int cmd_fan_calibrate(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	const struct fan_cal *cal;
+	enum fancal_states state;
+	uint8_t duty;
+	uint32_t elapsed;
+	int fan, i;
+
+	fan = port_index(&prev_cmd[3]);
+	if (fan < 0 || fan >= FAN_COUNT)
+		return 1;
+
+	if (!query)
+		return fancal_command(fan, args);
+
+	state = fancal_status(fan, &duty, &elapsed, NULL);
+	cal = &conf->fans[fan].cal;
+	printf("State:       %s\n", fancal_state2str(state));
+	if (state != FANCAL_IDLE) {
+		if (fancal_active(fan))
+			printf("Duty:        %u%%\n", duty);
+		printf("Elapsed:     %lu s\n", elapsed);
+	}
+	if (cal->points > 0) {
+		printf("RPM curve:   ");
+		for (i = 0; i < cal->points; i++)
+			printf("%s%u", (i > 0 ? "," : ""), cal->rpm[i]);
+		printf("\n");
+		printf("Stall duty:  %u%% (%u RPM)\n", cal->stall_duty, cal->min_rpm);
+		printf("Start duty:  %u%%\n", cal->start_duty);
+	}
+	return 0;
+}
+
+int cmd_fancal(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	enum fancal_states state;
+	uint8_t duty;
+	uint32_t elapsed;
+
+	if (!query)
+		return fancal_command(-1, args);
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		state = fancal_status(i, &duty, &elapsed, NULL);
+		printf("fan%d,%s,%u,%lu\n", i + 1, fancal_state2str(state),
+			duty, elapsed);
+	}
+	return 0;
+}
+
+int cmd_fan_kick(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	struct fan_output *f;
+	char *arg, *t, *saveptr;
+	int fan, count = 0;
+	int val[3];
+	int ret = 0;
+
+	fan = port_index(&prev_cmd[3]);
+	if (fan < 0 || fan >= FAN_COUNT)
+		return 1;
+	f = &conf->fans[fan];
+
+	if (query) {
+		printf("%u,%u,%u\n", f->kick_duty, f->kick_time, f->kick_retry);
+		return 0;
+	}
+
+	val[0] = 0;
+	val[1] = f->kick_time;
+	val[2] = f->kick_retry;
+	arg = strdup(args);
+	t = strtok_r(arg, ",", &saveptr);
+	while (t && count < 3) {
+		if (!str_to_int(t, &val[count], 10))
+			break;
+		count++;
+		t = strtok_r(NULL, ",", &saveptr);
+	}
+	free(arg);
+
+	if (count < 1 || t || val[0] < 0 || val[0] > 100
+		|| val[1] < FAN_KICK_MIN_TIME || val[1] > 60000
+		|| val[2] < 1 || val[2] > 3600) {
+		log_msg(LOG_WARNING, "fan%d: invalid start assist settings: %s",
+			fan + 1, args);
+		ret = 2;
+	} else {
+		log_msg(LOG_NOTICE, "fan%d: change start assist %u,%u,%u --> %d,%d,%d",
+			fan + 1, f->kick_duty, f->kick_time, f->kick_retry,
+			val[0], val[1], val[2]);
+		f->kick_duty = val[0];
+		f->kick_time = val[1];
+		f->kick_retry = val[2];
+	}
+
+	return ret;
+}
+
+int cmd_fan_slew(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	struct fan_output *f;
+	char *arg, *t, *saveptr;
+	int fan, count = 0;
+	float val[2];
+	int ret = 0;
+
+	fan = port_index(&prev_cmd[3]);
+	if (fan < 0 || fan >= FAN_COUNT)
+		return 1;
+	f = &conf->fans[fan];
+
+	if (query) {
+		printf("%.1f,%.1f\n", f->slew_up, f->slew_down);
+		return 0;
+	}
+
+	arg = strdup(args);
+	t = strtok_r(arg, ",", &saveptr);
+	while (t && count < 2) {
+		if (!str_to_float(t, &val[count]))
+			break;
+		count++;
+		t = strtok_r(NULL, ",", &saveptr);
+	}
+	free(arg);
+	if (count == 1)
+		val[1] = val[0];
+
+	if (count < 1 || t || val[0] < 0.0 || val[0] > 1000.0
+		|| val[1] < 0.0 || val[1] > 1000.0) {
+		log_msg(LOG_WARNING, "fan%d: invalid slew rate limits: %s",
+			fan + 1, args);
+		ret = 2;
+	} else {
+		log_msg(LOG_NOTICE, "fan%d: change slew rate limits %.1f,%.1f --> %.1f,%.1f",
+			fan + 1, f->slew_up, f->slew_down, val[0], val[1]);
+		f->slew_up = val[0];
+		f->slew_down = val[1];
+	}
+
+	return ret;
+}
+
+int cmd_fan_dwell(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	int fan;
+	int val;
+
+	fan = port_index(&prev_cmd[3]);
+	if (fan < 0 || fan >= FAN_COUNT)
+		return 1;
+
+	if (query) {
+		printf("%u\n", conf->fans[fan].min_dwell);
+	} else if (str_to_int(args, &val, 10)) {
+		if (val >= 0 && val <= 3600) {
+			log_msg(LOG_NOTICE, "fan%d: change minimum dwell time %u --> %d",
+				fan + 1, conf->fans[fan].min_dwell, val);
+			conf->fans[fan].min_dwell = val;
+		} else {
+			log_msg(LOG_WARNING, "fan%d: invalid minimum dwell time: %d",
+				fan + 1, val);
+			return 2;
+		}
+	}
+	return 0;
+}
+
+int cmd_fan_zone(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	int fan, val;
+
+	fan = port_index(&prev_cmd[3]);
+	if (fan < 0 || fan >= FAN_COUNT)
+		return 1;
+
+	if (query) {
+		if (conf->fans[fan].zone < 0)
+			printf("NONE\n");
+		else
+			printf("%d\n", conf->fans[fan].zone + 1);
+		return 0;
+	}
+
+	if (!strncasecmp(args, "NONE", 4) || !strcmp(args, "0")) {
+		val = -1;
+	} else if (str_to_int(args, &val, 10) && val >= 1 && val <= ZONE_COUNT) {
+		val--;
+	} else {
+		log_msg(LOG_WARNING, "fan%d: invalid zone: %s", fan + 1, args);
+		return 2;
+	}
+	log_msg(LOG_NOTICE, "fan%d: change zone %d --> %d", fan + 1,
+		conf->fans[fan].zone + 1, val + 1);
+	conf->fans[fan].zone = val;
+
+	return 0;
+}
+
+int cmd_fan_offset(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	int fan;
+	float val;
+
+	fan = port_index(&prev_cmd[3]);
+	if (fan < 0 || fan >= FAN_COUNT)
+		return 1;
+
+	if (query) {
+		printf("%.1f\n", conf->fans[fan].offset);
+	} else if (str_to_float(args, &val)) {
+		if (val >= -100.0 && val <= 100.0) {
+			log_msg(LOG_NOTICE, "fan%d: change offset %.1f --> %.1f",
+				fan + 1, conf->fans[fan].offset, val);
+			conf->fans[fan].offset = val;
+		} else {
+			log_msg(LOG_WARNING, "fan%d: invalid offset: %f",
+				fan + 1, val);
+			return 2;
+		}
+	}
+	return 0;
+}
+
 int cmd_fan_rpm_factor(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int fan;
 	int val;
 
-	fan = atoi(&prev_cmd[3]) - 1;
+	fan = port_index(&prev_cmd[3]);
 	if (fan >= 0 && fan < FAN_COUNT) {
 		if (query) {
 			printf("%u\n", conf->fans[fan].rpm_factor);
 		} else if (str_to_int(args, &val, 10)) {
-			if (val >= 1 || val <= 8) {
+			if (val >= 1 && val <= 8) {
 				log_msg(LOG_NOTICE, "fan%d: change RPM factor %u --> %d",
 					fan + 1, conf->fans[fan].rpm_factor, val);
 				conf->fans[fan].rpm_factor = val;
@@ -750,7 +1135,7 @@ int cmd_fan_source(const char *cmd, const char *args, int query, char *prev_cmd)
 	char *tok, *saveptr, *param;
 	int ret = 0;
 
-	fan = atoi(&prev_cmd[3]) - 1;
+	fan = port_index(&prev_cmd[3]);
 	if (fan < 0 || fan >= FAN_COUNT)
 		return 1;
 
@@ -767,7 +1152,8 @@ int cmd_fan_source(const char *cmd, const char *args, int query, char *prev_cmd)
 			type = str2pwm_source(tok);
 			d_n = (type != PWM_FIXED ? 1 : 0);
 			if ((tok = strtok_r(NULL, ",", &saveptr)) != NULL) {
-				val = atoi(tok) - d_n;
+				val = (str_to_int(tok, &val, 10) && val >= d_n && val <= UINT16_MAX
+					? val - d_n : -1);
 				if (valid_pwm_source_ref(type, val)) {
 					d_o = (conf->fans[fan].s_type != PWM_FIXED ? 1 : 0);
 					log_msg(LOG_NOTICE, "fan%d: change source %s,%u --> %s,%u",
@@ -795,16 +1181,17 @@ int cmd_fan_rpm(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int fan;
 	double rpm;
+	char buf[16];
 
 	if (!query)
 		return 1;
 
-	fan = atoi(&prev_cmd[3]) - 1;
+	fan = port_index(&prev_cmd[3]);
 	if (fan >= 0 && fan < FAN_COUNT) {
 		rpm = st->fan_freq[fan] * 60.0 / conf->fans[fan].rpm_factor;
 		log_msg(LOG_DEBUG, "fan%d (tacho = %fHz) rpm = %.1lf", fan + 1,
 			st->fan_freq[fan], rpm);
-		printf("%.0lf\n", rpm);
+		printf("%s\n", float_to_str(buf, sizeof(buf), rpm, 0, 0));
 		return 0;
 	}
 
@@ -815,15 +1202,16 @@ int cmd_fan_tacho(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int fan;
 	float f;
+	char buf[16];
 
 	if (!query)
 		return 1;
 
-	fan = atoi(&prev_cmd[3]) - 1;
+	fan = port_index(&prev_cmd[3]);
 	if (fan >= 0 && fan < FAN_COUNT) {
 		f = st->fan_freq[fan];
 		log_msg(LOG_DEBUG, "fan%d tacho = %fHz", fan + 1, f);
-		printf("%.1f\n", f);
+		printf("%s\n", float_to_str(buf, sizeof(buf), f, 0, 1));
 		return 0;
 	}
 
@@ -834,15 +1222,33 @@ int cmd_fan_pwm(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int fan;
 	float d;
+	char buf[16];
 
 	if (!query)
 		return 1;
 
-	fan = atoi(&prev_cmd[3]) - 1;
+	fan = port_index(&prev_cmd[3]);
 	if (fan >= 0 && fan < FAN_COUNT) {
 		d = st->fan_duty[fan];
 		log_msg(LOG_DEBUG, "fan%d duty = %f%%", fan + 1, d);
-		printf("%.0f\n", d);
+		printf("%s\n", float_to_str(buf, sizeof(buf), d, 0, 0));
+		return 0;
+	}
+
+	return 1;
+}
+
+int cmd_fan_status(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	int fan;
+
+	if (!query)
+		return 1;
+
+	fan = port_index(&prev_cmd[3]);
+	if (fan >= 0 && fan < FAN_COUNT) {
+		printf("%s,%lu,%d\n", fan_start_state2str(st->fan_start_state[fan]),
+			st->fan_stalls[fan], (st->fan_failed[fan] ? 1 : 0));
 		return 0;
 	}
 
@@ -854,14 +1260,15 @@ int cmd_fan_read(const char *cmd, const char *args, int query, char *prev_cmd)
 	int fan;
 	double rpm;
 	float d, f;
+	char s1[16], s2[16], s3[16];
 
 	if (!query)
 		return 1;
 
 	if (!strncasecmp(prev_cmd, "fan", 3)) {
-		fan = atoi(&prev_cmd[3]) - 1;
+		fan = port_index(&prev_cmd[3]);
 	} else {
-		fan = atoi(&cmd[3]) - 1;
+		fan = port_index(&cmd[3]);
 	}
 
 	if (fan >= 0 && fan < FAN_COUNT) {
@@ -870,18 +1277,132 @@ int cmd_fan_read(const char *cmd, const char *args, int query, char *prev_cmd)
 		rpm = f * 60.0 / conf->fans[fan].rpm_factor;
 		log_msg(LOG_DEBUG, "fan%d duty = %f%%, freq = %fHz, speed = %fRPM",
 			fan + 1, d, f, rpm);
-		printf("%.0f,%.1f,%.0f\n", d, f, rpm);
+		printf("%s,%s,%s\n",
+			float_to_str(s1, sizeof(s1), d, 0, 0),
+			float_to_str(s2, sizeof(s2), f, 0, 1),
+			float_to_str(s3, sizeof(s3), rpm, 0, 0));
 		return 0;
 	}
 
 	return 1;
 }
 
+int cmd_zone_name(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	int zone;
+
+	zone = port_index(&prev_cmd[4]);
+	if (zone >= 0 && zone < ZONE_COUNT) {
+		if (query) {
+			printf("%s\n", conf->zones[zone].name);
+		} else {
+			log_msg(LOG_NOTICE, "zone%d: change name '%s' --> '%s'", zone + 1,
+				conf->zones[zone].name, args);
+			strncopy(conf->zones[zone].name, args, sizeof(conf->zones[zone].name));
+		}
+		return 0;
+	}
+	return 1;
+}
+
+int cmd_zone_source(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	struct fan_zone *z;
+	int zone;
+	int type, val, d_o, d_n;
+	char *tok, *saveptr, *param;
+	int ret = 0;
+
+	zone = port_index(&prev_cmd[4]);
+	if (zone < 0 || zone >= ZONE_COUNT)
+		return 1;
+	z = &conf->zones[zone];
+
+	if (query) {
+		val = z->s_id;
+		if (z->s_type != PWM_FIXED)
+			val++;
+		printf("%s,%u\n", pwm_source2str(z->s_type), val);
+	} else {
+		param = strdup(args);
+		if ((tok = strtok_r(param, ",", &saveptr)) != NULL) {
+			type = str2pwm_source(tok);
+			d_n = (type != PWM_FIXED ? 1 : 0);
+			if ((tok = strtok_r(NULL, ",", &saveptr)) != NULL) {
+				val = (str_to_int(tok, &val, 10) && val >= d_n && val <= UINT16_MAX
+					? val - d_n : -1);
+				if (type != PWM_FAN && valid_pwm_source_ref(type, val)) {
+					d_o = (z->s_type != PWM_FIXED ? 1 : 0);
+					log_msg(LOG_NOTICE, "zone%d: change source %s,%u --> %s,%u",
+						zone + 1,
+						pwm_source2str(z->s_type),
+						z->s_id + d_o,
+						pwm_source2str(type),
+						val + d_n);
+					z->s_type = type;
+					z->s_id = val;
+				} else {
+					log_msg(LOG_WARNING, "zone%d: invalid source: %s",
+						zone + 1, args);
+					ret = 2;
+				}
+			}
+		}
+		free(param);
+	}
+
+	return ret;
+}
+
+int cmd_zone_filter(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	int zone;
+	int ret = 0;
+	char *tok, *saveptr, *param;
+	struct fan_zone *z;
+	enum signal_filter_types new_filter;
+	void *new_ctx;
+
+	zone = port_index(&prev_cmd[4]);
+	if (zone < 0 || zone >= ZONE_COUNT)
+		return 1;
+
+	z = &conf->zones[zone];
+	if (query) {
+		printf("%s", filter2str(z->filter));
+		tok = filter_print_args(z->filter, z->filter_ctx);
+		if (tok) {
+			printf(",%s\n", tok);
+			free(tok);
+		} else {
+			printf(",\n");
+		}
+	} else {
+		param = strdup(args);
+		if ((tok = strtok_r(param, ",", &saveptr)) != NULL) {
+			new_filter = str2filter(tok);
+			tok = strtok_r(NULL, "", &saveptr);
+			new_ctx = filter_parse_args(new_filter, tok);
+			if (new_filter == FILTER_NONE || new_ctx != NULL) {
+				z->filter = new_filter;
+				if (z->filter_ctx)
+					mem_free(MEM_FILTERS, z->filter_ctx);
+				z->filter_ctx = new_ctx;
+			} else {
+				ret = 1;
+			}
+		}
+		free(param);
+	}
+
+	return ret;
+}
+
 int cmd_mbfan_name(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int mbfan;
 
-	mbfan = atoi(&prev_cmd[5]) - 1;
+	mbfan = port_index(&prev_cmd[5]);
 	if (mbfan >= 0 && mbfan < MBFAN_COUNT) {
 		if (query) {
 			printf("%s\n", conf->mbfans[mbfan].name);
@@ -899,7 +1420,7 @@ int cmd_mbfan_min_rpm(const char *cmd, const char *args, int query, char *prev_c
 {
 	int fan, val;
 
-	fan = atoi(&prev_cmd[5]) - 1;
+	fan = port_index(&prev_cmd[5]);
 	if (fan >= 0 && fan < MBFAN_COUNT) {
 		if (query) {
 			printf("%d\n", conf->mbfans[fan].min_rpm);
@@ -923,7 +1444,7 @@ int cmd_mbfan_max_rpm(const char *cmd, const char *args, int query, char *prev_c
 {
 	int fan, val;
 
-	fan = atoi(&prev_cmd[5]) - 1;
+	fan = port_index(&prev_cmd[5]);
 	if (fan >= 0 && fan < MBFAN_COUNT) {
 		if (query) {
 			printf("%d\n", conf->mbfans[fan].max_rpm);
@@ -948,7 +1469,7 @@ int cmd_mbfan_rpm_coef(const char *cmd, const char *args, int query, char *prev_
 	int fan;
 	float val;
 
-	fan = atoi(&prev_cmd[5]) - 1;
+	fan = port_index(&prev_cmd[5]);
 	if (fan >= 0 && fan < MBFAN_COUNT) {
 		if (query) {
 			printf("%f\n", conf->mbfans[fan].rpm_coefficient);
@@ -973,12 +1494,12 @@ int cmd_mbfan_rpm_factor(const char *cmd, const char *args, int query, char *pre
 	int fan;
 	int val;
 
-	fan = atoi(&prev_cmd[5]) - 1;
+	fan = port_index(&prev_cmd[5]);
 	if (fan >= 0 && fan < MBFAN_COUNT) {
 		if (query) {
 			printf("%u\n", conf->mbfans[fan].rpm_factor);
 		} else if (str_to_int(args, &val, 10)) {
-			if (val >= 1 || val <= 8) {
+			if (val >= 1 && val <= 8) {
 				log_msg(LOG_NOTICE, "mbfan%d: change RPM factor %u --> %d",
 					fan + 1, conf->mbfans[fan].rpm_factor, val);
 				conf->mbfans[fan].rpm_factor = val;
@@ -993,6 +1514,70 @@ int cmd_mbfan_rpm_factor(const char *cmd, const char *args, int query, char *pre
 	return 1;
 }
 
+int cmd_mbfan_pulse_width(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	int fan;
+	int val;
+
+	fan = port_index(&prev_cmd[5]);
+	if (fan >= 0 && fan < MBFAN_COUNT) {
+		if (query) {
+			printf("%u\n", conf->mbfans[fan].tacho_duty);
+		} else if (str_to_int(args, &val, 10)) {
+			if (val >= 1 && val <= 99) {
+				log_msg(LOG_NOTICE, "mbfan%d: change tacho pulse width %u --> %d",
+					fan + 1, conf->mbfans[fan].tacho_duty, val);
+				conf->mbfans[fan].tacho_duty = val;
+			} else {
+				log_msg(LOG_WARNING, "mbfan%d: invalid tacho pulse width: %d",
+					fan + 1, val);
+				return 2;
+			}
+		}
+		return 0;
+	}
+	return 1;
+}
+
+int cmd_mbfan_stall_alarm(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	char name[32];
+	int fan;
+
+	fan = port_index(&prev_cmd[5]);
+	if (fan >= 0 && fan < MBFAN_COUNT) {
+		snprintf(name, sizeof(name), "mbfan%d: stall alarm", fan + 1);
+		return bool_setting(cmd, args, query, prev_cmd,
+				&conf->mbfans[fan].stall_alarm, name);
+	}
+	return 1;
+}
+
+int cmd_mbfan_hold_time(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	int fan;
+	int val;
+
+	fan = port_index(&prev_cmd[5]);
+	if (fan >= 0 && fan < MBFAN_COUNT) {
+		if (query) {
+			printf("%u\n", conf->mbfans[fan].hold_time);
+		} else if (str_to_int(args, &val, 10)) {
+			if (val >= 0 && val <= 60000) {
+				log_msg(LOG_NOTICE, "mbfan%d: change tacho hold time %u --> %d",
+					fan + 1, conf->mbfans[fan].hold_time, val);
+				conf->mbfans[fan].hold_time = val;
+			} else {
+				log_msg(LOG_WARNING, "mbfan%d: invalid tacho hold time: %d",
+					fan + 1, val);
+				return 2;
+			}
+		}
+		return 0;
+	}
+	return 1;
+}
+
 int cmd_mbfan_rpm_map(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int fan, i, count;
@@ -1002,7 +1587,7 @@ int cmd_mbfan_rpm_map(const char *cmd, const char *args, int query, char *prev_c
 	struct tacho_map new_map;
 	int ret = 0;
 
-	fan = atoi(&prev_cmd[5]) - 1;
+	fan = port_index(&prev_cmd[5]);
 	if (fan < 0 || fan >= MBFAN_COUNT)
 		return 0;
 	map = &conf->mbfans[fan].map;
@@ -1019,13 +1604,13 @@ int cmd_mbfan_rpm_map(const char *cmd, const char *args, int query, char *prev_c
 		arg = strdup(args);
 		count = 0;
 		t = strtok_r(arg, ",", &saveptr);
-		while (t) {
+		while (t && count < MAX_MAP_POINTS * 2) {
 			val = atoi(t);
 			new_map.tacho[count / 2][count % 2] = val;
 			count++;
 			t = strtok_r(NULL, ",", &saveptr);
 		}
-		if ((count >= 4) && (count % 2 == 0)) {
+		if ((count >= 4) && (count % 2 == 0) && !t) {
 			new_map.points = count / 2;
 			*map = new_map;
 		} else {
@@ -1049,7 +1634,7 @@ int cmd_mbfan_source(const char *cmd, const char *args, int query, char *prev_cm
 
 	memset(new_sources, 0, sizeof(new_sources));
 
-	fan = atoi(&prev_cmd[5]) - 1;
+	fan = port_index(&prev_cmd[5]);
 	if (fan < 0 || fan >= MBFAN_COUNT)
 		return 1;
 
@@ -1070,6 +1655,7 @@ int cmd_mbfan_source(const char *cmd, const char *args, int query, char *prev_cm
 		case TACHO_MIN:
 		case TACHO_MAX:
 		case TACHO_AVG:
+		case TACHO_WORST:
 			ocount = 0;
 			for (int i = 0; i < FAN_COUNT; i++) {
 				if (conf->mbfans[fan].sources[i]) {
@@ -1088,7 +1674,8 @@ int cmd_mbfan_source(const char *cmd, const char *args, int query, char *prev_cm
 			type = str2tacho_source(tok);
 			d_n = (type != TACHO_FIXED ? 1 : 0);
 			while ((tok = strtok_r(NULL, ",", &saveptr)) != NULL) {
-				val = atoi(tok) - d_n;
+				val = (str_to_int(tok, &val, 10) && val >= d_n && val <= UINT16_MAX
+					? val - d_n : -1);
 				if (valid_tacho_source_ref(type, val)) {
 					if (type == TACHO_FIXED || type == TACHO_FAN) {
 						d_o = (conf->mbfans[fan].s_type != TACHO_FIXED ? 1 : 0);
@@ -1111,7 +1698,8 @@ int cmd_mbfan_source(const char *cmd, const char *args, int query, char *prev_cm
 				}
 			}
 
-			if (type == TACHO_MIN || type == TACHO_MAX || type == TACHO_AVG) {
+			if (type == TACHO_MIN || type == TACHO_MAX || type == TACHO_AVG
+				|| type == TACHO_WORST) {
 				int scount = 0;
 				for (int i = 0; i < FAN_COUNT; i++) {
 					if (new_sources[i])
@@ -1140,14 +1728,15 @@ int cmd_mbfan_rpm(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int fan;
 	double rpm;
+	char buf[16];
 
 	if (query) {
-		fan = atoi(&prev_cmd[5]) - 1;
+		fan = port_index(&prev_cmd[5]);
 		if (fan >= 0 && fan < MBFAN_COUNT) {
 			rpm = st->mbfan_freq[fan] * 60.0 / conf->mbfans[fan].rpm_factor;
 			log_msg(LOG_DEBUG, "mbfan%d (tacho = %fHz) rpm = %.1lf", fan+1,
 				st->mbfan_freq[fan], rpm);
-			printf("%.0lf\n", rpm);
+			printf("%s\n", float_to_str(buf, sizeof(buf), rpm, 0, 0));
 			return 0;
 		}
 	}
@@ -1158,13 +1747,14 @@ int cmd_mbfan_tacho(const char *cmd, const char *args, int query, char *prev_cmd
 {
 	int fan;
 	float f;
+	char buf[16];
 
 	if (query) {
-		fan = atoi(&prev_cmd[5]) - 1;
+		fan = port_index(&prev_cmd[5]);
 		if (fan >= 0 && fan < MBFAN_COUNT) {
 			f = st->mbfan_freq[fan];
 			log_msg(LOG_DEBUG, "mbfan%d tacho = %fHz", fan + 1, f);
-			printf("%.1f\n", f);
+			printf("%s\n", float_to_str(buf, sizeof(buf), f, 0, 1));
 			return 0;
 		}
 	}
@@ -1175,13 +1765,14 @@ int cmd_mbfan_pwm(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int fan;
 	float d;
+	char buf[16];
 
 	if (query) {
-		fan = atoi(&prev_cmd[5]) - 1;
+		fan = port_index(&prev_cmd[5]);
 		if (fan >= 0 && fan < MBFAN_COUNT) {
 			d = st->mbfan_duty[fan];
 			log_msg(LOG_DEBUG, "mbfan%d duty = %f%%", fan + 1, d);
-			printf("%.0f\n", d);
+			printf("%s\n", float_to_str(buf, sizeof(buf), d, 0, 0));
 			return 0;
 		}
 	}
@@ -1193,14 +1784,15 @@ int cmd_mbfan_read(const char *cmd, const char *args, int query, char *prev_cmd)
 	int fan;
 	double rpm;
 	float d, f;
+	char s1[16], s2[16], s3[16];
 
 	if (!query)
 		return 1;
 
 	if (!strncasecmp(prev_cmd, "mbfan", 5)) {
-		fan = atoi(&prev_cmd[5]) - 1;
+		fan = port_index(&prev_cmd[5]);
 	} else {
-		fan = atoi(&cmd[5]) - 1;
+		fan = port_index(&cmd[5]);
 	}
 
 	if (fan >= 0 && fan < MBFAN_COUNT) {
@@ -1209,13 +1801,34 @@ int cmd_mbfan_read(const char *cmd, const char *args, int query, char *prev_cmd)
 		rpm = f * 60.0 / conf->mbfans[fan].rpm_factor;
 		log_msg(LOG_DEBUG, "mbfan%d duty = %f%%, freq = %fHz, speed = %fRPM",
 			fan + 1, d, f, rpm);
-		printf("%.0f,%.1f,%.0f\n", d, f, rpm);
+		printf("%s,%s,%s\n",
+			float_to_str(s1, sizeof(s1), d, 0, 0),
+			float_to_str(s2, sizeof(s2), f, 0, 1),
+			float_to_str(s3, sizeof(s3), rpm, 0, 0));
 		return 0;
 	}
 
 	return 1;
 }
 
+int cmd_mbfan_generator(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	struct tacho_gen_stats stats;
+	int fan;
+
+	if (!query)
+		return 1;
+
+	fan = port_index(&prev_cmd[5]);
+	if (fan < 0 || fan >= MBFAN_COUNT)
+		return 1;
+
+	tacho_gen_get_stats(fan, &stats);
+	printf("%lu,%lu,%lu\n", stats.updates, stats.coalesced, stats.unchanged);
+
+	return 0;
+}
+
 int cmd_mbfan_filter(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int mbfan;
@@ -1225,7 +1838,7 @@ int cmd_mbfan_filter(const char *cmd, const char *args, int query, char *prev_cm
 	enum signal_filter_types new_filter;
 	void *new_ctx;
 
-	mbfan = atoi(&prev_cmd[5]) - 1;
+	mbfan = port_index(&prev_cmd[5]);
 	if (mbfan < 0 || mbfan >= MBFAN_COUNT)
 		return 1;
 
@@ -1243,12 +1856,12 @@ int cmd_mbfan_filter(const char *cmd, const char *args, int query, char *prev_cm
 		param = strdup(args);
 		if ((tok = strtok_r(param, ",", &saveptr)) != NULL) {
 			new_filter = str2filter(tok);
-			tok += strlen(tok) + 1;
+			tok = strtok_r(NULL, "", &saveptr);
 			new_ctx = filter_parse_args(new_filter, tok);
 			if (new_filter == FILTER_NONE || new_ctx != NULL) {
 				m->filter = new_filter;
 				if (m->filter_ctx)
-					free(m->filter_ctx);
+					mem_free(MEM_FILTERS, m->filter_ctx);
 				m->filter_ctx = new_ctx;
 			} else {
 				ret = 1;
@@ -1264,7 +1877,7 @@ int cmd_sensor_name(const char *cmd, const char *args, int query, char *prev_cmd
 {
 	int sensor;
 
-	sensor = atoi(&prev_cmd[6]) - 1;
+	sensor = port_index(&prev_cmd[6]);
 	if (sensor >= 0 && sensor < SENSOR_COUNT) {
 		if (query) {
 			printf("%s\n", conf->sensors[sensor].name);
@@ -1284,7 +1897,7 @@ int cmd_sensor_temp_offset(const char *cmd, const char *args, int query, char *p
 	int sensor;
 	float val;
 
-	sensor = atoi(&prev_cmd[6]) - 1;
+	sensor = port_index(&prev_cmd[6]);
 	if (sensor >= 0 && sensor < SENSOR_COUNT) {
 		if (query) {
 			printf("%f\n", conf->sensors[sensor].temp_offset);
@@ -1298,12 +1911,81 @@ int cmd_sensor_temp_offset(const char *cmd, const char *args, int query, char *p
 	return 1;
 }
 
+int cmd_sensor_feed_forward(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	struct sensor_input *s;
+	char *arg, *t, *saveptr;
+	int sensor, count = 0;
+	float val[2];
+	int ret = 0;
+
+	sensor = port_index(&prev_cmd[6]);
+	if (sensor < 0 || sensor >= SENSOR_COUNT)
+		return 1;
+	s = &conf->sensors[sensor];
+
+	if (query) {
+		printf("%.2f,%.1f\n", s->ff_gain, s->ff_max);
+		return 0;
+	}
+
+	val[1] = s->ff_max;
+	arg = strdup(args);
+	t = strtok_r(arg, ",", &saveptr);
+	while (t && count < 2) {
+		if (!str_to_float(t, &val[count]))
+			break;
+		count++;
+		t = strtok_r(NULL, ",", &saveptr);
+	}
+	free(arg);
+
+	if (count < 1 || t || val[0] < 0.0 || val[0] > 100.0
+		|| val[1] < 0.0 || val[1] > 100.0) {
+		log_msg(LOG_WARNING, "sensor%d: invalid feed-forward settings: %s",
+			sensor + 1, args);
+		ret = 2;
+	} else {
+		log_msg(LOG_NOTICE, "sensor%d: change feed-forward %.2f,%.1f --> %.2f,%.1f",
+			sensor + 1, s->ff_gain, s->ff_max, val[0], val[1]);
+		s->ff_gain = val[0];
+		s->ff_max = val[1];
+	}
+
+	return ret;
+}
+
+int cmd_sensor_hysteresis(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	int sensor;
+	float val;
+
+	sensor = port_index(&prev_cmd[6]);
+	if (sensor >= 0 && sensor < SENSOR_COUNT) {
+		if (query) {
+			printf("%.1f\n", conf->sensors[sensor].hysteresis);
+		} else if (str_to_float(args, &val)) {
+			if (val >= 0.0 && val <= 100.0) {
+				log_msg(LOG_NOTICE, "sensor%d: change hysteresis %.1f --> %.1f",
+					sensor + 1, conf->sensors[sensor].hysteresis, val);
+				conf->sensors[sensor].hysteresis = val;
+			} else {
+				log_msg(LOG_WARNING, "sensor%d: invalid hysteresis: %f",
+					sensor + 1, val);
+				return 2;
+			}
+		}
+		return 0;
+	}
+	return 1;
+}
+
 int cmd_sensor_temp_coef(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int sensor;
 	float val;
 
-	sensor = atoi(&prev_cmd[6]) - 1;
+	sensor = port_index(&prev_cmd[6]);
 	if (sensor >= 0 && sensor < SENSOR_COUNT) {
 		if (query) {
 			printf("%f\n", conf->sensors[sensor].temp_coefficient);
@@ -1328,7 +2010,7 @@ int cmd_sensor_temp_nominal(const char *cmd, const char *args, int query, char *
 	int sensor;
 	float val;
 
-	sensor = atoi(&prev_cmd[6]) - 1;
+	sensor = port_index(&prev_cmd[6]);
 	if (sensor >= 0 && sensor < SENSOR_COUNT) {
 		if (query) {
 			printf("%.1f\n", conf->sensors[sensor].temp_nominal);
@@ -1354,7 +2036,7 @@ int cmd_sensor_ther_nominal(const char *cmd, const char *args, int query, char *
 	int sensor;
 	float val;
 
-	sensor = atoi(&prev_cmd[6]) - 1;
+	sensor = port_index(&prev_cmd[6]);
 	if (sensor >= 0 && sensor < SENSOR_COUNT) {
 		if (query) {
 			printf("%.0f\n", conf->sensors[sensor].thermistor_nominal);
@@ -1380,7 +2062,7 @@ int cmd_sensor_beta_coef(const char *cmd, const char *args, int query, char *pre
 	int sensor;
 	float val;
 
-	sensor = atoi(&prev_cmd[6]) - 1;
+	sensor = port_index(&prev_cmd[6]);
 	if (sensor >= 0 && sensor < SENSOR_COUNT) {
 		if (query) {
 			printf("%.0f\n", conf->sensors[sensor].beta_coefficient);
@@ -1410,7 +2092,7 @@ int cmd_sensor_temp_map(const char *cmd, const char *args, int query, char *prev
 	struct temp_map new_map;
 	int ret = 0;
 
-	sensor = atoi(&prev_cmd[6]) - 1;
+	sensor = port_index(&prev_cmd[6]);
 	if (sensor < 0 || sensor >= SENSOR_COUNT)
 		return 1;
 	map = &conf->sensors[sensor].map;
@@ -1427,13 +2109,13 @@ int cmd_sensor_temp_map(const char *cmd, const char *args, int query, char *prev
 		arg = strdup(args);
 		count = 0;
 		t = strtok_r(arg, ",", &saveptr);
-		while (t) {
+		while (t && count < MAX_MAP_POINTS * 2) {
 			val = atof(t);
 			new_map.temp[count / 2][count % 2] = val;
 			count++;
 			t = strtok_r(NULL, ",", &saveptr);
 		}
-		if ((count >= 4) && (count % 2 == 0)) {
+		if ((count >= 4) && (count % 2 == 0) && !t) {
 			new_map.points = count / 2;
 			*map = new_map;
 		} else {
@@ -1450,20 +2132,21 @@ int cmd_sensor_temp(const char *cmd, const char *args, int query, char *prev_cmd
 {
 	int sensor;
 	float d;
+	char buf[16];
 
 	if (!query)
 		return 1;
 
 	if (!strncasecmp(prev_cmd, "sensor", 6)) {
-		sensor = atoi(&prev_cmd[6]) - 1;
+		sensor = port_index(&prev_cmd[6]);
 	} else {
-		sensor = atoi(&cmd[6]) - 1;
+		sensor = port_index(&cmd[6]);
 	}
 
 	if (sensor >= 0 && sensor < SENSOR_COUNT) {
 		d = st->temp[sensor];
 		log_msg(LOG_DEBUG, "sensor%d temperature = %fC", sensor + 1, d);
-		printf("%.0f\n", d);
+		printf("%s\n", float_to_str(buf, sizeof(buf), d, 0, 0));
 		return 0;
 	}
 
@@ -1479,7 +2162,7 @@ int cmd_sensor_filter(const char *cmd, const char *args, int query, char *prev_c
 	enum signal_filter_types new_filter;
 	void *new_ctx;
 
-	sensor = atoi(&prev_cmd[6]) - 1;
+	sensor = port_index(&prev_cmd[6]);
 	if (sensor < 0 || sensor >= SENSOR_COUNT)
 		return 1;
 
@@ -1497,12 +2180,12 @@ int cmd_sensor_filter(const char *cmd, const char *args, int query, char *prev_c
 		param = strdup(args);
 		if ((tok = strtok_r(param, ",", &saveptr)) != NULL) {
 			new_filter = str2filter(tok);
-			tok += strlen(tok) + 1;
+			tok = strtok_r(NULL, "", &saveptr);
 			new_ctx = filter_parse_args(new_filter, tok);
 			if (new_filter == FILTER_NONE || new_ctx != NULL) {
 				s->filter = new_filter;
 				if (s->filter_ctx)
-					free(s->filter_ctx);
+					mem_free(MEM_FILTERS, s->filter_ctx);
 				s->filter_ctx = new_ctx;
 			} else {
 				ret = 1;
@@ -1518,7 +2201,7 @@ int cmd_vsensor_name(const char *cmd, const char *args, int query, char *prev_cm
 {
 	int sensor;
 
-	sensor = atoi(&prev_cmd[7]) - 1;
+	sensor = port_index(&prev_cmd[7]);
 	if (sensor >= 0 && sensor < VSENSOR_COUNT) {
 		if (query) {
 			printf("%s\n", conf->vsensors[sensor].name);
@@ -1543,7 +2226,7 @@ int cmd_vsensor_source(const char *cmd, const char *args, int query, char *prev_
 	int ret = 0;
 	int count = 0;
 
-	sensor = atoi(&prev_cmd[7]) - 1;
+	sensor = port_index(&prev_cmd[7]);
 	if (sensor < 0 || sensor >= VSENSOR_COUNT)
 		return 1;
 	vsmode = conf->vsensors[sensor].mode;
@@ -1620,6 +2303,75 @@ int cmd_vsensor_source(const char *cmd, const char *args, int query, char *prev_
 	return ret;
 }
 
+int cmd_vsensor_feed_forward(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	struct vsensor_input *s;
+	char *arg, *t, *saveptr;
+	int sensor, count = 0;
+	float val[2];
+	int ret = 0;
+
+	sensor = port_index(&prev_cmd[7]);
+	if (sensor < 0 || sensor >= VSENSOR_COUNT)
+		return 1;
+	s = &conf->vsensors[sensor];
+
+	if (query) {
+		printf("%.2f,%.1f\n", s->ff_gain, s->ff_max);
+		return 0;
+	}
+
+	val[1] = s->ff_max;
+	arg = strdup(args);
+	t = strtok_r(arg, ",", &saveptr);
+	while (t && count < 2) {
+		if (!str_to_float(t, &val[count]))
+			break;
+		count++;
+		t = strtok_r(NULL, ",", &saveptr);
+	}
+	free(arg);
+
+	if (count < 1 || t || val[0] < 0.0 || val[0] > 100.0
+		|| val[1] < 0.0 || val[1] > 100.0) {
+		log_msg(LOG_WARNING, "vsensor%d: invalid feed-forward settings: %s",
+			sensor + 1, args);
+		ret = 2;
+	} else {
+		log_msg(LOG_NOTICE, "vsensor%d: change feed-forward %.2f,%.1f --> %.2f,%.1f",
+			sensor + 1, s->ff_gain, s->ff_max, val[0], val[1]);
+		s->ff_gain = val[0];
+		s->ff_max = val[1];
+	}
+
+	return ret;
+}
+
+int cmd_vsensor_hysteresis(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	int sensor;
+	float val;
+
+	sensor = port_index(&prev_cmd[7]);
+	if (sensor >= 0 && sensor < VSENSOR_COUNT) {
+		if (query) {
+			printf("%.1f\n", conf->vsensors[sensor].hysteresis);
+		} else if (str_to_float(args, &val)) {
+			if (val >= 0.0 && val <= 100.0) {
+				log_msg(LOG_NOTICE, "vsensor%d: change hysteresis %.1f --> %.1f",
+					sensor + 1, conf->vsensors[sensor].hysteresis, val);
+				conf->vsensors[sensor].hysteresis = val;
+			} else {
+				log_msg(LOG_WARNING, "vsensor%d: invalid hysteresis: %f",
+					sensor + 1, val);
+				return 2;
+			}
+		}
+		return 0;
+	}
+	return 1;
+}
+
 int cmd_vsensor_temp_map(const char *cmd, const char *args, int query, char *prev_cmd)
 {
 	int sensor, i, count;
@@ -1629,7 +2381,7 @@ int cmd_vsensor_temp_map(const char *cmd, const char *args, int query, char *pre
 	struct temp_map new_map;
 	int ret = 0;
 
-	sensor = atoi(&prev_cmd[7]) - 1;
+	sensor = port_index(&prev_cmd[7]);
 	if (sensor < 0 || sensor >= VSENSOR_COUNT)
 		return 1;
 	map = &conf->vsensors[sensor].map;
@@ -1646,13 +2398,13 @@ int cmd_vsensor_temp_map(const char *cmd, const char *args, int query, char *pre
 		arg = strdup(args);
 		count = 0;
 		t = strtok_r(arg, ",", &saveptr);
-		while (t) {
+		while (t && count < MAX_MAP_POINTS * 2) {
 			val = atof(t);
 			new_map.temp[count / 2][count % 2] = val;
 			count++;
 			t = strtok_r(NULL, ",", &saveptr);
 		}
-		if ((count >= 4) && (count % 2 == 0)) {
+		if ((count >= 4) && (count % 2 == 0) && !t) {
 			new_map.points = count / 2;
 			*map = new_map;
 		} else {
@@ -1669,20 +2421,21 @@ int cmd_vsensor_temp(const char *cmd, const char *args, int query, char *prev_cm
 {
 	int sensor;
 	float d;
+	char buf[16];
 
 	if (!query)
 		return 1;
 
 	if (!strncasecmp(prev_cmd, "vsensor", 7)) {
-		sensor = atoi(&prev_cmd[7]) - 1;
+		sensor = port_index(&prev_cmd[7]);
 	} else {
-		sensor = atoi(&cmd[7]) - 1;
+		sensor = port_index(&cmd[7]);
 	}
 
 	if (sensor >= 0 && sensor < VSENSOR_COUNT) {
 		d = st->vtemp[sensor];
 		log_msg(LOG_DEBUG, "vsensor%d temperature = %fC", sensor + 1, d);
-		printf("%.0f\n", d);
+		printf("%s\n", float_to_str(buf, sizeof(buf), d, 0, 0));
 		return 0;
 	}
 
@@ -1698,7 +2451,7 @@ int cmd_vsensor_filter(const char *cmd, const char *args, int query, char *prev_
 	enum signal_filter_types new_filter;
 	void *new_ctx;
 
-	sensor = atoi(&prev_cmd[7]) - 1;
+	sensor = port_index(&prev_cmd[7]);
 	if (sensor < 0 || sensor >= VSENSOR_COUNT)
 		return 1;
 
@@ -1716,12 +2469,12 @@ int cmd_vsensor_filter(const char *cmd, const char *args, int query, char *prev_
 		param = strdup(args);
 		if ((tok = strtok_r(param, ",", &saveptr)) != NULL) {
 			new_filter = str2filter(tok);
-			tok += strlen(tok) + 1;
+			tok = strtok_r(NULL, "", &saveptr);
 			new_ctx = filter_parse_args(new_filter, tok);
 			if (new_filter == FILTER_NONE || new_ctx != NULL) {
 				s->filter = new_filter;
 				if (s->filter_ctx)
-					free(s->filter_ctx);
+					mem_free(MEM_FILTERS, s->filter_ctx);
 				s->filter_ctx = new_ctx;
 			} else {
 				ret = 1;
@@ -1742,9 +2495,9 @@ int cmd_vsensor_write(const char *cmd, const char *args, int query, char *prev_c
 		return 1;
 
 	if (!strncasecmp(prev_cmd, "vsensor", 7)) {
-		sensor = atoi(&prev_cmd[7]) - 1;
+		sensor = port_index(&prev_cmd[7]);
 	} else {
-		sensor = atoi(&cmd[7]) - 1;
+		sensor = port_index(&cmd[7]);
 	}
 
 	if (sensor >= 0 && sensor < VSENSOR_COUNT) {
@@ -2315,6 +3068,76 @@ int cmd_flash(const char *cmd, const char *args, int query, char *prev_cmd)
 }
 
 
+int cmd_perf(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	if (!query)
+		return 1;
+
+	perf_print();
+	return 0;
+}
+
+int cmd_perf_reset(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	if (query)
+		return 1;
+
+	log_msg(LOG_NOTICE, "Reset performance counters");
+	perf_reset();
+	sched_reset_stats();
+	return 0;
+}
+
+int cmd_tasks(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	if (!query)
+		return 1;
+
+	sched_print();
+	return 0;
+}
+
+#if TRACE_SUPPORT
+int cmd_trace(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	uint32_t mask = 0xffffffff;
+	char *saveptr, *arg, *t;
+	int ret = 0;
+
+	if (query) {
+		trace_print_status();
+		return 0;
+	}
+
+	if (!(arg = strdup(args)))
+		return 2;
+	t = strtok_r(arg, " \t", &saveptr);
+	if (t && !strncasecmp(t, "start", 6)) {
+		if ((t = strtok_r(NULL, " \t", &saveptr)))
+			mask = strtoul(t, NULL, 0);
+		log_msg(LOG_NOTICE, "Event trace started (mask=0x%08lx)", mask);
+		trace_start(mask);
+	} else if (t && !strncasecmp(t, "stop", 5)) {
+		trace_stop();
+		log_msg(LOG_NOTICE, "Event trace stopped");
+	} else {
+		ret = 2;
+	}
+	free(arg);
+
+	return ret;
+}
+
+int cmd_trace_dump(const char *cmd, const char *args, int query, char *prev_cmd)
+{
+	if (!query)
+		return 1;
+
+	trace_dump();
+	return 0;
+}
+#endif
+
 #define TEST_MEM_SIZE (264*1024)
 
 int cmd_memory(const char *cmd, const char *args, int query, char *prev_cmd)
@@ -2323,7 +3146,9 @@ int cmd_memory(const char *cmd, const char *args, int query, char *prev_cmd)
 
 	if (query) {
 		print_rp2040_meminfo();
-		printf("mallinfo:\n");
+		printf("\nHeap usage by subsystem:\n");
+		mem_print_stats();
+		printf("\nmallinfo:\n");
 		print_mallinfo();
 		return 0;
 	}
@@ -2347,6 +3172,8 @@ int cmd_memory(const char *cmd, const char *args, int query, char *prev_cmd)
 		}
 		buf = malloc(bufsize);
 	} while (buf && bufsize < TEST_MEM_SIZE);
+	if (buf)
+		free(buf);
 	printf("Largest available memory block:        %u bytes\n",
 		bufsize - blocksize);
 
@@ -2390,15 +3217,33 @@ int cmd_spi(const char *cmd, const char *args, int query, char *prev_cmd)
 const struct cmd_t display_commands[] = {
 	{ "LAYOUTR",   7, NULL,              cmd_display_layout_r },
 	{ "LOGO",      4, NULL,              cmd_display_logo },
+	{ "STATS",     5, NULL,              cmd_display_stats },
 	{ "THEMe",     4, NULL,              cmd_display_theme },
 	{ 0, 0, 0, 0 }
 };
 
+const struct cmd_t boot_commands[] = {
+	{ "FAST",      4, NULL,              cmd_boot_fast },
+	{ 0, 0, 0, 0 }
+};
+
 const struct cmd_t lfs_commands[] = {
 	{ "FORMAT",    6, NULL,              cmd_lfs_format },
 	{ 0, 0, 0, 0 }
 };
 
+const struct cmd_t perf_commands[] = {
+	{ "RESet",     3, NULL,              cmd_perf_reset },
+	{ 0, 0, 0, 0 }
+};
+
+const struct cmd_t trace_commands[] = {
+#if TRACE_SUPPORT
+	{ "DUMP",      4, NULL,              cmd_trace_dump },
+#endif
+	{ 0, 0, 0, 0 }
+};
+
 const struct cmd_t wifi_commands[] = {
 #ifdef WIFI_SUPPORT
 	{ "COUntry",   3, NULL,              cmd_wifi_country },
@@ -2487,10 +3332,13 @@ const struct cmd_t telnet_commands[] = {
 };
 
 const struct cmd_t system_commands[] = {
+	{ "BOOT",      4, boot_commands,     cmd_boot },
 	{ "DEBUG",     5, NULL,              cmd_debug }, /* Obsolete ? */
 	{ "DISPlay",   4, display_commands,  cmd_display_type },
 	{ "ECHO",      4, NULL,              cmd_echo },
 	{ "ERRor",     3, NULL,              cmd_err },
+	{ "FANCAL",    6, NULL,              cmd_fancal },
+	{ "FANFail",   4, NULL,              cmd_fan_fail },
 	{ "FANS",      4, NULL,              cmd_fans },
 	{ "FLASH",     5, NULL,              cmd_flash },
 	{ "LED",       3, NULL,              cmd_led },
@@ -2502,14 +3350,21 @@ const struct cmd_t system_commands[] = {
 	{ "MQTT",      4, mqtt_commands,     NULL },
 #endif
 	{ "NAME",      4, NULL,              cmd_name },
+	{ "PERF",      4, perf_commands,     cmd_perf },
+	{ "PWMDither", 4, NULL,              cmd_pwm_dither },
+	{ "PWMPhase",  4, NULL,              cmd_pwm_phase },
 	{ "SENSORS",   7, NULL,              cmd_sensors },
 	{ "SERIAL",    6, NULL,              cmd_serial },
 	{ "SPI",       3, NULL,              cmd_spi },
 	{ "SYSLOG",    6, NULL,              cmd_syslog_level },
+	{ "TASKS",     5, NULL,              cmd_tasks },
 	{ "TELNET",    6, telnet_commands,   NULL },
 	{ "TIMEZONE",  8, NULL,              cmd_timezone },
 	{ "TIME",      4, NULL,              cmd_time },
 	{ "TLS",       3, tls_commands,      NULL },
+#if TRACE_SUPPORT
+	{ "TRACE",     5, trace_commands,    cmd_trace },
+#endif
 	{ "UPGRADE",   7, NULL,              cmd_usb_boot },
 	{ "UPTIme",    4, NULL,              cmd_uptime },
 	{ "VERsion",   3, NULL,              cmd_version },
@@ -2519,22 +3374,38 @@ const struct cmd_t system_commands[] = {
 };
 
 const struct cmd_t fan_c_commands[] = {
+	{ "CALibrate", 3, NULL,              cmd_fan_calibrate },
+	{ "DWELL",     5, NULL,              cmd_fan_dwell },
 	{ "FILTER",    6, NULL,              cmd_fan_filter },
+	{ "KICK",      4, NULL,              cmd_fan_kick },
 	{ "MAXpwm",    3, NULL,              cmd_fan_max_pwm },
 	{ "MINpwm",    3, NULL,              cmd_fan_min_pwm },
 	{ "NAME",      4, NULL,              cmd_fan_name },
+	{ "OFFSet",    4, NULL,              cmd_fan_offset },
 	{ "PWMCoeff",  4, NULL,              cmd_fan_pwm_coef },
 	{ "PWMMap",    4, NULL,              cmd_fan_pwm_map },
 	{ "RPMFactor", 4, NULL,              cmd_fan_rpm_factor },
+	{ "SLEW",      4, NULL,              cmd_fan_slew },
 	{ "SOUrce",    3, NULL,              cmd_fan_source },
+	{ "ZONE",      4, NULL,              cmd_fan_zone },
+	{ 0, 0, 0, 0 }
+};
+
+const struct cmd_t zone_c_commands[] = {
+	{ "FILTER",    6, NULL,              cmd_zone_filter },
+	{ "NAME",      4, NULL,              cmd_zone_name },
+	{ "SOUrce",    3, NULL,              cmd_zone_source },
 	{ 0, 0, 0, 0 }
 };
 
 const struct cmd_t mbfan_c_commands[] = {
+	{ "ALARM",     5, NULL,              cmd_mbfan_stall_alarm },
 	{ "FILTER",    6, NULL,              cmd_mbfan_filter },
+	{ "HOLD",      4, NULL,              cmd_mbfan_hold_time },
 	{ "MAXrpm",    3, NULL,              cmd_mbfan_max_rpm },
 	{ "MINrpm",    3, NULL,              cmd_mbfan_min_rpm },
 	{ "NAME",      4, NULL,              cmd_mbfan_name },
+	{ "PULSEwidth", 5, NULL,             cmd_mbfan_pulse_width },
 	{ "RPMCoeff",  4, NULL,              cmd_mbfan_rpm_coef },
 	{ "RPMFactor", 4, NULL,              cmd_mbfan_rpm_factor },
 	{ "RPMMap",    4, NULL,              cmd_mbfan_rpm_map },
@@ -2544,7 +3415,9 @@ const struct cmd_t mbfan_c_commands[] = {
 
 const struct cmd_t sensor_c_commands[] = {
 	{ "BETAcoeff",   4, NULL,            cmd_sensor_beta_coef },
+	{ "FEEDforward", 4, NULL,            cmd_sensor_feed_forward },
 	{ "FILTER",      6, NULL,            cmd_sensor_filter },
+	{ "HYSTeresis",  4, NULL,            cmd_sensor_hysteresis },
 	{ "NAME",        4, NULL,            cmd_sensor_name },
 	{ "TEMPCoeff",   5, NULL,            cmd_sensor_temp_coef },
 	{ "TEMPMap",     5, NULL,            cmd_sensor_temp_map },
@@ -2555,7 +3428,9 @@ const struct cmd_t sensor_c_commands[] = {
 };
 
 const struct cmd_t vsensor_c_commands[] = {
+	{ "FEEDforward", 4, NULL,            cmd_vsensor_feed_forward },
 	{ "FILTER",      6, NULL,            cmd_vsensor_filter },
+	{ "HYSTeresis",  4, NULL,            cmd_vsensor_hysteresis },
 	{ "NAME",        4, NULL,            cmd_vsensor_name },
 	{ "SOUrce",      3, NULL,            cmd_vsensor_source },
 	{ "TEMPMap",     5, NULL,            cmd_vsensor_temp_map },
@@ -2570,6 +3445,7 @@ const struct cmd_t config_commands[] = {
 	{ "SAVe",      3, NULL,              cmd_save_config },
 	{ "SENSOR",    6, sensor_c_commands, NULL },
 	{ "VSENSOR",   7, vsensor_c_commands, NULL },
+	{ "ZONE",      4, zone_c_commands,   NULL },
 	{ 0, 0, 0, 0 }
 };
 
@@ -2577,11 +3453,13 @@ const struct cmd_t fan_commands[] = {
 	{ "PWM",       3, NULL,              cmd_fan_pwm },
 	{ "Read",      1, NULL,              cmd_fan_read },
 	{ "RPM",       3, NULL,              cmd_fan_rpm },
+	{ "STATus",    4, NULL,              cmd_fan_status },
 	{ "TACho",     3, NULL,              cmd_fan_tacho },
 	{ 0, 0, 0, 0 }
 };
 
 const struct cmd_t mbfan_commands[] = {
+	{ "GENerator", 3, NULL,              cmd_mbfan_generator },
 	{ "PWM",       3, NULL,              cmd_mbfan_pwm },
 	{ "Read",      1, NULL,              cmd_mbfan_read },
 	{ "RPM",       3, NULL,              cmd_mbfan_rpm },
@@ -2669,7 +3547,7 @@ const struct cmd_t* run_cmd(char *cmd, const struct cmd_t *cmd_level, char **pre
 						query = (s[strlen(s)-1] == '?' ? 1 : 0);
 						arg = t + cmd_len + 1;
 						if (!query)
-							mutex_enter_blocking(config_mutex);
+							perf_mutex_enter_blocking(config_mutex, PERF_MUTEX_CONFIG);
 						res = cmd_level[i].func(s,
 								(total_len > cmd_len+1 ? arg : ""),
 								query,
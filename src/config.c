@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <malloc.h>
 #include <string.h>
+#include <float.h>
 #include "pico/stdlib.h"
 #include "pico/mutex.h"
 #include "cJSON.h"
@@ -147,6 +148,8 @@ int str2tacho_source(const char *s)
 			ret = TACHO_MAX;
 		else if (!strncasecmp(s, "avg", 3))
 			ret = TACHO_AVG;
+		else if (!strncasecmp(s, "worst", 5))
+			ret = TACHO_WORST;
 	}
 
 	return ret;
@@ -163,6 +166,8 @@ const char* tacho_source2str(enum tacho_source_types source)
 		return "max";
 	else if (source == TACHO_AVG)
 		return "avg";
+	else if (source == TACHO_WORST)
+		return "worst";
 
 	return "fixed";
 }
@@ -181,6 +186,7 @@ int valid_tacho_source_ref(enum tacho_source_types source, uint16_t s_id)
 	case TACHO_MIN:
 	case TACHO_MAX:
 	case TACHO_AVG:
+	case TACHO_WORST:
 		ret = (s_id >= 0 && s_id < FAN_MAX_COUNT ? 1 : 0);
 		break;
 	}
@@ -189,20 +195,54 @@ int valid_tacho_source_ref(enum tacho_source_types source, uint16_t s_id)
 }
 
 
+static int json_map_row(cJSON *row)
+{
+	return (cJSON_GetArraySize(row) >= 2
+		&& cJSON_IsNumber(cJSON_GetArrayItem(row, 0))
+		&& cJSON_IsNumber(cJSON_GetArrayItem(row, 1)) ? 1 : 0);
+}
+
+
+/* Return numeric value of item, or default value if item is missing
+ * or its value is outside of the given range.
+ */
+static double json_number(cJSON *item, const char *name, double min, double max, double def)
+{
+	cJSON *o = cJSON_GetObjectItem(item, name);
+	double val;
+
+	if (!o)
+		return def;
+	val = cJSON_GetNumberValue(o);
+	if (!cJSON_IsNumber(o) || !(val >= min && val <= max)) {
+		log_msg(LOG_WARNING, "Ignoring invalid value for '%s'", name);
+		return def;
+	}
+	return val;
+}
+
+
 void json2pwm_map(cJSON *item, struct pwm_map *map)
 {
+	struct pwm_map m;
 	cJSON *row;
 	int c = 0;
 
 	cJSON_ArrayForEach(row, item) {
-		if (c < MAX_MAP_POINTS) {
-			map->pwm[c][0] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 0));
-			map->pwm[c][1] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 1));
+		if (c < MAX_MAP_POINTS && json_map_row(row)) {
+			m.pwm[c][0] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 0));
+			m.pwm[c][1] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 1));
 			c++;
 		}
 	}
 
-	map->points = c;
+	/* Keep current map unless new map is usable */
+	if (c < 2) {
+		log_msg(LOG_WARNING, "Ignoring invalid pwm map (%d points)", c);
+		return;
+	}
+	m.points = c;
+	*map = m;
 }
 
 
@@ -227,44 +267,109 @@ cJSON* pwm_map2json(const struct pwm_map *map)
 
 void json2filter(cJSON *item, enum signal_filter_types *filter, void **filter_ctx)
 {
-	cJSON *args;
+	char *args;
 
 	*filter = str2filter(cJSON_GetStringValue(cJSON_GetObjectItem(item, "name")));
-	if ((args = cJSON_GetObjectItem(item, "args")) && *filter != FILTER_NONE) {
-		*filter_ctx =  filter_parse_args(*filter, cJSON_GetStringValue(args));
-		if (!*filter_ctx)
-			*filter = FILTER_NONE;
+	if (*filter == FILTER_NONE)
+		return;
+
+	/* Parse a copy of the arguments, as parser modifies the string */
+	args = cJSON_GetStringValue(cJSON_GetObjectItem(item, "args"));
+	if (args && (args = strdup(args))) {
+		*filter_ctx = filter_parse_args(*filter, args);
+		free(args);
 	}
+	if (!*filter_ctx)
+		*filter = FILTER_NONE;
 }
 
 
 cJSON* filter2json(enum signal_filter_types filter, void *filter_ctx)
 {
 	cJSON *o;
+	char *args;
 
 	if ((o = cJSON_CreateObject()) == NULL)
 		return NULL;
 
+	args = filter_print_args(filter, filter_ctx);
 	cJSON_AddItemToObject(o, "name", cJSON_CreateString(filter2str(filter)));
-	cJSON_AddItemToObject(o, "args", cJSON_CreateString(filter_print_args(filter, filter_ctx)));
+	if (args) {
+		cJSON_AddItemToObject(o, "args", cJSON_CreateString(args));
+		free(args);
+	}
+	return o;
+}
+
+
+void json2fan_cal(cJSON *item, struct fan_cal *cal)
+{
+	struct fan_cal c;
+	cJSON *rpm, *o;
+	double val;
+	int i = 0;
+
+	memset(&c, 0, sizeof(c));
+	rpm = cJSON_GetObjectItem(item, "rpm");
+	cJSON_ArrayForEach(o, rpm) {
+		val = cJSON_GetNumberValue(o);
+		if (i >= FAN_CAL_POINTS || !cJSON_IsNumber(o) || !(val >= 0 && val <= 50000))
+			break;
+		c.rpm[i++] = val;
+	}
+	if (i != FAN_CAL_POINTS || i != cJSON_GetArraySize(rpm)) {
+		log_msg(LOG_WARNING, "Ignoring invalid fan calibration data");
+		return;
+	}
+	c.points = FAN_CAL_POINTS;
+	c.stall_duty = json_number(item, "stall_duty", 0, 100, 0);
+	c.start_duty = json_number(item, "start_duty", 0, 100, 0);
+	c.min_rpm = json_number(item, "min_rpm", 0, 50000, 0);
+	*cal = c;
+}
+
+
+cJSON* fan_cal2json(const struct fan_cal *cal)
+{
+	cJSON *o, *rpm;
+	int i;
+
+	if ((o = cJSON_CreateObject()) == NULL)
+		return NULL;
+
+	if ((rpm = cJSON_CreateArray())) {
+		for (i = 0; i < cal->points; i++)
+			cJSON_AddItemToArray(rpm, cJSON_CreateNumber(cal->rpm[i]));
+		cJSON_AddItemToObject(o, "rpm", rpm);
+	}
+	cJSON_AddItemToObject(o, "stall_duty", cJSON_CreateNumber(cal->stall_duty));
+	cJSON_AddItemToObject(o, "min_rpm", cJSON_CreateNumber(cal->min_rpm));
+	cJSON_AddItemToObject(o, "start_duty", cJSON_CreateNumber(cal->start_duty));
 	return o;
 }
 
 
 void json2tacho_map(cJSON *item, struct tacho_map *map)
 {
+	struct tacho_map m;
 	cJSON *row;
 	int c = 0;
 
 	cJSON_ArrayForEach(row, item) {
-		if (c < MAX_MAP_POINTS) {
-			map->tacho[c][0] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 0));
-			map->tacho[c][1] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 1));
+		if (c < MAX_MAP_POINTS && json_map_row(row)) {
+			m.tacho[c][0] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 0));
+			m.tacho[c][1] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 1));
 			c++;
 		}
 	}
 
-	map->points = c;
+	/* Keep current map unless new map is usable */
+	if (c < 2) {
+		log_msg(LOG_WARNING, "Ignoring invalid tacho map (%d points)", c);
+		return;
+	}
+	m.points = c;
+	*map = m;
 }
 
 cJSON* tacho_map2json(const struct tacho_map *map)
@@ -318,18 +423,25 @@ cJSON* tacho_sources2json(const uint8_t *sources)
 
 void json2temp_map(cJSON *item, struct temp_map *map)
 {
+	struct temp_map m;
 	cJSON *row;
 	int c = 0;
 
 	cJSON_ArrayForEach(row, item) {
-		if (c < MAX_MAP_POINTS) {
-			map->temp[c][0] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 0));
-			map->temp[c][1] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 1));
+		if (c < MAX_MAP_POINTS && json_map_row(row)) {
+			m.temp[c][0] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 0));
+			m.temp[c][1] = cJSON_GetNumberValue(cJSON_GetArrayItem(row, 1));
 			c++;
 		}
 	}
 
-	map->points = c;
+	/* Keep current map unless new map is usable */
+	if (c < 2) {
+		log_msg(LOG_WARNING, "Ignoring invalid temp map (%d points)", c);
+		return;
+	}
+	m.points = c;
+	*map = m;
 }
 
 
@@ -393,9 +505,10 @@ void clear_config(struct fanpico_config *cfg)
 	struct sensor_input *s;
 	struct vsensor_input *vs;
 	struct fan_output *f;
+	struct fan_zone *z;
 	struct mb_input *m;
 
-	mutex_enter_blocking(config_mutex);
+	perf_mutex_enter_blocking(config_mutex, PERF_MUTEX_CONFIG);
 
 	for (i = 0; i < SENSOR_MAX_COUNT; i++) {
 		s = &cfg->sensors[i];
@@ -408,6 +521,9 @@ void clear_config(struct fanpico_config *cfg)
 		s->temp_offset = 0.0;
 		s->temp_coefficient = 0.0;
 		s->map.points = 0;
+		s->hysteresis = 0.0;
+		s->ff_gain = 0.0;
+		s->ff_max = 20.0;
 		s->filter = FILTER_NONE;
 		s->filter_ctx = NULL;
 	}
@@ -426,6 +542,9 @@ void clear_config(struct fanpico_config *cfg)
 		vs->map.temp[0][1] = 0.0;
 		vs->map.temp[1][0] = 50.0;
 		vs->map.temp[1][1] = 100.0;
+		vs->hysteresis = 0.0;
+		vs->ff_gain = 0.0;
+		vs->ff_max = 20.0;
 		vs->filter = FILTER_NONE;
 		vs->filter_ctx = NULL;
 
@@ -446,6 +565,25 @@ void clear_config(struct fanpico_config *cfg)
 		f->rpm_factor = 2;
 		f->filter = FILTER_NONE;
 		f->filter_ctx = NULL;
+		f->zone = -1;
+		f->offset = 0.0;
+		f->slew_up = 0.0;
+		f->slew_down = 0.0;
+		f->min_dwell = 0;
+		f->kick_duty = 0;
+		f->kick_time = 2000;
+		f->kick_retry = 10;
+		memset(&f->cal, 0, sizeof(f->cal));
+	}
+
+	for (i = 0; i < ZONE_MAX_COUNT; i++) {
+		z = &cfg->zones[i];
+
+		z->name[0] = 0;
+		z->s_type = PWM_FIXED;
+		z->s_id = 100;
+		z->filter = FILTER_NONE;
+		z->filter_ctx = NULL;
 	}
 
 	for (i = 0; i < MBFAN_MAX_COUNT; i++) {
@@ -456,6 +594,9 @@ void clear_config(struct fanpico_config *cfg)
 		m->max_rpm = 0;
 		m->rpm_coefficient = 0.0;
 		m->rpm_factor = 2;
+		m->tacho_duty = 50;
+		m->stall_alarm = false;
+		m->hold_time = 0;
 		m->s_type = TACHO_FIXED;
 		m->s_id = 0;
 		m->map.points = 0;
@@ -466,6 +607,13 @@ void clear_config(struct fanpico_config *cfg)
 	}
 
 	cfg->local_echo = false;
+	cfg->fast_boot = false;
+	cfg->fan_fail_duty = 0;
+	cfg->fan_fail_boost = 100;
+	cfg->pwm_dither = false;
+	cfg->pwm_phase_auto = true;
+	for (i = 0; i < FAN_MAX_COUNT / 2; i++)
+		cfg->pwm_phase[i] = 0;
 	cfg->spi_active = false;
 	cfg->serial_active = false;
 	cfg->led_mode = 0;
@@ -524,7 +672,7 @@ void clear_config(struct fanpico_config *cfg)
 cJSON *config_to_json(const struct fanpico_config *cfg)
 {
 	cJSON *config = cJSON_CreateObject();
-	cJSON *fans, *mbfans, *sensors, *vsensors, *o;
+	cJSON *fans, *zones, *mbfans, *sensors, *vsensors, *o;
 	int i;
 
 	if (!config)
@@ -535,6 +683,16 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 	cJSON_AddItemToObject(config, "log_level", cJSON_CreateNumber(get_log_level()));
 	cJSON_AddItemToObject(config, "syslog_level", cJSON_CreateNumber(get_syslog_level()));
 	cJSON_AddItemToObject(config, "local_echo", cJSON_CreateBool(cfg->local_echo));
+	cJSON_AddItemToObject(config, "fast_boot", cJSON_CreateBool(cfg->fast_boot));
+	cJSON_AddItemToObject(config, "fan_fail_duty", cJSON_CreateNumber(cfg->fan_fail_duty));
+	cJSON_AddItemToObject(config, "fan_fail_boost", cJSON_CreateNumber(cfg->fan_fail_boost));
+	cJSON_AddItemToObject(config, "pwm_dither", cJSON_CreateBool(cfg->pwm_dither));
+	cJSON_AddItemToObject(config, "pwm_phase_auto", cJSON_CreateBool(cfg->pwm_phase_auto));
+	if ((o = cJSON_CreateArray())) {
+		for (i = 0; i < FAN_COUNT / 2; i++)
+			cJSON_AddItemToArray(o, cJSON_CreateNumber(cfg->pwm_phase[i]));
+		cJSON_AddItemToObject(config, "pwm_phase", o);
+	}
 	cJSON_AddItemToObject(config, "led_mode", cJSON_CreateNumber(cfg->led_mode));
 	cJSON_AddItemToObject(config, "spi_active", cJSON_CreateNumber(cfg->spi_active));
 	cJSON_AddItemToObject(config, "serial_active", cJSON_CreateNumber(cfg->serial_active));
@@ -691,10 +849,39 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 		cJSON_AddItemToObject(o, "pwm_map", pwm_map2json(&f->map));
 		cJSON_AddItemToObject(o, "rpm_factor", cJSON_CreateNumber(f->rpm_factor));
 		cJSON_AddItemToObject(o, "filter", filter2json(f->filter, f->filter_ctx));
+		cJSON_AddItemToObject(o, "zone", cJSON_CreateNumber(f->zone));
+		cJSON_AddItemToObject(o, "offset", cJSON_CreateNumber(f->offset));
+		cJSON_AddItemToObject(o, "slew_up", cJSON_CreateNumber(f->slew_up));
+		cJSON_AddItemToObject(o, "slew_down", cJSON_CreateNumber(f->slew_down));
+		cJSON_AddItemToObject(o, "min_dwell", cJSON_CreateNumber(f->min_dwell));
+		cJSON_AddItemToObject(o, "kick_duty", cJSON_CreateNumber(f->kick_duty));
+		cJSON_AddItemToObject(o, "kick_time", cJSON_CreateNumber(f->kick_time));
+		cJSON_AddItemToObject(o, "kick_retry", cJSON_CreateNumber(f->kick_retry));
+		if (f->cal.points > 0)
+			cJSON_AddItemToObject(o, "calibration", fan_cal2json(&f->cal));
 		cJSON_AddItemToArray(fans, o);
 	}
 	cJSON_AddItemToObject(config, "fans", fans);
 
+	/* Fan zones */
+	zones = cJSON_CreateArray();
+	if (!zones)
+		goto panic;
+	for (i = 0; i < ZONE_COUNT; i++) {
+		const struct fan_zone *z = &cfg->zones[i];
+
+		o = cJSON_CreateObject();
+		if (!o)
+			goto panic;
+		cJSON_AddItemToObject(o, "id", cJSON_CreateNumber(i));
+		cJSON_AddItemToObject(o, "name", cJSON_CreateString(z->name));
+		cJSON_AddItemToObject(o, "source_type", cJSON_CreateString(pwm_source2str(z->s_type)));
+		cJSON_AddItemToObject(o, "source_id", cJSON_CreateNumber(z->s_id));
+		cJSON_AddItemToObject(o, "filter", filter2json(z->filter, z->filter_ctx));
+		cJSON_AddItemToArray(zones, o);
+	}
+	cJSON_AddItemToObject(config, "zones", zones);
+
 	/* MB Fan inputs */
 	mbfans = cJSON_CreateArray();
 	if (!mbfans)
@@ -711,10 +898,14 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 		cJSON_AddItemToObject(o, "max_rpm", cJSON_CreateNumber(m->max_rpm));
 		cJSON_AddItemToObject(o, "rpm_coefficient", cJSON_CreateNumber(m->rpm_coefficient));
 		cJSON_AddItemToObject(o, "rpm_factor", cJSON_CreateNumber(m->rpm_factor));
+		cJSON_AddItemToObject(o, "tacho_duty", cJSON_CreateNumber(m->tacho_duty));
 		cJSON_AddItemToObject(o, "source_type", cJSON_CreateString(tacho_source2str(m->s_type)));
 		cJSON_AddItemToObject(o, "source_id", cJSON_CreateNumber(m->s_id));
-		if (m->s_type == TACHO_MIN || m->s_type == TACHO_MAX || m->s_type == TACHO_AVG)
+		if (m->s_type == TACHO_MIN || m->s_type == TACHO_MAX || m->s_type == TACHO_AVG
+			|| m->s_type == TACHO_WORST)
 			cJSON_AddItemToObject(o, "sources", tacho_sources2json(m->sources));
+		cJSON_AddItemToObject(o, "stall_alarm", cJSON_CreateBool(m->stall_alarm));
+		cJSON_AddItemToObject(o, "hold_time", cJSON_CreateNumber(m->hold_time));
 		cJSON_AddItemToObject(o, "rpm_map", tacho_map2json(&m->map));
 		cJSON_AddItemToObject(o, "filter", filter2json(m->filter, m->filter_ctx));
 		cJSON_AddItemToArray(mbfans, o);
@@ -737,6 +928,9 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 		cJSON_AddItemToObject(o, "temp_offset", cJSON_CreateNumber(s->temp_offset));
 		cJSON_AddItemToObject(o, "temp_coefficient", cJSON_CreateNumber(s->temp_coefficient));
 		cJSON_AddItemToObject(o, "temp_map", temp_map2json(&s->map));
+		cJSON_AddItemToObject(o, "hysteresis", cJSON_CreateNumber(s->hysteresis));
+		cJSON_AddItemToObject(o, "ff_gain", cJSON_CreateNumber(s->ff_gain));
+		cJSON_AddItemToObject(o, "ff_max", cJSON_CreateNumber(s->ff_max));
 		if (s->type == TEMP_EXTERNAL) {
 			cJSON_AddItemToObject(o, "temperature_nominal",
 					cJSON_CreateNumber(s->temp_nominal));
@@ -764,6 +958,9 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 		cJSON_AddItemToObject(o, "name", cJSON_CreateString(s->name));
 		cJSON_AddItemToObject(o, "mode", cJSON_CreateString(vsmode2str(s->mode)));
 		cJSON_AddItemToObject(o, "temp_map", temp_map2json(&s->map));
+		cJSON_AddItemToObject(o, "hysteresis", cJSON_CreateNumber(s->hysteresis));
+		cJSON_AddItemToObject(o, "ff_gain", cJSON_CreateNumber(s->ff_gain));
+		cJSON_AddItemToObject(o, "ff_max", cJSON_CreateNumber(s->ff_max));
 		if (s->mode == VSMODE_MANUAL) {
 			cJSON_AddItemToObject(o, "default_temp", cJSON_CreateNumber(s->default_temp));
 			cJSON_AddItemToObject(o, "timeout", cJSON_CreateNumber(s->timeout));
@@ -786,19 +983,20 @@ panic:
 int json_to_config(cJSON *config, struct fanpico_config *cfg)
 {
 	cJSON *ref, *item, *r;
-	int id;
+	int id, type;
+	uint16_t s_id;
 	const char *name, *val;
 
 
 	if (!config || !cfg)
 		return -1;
 
-	mutex_enter_blocking(config_mutex);
+	perf_mutex_enter_blocking(config_mutex, PERF_MUTEX_CONFIG);
 
 	/* Parse JSON configuration */
 
-	if ((ref = cJSON_GetObjectItem(config, "id")))
-		log_msg(LOG_INFO, "Config version: %s", ref->valuestring);
+	if ((val = cJSON_GetStringValue(cJSON_GetObjectItem(config, "id"))))
+		log_msg(LOG_INFO, "Config version: %s", val);
 	if ((ref = cJSON_GetObjectItem(config, "debug")))
 		set_debug_level(cJSON_GetNumberValue(ref));
 	if ((ref = cJSON_GetObjectItem(config, "log_level")))
@@ -807,6 +1005,21 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 		set_syslog_level(cJSON_GetNumberValue(ref));
 	if ((ref = cJSON_GetObjectItem(config, "local_echo")))
 		cfg->local_echo = (cJSON_IsTrue(ref) ? true : false);
+	if ((ref = cJSON_GetObjectItem(config, "fast_boot")))
+		cfg->fast_boot = (cJSON_IsTrue(ref) ? true : false);
+	cfg->fan_fail_duty = json_number(config, "fan_fail_duty", 0, 100, cfg->fan_fail_duty);
+	cfg->fan_fail_boost = json_number(config, "fan_fail_boost", 0, 100, cfg->fan_fail_boost);
+	if ((ref = cJSON_GetObjectItem(config, "pwm_dither")))
+		cfg->pwm_dither = (cJSON_IsTrue(ref) ? true : false);
+	if ((ref = cJSON_GetObjectItem(config, "pwm_phase_auto")))
+		cfg->pwm_phase_auto = (cJSON_IsTrue(ref) ? true : false);
+	if ((ref = cJSON_GetObjectItem(config, "pwm_phase"))) {
+		int i = 0;
+		cJSON_ArrayForEach(item, ref) {
+			if (i < FAN_MAX_COUNT / 2)
+				cfg->pwm_phase[i++] = (int)cJSON_GetNumberValue(item) % 360;
+		}
+	}
 	if ((ref = cJSON_GetObjectItem(config, "led_mode")))
 		cfg->led_mode = cJSON_GetNumberValue(ref);
 	if ((ref = cJSON_GetObjectItem(config, "spi_active")))
@@ -1007,21 +1220,64 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 			name = cJSON_GetStringValue(cJSON_GetObjectItem(item, "name"));
 			if (name) strncopy(f->name, name ,sizeof(f->name));
 
-			f->min_pwm = cJSON_GetNumberValue(cJSON_GetObjectItem(item, "min_pwm"));
-			f->max_pwm = cJSON_GetNumberValue(cJSON_GetObjectItem(item, "max_pwm"));
-			f->pwm_coefficient = cJSON_GetNumberValue(
-				cJSON_GetObjectItem(item,"pwm_coefficient"));
-			f->s_type = str2pwm_source(cJSON_GetStringValue(
+			f->min_pwm = json_number(item, "min_pwm", 0, 100, f->min_pwm);
+			f->max_pwm = json_number(item, "max_pwm", 0, 100, f->max_pwm);
+			f->pwm_coefficient = json_number(item, "pwm_coefficient",
+							-FLT_MAX, FLT_MAX, f->pwm_coefficient);
+			type = str2pwm_source(cJSON_GetStringValue(
 							cJSON_GetObjectItem(item, "source_type")));
-			f->s_id = cJSON_GetNumberValue(cJSON_GetObjectItem(item, "source_id"));
+			s_id = json_number(item, "source_id", 0, UINT16_MAX, UINT16_MAX);
+			if (valid_pwm_source_ref(type, s_id)) {
+				f->s_type = type;
+				f->s_id = s_id;
+			} else {
+				log_msg(LOG_WARNING, "fan%d: invalid source: %s,%u",
+					id + 1, pwm_source2str(type), s_id);
+			}
 			if ((r = cJSON_GetObjectItem(item, "pwm_map")))
 				json2pwm_map(r, &f->map);
-			f->rpm_factor = cJSON_GetNumberValue(cJSON_GetObjectItem(item,"rpm_factor"));
+			f->rpm_factor = json_number(item, "rpm_factor", 1, 8, f->rpm_factor);
+			f->zone = json_number(item, "zone", -1, ZONE_COUNT - 1, f->zone);
+			f->offset = json_number(item, "offset", -100, 100, f->offset);
+			f->slew_up = json_number(item, "slew_up", 0, 1000, f->slew_up);
+			f->slew_down = json_number(item, "slew_down", 0, 1000, f->slew_down);
+			f->min_dwell = json_number(item, "min_dwell", 0, 3600, f->min_dwell);
+			f->kick_duty = json_number(item, "kick_duty", 0, 100, f->kick_duty);
+			f->kick_time = json_number(item, "kick_time",
+						FAN_KICK_MIN_TIME, 60000, f->kick_time);
+			f->kick_retry = json_number(item, "kick_retry", 1, 3600, f->kick_retry);
+			if ((r = cJSON_GetObjectItem(item, "calibration")))
+				json2fan_cal(r, &f->cal);
 			if ((r = cJSON_GetObjectItem(item, "filter")))
 				json2filter(r, &f->filter, &f->filter_ctx);
 		}
 	}
 
+	/* Fan zone configurations */
+	ref = cJSON_GetObjectItem(config, "zones");
+	cJSON_ArrayForEach(item, ref) {
+		id = (int)cJSON_GetNumberValue(cJSON_GetObjectItem(item, "id"));
+		if (id >= 0 && id < ZONE_COUNT) {
+			struct fan_zone *z = &cfg->zones[id];
+
+			name = cJSON_GetStringValue(cJSON_GetObjectItem(item, "name"));
+			if (name) strncopy(z->name, name ,sizeof(z->name));
+
+			type = str2pwm_source(cJSON_GetStringValue(
+							cJSON_GetObjectItem(item, "source_type")));
+			s_id = json_number(item, "source_id", 0, UINT16_MAX, UINT16_MAX);
+			if (type != PWM_FAN && valid_pwm_source_ref(type, s_id)) {
+				z->s_type = type;
+				z->s_id = s_id;
+			} else {
+				log_msg(LOG_WARNING, "zone%d: invalid source: %s,%u",
+					id + 1, pwm_source2str(type), s_id);
+			}
+			if ((r = cJSON_GetObjectItem(item, "filter")))
+				json2filter(r, &z->filter, &z->filter_ctx);
+		}
+	}
+
 	/* MB Fan input configurations */
 	ref = cJSON_GetObjectItem(config, "mbfans");
 	cJSON_ArrayForEach(item, ref) {
@@ -1032,16 +1288,27 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 			name = cJSON_GetStringValue(cJSON_GetObjectItem(item, "name"));
 			if (name) strncopy(m->name, name ,sizeof(m->name));
 
-			m->min_rpm = cJSON_GetNumberValue(cJSON_GetObjectItem(item, "min_rpm"));
-			m->max_rpm = cJSON_GetNumberValue(cJSON_GetObjectItem(item, "max_rpm"));
-			m->rpm_coefficient = cJSON_GetNumberValue(
-				cJSON_GetObjectItem(item, "rpm_coefficient"));
-			m->rpm_factor = cJSON_GetNumberValue(cJSON_GetObjectItem(item,"rpm_factor"));
-			m->s_type = str2tacho_source(cJSON_GetStringValue(
+			m->min_rpm = json_number(item, "min_rpm", 0, 50000, m->min_rpm);
+			m->max_rpm = json_number(item, "max_rpm", 0, 50000, m->max_rpm);
+			m->rpm_coefficient = json_number(item, "rpm_coefficient",
+							-FLT_MAX, FLT_MAX, m->rpm_coefficient);
+			m->rpm_factor = json_number(item, "rpm_factor", 1, 8, m->rpm_factor);
+			m->tacho_duty = json_number(item, "tacho_duty", 1, 99, m->tacho_duty);
+			type = str2tacho_source(cJSON_GetStringValue(
 							cJSON_GetObjectItem(item, "source_type")));
-			m->s_id = cJSON_GetNumberValue(cJSON_GetObjectItem(item, "source_id"));
+			s_id = json_number(item, "source_id", 0, UINT16_MAX, UINT16_MAX);
+			if (valid_tacho_source_ref(type, s_id)) {
+				m->s_type = type;
+				m->s_id = s_id;
+			} else {
+				log_msg(LOG_WARNING, "mbfan%d: invalid source: %s,%u",
+					id + 1, tacho_source2str(type), s_id);
+			}
 			if ((r = cJSON_GetObjectItem(item, "sources")))
 				json2tacho_sources(r, m->sources);
+			if ((r = cJSON_GetObjectItem(item, "stall_alarm")))
+				m->stall_alarm = (cJSON_IsTrue(r) ? true : false);
+			m->hold_time = json_number(item, "hold_time", 0, 60000, m->hold_time);
 			if ((r = cJSON_GetObjectItem(item, "rpm_map")))
 				json2tacho_map(r, &m->map);
 			if ((r = cJSON_GetObjectItem(item, "filter")))
@@ -1059,21 +1326,25 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 			name = cJSON_GetStringValue(cJSON_GetObjectItem(item, "name"));
 			if (name) strncopy(s->name, name ,sizeof(s->name));
 
-			s->type = cJSON_GetNumberValue(cJSON_GetObjectItem(item, "sensor_type"));
+			s->type = json_number(item, "sensor_type",
+					TEMP_INTERNAL, TEMP_EXTERNAL, s->type);
 			if (s->type == TEMP_EXTERNAL) {
-				s->temp_nominal = cJSON_GetNumberValue(
-					cJSON_GetObjectItem(item, "temperature_nominal"));
-				s->thermistor_nominal = cJSON_GetNumberValue(
-					cJSON_GetObjectItem(item, "thermistor_nominal"));
-				s->beta_coefficient = cJSON_GetNumberValue(
-					cJSON_GetObjectItem(item, "beta_coefficient"));
+				s->temp_nominal = json_number(item, "temperature_nominal",
+							-273.15, FLT_MAX, s->temp_nominal);
+				s->thermistor_nominal = json_number(item, "thermistor_nominal",
+							FLT_MIN, FLT_MAX, s->thermistor_nominal);
+				s->beta_coefficient = json_number(item, "beta_coefficient",
+							FLT_MIN, FLT_MAX, s->beta_coefficient);
 			}
-			s->temp_offset = cJSON_GetNumberValue(
-				cJSON_GetObjectItem(item, "temp_offset"));
-			s->temp_coefficient = cJSON_GetNumberValue(
-				cJSON_GetObjectItem(item, "temp_coefficient"));
+			s->temp_offset = json_number(item, "temp_offset",
+						-FLT_MAX, FLT_MAX, s->temp_offset);
+			s->temp_coefficient = json_number(item, "temp_coefficient",
+						-FLT_MAX, FLT_MAX, s->temp_coefficient);
 			if ((r = cJSON_GetObjectItem(item, "temp_map")))
 				json2temp_map(r, &s->map);
+			s->hysteresis = json_number(item, "hysteresis", 0, 100, s->hysteresis);
+			s->ff_gain = json_number(item, "ff_gain", 0, 100, s->ff_gain);
+			s->ff_max = json_number(item, "ff_max", 0, 100, s->ff_max);
 			if ((r = cJSON_GetObjectItem(item, "filter")))
 				json2filter(r, &s->filter, &s->filter_ctx);
 		}
@@ -1101,6 +1372,9 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 			}
 			if ((r = cJSON_GetObjectItem(item, "temp_map")))
 				json2temp_map(r, &s->map);
+			s->hysteresis = json_number(item, "hysteresis", 0, 100, s->hysteresis);
+			s->ff_gain = json_number(item, "ff_gain", 0, 100, s->ff_gain);
+			s->ff_max = json_number(item, "ff_max", 0, 100, s->ff_max);
 			if ((r = cJSON_GetObjectItem(item, "filter")))
 				json2filter(r, &s->filter, &s->filter_ctx);
 		}
@@ -1111,18 +1385,44 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 }
 
 
-void read_config()
+/* Release signal filter contexts from previously read configuration. */
+static void free_filter_contexts(struct fanpico_config *config)
+{
+	for (int i = 0; i < SENSOR_MAX_COUNT; i++)
+		mem_free(MEM_FILTERS, config->sensors[i].filter_ctx);
+	for (int i = 0; i < VSENSOR_MAX_COUNT; i++)
+		mem_free(MEM_FILTERS, config->vsensors[i].filter_ctx);
+	for (int i = 0; i < FAN_MAX_COUNT; i++)
+		mem_free(MEM_FILTERS, config->fans[i].filter_ctx);
+	for (int i = 0; i < ZONE_MAX_COUNT; i++)
+		mem_free(MEM_FILTERS, config->zones[i].filter_ctx);
+	for (int i = 0; i < MBFAN_MAX_COUNT; i++)
+		mem_free(MEM_FILTERS, config->mbfans[i].filter_ctx);
+}
+
+
+/* Read configuration from flash (or use default configuration).
+ * Returns 0 if saved configuration was used, 1 if default configuration
+ * was used, and negative value if there was an error.
+ */
+int read_config()
 {
 	const char *default_config = fanpico_default_config;
 	uint32_t default_config_size = strlen(default_config);
 	cJSON *config = NULL;
-	int res;
+	int res, ret = 0;
 	uint32_t file_size;
 	char  *buf = NULL;
+	enum mem_subsystems owner;
 
 
 	log_msg(LOG_INFO, "Reading configuration...");
 
+	/* Parse configuration using config arena, so that the parse tree
+	   can be released in one step. */
+	owner = mem_set_owner(MEM_CONFIG);
+	mem_arena_claim(MEM_CONFIG);
+
 	res = flash_read_file(&buf, &file_size, "fanpico.cfg");
 	if (res == 0 && buf != NULL) {
 		/* parse saved config... */
@@ -1131,12 +1431,15 @@ void read_config()
 			const char *error_str = cJSON_GetErrorPtr();
 			log_msg(LOG_ERR, "Failed to parse saved config: %s",
 				(error_str ? error_str : "") );
+			ret = -1;
 		}
 		free(buf);
 	}
 
 	if (!config) {
 		log_msg(LOG_NOTICE, "Using default configuration...");
+		if (ret == 0)
+			ret = 1;
 		log_msg(LOG_DEBUG, "config size = %lu", default_config_size);
 		/* printf("default config:\n---\n%s\n---\n", default_config); */
 		config = cJSON_Parse(fanpico_default_config);
@@ -1149,12 +1452,18 @@ void read_config()
 
 
         /* Parse JSON configuration */
+	free_filter_contexts(&fanpico_config);
 	clear_config(&fanpico_config);
 	if (json_to_config(config, &fanpico_config) < 0) {
 		log_msg(LOG_ERR, "Error parsing JSON configuration");
+		ret = -2;
 	}
 
 	cJSON_Delete(config);
+	mem_arena_release(MEM_CONFIG);
+	mem_set_owner(owner);
+
+	return ret;
 }
 
 
@@ -1162,24 +1471,31 @@ void save_config()
 {
 	cJSON *config;
 	char *str;
+	enum mem_subsystems owner;
 
 	log_msg(LOG_NOTICE, "Saving configuration...");
 
+	owner = mem_set_owner(MEM_CONFIG);
+	mem_arena_claim(MEM_CONFIG);
 	config = config_to_json(cfg);
 	if (!config) {
 		log_msg(LOG_ALERT, "Out of memory!");
-		return;
+		goto done;
 	}
 
-	if ((str = cJSON_Print(config)) == NULL) {
+	if ((str = mem_json_print(config)) == NULL) {
 		log_msg(LOG_ERR, "Failed to generate JSON output");
 	} else {
 		uint32_t config_size = strlen(str) + 1;
 		flash_write_file(str, config_size, "fanpico.cfg");
-		free(str);
+		cJSON_free(str);
 	}
 
 	cJSON_Delete(config);
+
+done:
+	mem_arena_release(MEM_CONFIG);
+	mem_set_owner(owner);
 }
 
 
@@ -1187,21 +1503,28 @@ void print_config()
 {
 	cJSON *config;
 	char *str;
+	enum mem_subsystems owner;
 
+	owner = mem_set_owner(MEM_CONFIG);
+	mem_arena_claim(MEM_CONFIG);
 	config = config_to_json(cfg);
 	if (!config) {
 		log_msg(LOG_ALERT, "Out of memory");
-		return;
+		goto done;
 	}
 
-	if ((str = cJSON_Print(config)) == NULL) {
+	if ((str = mem_json_print(config)) == NULL) {
 		log_msg(LOG_ERR, "Failed to generate JSON output");
 	} else {
 		printf("Current Configuration:\n%s\n---\n", str);
-		free(str);
+		cJSON_free(str);
 	}
 
 	cJSON_Delete(config);
+
+done:
+	mem_arena_release(MEM_CONFIG);
+	mem_set_owner(owner);
 }
 
 
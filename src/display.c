@@ -21,11 +21,39 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "pico/stdlib.h"
 
 #include "fanpico.h"
 
 
+struct display_stats display_stats;
+static bool frame_active = false;
+static uint32_t frame_time = 0;
+static uint64_t frame_start_bytes = 0;
+
+
+static void update_stats(absolute_time_t t_start)
+{
+	uint32_t t = absolute_time_diff_us(t_start, get_absolute_time());
+
+	display_stats.busy_time += t;
+	if (t > display_stats.max_call_time)
+		display_stats.max_call_time = t;
+	frame_time += t;
+}
+
+static void frame_done()
+{
+	frame_active = false;
+	display_stats.frames++;
+	display_stats.last_frame_time = frame_time;
+	display_stats.last_frame_bytes = display_stats.bytes - frame_start_bytes;
+	if (frame_time > display_stats.max_frame_time)
+		display_stats.max_frame_time = frame_time;
+}
+
+
 void display_init()
 {
 #if OLED_DISPLAY || LCD_DISPLAY
@@ -57,6 +85,14 @@ void clear_display()
 void display_status(const struct fanpico_state *state,
 	const struct fanpico_config *config)
 {
+	absolute_time_t t_start = get_absolute_time();
+
+	if (frame_active)
+		frame_done();
+	frame_time = 0;
+	frame_start_bytes = display_stats.bytes;
+	frame_active = true;
+
 #if LCD_DISPLAY
 	if (cfg->spi_active)
 		lcd_display_status(state, config);
@@ -65,6 +101,55 @@ void display_status(const struct fanpico_state *state,
 	if (!cfg->spi_active)
 		oled_display_status(state, config);
 #endif
+
+	update_stats(t_start);
+}
+
+/* Draw (part of) current frame. Returns non-zero if frame is not yet complete. */
+int display_poll()
+{
+	absolute_time_t t_start;
+	int pending = 0;
+
+	if (!frame_active)
+		return 0;
+
+	t_start = get_absolute_time();
+#if LCD_DISPLAY
+	if (cfg->spi_active)
+		pending = lcd_display_poll();
+#endif
+	update_stats(t_start);
+
+	if (!pending)
+		frame_done();
+
+	return pending;
+}
+
+void display_reset_stats()
+{
+	memset(&display_stats, 0, sizeof(display_stats));
+	frame_start_bytes = 0;
+}
+
+void display_print_stats()
+{
+	const struct display_stats *s = &display_stats;
+
+	printf("Frames:            %lu\n", s->frames);
+	printf("Fields drawn:      %lu\n", s->draw_ops);
+	printf("Fields skipped:    %lu\n", s->skipped_ops);
+	printf("Bytes sent:        %llu\n", s->bytes);
+	printf("Avg bytes/frame:   %llu\n",
+		(s->frames > 0 ? s->bytes / s->frames : 0));
+	printf("Last frame bytes:  %lu\n", s->last_frame_bytes);
+	printf("Total busy time:   %llu us\n", s->busy_time);
+	printf("Avg frame time:    %llu us\n",
+		(s->frames > 0 ? s->busy_time / s->frames : 0));
+	printf("Last frame time:   %lu us\n", s->last_frame_time);
+	printf("Max frame time:    %lu us\n", s->max_frame_time);
+	printf("Max blocking time: %lu us\n", s->max_call_time);
 }
 
 void display_message(int rows, const char **text_lines)
@@ -81,6 +81,7 @@ enum display_data_types {
 	PWM,
 	TEMP,
 	OTHER,
+	TREND,
 	DISPLAY_DATA_TYPE_COUNT
 };
 
@@ -93,6 +94,12 @@ typedef struct display_field {
 	uint16_t fg;
 	uint16_t bg;
 	int font;
+	/* TREND fields only: size of the graph and range of values
+	   (RPM for fans, C for sensors) shown in the graph */
+	int width;
+	int height;
+	int min;
+	int max;
 } display_field_t;
 
 struct display_theme {
@@ -107,6 +114,7 @@ struct display_theme {
 	uint8_t sensor_name_len;
 	const char* vsensor_name_fmt;
 	uint8_t vsensor_name_len;
+	uint16_t trend_span; /* time span of TREND graphs (seconds) */
 };
 
 struct display_theme_entry {
@@ -159,6 +167,61 @@ const display_logo_t* logos[] = {
 const struct display_theme *theme = NULL;
 
 
+/* Foreground fields are not drawn directly from lcd_display_status(),
+ * instead only fields that have changed are marked "dirty" and then
+ * lcd_display_poll() draws these few at a time. This way core0 main loop
+ * (network, console) is not blocked for the duration of the whole
+ * screen update.
+ */
+#define LCD_POLL_BUDGET_US 1000  /* max time to spend drawing per poll */
+
+/* Font dimensions (in pixels) for estimating amount of pixel data sent. */
+static const uint8_t font_sizes[][2] = {
+	[FONT_6x8] = { 6, 8 },
+	[FONT_8x8] = { 8, 8 },
+	[FONT_12x16] = { 12, 16 },
+	[FONT_16x16] = { 16, 16 },
+	[FONT_16x32] = { 16, 32 },
+};
+
+struct lcd_field_state {
+	char text[64];
+	bool dirty;
+};
+
+static struct lcd_field_state *fg_fields = NULL;
+static int fg_field_count = 0;
+static int fg_dirty_count = 0;
+static int fg_pos = 0;
+
+
+/* TREND fields are drawn one column at a time: each new sample is drawn
+ * in the column following the previous sample (wrapping around at the end
+ * of the graph) and the next column is cleared to mark current position.
+ * Full redraw of a graph is also done in slices (redraw_col tracks progress),
+ * within the same per poll time budget as the other fields.
+ */
+#define TREND_DEFAULT_SPAN 600  /* default time span of graphs (seconds) */
+
+struct lcd_trend {
+	const display_field_t *f;
+	int16_t *samples;    /* ring buffer of samples (RPM or 0.1C units) */
+	uint16_t count;      /* number of samples in buffer */
+	uint16_t pos;        /* column where next sample goes */
+	int32_t sum;         /* sum of readings for next sample */
+	uint16_t sum_count;  /* number of readings in 'sum' */
+	uint32_t interval;   /* sample interval (ms) */
+	absolute_time_t t_sample;
+	bool pending;        /* new sample waiting to be drawn */
+	bool redraw;         /* whole graph needs to be redrawn */
+	uint16_t redraw_col; /* next column to draw (during redraw) */
+};
+
+static struct lcd_trend *trends = NULL;
+static int trend_count = 0;
+static bool bg_drawn = false;
+
+
 const uint8_t waveshare35a[] = {
 	1, 0x01,
 	LCD_DELAY, 50,
@@ -401,6 +464,47 @@ void lcd_display_init()
 	}
 	theme = (lcd.iCurrentWidth >= 480 ? themes[theme_idx].theme_normal : themes[theme_idx].theme_small);
 	log_msg(LOG_INFO, "LCD theme: %s", themes[theme_idx].name);
+
+	/* Allocate buffer for tracking changes in foreground fields... */
+	fg_field_count = 0;
+	while (theme->fg[fg_field_count].type > INVALID_FIELDTYPE
+		&& theme->fg[fg_field_count].type < DISPLAY_FIELD_TYPE_COUNT)
+		fg_field_count++;
+	fg_fields = calloc(fg_field_count, sizeof(struct lcd_field_state));
+	if (!fg_fields) {
+		log_msg(LOG_ERR, "Not enough memory for LCD field buffer.");
+		fg_field_count = 0;
+	}
+
+	/* Allocate sample buffers for trend graphs... */
+	trend_count = 0;
+	for (int i = 0; i < fg_field_count; i++) {
+		if (theme->fg[i].data == TREND)
+			trend_count++;
+	}
+	if (trend_count > 0) {
+		trends = calloc(trend_count, sizeof(struct lcd_trend));
+		if (!trends)
+			trend_count = 0;
+	}
+	for (int i = 0, j = 0; i < fg_field_count && j < trend_count; i++) {
+		const display_field_t *f = &theme->fg[i];
+		struct lcd_trend *t = &trends[j];
+		uint16_t span = (theme->trend_span > 0 ? theme->trend_span : TREND_DEFAULT_SPAN);
+
+		if (f->data != TREND)
+			continue;
+		t->f = f;
+		if (f->width > 1 && f->height > 1)
+			t->samples = calloc(f->width, sizeof(int16_t));
+		if (!t->samples) {
+			log_msg(LOG_ERR, "Not enough memory for LCD trend buffer.");
+			t->f = NULL;
+		}
+		t->interval = span * 1000 / (f->width > 1 ? f->width : 1);
+		t->t_sample = get_absolute_time();
+		j++;
+	}
 }
 
 void lcd_clear_display()
@@ -409,150 +513,173 @@ void lcd_clear_display()
 		return;
 
 	spilcdFill(&lcd, 0, DRAW_TO_LCD);
+
+	/* Screen is now blank, so background and all fields need to be
+	   redrawn (on next call to lcd_display_status())... */
+	bg_drawn = false;
+	for (int i = 0; i < fg_field_count; i++) {
+		fg_fields[i].text[0] = 0;
+		fg_fields[i].dirty = false;
+	}
+	fg_dirty_count = 0;
+	for (int i = 0; i < trend_count; i++) {
+		trends[i].pending = false;
+		trends[i].redraw = true;
+		trends[i].redraw_col = 0;
+	}
 }
 
-void draw_fields(const struct fanpico_state *state, const struct fanpico_config *conf, const struct display_theme *theme, int mode)
+static void format_field(char *buf, size_t size, const display_field_t *f,
+			const struct fanpico_state *state, const struct fanpico_config *conf)
 {
-	int i = 0;
-	char buf[64];
 	double val;
 	datetime_t t;
-	const display_field_t *list;
 
-	list = (mode ? theme->fg : theme->bg);
+	buf[0] = 0;
+	switch (f->data) {
 
+	case LABEL:
+		switch (f->type) {
 
-	while (list[i].type > INVALID_FIELDTYPE && list[i].type < DISPLAY_FIELD_TYPE_COUNT) {
-		const display_field_t *f = &list[i];
-
-		buf[0] = 0;
-		switch (f->data) {
+		case FAN:
+			snprintf(buf, theme->fan_name_len + 1, theme->fan_name_fmt,
+				conf->fans[f->id].name);
+			break;
 
-		case LABEL:
-			switch (f->type) {
+		case MBFAN:
+			snprintf(buf, theme->mbfan_name_len + 1, theme->mbfan_name_fmt,
+				conf->mbfans[f->id].name);
+			break;
 
-			case FAN:
-				snprintf(buf, theme->fan_name_len + 1, theme->fan_name_fmt,
-					conf->fans[f->id].name);
-				break;
+		case SENSOR:
+			snprintf(buf, theme->sensor_name_len + 1, theme->sensor_name_fmt,
+				conf->sensors[f->id].name);
+			break;
 
-			case MBFAN:
-				snprintf(buf, theme->mbfan_name_len + 1, theme->mbfan_name_fmt,
-					conf->mbfans[f->id].name);
-				break;
+		case VSENSOR:
+			snprintf(buf, theme->vsensor_name_len + 1, theme->vsensor_name_fmt,
+				conf->vsensors[f->id].name);
+			break;
 
-			case SENSOR:
-				snprintf(buf, theme->sensor_name_len + 1, theme->sensor_name_fmt,
-					conf->sensors[f->id].name);
-				break;
+		case MODEL_VERSION:
+			snprintf(buf, size, "%s",
+				"FanPico-" FANPICO_MODEL " v" FANPICO_VERSION);
+			break;
 
-			case VSENSOR:
-				snprintf(buf, theme->vsensor_name_len + 1, theme->vsensor_name_fmt,
-					conf->vsensors[f->id].name);
-				break;
+		default:
+			break;
+		}
+		break;
 
-			case MODEL_VERSION:
-				snprintf(buf, sizeof(buf), "%s",
-					"FanPico-" FANPICO_MODEL " v" FANPICO_VERSION);
-				break;
+	case RPM:
+		switch (f->type) {
 
-			default:
-				break;
-			}
+		case FAN:
+			val = state->fan_freq[f->id] * 60 / conf->fans[f->id].rpm_factor;
 			break;
 
-		case RPM:
-			switch (f->type) {
+		case MBFAN:
+			val = state->mbfan_freq[f->id] * 60 / conf->mbfans[f->id].rpm_factor;
+			break;
 
-			case FAN:
-				val = state->fan_freq[f->id] * 60 / conf->fans[f->id].rpm_factor;
-				break;
+		default:
+			val = 0.0;
+		}
+		float_to_str(buf, 5, val, 4, 0);
+		break;
 
-			case MBFAN:
-				val = state->mbfan_freq[f->id] * 60 / conf->mbfans[f->id].rpm_factor;
-				break;
+	case PWM:
+		switch (f->type) {
+		case FAN:
+			val = state->fan_duty[f->id];
+			break;
+		case MBFAN:
+			val = state->mbfan_duty[f->id];
+			break;
+		default:
+			val = 0.0;
+		}
+		float_to_str(buf, 4, val, 3, 0);
+		break;
 
-			default:
-				val = 0.0;
+	case TEMP:
+		switch (f->type) {
+		case SENSOR:
+			val = state->temp[f->id];
+			break;
+		case VSENSOR:
+			val = state->vtemp[f->id];
+			break;
+		default:
+			val = 0.0;
+		}
+		float_to_str(buf, 5, val, 2, 1);
+		break;
+
+	case OTHER:
+		switch (f->type) {
+		case IP:
+			{
+				const char *ip = network_ip();
+				snprintf(buf, 16, "%15s", (ip ? ip : ""));
 			}
-			snprintf(buf, 5, "%4.0lf", val);
 			break;
-
-		case PWM:
-			switch (f->type) {
-			case FAN:
-				val = state->fan_duty[f->id];
-				break;
-			case MBFAN:
-				val = state->mbfan_duty[f->id];
-				break;
-			default:
-				val = 0.0;
+		case DATE_TIME:
+			if (rtc_get_datetime(&t)) {
+				snprintf(buf, size, "%04d-%02d-%02d %02d:%02d:%02d",
+					t.year, t.month, t.day, t.hour, t.min, t.sec);
 			}
-			snprintf(buf, 4, "%3.0lf", val);
 			break;
-
-		case TEMP:
-			switch (f->type) {
-			case SENSOR:
-				val = state->temp[f->id];
-				break;
-			case VSENSOR:
-				val = state->vtemp[f->id];
-				break;
-			default:
-				val = 0.0;
+		case DATE:
+			if (rtc_get_datetime(&t)) {
+				snprintf(buf, size, "%04d-%02d-%02d",
+					t.year, t.month, t.day);
 			}
-			snprintf(buf, 5, "%2.1lf", val);
 			break;
-
-		case OTHER:
-			switch (f->type) {
-			case IP:
-				snprintf(buf, 16, "%15s", network_ip());
-				break;
-			case DATE_TIME:
-				if (rtc_get_datetime(&t)) {
-					snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d",
-						t.year, t.month, t.day, t.hour, t.min, t.sec);
-				}
-				break;
-			case DATE:
-				if (rtc_get_datetime(&t)) {
-					snprintf(buf, sizeof(buf), "%04d-%02d-%02d",
-						t.year, t.month, t.day);
-				}
-				break;
-			case TIME:
-				if (rtc_get_datetime(&t)) {
-					snprintf(buf, sizeof(buf), "%02d:%02d:%02d",
-						t.hour, t.min, t.sec);
-				}
-				break;
-			case UPTIME:
-			        {
-					uint32_t secs = to_us_since_boot(get_absolute_time()) / 1000000;
-					uint32_t mins =  secs / 60;
-					uint32_t hours = mins / 60;
-					uint32_t days = hours / 24;
-
-					snprintf(buf, 13, "%03lu+%02lu:%02lu:%02lu",
-						days % 1000,
-						hours % 24,
-						mins % 60,
-						secs % 60);
-			        }
-				break;
-
-			default:
-				break;
+		case TIME:
+			if (rtc_get_datetime(&t)) {
+				snprintf(buf, size, "%02d:%02d:%02d",
+					t.hour, t.min, t.sec);
 			}
 			break;
+		case UPTIME:
+		        {
+				uint32_t secs = to_us_since_boot(get_absolute_time()) / 1000000;
+				uint32_t mins =  secs / 60;
+				uint32_t hours = mins / 60;
+				uint32_t days = hours / 24;
+
+				snprintf(buf, 13, "%03lu+%02lu:%02lu:%02lu",
+					days % 1000,
+					hours % 24,
+					mins % 60,
+					secs % 60);
+		        }
+			break;
 
 		default:
-			buf[0] = 0;
+			break;
 		}
+		break;
+
+	default:
+		buf[0] = 0;
+	}
+}
 
+void draw_fields(const struct fanpico_state *state, const struct fanpico_config *conf, const struct display_theme *theme, int mode)
+{
+	int i = 0;
+	char buf[64];
+	const display_field_t *list;
+
+	list = (mode ? theme->fg : theme->bg);
+
+
+	while (list[i].type > INVALID_FIELDTYPE && list[i].type < DISPLAY_FIELD_TYPE_COUNT) {
+		const display_field_t *f = &list[i];
+
+		format_field(buf, sizeof(buf), f, state, conf);
 		if (strlen(buf) > 0)
 			spilcdWriteString(&lcd, f->x, f->y, buf, f->fg, f->bg, f->font, DRAW_TO_LCD);
 
@@ -560,18 +687,221 @@ void draw_fields(const struct fanpico_state *state, const struct fanpico_config
 	}
 }
 
-void lcd_display_status(const struct fanpico_state *state,
-	const struct fanpico_config *conf)
+static void update_fields(const struct fanpico_state *state, const struct fanpico_config *conf)
+{
+	char buf[sizeof(fg_fields[0].text)];
+
+	for (int i = 0; i < fg_field_count; i++) {
+		struct lcd_field_state *fs = &fg_fields[i];
+
+		if (theme->fg[i].data == TREND)
+			continue;
+		format_field(buf, sizeof(buf), &theme->fg[i], state, conf);
+		if (!strcmp(buf, fs->text)) {
+			if (!fs->dirty)
+				display_stats.skipped_ops++;
+			continue;
+		}
+		strncopy(fs->text, buf, sizeof(fs->text));
+		if (!fs->dirty) {
+			fs->dirty = true;
+			fg_dirty_count++;
+		}
+	}
+}
+
+static int16_t trend_value(const display_field_t *f, const struct fanpico_state *state,
+			const struct fanpico_config *conf)
+{
+	double val;
+
+	switch (f->type) {
+	case FAN:
+		val = state->fan_freq[f->id] * 60 / conf->fans[f->id].rpm_factor;
+		break;
+	case MBFAN:
+		val = state->mbfan_freq[f->id] * 60 / conf->mbfans[f->id].rpm_factor;
+		break;
+	case SENSOR:
+		val = state->temp[f->id] * 10;
+		break;
+	case VSENSOR:
+		val = state->vtemp[f->id] * 10;
+		break;
+	default:
+		val = 0.0;
+	}
+
+	return clamp_int(round(val), INT16_MIN, INT16_MAX);
+}
+
+static int trend_y(const display_field_t *f, int16_t val)
+{
+	int scale = (f->type == SENSOR || f->type == VSENSOR ? 10 : 1);
+	int range = (f->max - f->min) * scale;
+	int y = 0;
+
+	if (range > 0)
+		y = clamp_int((val - f->min * scale) * (f->height - 1) / range,
+			0, f->height - 1);
+
+	return f->y + f->height - 1 - y;
+}
+
+static void draw_trend_column(const struct lcd_trend *t, int col)
+{
+	const display_field_t *f = t->f;
+	int prev = (col > 0 ? col - 1 : (t->count >= f->width ? f->width - 1 : 0));
+	int y1 = trend_y(f, t->samples[col]);
+	int y2 = trend_y(f, t->samples[prev]);
+
+	if (y1 > y2) {
+		int tmp = y1;
+		y1 = y2;
+		y2 = tmp;
+	}
+	spilcdRectangle(&lcd, f->x + col, y1, 1, y2 - y1 + 1, f->fg, f->fg, 1, DRAW_TO_LCD);
+	display_stats.bytes += (y2 - y1 + 1) * 2;
+}
+
+static void clear_trend_column(const struct lcd_trend *t, int col)
+{
+	const display_field_t *f = t->f;
+
+	spilcdRectangle(&lcd, f->x + col, f->y, 1, f->height, f->bg, f->bg, 1, DRAW_TO_LCD);
+	display_stats.bytes += f->height * 2;
+}
+
+/* Draw pending changes to a trend graph. Returns false if (full) redraw
+   of the graph was not completed within time budget. */
+static bool draw_trend(struct lcd_trend *t, absolute_time_t t_start)
+{
+	const display_field_t *f = t->f;
+
+	if (t->redraw) {
+		if (t->redraw_col == 0) {
+			spilcdRectangle(&lcd, f->x, f->y, f->width, f->height, f->bg, f->bg, 1, DRAW_TO_LCD);
+			display_stats.bytes += f->width * f->height * 2;
+		}
+		while (t->redraw_col < t->count) {
+			if (t->redraw_col != t->pos)
+				draw_trend_column(t, t->redraw_col);
+			t->redraw_col++;
+			if (t->redraw_col < t->count && absolute_time_diff_us(t_start,
+						get_absolute_time()) >= LCD_POLL_BUDGET_US)
+				return false;
+		}
+		t->redraw_col = 0;
+	} else {
+		draw_trend_column(t, (t->pos > 0 ? t->pos - 1 : f->width - 1));
+		clear_trend_column(t, t->pos);
+	}
+	display_stats.draw_ops++;
+	t->redraw = false;
+	t->pending = false;
+
+	return true;
+}
+
+static void update_trends(const struct fanpico_state *state, const struct fanpico_config *conf)
+{
+	for (int i = 0; i < trend_count; i++) {
+		struct lcd_trend *t = &trends[i];
+
+		if (!t->f)
+			continue;
+
+		t->sum += trend_value(t->f, state, conf);
+		t->sum_count++;
+		if (!time_passed(&t->t_sample, t->interval))
+			continue;
+
+		t->samples[t->pos] = t->sum / t->sum_count;
+		t->sum = 0;
+		t->sum_count = 0;
+		t->pos = (t->pos + 1) % t->f->width;
+		if (t->count < t->f->width)
+			t->count++;
+		if (t->pending || t->redraw) {
+			/* (re)start full redraw, as graph has scrolled */
+			t->redraw = true;
+			t->redraw_col = 0;
+		}
+		t->pending = true;
+	}
+}
+
+static int draw_pending_trends(absolute_time_t t_start)
 {
-	static uint8_t bg_drawn = 0;
+	int count = 0;
+
+	for (int i = 0; i < trend_count; i++) {
+		struct lcd_trend *t = &trends[i];
 
+		if (t->f && (t->pending || t->redraw)) {
+			count++;
+			if (!draw_trend(t, t_start))
+				break;
+			if (absolute_time_diff_us(t_start, get_absolute_time()) >= LCD_POLL_BUDGET_US)
+				break;
+		}
+	}
 
+	return count;
+}
+
+int lcd_display_poll()
+{
+	absolute_time_t t_start;
+
+	if (!lcd_found || !bg_drawn)
+		return 0;
+
+	t_start = get_absolute_time();
+	if (draw_pending_trends(t_start) > 0)
+		return fg_dirty_count + 1;
+
+	if (fg_dirty_count < 1)
+		return 0;
+
+	while (fg_dirty_count > 0) {
+		struct lcd_field_state *fs = &fg_fields[fg_pos];
+		const display_field_t *f = &theme->fg[fg_pos];
+
+		fg_pos = (fg_pos + 1) % fg_field_count;
+		if (!fs->dirty)
+			continue;
+
+		if (strlen(fs->text) > 0) {
+			spilcdWriteString(&lcd, f->x, f->y, fs->text, f->fg, f->bg, f->font, DRAW_TO_LCD);
+			display_stats.draw_ops++;
+			if (f->font >= 0 && f->font <= FONT_16x32)
+				display_stats.bytes += strlen(fs->text) * 2
+					* font_sizes[f->font][0] * font_sizes[f->font][1];
+		}
+		fs->dirty = false;
+		fg_dirty_count--;
+
+		if (absolute_time_diff_us(t_start, get_absolute_time()) >= LCD_POLL_BUDGET_US)
+			break;
+	}
+
+	return fg_dirty_count;
+}
+
+void lcd_display_status(const struct fanpico_state *state,
+	const struct fanpico_config *conf)
+{
 	if (!lcd_found || !state)
 		return;
 
 	if (!bg_drawn) {
 		/* draw background graphics only once... */
-		bg_drawn = 1;
+		bg_drawn = true;
+		for (int i = 0; i < trend_count; i++) {
+			trends[i].redraw = true;
+			trends[i].redraw_col = 0;
+		}
 		//spilcdRectangle(&lcd, 0, 0, lcd.iCurrentWidth -1, lcd.iCurrentHeight - 1, 0xffff, 0xffff, 0, DRAW_TO_LCD);
 
 		if (theme->bmp) {
@@ -589,7 +919,11 @@ void lcd_display_status(const struct fanpico_state *state,
 		}
 	}
 
-	draw_fields(state, conf, theme, 1);
+	if (fg_fields)
+		update_fields(state, conf);
+	else
+		draw_fields(state, conf, theme, 1);
+	update_trends(state, conf);
 }
 
 void lcd_display_message(int rows, const char **text_lines)
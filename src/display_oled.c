@@ -59,6 +59,22 @@ static uint8_t r_lines = 8;
 static struct layout_item r_layout[R_LAYOUT_MAX];
 
 
+/* Text currently on screen, this is used to only send changed
+ * characters to the display (instead of redrawing every row every time).
+ */
+#define OLED_TEXT_SLOTS 32
+
+struct oled_text_slot {
+	uint8_t x;
+	uint8_t y;
+	uint8_t font;
+	char text[24];
+};
+
+static struct oled_text_slot text_slots[OLED_TEXT_SLOTS];
+static uint8_t text_slot_count = 0;
+
+
 /* Default screen layouts for inputs/sensors */
 #define R_LAYOUT_128x64  "M1,M2,M3,M4,-,S1,S2,S3"
 #define R_LAYOUT_128x128 "LMB Inputs,M1,M2,M3,M4,-,LSensors,S1,S2,S3"
@@ -226,12 +242,82 @@ void oled_clear_display()
 		return;
 
 	oledFill(&oled, 0, 1);
+	text_slot_count = 0;
+}
+
+static void oled_write_text(int x, int y, const char *str, int font)
+{
+	struct oled_text_slot *slot = NULL;
+	char buf[sizeof(slot->text)];
+	int len = strlen(str);
+	int old_len, first, last;
+	uint8_t c_w, c_h;
+
+
+	switch (font) {
+	case FONT_12x16:
+		c_w = 12;
+		c_h = 2;
+		break;
+	case FONT_8x8:
+		c_w = 8;
+		c_h = 1;
+		break;
+	default:
+		c_w = 6;
+		c_h = 1;
+	}
+
+	for (int i = 0; i < text_slot_count; i++) {
+		struct oled_text_slot *ts = &text_slots[i];
+		if (ts->x == x && ts->y == y && ts->font == font) {
+			slot = ts;
+			break;
+		}
+	}
+	if (!slot && text_slot_count < OLED_TEXT_SLOTS && len < sizeof(slot->text)) {
+		slot = &text_slots[text_slot_count++];
+		slot->x = x;
+		slot->y = y;
+		slot->font = font;
+		slot->text[0] = 0;
+	}
+	if (!slot || len >= sizeof(slot->text)) {
+		/* No slot available, draw whole string... */
+		oledWriteString(&oled, 0, x, y, (char*)str, font, 0, 1);
+		display_stats.draw_ops++;
+		display_stats.bytes += len * c_w * c_h;
+		return;
+	}
+
+	/* Find range of characters that have changed... */
+	old_len = strlen(slot->text);
+	first = 0;
+	while (first < len && first < old_len && str[first] == slot->text[first])
+		first++;
+	if (first >= len) {
+		display_stats.skipped_ops++;
+		strncopy(slot->text, str, sizeof(slot->text));
+		return;
+	}
+	last = len - 1;
+	if (len == old_len) {
+		while (last > first && str[last] == slot->text[last])
+			last--;
+	}
+
+	memcpy(buf, str + first, last - first + 1);
+	buf[last - first + 1] = 0;
+	oledWriteString(&oled, 0, x + first * c_w, y, buf, font, 0, 1);
+	display_stats.draw_ops++;
+	display_stats.bytes += (last - first + 1) * c_w * c_h;
+	strncopy(slot->text, str, sizeof(slot->text));
 }
 
 void oled_display_status(const struct fanpico_state *state,
 	const struct fanpico_config *conf)
 {
-	char buf[64];
+	char buf[64], s1[16], s2[16];
 	int i;
 	double rpm, pwm, temp;
 	datetime_t t;
@@ -278,8 +364,10 @@ void oled_display_status(const struct fanpico_state *state,
 	for (i = 0; i < FAN_COUNT; i++) {
 		rpm = state->fan_freq[i] * 60 / conf->fans[i].rpm_factor;
 		pwm = state->fan_duty[i];
-		snprintf(buf, sizeof(buf), "%d:%4.0lf %3.0lf%%", i + 1, rpm, pwm);
-		oledWriteString(&oled, 0 , 0, i + fan_row_offset, buf, FONT_6x8, 0, 1);
+		snprintf(buf, sizeof(buf), "%d:%s %s%%", i + 1,
+			float_to_str(s1, sizeof(s1), rpm, 4, 0),
+			float_to_str(s2, sizeof(s2), pwm, 3, 0));
+		oled_write_text(0, i + fan_row_offset, buf, FONT_6x8);
 	}
 	for (i = 0; i < r_lines; i++) {
 		struct layout_item *l = &r_layout[i];
@@ -287,24 +375,27 @@ void oled_display_status(const struct fanpico_state *state,
 
 		if (l->type == MBFAN) {
 			pwm = state->mbfan_duty[l->idx];
-			snprintf(buf, sizeof(buf), "%d: %4.0lf%%  ", l->idx + 1, pwm);
+			snprintf(buf, sizeof(buf), "%d: %s%%  ", l->idx + 1,
+				float_to_str(s1, sizeof(s1), pwm, 4, 0));
 			write_buf = 1;
 		}
 		else if (l->type == SENSOR) {
 			temp = state->temp[l->idx];
-			snprintf(buf, sizeof(buf), "s%d:%5.1lfC", l->idx + 1, temp);
+			snprintf(buf, sizeof(buf), "s%d:%sC", l->idx + 1,
+				float_to_str(s1, sizeof(s1), temp, 5, 1));
 			write_buf = 1;
 		}
 		else if (l->type ==  VSENSOR) {
 			temp = state->vtemp[l->idx];
-			snprintf(buf, sizeof(buf), "v%d:%5.1lfC", l->idx + 1, temp);
+			snprintf(buf, sizeof(buf), "v%d:%sC", l->idx + 1,
+				float_to_str(s1, sizeof(s1), temp, 5, 1));
 			write_buf = 1;
 		}
 		if (write_buf) {
 			if (oled_height <= 64 && i == 0) {
 				buf[8] = (counter++ % 2 == 0 ? '*' : ' ');
 			}
-			oledWriteString(&oled, 0 , h_pos + 2, i, buf, FONT_6x8, 0, 1);
+			oled_write_text(h_pos + 2, i, buf, FONT_6x8);
 		}
 	}
 
@@ -319,7 +410,7 @@ void oled_display_status(const struct fanpico_state *state,
 			int offset = delta / 2;
 			memset(buf, ' ', 8);
 			snprintf(buf + offset, sizeof(buf), " %s", ip);
-			oledWriteString(&oled, 0, 10 + (delta % 2 ? 3 : 0), 15, buf, FONT_6x8, 0, 1);
+			oled_write_text(10 + (delta % 2 ? 3 : 0), 15, buf, FONT_6x8);
 		}
 
 		/* Uptime & NTP time */
@@ -333,11 +424,11 @@ void oled_display_status(const struct fanpico_state *state,
 			mins % 60,
 			secs % 60);
 		if (rtc_get_datetime(&t)) {
-			oledWriteString(&oled, 0, 28, 14, buf, FONT_6x8, 0, 1);
+			oled_write_text(28, 14, buf, FONT_6x8);
 			snprintf(buf, sizeof(buf), "%02d:%02d:%02d", t.hour, t.min, t.sec);
-			oledWriteString(&oled, 0, 16, 11, buf, FONT_12x16, 0, 1);
+			oled_write_text(16, 11, buf, FONT_12x16);
 		} else {
-			oledWriteString(&oled, 0, 28, 12, buf, FONT_6x8, 0, 1);
+			oled_write_text(28, 12, buf, FONT_6x8);
 		}
 	}
 }
@@ -0,0 +1,396 @@
+/* fancal.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Fan characterization (calibration) sweep.
+ *
+ * Sweep runs on core1 (from core1_loop()) in the background. Each fan
+ * being calibrated goes through following phases:
+ *
+ *   SWEEP  Step duty cycle from 100% down to 0% (in 10% steps), wait
+ *          for RPM to settle at each step and record RPM.
+ *   START  Starting from standstill, increase duty cycle in small steps
+ *          until fan starts spinning (minimum start duty).
+ *   STALL  Decrease duty cycle in small steps until fan stops
+ *          (lowest duty cycle fan keeps running).
+ *
+ * Fans not being calibrated are controlled normally. Results are picked
+ * up by core0 (fancal_apply_results()) and stored in the configuration,
+ * along with a linearized PWM map generated from the measured curve.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "pico/mutex.h"
+
+#include "fanpico.h"
+
+
+#define FANCAL_SAMPLE_INTERVAL  1000  /* ms between tacho samples */
+#define FANCAL_SETTLE_MIN       4000  /* minimum time at each duty step (ms) */
+#define FANCAL_SETTLE_MAX       20000 /* maximum time at each duty step (ms) */
+#define FANCAL_SETTLE_SAMPLES   3     /* stable samples needed */
+#define FANCAL_START_WAIT       5000  /* time to wait fan to start (ms) */
+#define FANCAL_FINE_STEP        2     /* duty step when searching start/stall duty */
+
+struct fan_cal_sweep {
+	enum fancal_states state;
+	bool applied;
+	uint8_t duty;
+	uint8_t point;
+	uint8_t samples;
+	float last_rpm;
+	absolute_time_t t_step;
+	absolute_time_t t_start;
+	absolute_time_t t_end;
+	struct fan_cal result;
+};
+
+static struct fan_cal_sweep sweeps[FAN_MAX_COUNT];
+static uint32_t start_mask = 0;
+static uint32_t stop_mask = 0;
+static volatile uint32_t active_mask = 0;
+static absolute_time_t t_sample;
+
+auto_init_mutex(fancal_mutex_inst);
+static mutex_t *fancal_mutex = &fancal_mutex_inst;
+
+
+const char* fancal_state2str(enum fancal_states state)
+{
+	switch (state) {
+	case FANCAL_SWEEP:
+		return "SWEEP";
+	case FANCAL_START:
+		return "START";
+	case FANCAL_STALL:
+		return "STALL";
+	case FANCAL_DONE:
+		return "DONE";
+	case FANCAL_FAILED:
+		return "FAILED";
+	case FANCAL_ABORTED:
+		return "ABORTED";
+	default:
+		break;
+	}
+	return "IDLE";
+}
+
+
+/* Request calibration to start (fan < 0 = all fans). Called from core0. */
+void fancal_start(int fan)
+{
+	uint32_t mask = (fan < 0 ? (1 << FAN_COUNT) - 1 : 1 << fan);
+
+	perf_mutex_enter_blocking(fancal_mutex, PERF_MUTEX_FANCAL);
+	start_mask |= mask;
+	stop_mask &= ~mask;
+	mutex_exit(fancal_mutex);
+}
+
+
+/* Request calibration to be aborted (fan < 0 = all fans). Called from core0. */
+void fancal_stop(int fan)
+{
+	uint32_t mask = (fan < 0 ? (1 << FAN_COUNT) - 1 : 1 << fan);
+
+	perf_mutex_enter_blocking(fancal_mutex, PERF_MUTEX_FANCAL);
+	stop_mask |= mask;
+	start_mask &= ~mask;
+	mutex_exit(fancal_mutex);
+}
+
+
+/* Get calibration status of a fan. Called from core0. */
+enum fancal_states fancal_status(int fan, uint8_t *duty, uint32_t *elapsed,
+				struct fan_cal *result)
+{
+	enum fancal_states state;
+	struct fan_cal_sweep *s = &sweeps[fan];
+
+	perf_mutex_enter_blocking(fancal_mutex, PERF_MUTEX_FANCAL);
+	state = (start_mask & (1 << fan) ? FANCAL_IDLE : s->state);
+	if (duty)
+		*duty = s->duty;
+	if (elapsed)
+		*elapsed = (state == FANCAL_IDLE ? 0 :
+			absolute_time_diff_us(s->t_start, (fancal_active(fan) ?
+						get_absolute_time() : s->t_end)) / 1000000);
+	if (result)
+		*result = s->result;
+	if (start_mask & (1 << fan))
+		state = FANCAL_SWEEP;
+	mutex_exit(fancal_mutex);
+
+	return state;
+}
+
+
+/* Return true if fan output is currently controlled by calibration sweep. */
+bool fancal_active(int fan)
+{
+	return (active_mask & (1 << fan) ? true : false);
+}
+
+
+/* Generate PWM map that makes fan RPM (roughly) linear to input duty cycle.
+ * Inputs that would result in RPM below the lowest speed fan can run at
+ * are mapped to stall duty cycle (fan will not stop).
+ */
+void fancal_build_map(const struct fan_cal *cal, struct pwm_map *map)
+{
+	float rpm[FAN_CAL_POINTS];
+	float max_rpm, target, duty;
+	int i, k, c = 0;
+
+	if (cal->points != FAN_CAL_POINTS)
+		return;
+
+	/* Force curve to be monotonic */
+	for (i = 0; i < FAN_CAL_POINTS; i++)
+		rpm[i] = (i > 0 && cal->rpm[i] < rpm[i - 1] ? rpm[i - 1] : cal->rpm[i]);
+	max_rpm = rpm[FAN_CAL_POINTS - 1];
+
+	for (i = 0; i <= 100; i += 5) {
+		target = max_rpm * i / 100.0;
+		duty = 100.0;
+		if (target <= cal->min_rpm) {
+			duty = cal->stall_duty;
+		} else {
+			for (k = 1; k < FAN_CAL_POINTS; k++) {
+				if (rpm[k] >= target) {
+					duty = FAN_CAL_STEP * (k - 1 +
+						(target - rpm[k - 1]) / (rpm[k] - rpm[k - 1]));
+					break;
+				}
+			}
+			if (duty < cal->stall_duty)
+				duty = cal->stall_duty;
+		}
+		map->pwm[c][0] = i;
+		map->pwm[c][1] = roundf(duty * 10) / 10;
+		c++;
+	}
+	map->points = c;
+}
+
+
+/* Store results of completed calibration sweeps into configuration.
+ * Called periodically from core0.
+ */
+void fancal_apply_results(struct fanpico_config *config)
+{
+	struct fan_cal_sweep *s;
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		s = &sweeps[i];
+		perf_mutex_enter_blocking(fancal_mutex, PERF_MUTEX_FANCAL);
+		if (s->state == FANCAL_DONE && !s->applied) {
+			perf_mutex_enter_blocking(config_mutex, PERF_MUTEX_CONFIG);
+			config->fans[i].cal = s->result;
+			fancal_build_map(&s->result, &config->fans[i].map);
+			mutex_exit(config_mutex);
+			s->applied = true;
+			log_msg(LOG_NOTICE, "fan%d: calibration complete: max %u RPM, stall %u%% (%u RPM), start %u%%",
+				i + 1, s->result.rpm[FAN_CAL_POINTS - 1],
+				s->result.stall_duty, s->result.min_rpm,
+				s->result.start_duty);
+		}
+		mutex_exit(fancal_mutex);
+	}
+}
+
+
+static void set_duty(struct fan_cal_sweep *s, int fan, int duty,
+		struct fanpico_state *state)
+{
+	s->duty = duty;
+	s->samples = 0;
+	s->last_rpm = -1.0;
+	s->t_step = get_absolute_time();
+	state->fan_duty[fan] = duty;
+	state->fan_duty_prev[fan] = duty;
+	set_pwm_duty_cycle(fan, duty);
+}
+
+
+static void finish(struct fan_cal_sweep *s, int fan, enum fancal_states result,
+		struct fanpico_state *state, const struct fanpico_config *config)
+{
+	s->state = result;
+	s->t_end = get_absolute_time();
+	active_mask &= ~(1 << fan);
+
+	/* Return fan to normal control */
+	state->fan_duty[fan] = calculate_pwm_duty(state, config, fan);
+	state->fan_duty_prev[fan] = state->fan_duty[fan];
+	set_pwm_duty_cycle(fan, state->fan_duty[fan]);
+
+	log_msg(LOG_INFO, "fan%d: calibration %s", fan + 1, fancal_state2str(result));
+}
+
+
+static bool settled(struct fan_cal_sweep *s, float rpm)
+{
+	int64_t t = absolute_time_diff_us(s->t_step, get_absolute_time()) / 1000;
+
+	/* With multiplexed tacho inputs, readings of each fan are not
+	   refreshed every sample period. Ignore repeated (non-zero) readings. */
+	if (rpm > 0 && rpm == s->last_rpm)
+		return (t >= FANCAL_SETTLE_MAX);
+
+	if (s->last_rpm >= 0 && fabsf(rpm - s->last_rpm) <= fmaxf(rpm * 0.02, 20.0)) {
+		s->samples++;
+	} else {
+		s->samples = 0;
+	}
+	s->last_rpm = rpm;
+
+	return ((t >= FANCAL_SETTLE_MIN && s->samples >= FANCAL_SETTLE_SAMPLES)
+		|| t >= FANCAL_SETTLE_MAX);
+}
+
+
+static void sweep_fan(int fan, struct fanpico_state *state,
+		const struct fanpico_config *config)
+{
+	struct fan_cal_sweep *s = &sweeps[fan];
+	float rpm = state->fan_freq[fan] * 60.0 / config->fans[fan].rpm_factor;
+	int64_t t = absolute_time_diff_us(s->t_step, get_absolute_time()) / 1000;
+	int i;
+
+	switch (s->state) {
+	case FANCAL_SWEEP:
+		if (!settled(s, rpm))
+			break;
+		log_msg(LOG_DEBUG, "fan%d: calibration %u%% = %.0f RPM", fan + 1, s->duty, rpm);
+		s->result.rpm[s->point] = roundf(rpm);
+		if (s->point > 0) {
+			s->point--;
+			set_duty(s, fan, s->point * FAN_CAL_STEP, state);
+			break;
+		}
+		s->result.points = FAN_CAL_POINTS;
+		if (s->result.rpm[FAN_CAL_POINTS - 1] < 1) {
+			log_msg(LOG_WARNING, "fan%d: calibration failed (no tacho signal)", fan + 1);
+			finish(s, fan, FANCAL_FAILED, state, config);
+		} else if (s->result.rpm[0] > 0) {
+			/* Fan does not stop at 0% duty cycle */
+			s->result.stall_duty = 0;
+			s->result.start_duty = 0;
+			s->result.min_rpm = s->result.rpm[0];
+			finish(s, fan, FANCAL_DONE, state, config);
+		} else {
+			/* Fan is now stopped, search for start duty starting from
+			   the highest curve point fan was not spinning... */
+			for (i = 1; i < FAN_CAL_POINTS - 1; i++) {
+				if (s->result.rpm[i] > 0)
+					break;
+			}
+			s->state = FANCAL_START;
+			set_duty(s, fan, (i - 1) * FAN_CAL_STEP + FANCAL_FINE_STEP, state);
+		}
+		break;
+
+	case FANCAL_START:
+		if (t < FANCAL_START_WAIT)
+			break;
+		if (rpm > 0) {
+			s->result.start_duty = s->duty;
+			s->result.stall_duty = s->duty;
+			s->result.min_rpm = roundf(rpm);
+			s->state = FANCAL_STALL;
+			set_duty(s, fan, s->duty, state);
+		} else if (s->duty + FANCAL_FINE_STEP > 100) {
+			log_msg(LOG_WARNING, "fan%d: calibration failed (fan did not start)", fan + 1);
+			finish(s, fan, FANCAL_FAILED, state, config);
+		} else {
+			set_duty(s, fan, s->duty + FANCAL_FINE_STEP, state);
+		}
+		break;
+
+	case FANCAL_STALL:
+		if (!settled(s, rpm))
+			break;
+		if (rpm > 0) {
+			s->result.stall_duty = s->duty;
+			s->result.min_rpm = roundf(rpm);
+			if (s->duty >= FANCAL_FINE_STEP) {
+				set_duty(s, fan, s->duty - FANCAL_FINE_STEP, state);
+				break;
+			}
+		}
+		finish(s, fan, FANCAL_DONE, state, config);
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+/* Run calibration sweeps. Called from core1 main loop. */
+void fancal_poll(struct fanpico_state *state, const struct fanpico_config *config)
+{
+	struct fan_cal_sweep *s;
+	uint32_t mask;
+
+	if (!start_mask && !stop_mask && !active_mask)
+		return;
+
+	perf_mutex_enter_blocking(fancal_mutex, PERF_MUTEX_FANCAL);
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		mask = 1 << i;
+		s = &sweeps[i];
+		if (stop_mask & mask) {
+			if (active_mask & mask)
+				finish(s, i, FANCAL_ABORTED, state, config);
+		} else if (start_mask & mask) {
+			log_msg(LOG_INFO, "fan%d: calibration started", i + 1);
+			memset(&s->result, 0, sizeof(s->result));
+			s->state = FANCAL_SWEEP;
+			s->applied = false;
+			s->point = FAN_CAL_POINTS - 1;
+			s->t_start = get_absolute_time();
+			active_mask |= mask;
+			set_duty(s, i, 100, state);
+		}
+	}
+	start_mask = 0;
+	stop_mask = 0;
+
+	if (active_mask && time_passed(&t_sample, FANCAL_SAMPLE_INTERVAL)) {
+		for (int i = 0; i < FAN_COUNT; i++) {
+			if (active_mask & (1 << i))
+				sweep_fan(i, state, config);
+		}
+	}
+
+	mutex_exit(fancal_mutex);
+}
+
+
+/* eof :-) */
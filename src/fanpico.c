@@ -59,6 +59,22 @@ auto_init_mutex(state_mutex_inst);
 mutex_t *state_mutex = &state_mutex_inst;
 bool rebooted_by_watchdog = false;
 
+#define BOOT_PHASE_MAX 12
+
+struct boot_phase {
+	const char *name;
+	uint64_t t;
+};
+
+static struct boot_phase boot_phases[BOOT_PHASE_MAX];
+static int boot_phase_count = 0;
+/* Time (us since reset) when core1 first updated outputs. This is 32bit
+   so that core0 can read it atomically (without state_mutex). */
+static volatile uint32_t boot_first_output = 0;
+static bool core1_running = false;
+
+void core1_main();
+
 
 void update_persistent_memory_crc()
 {
@@ -111,30 +127,104 @@ void update_persistent_memory()
 	mutex_exit(pmem_mutex);
 }
 
+/* Record time (since reset) when a boot phase completed. */
+static void boot_mark(const char *name)
+{
+	if (boot_phase_count >= BOOT_PHASE_MAX)
+		return;
+	boot_phases[boot_phase_count].name = name;
+	boot_phases[boot_phase_count].t = to_us_since_boot(get_absolute_time());
+	boot_phase_count++;
+}
+
+void print_boot_times()
+{
+	uint64_t prev = 0;
+	char s1[16], s2[16];
+
+	printf("Fast boot:         %s\n", (cfg->fast_boot ? "yes" : "no"));
+	for (int i = 0; i < boot_phase_count; i++) {
+		const struct boot_phase *p = &boot_phases[i];
+
+		printf("%-18s %s ms (+%s ms)\n", p->name,
+			fixed_to_str(s1, sizeof(s1), p->t, 3, 8, 1),
+			fixed_to_str(s2, sizeof(s2), p->t - prev, 3, 0, 1));
+		prev = p->t;
+	}
+	if (boot_first_output)
+		printf("%-18s %s ms\n", "first_output",
+			fixed_to_str(s1, sizeof(s1), boot_first_output, 3, 8, 1));
+}
+
 void boot_reason()
 {
 	printf("     CHIP_RESET: %08lx\n", vreg_and_chip_reset_hw->chip_reset);
 	printf("WATCHDOG_REASON: %08lx\n", watchdog_hw->reason);
 }
 
+/* Initialize I/O needed by the fan control loop (core1). */
+static void setup_control_io()
+{
+	/* Enable ADC */
+	log_msg(LOG_NOTICE, "Initialize ADC...");
+	adc_init();
+	adc_set_temp_sensor_enabled(true);
+	if (SENSOR1_READ_PIN > 0)
+		adc_gpio_init(SENSOR1_READ_PIN);
+	if (SENSOR2_READ_PIN > 0)
+		adc_gpio_init(SENSOR2_READ_PIN);
+
+	/* Setup GPIO pins... */
+	log_msg(LOG_NOTICE, "Initialize GPIO...");
+
+	/* Configure PWM pins... */
+	setup_pwm_outputs();
+	setup_pwm_inputs();
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		set_pwm_duty_cycle(i, 0);
+	}
+
+	/* Configure Tacho pins... */
+	setup_tacho_outputs();
+	setup_tacho_inputs();
+}
+
+
 void setup()
 {
 	datetime_t t;
 	char buf[32];
 	int i = 0;
+	int config_res;
 
 	rtc_init();
+	boot_mark("reset");
 
 	stdio_usb_init();
+	lfs_setup(false);
+	/* Configuration is needed to check if fast boot is enabled
+	   (log messages are lost since console is not available yet)... */
+	config_res = read_config();
+
+	if (cfg->fast_boot) {
+		boot_mark("config");
+		/* Start fan control before (potentially slow) console,
+		   display, and network initialization... */
+		setup_control_io();
+		boot_mark("control_io");
+		multicore_launch_core1(core1_main);
+		core1_running = true;
+		boot_mark("core1");
+	}
+
 	/* Wait a while for USB Serial to connect... */
 	while (i++ < 40) {
 		if (stdio_usb_connected())
 			break;
 		sleep_ms(50);
 	}
-
-	lfs_setup(false);
-	read_config();
+	boot_mark("usb");
 
 #if TTL_SERIAL
 	/* Initialize serial console if configured... */
@@ -166,6 +256,18 @@ void setup()
 	printf("\n");
 
 	log_msg(LOG_NOTICE, "System starting...");
+	if (cfg->fast_boot) {
+		/* Report result of reading configuration before console was up */
+		if (config_res < 0)
+			log_msg(LOG_ERR, "Error reading configuration (fast boot): %d", config_res);
+		else
+			log_msg(LOG_NOTICE, "Using %s configuration (fast boot)",
+				(config_res ? "default" : "saved"));
+	} else {
+		/* Read configuration again, now that console is available */
+		read_config();
+		boot_mark("config");
+	}
 	if (persistent_mem->prev_uptime) {
 		log_msg(LOG_NOTICE, "Uptime before soft reset: %llus\n",
 			persistent_mem->prev_uptime / 1000000);
@@ -175,19 +277,14 @@ void setup()
 	}
 
 	display_init();
+	boot_mark("display");
 	network_init(&system_state);
+	boot_mark("network");
 
-	/* Enable ADC */
-	log_msg(LOG_NOTICE, "Initialize ADC...");
-	adc_init();
-	adc_set_temp_sensor_enabled(true);
-	if (SENSOR1_READ_PIN > 0)
-		adc_gpio_init(SENSOR1_READ_PIN);
-	if (SENSOR2_READ_PIN > 0)
-		adc_gpio_init(SENSOR2_READ_PIN);
-
-	/* Setup GPIO pins... */
-	log_msg(LOG_NOTICE, "Initialize GPIO...");
+	if (!cfg->fast_boot) {
+		setup_control_io();
+		boot_mark("control_io");
+	}
 
 	/* Initialize status LED... */
 	if (LED_PIN > 0) {
@@ -200,18 +297,6 @@ void setup()
 	cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 0);
 #endif
 
-	/* Configure PWM pins... */
-	setup_pwm_outputs();
-	setup_pwm_inputs();
-
-	for (i = 0; i < FAN_COUNT; i++) {
-		set_pwm_duty_cycle(i, 0);
-	}
-
-	/* Configure Tacho pins... */
-	setup_tacho_outputs();
-	setup_tacho_inputs();
-
 	/* Setup timezone */
 	if (strlen(cfg->timezone) > 1) {
 		log_msg(LOG_NOTICE, "Set Timezone: %s", cfg->timezone);
@@ -219,6 +304,7 @@ void setup()
 		tzset();
 	}
 
+	boot_mark("setup");
 	log_msg(LOG_NOTICE, "System initialization complete.");
 }
 
@@ -232,20 +318,39 @@ void clear_state(struct fanpico_state *s)
 		s->mbfan_duty_prev[i] = 0.0;
 		s->mbfan_freq[i] = 0.0;
 		s->mbfan_freq_prev[i] = 0.0;
+		s->mbfan_hold_rpm[i] = 0.0;
+		s->mbfan_hold_t[i] = from_us_since_boot(0);
 	}
 	for (i = 0; i < FAN_MAX_COUNT; i++) {
 		s->fan_duty[i] = 0.0;
 		s->fan_duty_prev[i] = 0.0;
 		s->fan_freq[i] = 0.0;
 		s->fan_freq_prev[i] = 0.0;
+		s->fan_duty_slew[i] = 0.0;
+		s->fan_slew_t[i] = from_us_since_boot(0);
+		s->fan_up_t[i] = from_us_since_boot(0);
+		s->fan_failed[i] = false;
+		s->fan_fail_t[i] = from_us_since_boot(0);
+		s->fan_start_state[i] = FAN_START_IDLE;
+		s->fan_start_t[i] = from_us_since_boot(0);
+		s->fan_stalls[i] = 0;
+	}
+	for (i = 0; i < ZONE_MAX_COUNT; i++) {
+		s->zone_duty[i] = 0.0;
 	}
 	for (i = 0; i < SENSOR_MAX_COUNT; i++) {
 		s->temp[i] = 0.0;
 		s->temp_prev[i] = 0.0;
+		s->temp_hyst[i] = -273.15;
+		memset(&s->temp_slope[i], 0, sizeof(s->temp_slope[i]));
+		s->temp_rate[i] = 0.0;
 	}
 	for (i = 0; i < VSENSOR_MAX_COUNT; i++) {
 		s->vtemp[i] = 0.0;
 		s->vtemp_prev[i] = 0.0;
+		s->vtemp_hyst[i] = -273.15;
+		memset(&s->vtemp_slope[i], 0, sizeof(s->vtemp_slope[i]));
+		s->vtemp_rate[i] = 0.0;
 		s->vtemp_updated[i] = from_us_since_boot(0);
 	}
 }
@@ -259,7 +364,7 @@ void clear_state(struct fanpico_state *s)
 
 void update_system_state()
 {
-	mutex_enter_blocking(state_mutex);
+	perf_mutex_enter_blocking(state_mutex, PERF_MUTEX_STATE);
 	memcpy(&system_state, &transfer_state, sizeof(system_state));
 	mutex_exit(state_mutex);
 }
@@ -269,158 +374,357 @@ void update_outputs(struct fanpico_state *state, const struct fanpico_config *co
 {
 	int i;
 
+	/* Update fan zone control signals */
+	for (i = 0; i < ZONE_COUNT; i++)
+		state->zone_duty[i] = calculate_zone_duty(state, config, i);
+
+	/* Check for failed fans */
+	update_fan_failures(state, config);
+
 	/* Update fan PWM signals */
+	set_pwm_phases(config);
+	set_pwm_dither(config->pwm_dither);
 	for (i = 0; i < FAN_COUNT; i++) {
-		state->fan_duty[i] = calculate_pwm_duty(state, config, i);
+		if (fancal_active(i))
+			continue;
+		state->fan_duty[i] = fan_start_assist(state, config, i,
+					fan_failure_boost(state, config, i,
+						fan_output_limits(state, config, i,
+							calculate_pwm_duty(state, config, i))));
 		if (check_for_change(state->fan_duty_prev[i], state->fan_duty[i], 1.0)) {
-			log_msg(LOG_INFO, "fan%d: Set output PWM %.1f%% --> %.1f%%",
+			char prev[16], new[16];
+
+			log_msg(LOG_INFO, "fan%d: Set output PWM %s%% --> %s%%",
 				i+1,
-				state->fan_duty_prev[i],
-				state->fan_duty[i]);
+				float_to_str(prev, sizeof(prev), state->fan_duty_prev[i], 0, 1),
+				float_to_str(new, sizeof(new), state->fan_duty[i], 0, 1));
 			state->fan_duty_prev[i] = state->fan_duty[i];
-			set_pwm_duty_cycle(i, state->fan_duty[i]);
 		}
+		/* Output has sub-percent resolution, so update also on small changes */
+		set_pwm_duty_cycle(i, state->fan_duty[i]);
 	}
 
 	/* Update mb tacho signals */
 	for (i = 0; i < MBFAN_COUNT; i++) {
 		state->mbfan_freq[i] = calculate_tacho_freq(state, config, i);
 		if (check_for_change(state->mbfan_freq_prev[i], state->mbfan_freq[i], 1.0)) {
-			log_msg(LOG_INFO, "mbfan%d: Set output Tacho %.2fHz --> %.2fHz",
+			char prev[16], new[16];
+
+			log_msg(LOG_INFO, "mbfan%d: Set output Tacho %sHz --> %sHz",
 				i+1,
-				state->mbfan_freq_prev[i],
-				state->mbfan_freq[i]);
+				float_to_str(prev, sizeof(prev), state->mbfan_freq_prev[i], 0, 2),
+				float_to_str(new, sizeof(new), state->mbfan_freq[i], 0, 2));
 			state->mbfan_freq_prev[i] = state->mbfan_freq[i];
-			set_tacho_output_freq(i, state->mbfan_freq[i]);
 		}
+		/* Generator has fractional resolution, so update also on small changes */
+		set_tacho_output_freq(i, state->mbfan_freq[i], config->mbfans[i].tacho_duty);
 	}
 }
 
 
-void core1_main()
+/* core1 main loop timers. */
+static absolute_time_t t_core1_temp;
+static absolute_time_t t_core1_tacho;
+static absolute_time_t t_core1_poll_pwm;
+static absolute_time_t t_core1_set_outputs;
+static absolute_time_t t_core1_config;
+static absolute_time_t t_core1_state;
+static absolute_time_t t_core1_last;
+static int64_t core1_max_delta;
+
+
+/* core1_setup()
+ *  Initialize core1 state before entering main loop.
+ */
+
+void core1_setup()
+{
+	mutex_enter_blocking(config_mutex);
+	memcpy(&core1_config, cfg, sizeof(core1_config));
+	mutex_exit(config_mutex);
+	memcpy(&core1_state, &system_state, sizeof(core1_state));
+
+	setup_tacho_input_interrupts();
+
+	t_core1_temp = from_us_since_boot(0);
+	t_core1_tacho = from_us_since_boot(0);
+	t_core1_poll_pwm = from_us_since_boot(0);
+	t_core1_set_outputs = from_us_since_boot(0);
+	t_core1_state = t_core1_config = t_core1_last = get_absolute_time();
+	core1_max_delta = 0;
+}
+
+
+/* core1_loop()
+ *  Run one iteration of core1 main loop. This is called from core1_main(),
+ *  and directly from host side simulator (contrib/host).
+ */
+
+void core1_loop()
 {
 	struct fanpico_config *config = &core1_config;
 	struct fanpico_state *state = &core1_state;
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_temp, 0);
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_tacho, 0);
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_poll_pwm, 0);
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_set_outputs, 0);
-	absolute_time_t t_last, t_now, t_config, t_state;
-	int64_t max_delta = 0;
+	absolute_time_t t_now;
 	int64_t delta;
+	uint32_t t_start;
 
+	t_now = get_absolute_time();
+	delta = absolute_time_diff_us(t_core1_last, t_now);
+	t_core1_last = t_now;
+	perf_add(PERF_CORE1_LOOP, delta);
 
+	if (delta > core1_max_delta) {
+		core1_max_delta = delta;
+		log_msg(LOG_INFO, "core1: max_loop_time=%lld", core1_max_delta);
+	}
+
+	/* Tachometer inputs from Fans */
+	t_start = perf_begin(PERF_TACHO_READ);
+	read_tacho_inputs();
+	if (time_passed(&t_core1_tacho, 1000)) {
+		/* Calculate frequencies from input tachometer signals peridocially */
+		log_msg(LOG_DEBUG, "Updating tacho input signals.");
+		update_tacho_input_freq(state);
+	}
+	perf_end(PERF_TACHO_READ, t_start);
+
+	/* PWM input signals (duty cycles) from "motherboard". */
+	t_start = perf_begin(PERF_PWM_INPUT);
+	get_pwm_duty_cycles(config);
+	if (time_passed(&t_core1_poll_pwm, 200)) {
+		log_msg(LOG_DEBUG, "Read PWM inputs");
+		for (int i = 0; i < MBFAN_COUNT; i++) {
+			state->mbfan_duty[i] = roundf(mbfan_pwm_duty[i]);
+			if (check_for_change(state->mbfan_duty_prev[i], state->mbfan_duty[i], 1.5)) {
+				char prev[16], new[16];
+
+				log_msg(LOG_INFO, "mbfan%d: Input PWM change %s%% --> %s%%",
+					i+1,
+					float_to_str(prev, sizeof(prev), state->mbfan_duty_prev[i], 0, 1),
+					float_to_str(new, sizeof(new), state->mbfan_duty[i], 0, 1));
+				state->mbfan_duty_prev[i] = state->mbfan_duty[i];
+			}
+		}
+	}
+	perf_end(PERF_PWM_INPUT, t_start);
+
+	/* Read temperature sensors periodically */
+	if (time_passed(&t_core1_temp, 2000)) {
+		uint32_t t_ms = to_ms_since_boot(get_absolute_time());
+
+		t_start = perf_begin(PERF_TEMP_READ);
+		log_msg(LOG_DEBUG, "Read temperature sensors");
+		for (int i = 0; i < SENSOR_COUNT; i++) {
+			state->temp[i] = get_temperature(i, config);
+			state->temp_hyst[i] = temp_hysteresis(state->temp_hyst[i],
+							state->temp[i], config->sensors[i].hysteresis);
+			temp_slope_add(&state->temp_slope[i], state->temp[i], t_ms);
+			state->temp_rate[i] = temp_slope_rate(&state->temp_slope[i]);
+			if (check_for_change(state->temp_prev[i], state->temp[i], 0.5)) {
+				char prev[16], new[16];
+
+				log_msg(LOG_INFO, "sensor%d: Temperature change %sC --> %sC",
+					i+1,
+					float_to_str(prev, sizeof(prev), state->temp_prev[i], 0, 1),
+					float_to_str(new, sizeof(new), state->temp[i], 0, 1));
+				state->temp_prev[i] = state->temp[i];
+			}
+		}
+		perf_end(PERF_TEMP_READ, t_start);
+
+		t_start = perf_begin(PERF_VSENSORS);
+		log_msg(LOG_DEBUG, "Update virtual sensors");
+		for (int i = 0; i < VSENSOR_COUNT; i++) {
+			state->vtemp[i] = get_vsensor(i, config, state);
+			state->vtemp_hyst[i] = temp_hysteresis(state->vtemp_hyst[i],
+							state->vtemp[i], config->vsensors[i].hysteresis);
+			temp_slope_add(&state->vtemp_slope[i], state->vtemp[i], t_ms);
+			state->vtemp_rate[i] = temp_slope_rate(&state->vtemp_slope[i]);
+			if (check_for_change(state->vtemp_prev[i], state->vtemp[i], 0.5)) {
+				char prev[16], new[16];
+
+				log_msg(LOG_INFO, "vsensor%d: Temperature change %sC --> %sC",
+					i+1,
+					float_to_str(prev, sizeof(prev), state->vtemp_prev[i], 0, 1),
+					float_to_str(new, sizeof(new), state->vtemp[i], 0, 1));
+				state->vtemp_prev[i] = state->vtemp[i];
+			}
+		}
+		perf_end(PERF_VSENSORS, t_start);
+	}
+
+	if (time_passed(&t_core1_set_outputs, 500)) {
+		log_msg(LOG_DEBUG, "Updating output signals.");
+		t_start = perf_begin(PERF_OUTPUTS);
+		update_outputs(state, config);
+		perf_end(PERF_OUTPUTS, t_start);
+		if (!boot_first_output)
+			boot_first_output = time_us_32();
+	}
+
+	/* Fan characterization sweep (if active) */
+	fancal_poll(state, config);
+
+	if (time_passed(&t_core1_config, 1000)) {
+		/* Attempt to update config from core0 */
+		t_start = perf_begin(PERF_CONFIG_SYNC);
+		if (perf_mutex_enter_timeout_us(config_mutex, 100, PERF_MUTEX_CONFIG)) {
+			memcpy(config, cfg, sizeof(*config));
+			mutex_exit(config_mutex);
+		} else {
+			log_msg(LOG_DEBUG, "failed to get config_mutex");
+		}
+		perf_end(PERF_CONFIG_SYNC, t_start);
+	}
+	if (time_passed(&t_core1_state, 500)) {
+		/* Attempt to update system state on core0 */
+		t_start = perf_begin(PERF_STATE_PUBLISH);
+		if (perf_mutex_enter_timeout_us(state_mutex, 100, PERF_MUTEX_STATE)) {
+			memcpy(&transfer_state, state, sizeof(transfer_state));
+			mutex_exit(state_mutex);
+		} else {
+			log_msg(LOG_DEBUG, "failed to get state_mutex");
+		}
+		perf_end(PERF_STATE_PUBLISH, t_start);
+	}
+}
+
+
+void core1_main()
+{
+	stack_paint();
 	log_msg(LOG_INFO, "core1: started...");
 
 	/* Allow core0 to pause this core... */
 	multicore_lockout_victim_init();
 
-	setup_tacho_input_interrupts();
-
-	t_state = t_config = t_last = get_absolute_time();
+	core1_setup();
 
 	while (1) {
-		t_now = get_absolute_time();
-		delta = absolute_time_diff_us(t_last, t_now);
-		t_last = t_now;
+		core1_loop();
+	}
+}
 
-		if (delta > max_delta) {
-			max_delta = delta;
-			log_msg(LOG_INFO, "core1: max_loop_time=%lld", max_delta);
-		}
 
-		/* Tachometer inputs from Fans */
-		read_tacho_inputs();
-		if (time_passed(&t_tacho, 1000)) {
-			/* Calculate frequencies from input tachometer signals peridocially */
-			log_msg(LOG_DEBUG, "Updating tacho input signals.");
-			update_tacho_input_freq(state);
-		}
+static bool task_watchdog()
+{
+#if WATCHDOG_ENABLED
+	watchdog_update();
+#endif
+	return false;
+}
 
-		/* PWM input signals (duty cycles) from "motherboard". */
-		get_pwm_duty_cycles(config);
-		if (time_passed(&t_poll_pwm, 200)) {
-			log_msg(LOG_DEBUG, "Read PWM inputs");
-			for (int i = 0; i < MBFAN_COUNT; i++) {
-				state->mbfan_duty[i] = roundf(mbfan_pwm_duty[i]);
-				if (check_for_change(state->mbfan_duty_prev[i], state->mbfan_duty[i], 1.5)) {
-					log_msg(LOG_INFO, "mbfan%d: Input PWM change %.1f%% --> %.1f%%",
-						i+1,
-						state->mbfan_duty_prev[i],
-						state->mbfan_duty[i]);
-					state->mbfan_duty_prev[i] = state->mbfan_duty[i];
-				}
-			}
-		}
+static bool task_network()
+{
+	uint32_t t_start = perf_begin(PERF_NETWORK);
 
-		/* Read temperature sensors periodically */
-		if (time_passed(&t_temp, 2000)) {
-			log_msg(LOG_DEBUG, "Read temperature sensors");
-			for (int i = 0; i < SENSOR_COUNT; i++) {
-				state->temp[i] = get_temperature(i, config);
-				if (check_for_change(state->temp_prev[i], state->temp[i], 0.5)) {
-					log_msg(LOG_INFO, "sensor%d: Temperature change %.1fC --> %.1fC",
-						i+1,
-						state->temp_prev[i],
-						state->temp[i]);
-					state->temp_prev[i] = state->temp[i];
-				}
-			}
+	network_poll();
+	perf_end(PERF_NETWORK, t_start);
 
-			log_msg(LOG_DEBUG, "Update virtual sensors");
-			for (int i = 0; i < VSENSOR_COUNT; i++) {
-				state->vtemp[i] = get_vsensor(i, config, state);
-				if (check_for_change(state->vtemp_prev[i], state->vtemp[i], 0.5)) {
-					log_msg(LOG_INFO, "vsensor%d: Temperature change %.1fC --> %.1fC",
-						i+1,
-						state->vtemp_prev[i],
-						state->vtemp[i]);
-					state->vtemp_prev[i] = state->vtemp[i];
-				}
-			}
-		}
+	return false;
+}
 
-		if (time_passed(&t_set_outputs, 500)) {
-			log_msg(LOG_DEBUG, "Updating output signals.");
-			update_outputs(state, config);
-		}
+/* Process (user) input. Input is processed until a complete command has been
+ * received, and then the command is run. Any further input is processed in
+ * the next slice, so that higher priority tasks can run between commands. */
+static bool task_console()
+{
+	static char input_buf[1024 + 1];
+	static int i_ptr = 0;
+	uint32_t t_start;
+	int c;
 
-		if (time_passed(&t_config, 1000)) {
-			/* Attempt to update config from core0 */
-			if (mutex_enter_timeout_us(config_mutex, 100)) {
-				memcpy(config, cfg, sizeof(*config));
-				mutex_exit(config_mutex);
-			} else {
-				log_msg(LOG_DEBUG, "failed to get config_mutex");
-			}
+	while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+		if (c == 0xff || c == 0x00)
+			continue;
+		if (c == 0x7f || c == 0x08) {
+			if (i_ptr > 0) i_ptr--;
+			if (cfg->local_echo) printf("\b \b");
+			continue;
 		}
-		if (time_passed(&t_state, 500)) {
-			/* Attempt to update system state on core0 */
-			if (mutex_enter_timeout_us(state_mutex, 100)) {
-				memcpy(&transfer_state, state, sizeof(transfer_state));
-				mutex_exit(state_mutex);
-			} else {
-				log_msg(LOG_DEBUG, "failed to get state_mutex");
+		if (c == 10 || c == 13 || i_ptr >= sizeof(input_buf) - 1) {
+			if (cfg->local_echo) printf("\r\n");
+			input_buf[i_ptr] = 0;
+			if (i_ptr > 0) {
+				t_start = perf_begin(PERF_COMMAND);
+				update_system_state();
+				process_command(fanpico_state, (struct fanpico_config *)cfg, input_buf);
+				perf_end(PERF_COMMAND, t_start);
+				i_ptr = 0;
+				return true;
 			}
+			continue;
 		}
+		input_buf[i_ptr++] = c;
+		if (cfg->local_echo) printf("%c", c);
+	}
+
+	return false;
+}
+
+/* Update display every 1000ms. Display is drawn in slices (display_poll()). */
+static bool task_display()
+{
+	static bool drawing = false;
+	uint32_t t_start = perf_begin(PERF_DISPLAY);
 
+	if (!drawing) {
+		update_system_state();
+		display_status(fanpico_state, cfg);
 	}
+	drawing = (display_poll() ? true : false);
+	perf_end(PERF_DISPLAY, t_start);
+
+	return drawing;
+}
+
+static bool task_persistent_memory()
+{
+	update_persistent_memory();
+	return false;
+}
+
+static bool task_fancal()
+{
+	fancal_apply_results((struct fanpico_config *)cfg);
+	return false;
+}
+
+/* Toggle LED every 1000ms */
+static bool task_led()
+{
+	static uint8_t led_state = 0;
+
+	if (cfg->led_mode == 0) {
+		/* Slow blinking */
+		led_state = (led_state > 0 ? 0 : 1);
+	} else if (cfg->led_mode == 1) {
+		/* Always on */
+		led_state = 1;
+	} else {
+		/* Always off */
+		led_state = 0;
+	}
+#if LED_PIN > 0
+	gpio_put(LED_PIN, led_state);
+#endif
+#ifdef LIB_PICO_CYW43_ARCH
+	cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, led_state);
+#endif
+
+	return false;
 }
 
 
 int main()
 {
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_led, 0);
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_network, 0);
-	absolute_time_t t_now, t_last, t_display, t_ram;
-	uint8_t led_state = 0;
+	absolute_time_t t_now, t_last;
 	int64_t max_delta = 0;
 	int64_t delta;
-	int c;
-	char input_buf[1024 + 1];
-	int i_ptr = 0;
 
 
+	mem_init();
+	stack_paint();
 	set_binary_info();
 	clear_state(&system_state);
 	clear_state(&transfer_state);
@@ -432,87 +736,40 @@ int main()
 	if (get_debug_level() >= 2)
 		print_mallinfo();
 
-	/* Start second core (core1)... */
-	memcpy(&core1_config, cfg, sizeof(core1_config));
-	memcpy(&core1_state, &system_state, sizeof(core1_state));
-	multicore_launch_core1(core1_main);
+	/* Start second core (core1), unless already started in setup()... */
+	if (!core1_running) {
+		multicore_launch_core1(core1_main);
+		core1_running = true;
+	}
 
 #if WATCHDOG_ENABLED
 	watchdog_enable(WATCHDOG_REBOOT_DELAY, 1);
 	log_msg(LOG_NOTICE, "Watchdog enabled.");
 #endif
 
+	/* Core0 tasks: name, function, priority (0 = highest), period (ms), deadline (ms) */
+	sched_add_task("watchdog", task_watchdog, 0, 10, 1000);
+	sched_add_task("network", task_network, 1, 1, 10);
+	sched_add_task("console", task_console, 2, 1, 50);
+	sched_add_task("display", task_display, 3, 1000, 500);
+	sched_add_task("persistent_mem", task_persistent_memory, 4, 1000, 1000);
+	sched_add_task("fancal", task_fancal, 4, 1000, 1000);
+	sched_add_task("led", task_led, 5, 1000, 1000);
+
 	t_last = get_absolute_time();
-	t_ram = t_display = t_last;
 
 	while (1) {
 		t_now = get_absolute_time();
 		delta = absolute_time_diff_us(t_last, t_now);
 		t_last = t_now;
+		perf_add(PERF_CORE0_LOOP, delta);
 
 		if (delta > max_delta) {
 			max_delta = delta;
 			log_msg(LOG_INFO, "core0: max_loop_time=%lld", max_delta);
 		}
 
-		if (time_passed(&t_network, 1)) {
-			network_poll();
-		}
-		if (time_passed(&t_ram, 1000)) {
-			update_persistent_memory();
-		}
-
-		/* Toggle LED every 1000ms */
-		if (time_passed(&t_led, 1000)) {
-			if (cfg->led_mode == 0) {
-				/* Slow blinking */
-				led_state = (led_state > 0 ? 0 : 1);
-			} else if (cfg->led_mode == 1) {
-				/* Always on */
-				led_state = 1;
-			} else {
-				/* Always off */
-				led_state = 0;
-			}
-#if LED_PIN > 0
-			gpio_put(LED_PIN, led_state);
-#endif
-#ifdef LIB_PICO_CYW43_ARCH
-			cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, led_state);
-#endif
-		}
-
-		/* Update display every 1000ms */
-		if (time_passed(&t_display, 1000)) {
-			update_system_state();
-			display_status(fanpico_state, cfg);
-		}
-
-		/* Process any (user) input */
-		while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
-			if (c == 0xff || c == 0x00)
-				continue;
-			if (c == 0x7f || c == 0x08) {
-				if (i_ptr > 0) i_ptr--;
-				if (cfg->local_echo) printf("\b \b");
-				continue;
-			}
-			if (c == 10 || c == 13 || i_ptr >= sizeof(input_buf) - 1) {
-				if (cfg->local_echo) printf("\r\n");
-				input_buf[i_ptr] = 0;
-				if (i_ptr > 0) {
-					update_system_state();
-					process_command(fanpico_state, (struct fanpico_config *)cfg, input_buf);
-					i_ptr = 0;
-				}
-				continue;
-			}
-			input_buf[i_ptr++] = c;
-			if (cfg->local_echo) printf("%c", c);
-		}
-#if WATCHDOG_ENABLED
-		watchdog_update();
-#endif
+		sched_run();
 	}
 }
 
@@ -39,9 +39,11 @@
 #define MBFAN_MAX_COUNT   4   /* Max number of (Motherboard) Fan inputs on the board */
 #define SENSOR_MAX_COUNT  3   /* Max number of sensor inputs on the board */
 #define VSENSOR_MAX_COUNT 8   /* Max number of virtual sensors */
+#define ZONE_MAX_COUNT    4   /* Max number of fan zones */
 
 #define VSENSOR_SOURCE_MAX_COUNT 8
 #define VSENSOR_COUNT 8
+#define ZONE_COUNT    4
 
 #define SENSOR_SERIES_RESISTANCE 10000.0
 
@@ -60,6 +62,7 @@
 #define MQTT_MAX_TOPIC_LEN            33
 #define MQTT_MAX_USERNAME_LEN         81
 #define MQTT_MAX_PASSWORD_LEN         65
+#define MQTT_CMD_MAX_LEN              100
 #define DEFAULT_MQTT_STATUS_INTERVAL  600
 #define DEFAULT_MQTT_TEMP_INTERVAL    60
 #define DEFAULT_MQTT_RPM_INTERVAL     60
@@ -93,6 +96,7 @@ enum tacho_source_types {
 	TACHO_MIN    = 2,     /* Slowest tacho signal from a group of fans. */
 	TACHO_MAX    = 3,     /* Fastest tacho signal from a group of fans. */
 	TACHO_AVG    = 4,     /* Average tacho signal from a group of fans. */
+	TACHO_WORST  = 5,     /* Tacho signal of worst performing fan in a group. */
 };
 #define TACHO_ENUM_MAX 1
 
@@ -113,7 +117,7 @@ enum vsensor_modes {
 
 struct pwm_map {
 	uint8_t points;
-	uint8_t pwm[MAX_MAP_POINTS][2];
+	float pwm[MAX_MAP_POINTS][2];
 };
 
 struct tacho_map {
@@ -126,21 +130,84 @@ struct temp_map {
 	float temp[MAX_MAP_POINTS][2];
 };
 
+#define TEMP_SLOPE_SAMPLES 8  /* samples used to estimate temperature rate of change */
+
+struct temp_slope {
+	float temp[TEMP_SLOPE_SAMPLES];
+	uint32_t t[TEMP_SLOPE_SAMPLES];  /* sample time (ms) */
+	uint8_t count;
+	uint8_t head;
+};
+
+#define FAN_KICK_MIN_TIME  1000  /* tacho reading interval */
+#define FAN_STALL_TIME     3000  /* fan not spinning to be considered stalled (ms) */
+#define FAN_FAIL_TIME      3000  /* no tacho signal to be considered failed (ms) */
+
+#define FAN_CAL_POINTS 11    /* calibration curve: 0%, 10%, ..., 100% */
+#define FAN_CAL_STEP   10
+
+enum fan_start_states {
+	FAN_START_IDLE = 0,     /* normal operation */
+	FAN_START_KICK = 1,     /* applying kick duty to get fan spinning */
+	FAN_START_STALLED = 2,  /* fan failed to start, waiting to retry */
+};
+
+enum fancal_states {
+	FANCAL_IDLE = 0,
+	FANCAL_SWEEP = 1,    /* measuring RPM vs duty cycle curve */
+	FANCAL_START = 2,    /* searching minimum start duty cycle */
+	FANCAL_STALL = 3,    /* searching stall duty cycle */
+	FANCAL_DONE = 4,
+	FANCAL_FAILED = 5,
+	FANCAL_ABORTED = 6,
+};
+
+struct fan_cal {
+	uint8_t points;
+	uint16_t rpm[FAN_CAL_POINTS];
+	uint8_t stall_duty;  /* lowest duty cycle fan keeps running at */
+	uint16_t min_rpm;    /* RPM at stall_duty */
+	uint8_t start_duty;  /* lowest duty cycle fan starts from standstill */
+};
+
 struct fan_output {
 	char name[MAX_NAME_LEN];
 
 	/* output PWM signal settings */
-	uint8_t min_pwm;
-	uint8_t max_pwm;
+	float min_pwm;
+	float max_pwm;
 	float pwm_coefficient;
 	enum pwm_source_types s_type;
 	uint16_t s_id;
 	struct pwm_map map;
 	enum signal_filter_types filter;
 	void *filter_ctx;
+	int8_t zone;          /* fan zone (-1 = not member of any zone) */
+	float offset;         /* offset (%) added to duty cycle */
+
+	/* output rate limiting */
+	float slew_up;        /* max increase (%/s), 0 = no limit */
+	float slew_down;      /* max decrease (%/s), 0 = no limit */
+	uint16_t min_dwell;   /* min time (s) after increase before decreasing */
 
 	/* input Tacho signal settings */
 	uint8_t rpm_factor;
+
+	/* start assist settings */
+	uint8_t kick_duty;    /* 0 = disabled */
+	uint16_t kick_time;   /* max time to apply kick duty (ms) */
+	uint16_t kick_retry;  /* delay between start attempts (s) */
+
+	/* fan characterization results */
+	struct fan_cal cal;
+};
+
+struct fan_zone {
+	char name[MAX_NAME_LEN];
+	enum pwm_source_types s_type;
+	uint16_t s_id;
+	enum signal_filter_types filter;
+	void *filter_ctx;
 };
 
 struct mb_input {
@@ -151,6 +218,9 @@ struct mb_input {
 	uint16_t max_rpm;
 	float rpm_coefficient;
 	uint8_t rpm_factor;
+	uint8_t tacho_duty;   /* tacho output pulse width (%) */
+	bool stall_alarm;     /* report 0 RPM if any source fan has failed */
+	uint16_t hold_time;   /* hold last good value on tacho dropout (ms) */
 	enum tacho_source_types s_type;
 	uint16_t s_id;
 	uint8_t sources[FAN_MAX_COUNT];
@@ -170,6 +240,9 @@ struct sensor_input {
 	float temp_offset;
 	float temp_coefficient;
 	struct temp_map map;
+	float hysteresis;     /* hysteresis (C) for temp_map evaluation */
+	float ff_gain;        /* feed-forward gain (% per C/min), 0 = disabled */
+	float ff_max;         /* feed-forward max duty (%) */
 	enum signal_filter_types filter;
 	void *filter_ctx;
 };
@@ -181,6 +254,9 @@ struct vsensor_input {
 	int32_t timeout;
 	uint8_t sensors[VSENSOR_SOURCE_MAX_COUNT];
 	struct temp_map map;
+	float hysteresis;     /* hysteresis (C) for temp_map evaluation */
+	float ff_gain;        /* feed-forward gain (% per C/min), 0 = disabled */
+	float ff_max;         /* feed-forward max duty (%) */
 	enum signal_filter_types filter;
 	void *filter_ctx;
 };
@@ -189,8 +265,15 @@ struct fanpico_config {
 	struct sensor_input sensors[SENSOR_MAX_COUNT];
 	struct vsensor_input vsensors[VSENSOR_MAX_COUNT];
 	struct fan_output fans[FAN_MAX_COUNT];
+	struct fan_zone zones[ZONE_MAX_COUNT];
 	struct mb_input mbfans[MBFAN_MAX_COUNT];
 	bool local_echo;
+	bool fast_boot;
+	uint8_t fan_fail_duty;   /* min duty (%) for stall detection, 0 = disabled */
+	uint8_t fan_fail_boost;  /* boost (%) for other fans in group, 100 = max */
+	bool pwm_dither;         /* dither PWM outputs for sub-step resolution */
+	bool pwm_phase_auto;     /* spread PWM output phases evenly */
+	uint16_t pwm_phase[FAN_MAX_COUNT / 2];  /* PWM slice phase offsets (degrees) */
 	uint8_t led_mode;
 	char display_type[64];
 	char display_theme[16];
@@ -254,14 +337,46 @@ struct fanpico_state {
 	float fan_freq_prev[FAN_MAX_COUNT];
 	float temp[SENSOR_MAX_COUNT];
 	float temp_prev[SENSOR_MAX_COUNT];
+	float temp_hyst[SENSOR_MAX_COUNT];
+	struct temp_slope temp_slope[SENSOR_MAX_COUNT];
+	float temp_rate[SENSOR_MAX_COUNT];  /* C/min */
 	float vtemp[VSENSOR_MAX_COUNT];
 	absolute_time_t vtemp_updated[VSENSOR_MAX_COUNT];
 	float vtemp_prev[VSENSOR_MAX_COUNT];
+	float vtemp_hyst[VSENSOR_MAX_COUNT];
+	struct temp_slope vtemp_slope[VSENSOR_MAX_COUNT];
+	float vtemp_rate[VSENSOR_MAX_COUNT];  /* C/min */
 	/* outputs */
 	float fan_duty[FAN_MAX_COUNT];
 	float fan_duty_prev[FAN_MAX_COUNT];
 	float mbfan_freq[MBFAN_MAX_COUNT];
 	float mbfan_freq_prev[MBFAN_MAX_COUNT];
+	float mbfan_hold_rpm[MBFAN_MAX_COUNT];
+	absolute_time_t mbfan_hold_t[MBFAN_MAX_COUNT];
+	float zone_duty[ZONE_MAX_COUNT];
+	/* fan output rate limiting */
+	float fan_duty_slew[FAN_MAX_COUNT];
+	absolute_time_t fan_slew_t[FAN_MAX_COUNT];
+	absolute_time_t fan_up_t[FAN_MAX_COUNT];
+	/* fan failure compensation */
+	bool fan_failed[FAN_MAX_COUNT];
+	absolute_time_t fan_fail_t[FAN_MAX_COUNT];
+	/* fan start assist */
+	enum fan_start_states fan_start_state[FAN_MAX_COUNT];
+	absolute_time_t fan_start_t[FAN_MAX_COUNT];
+	uint32_t fan_stalls[FAN_MAX_COUNT];
+};
+
+struct display_stats {
+	uint32_t frames;          /* completed screen updates */
+	uint32_t draw_ops;        /* fields/rows written to display */
+	uint32_t skipped_ops;     /* unchanged fields/rows not written */
+	uint64_t bytes;           /* pixel data bytes sent to display */
+	uint32_t last_frame_bytes; /* pixel data bytes sent during last frame */
+	uint64_t busy_time;       /* total time spent updating display (us) */
+	uint32_t max_call_time;   /* longest time single call blocked core0 (us) */
+	uint32_t last_frame_time; /* time spent updating last frame (us) */
+	uint32_t max_frame_time;  /* longest time spent updating a frame (us) */
 };
 
 struct persistent_memory_block {
@@ -280,6 +395,10 @@ extern bool rebooted_by_watchdog;
 extern mutex_t *state_mutex;
 void update_display_state();
 void update_persistent_memory();
+void update_system_state();
+void print_boot_times();
+void core1_setup();
+void core1_loop();
 
 /* bi_decl.c */
 void set_binary_info();
@@ -300,21 +419,26 @@ int valid_pwm_source_ref(enum pwm_source_types source, uint16_t s_id);
 int str2tacho_source(const char *s);
 const char* tacho_source2str(enum tacho_source_types source);
 int valid_tacho_source_ref(enum tacho_source_types source, uint16_t s_id);
-void read_config();
+int read_config();
 void save_config();
 void delete_config();
 void print_config();
 
 /* display.c */
+extern struct display_stats display_stats;
 void display_init();
 void clear_display();
 void display_message(int rows, const char **text_lines);
 void display_status(const struct fanpico_state *state, const struct fanpico_config *config);
+int display_poll();
+void display_reset_stats();
+void display_print_stats();
 
 /* display_lcd.c */
 void lcd_display_init();
 void lcd_clear_display();
 void lcd_display_status(const struct fanpico_state *state,const struct fanpico_config *conf);
+int lcd_display_poll();
 void lcd_display_message(int rows, const char **text_lines);
 
 /* display_oled.c */
@@ -343,6 +467,10 @@ void set_pico_system_time(long unsigned int sec);
 const char *network_ip();
 const char *network_hostname();
 
+/* mqtt.c */
+int mqtt_parse_command(const uint8_t *data, size_t len, bool allow_scpi,
+		char *cmd, size_t cmd_size);
+
 #if WIFI_SUPPORT
 /* httpd.c */
 u16_t fanpico_ssi_handler(const char *tag, char *insert, int insertlen,
@@ -374,10 +502,32 @@ extern float mbfan_pwm_duty[MBFAN_MAX_COUNT];
 void setup_pwm_inputs();
 void setup_pwm_outputs();
 void set_pwm_duty_cycle(uint fan, float duty);
+void set_pwm_dither(bool enabled);
+void set_pwm_phases(const struct fanpico_config *config);
 float get_pwm_duty_cycle(uint fan);
 void get_pwm_duty_cycles(const struct fanpico_config *config);
 double pwm_map(const struct pwm_map *map, double val);
 double calculate_pwm_duty(struct fanpico_state *state, const struct fanpico_config *config, int i);
+double calculate_zone_duty(struct fanpico_state *state, const struct fanpico_config *config, int z);
+double fan_output_limits(struct fanpico_state *state, const struct fanpico_config *config,
+			int i, double duty);
+void update_fan_failures(struct fanpico_state *state, const struct fanpico_config *config);
+double fan_failure_boost(const struct fanpico_state *state, const struct fanpico_config *config,
+			int i, double duty);
+double fan_start_assist(struct fanpico_state *state, const struct fanpico_config *config,
+			int i, double duty);
+const char* fan_start_state2str(enum fan_start_states state);
+
+/* fancal.c */
+const char* fancal_state2str(enum fancal_states state);
+void fancal_start(int fan);
+void fancal_stop(int fan);
+enum fancal_states fancal_status(int fan, uint8_t *duty, uint32_t *elapsed,
+				struct fan_cal *result);
+bool fancal_active(int fan);
+void fancal_build_map(const struct fan_cal *cal, struct pwm_map *map);
+void fancal_apply_results(struct fanpico_config *config);
+void fancal_poll(struct fanpico_state *state, const struct fanpico_config *config);
 
 /* filters.c */
 int str2filter(const char *s);
@@ -389,6 +539,10 @@ float filter(enum signal_filter_types filter, void *ctx, float input);
 /* sensors.c */
 double get_temperature(uint8_t input, const struct fanpico_config *config);
 double sensor_get_duty(const struct temp_map *map, double temp);
+double temp_hysteresis(double prev, double temp, double band);
+void temp_slope_add(struct temp_slope *s, double temp, uint32_t t_ms);
+double temp_slope_rate(const struct temp_slope *s);
+double sensor_feed_forward(double rate, double gain, double max);
 double get_vsensor(uint8_t i, struct fanpico_config *config,
 		struct fanpico_state *state);
 
@@ -398,10 +552,113 @@ void setup_tacho_input_interrupts();
 void setup_tacho_outputs();
 void read_tacho_inputs();
 void update_tacho_input_freq(struct fanpico_state *state);
-void set_tacho_output_freq(uint fan, double frequency);
+void set_tacho_output_freq(uint fan, double frequency, uint8_t duty);
 double tacho_map(const struct tacho_map *map, double val);
 double calculate_tacho_freq(struct fanpico_state *state, const struct fanpico_config *config, int i);
 
+/* sched.c */
+typedef bool (*sched_task_func_t)(void);
+
+int sched_add_task(const char *name, sched_task_func_t func, uint8_t priority,
+		uint32_t period_ms, uint32_t deadline_ms);
+bool sched_run();
+void sched_reset_stats();
+void sched_print();
+
+/* perf.c */
+#define PERF_HIST_BUCKETS 16
+
+enum perf_stages {
+	PERF_CORE1_LOOP = 0,
+	PERF_TACHO_READ,
+	PERF_PWM_INPUT,
+	PERF_TEMP_READ,
+	PERF_VSENSORS,
+	PERF_OUTPUTS,
+	PERF_CONFIG_SYNC,
+	PERF_STATE_PUBLISH,
+	PERF_CORE0_LOOP,
+	PERF_NETWORK,
+	PERF_DISPLAY,
+	PERF_COMMAND,
+	PERF_STAGE_COUNT
+};
+
+enum perf_mutexes {
+	PERF_MUTEX_CONFIG = 0,
+	PERF_MUTEX_STATE,
+	PERF_MUTEX_FANCAL,
+	PERF_MUTEX_COUNT
+};
+
+extern volatile uint32_t perf_tacho_irqs[FAN_MAX_COUNT];
+void perf_reset();
+const char* perf_stage_name(enum perf_stages stage);
+const char* perf_mutex_name(enum perf_mutexes id);
+void perf_add(enum perf_stages stage, uint32_t us);
+uint32_t perf_begin(enum perf_stages stage);
+void perf_end(enum perf_stages stage, uint32_t t_start);
+void perf_mutex_enter_blocking(mutex_t *mtx, enum perf_mutexes id);
+bool perf_mutex_enter_timeout_us(mutex_t *mtx, uint32_t timeout_us, enum perf_mutexes id);
+void perf_print();
+struct cJSON *perf_to_json();
+
+/* memory.c */
+enum mem_subsystems {
+	MEM_CJSON = 0,
+	MEM_CONFIG,
+	MEM_FILTERS,
+	MEM_HTTPD,
+	MEM_MQTT,
+	MEM_TLS,
+	MEM_SUBSYSTEM_COUNT
+};
+
+void mem_init();
+void* mem_malloc(enum mem_subsystems sys, size_t size);
+void* mem_calloc(enum mem_subsystems sys, size_t nmemb, size_t size);
+void mem_free(enum mem_subsystems sys, void *ptr);
+enum mem_subsystems mem_set_owner(enum mem_subsystems sys);
+bool mem_arena_claim(enum mem_subsystems sys);
+void mem_arena_release(enum mem_subsystems sys);
+char* mem_json_print(const struct cJSON *item);
+void mem_print_stats();
+
+/* trace.c */
+enum trace_types {
+	TRACE_TYPE_BEGIN = 0,
+	TRACE_TYPE_END,
+	TRACE_TYPE_INSTANT,
+};
+
+enum trace_events {
+	TRACE_FLASH_PROG = PERF_STAGE_COUNT,
+	TRACE_FLASH_ERASE,
+	TRACE_IRQ_TACHO,
+	TRACE_IRQ_PULSE,
+	TRACE_MUTEX_WAIT, /* + enum perf_mutexes */
+	TRACE_EVENT_COUNT = TRACE_MUTEX_WAIT + PERF_MUTEX_COUNT
+};
+
+#if TRACE_SUPPORT
+#define TRACE_EVENT(type, id, arg) do {				\
+		if (trace_mask & (1UL << (id)))				\
+			trace_record(type, id, arg);			\
+	} while (0)
+#else
+#define TRACE_EVENT(type, id, arg) do { } while (0)
+#endif
+#define TRACE_BEGIN(id, arg) TRACE_EVENT(TRACE_TYPE_BEGIN, id, arg)
+#define TRACE_END(id, arg) TRACE_EVENT(TRACE_TYPE_END, id, arg)
+#define TRACE_INSTANT(id, arg) TRACE_EVENT(TRACE_TYPE_INSTANT, id, arg)
+
+extern volatile uint32_t trace_mask;
+void trace_record(enum trace_types type, uint8_t id, uint16_t arg);
+void trace_start(uint32_t mask);
+void trace_stop();
+void trace_print_status();
+void trace_dump();
+
 /* log.c */
 int str2log_priority(const char *pri);
 const char* log_priority2str(int pri);
@@ -432,6 +689,8 @@ int valid_hostname(const char *name);
 int check_for_change(double oldval, double newval, double threshold);
 int64_t pow_i64(int64_t x, uint8_t y);
 double round_decimal(double val, unsigned int decimal);
+char* float_to_str(char *buf, size_t size, double val, int width, int decimals);
+char* fixed_to_str(char *buf, size_t size, int64_t val, int scale, int width, int decimals);
 char* base64encode(const char *input);
 char* base64decode(const char *input);
 char *strncopy(char *dst, const char *src, size_t size);
@@ -444,6 +703,8 @@ int str_to_bitmask(const char *str, uint16_t len, uint32_t *mask, uint8_t base);
 /* util_rp2040.c */
 uint32_t get_stack_pointer();
 uint32_t get_stack_free();
+void stack_paint();
+uint32_t stack_used_max(uint core);
 void print_rp2040_meminfo();
 void print_irqinfo();
 void watchdog_disable();
@@ -65,7 +65,7 @@ void* lossy_peak_parse_args(char *args)
 		return NULL;
 
 
-	if (!(c = malloc(sizeof(lossypeak_context_t))))
+	if (!(c = mem_malloc(MEM_FILTERS, sizeof(lossypeak_context_t))))
 		return NULL;
 
 	c->peak = 0.0;
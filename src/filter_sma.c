@@ -57,7 +57,7 @@ void* sma_parse_args(char *args)
 	if (window < 2 || window > SMA_WINDOW_MAX_SIZE)
 		return NULL;
 
-	if (!(c = malloc(sizeof(sma_context_t))))
+	if (!(c = mem_malloc(MEM_FILTERS, sizeof(sma_context_t))))
 		return NULL;
 
 	c->index = 0;
@@ -42,6 +42,9 @@ int str2filter(const char *s)
 {
 	int ret = FILTER_NONE;
 
+	if (!s)
+		return ret;
+
 	for(int i = 0; filters[i].name; i++) {
 		if (!strcasecmp(s, filters[i].name)) {
 			ret = i;
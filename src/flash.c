@@ -37,6 +37,36 @@ static struct lfs_config *lfs_cfg;
 static lfs_t lfs;
 static lfs_file_t lfs_file;
 
+#if TRACE_SUPPORT
+static int (*lfs_prog_func)(const struct lfs_config *c, lfs_block_t block,
+			lfs_off_t off, const void *buffer, lfs_size_t size);
+static int (*lfs_erase_func)(const struct lfs_config *c, lfs_block_t block);
+
+/* Wrappers for the flash (block device) operations to record them in trace... */
+static int lfs_trace_prog(const struct lfs_config *c, lfs_block_t block,
+			lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+	int res;
+
+	TRACE_BEGIN(TRACE_FLASH_PROG, block);
+	res = lfs_prog_func(c, block, off, buffer, size);
+	TRACE_END(TRACE_FLASH_PROG, block);
+
+	return res;
+}
+
+static int lfs_trace_erase(const struct lfs_config *c, lfs_block_t block)
+{
+	int res;
+
+	TRACE_BEGIN(TRACE_FLASH_ERASE, block);
+	res = lfs_erase_func(c, block);
+	TRACE_END(TRACE_FLASH_ERASE, block);
+
+	return res;
+}
+#endif
+
 void lfs_setup(bool multicore)
 {
 	int err;
@@ -45,6 +75,12 @@ void lfs_setup(bool multicore)
 	lfs_cfg = pico_lfs_init(PICO_FLASH_SIZE_BYTES - FS_SIZE, FS_SIZE);
 	if (!lfs_cfg)
 		panic("lfs_setup: not enough memory!");
+#if TRACE_SUPPORT
+	lfs_prog_func = lfs_cfg->prog;
+	lfs_cfg->prog = lfs_trace_prog;
+	lfs_erase_func = lfs_cfg->erase;
+	lfs_cfg->erase = lfs_trace_erase;
+#endif
 
 	/* Check if we need to initialize/format filesystem... */
 	err = lfs_mount(&lfs, lfs_cfg);
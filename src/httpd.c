@@ -39,53 +39,53 @@ u16_t csv_stats(char *insert, int insertlen, u16_t current_tag_part, u16_t *next
 	static char *p;
 	static u16_t part;
 	static size_t buf_left;
-	char row[128];
+	char row[128], s1[16], s2[16], s3[16];
 	double rpm, pwm;
 	int i;
 	size_t printed, count;
 
 	if (current_tag_part == 0) {
 		/* Generate 'output' into a buffer that then will be fed in chunks to LwIP... */
-		if (!(buf = malloc(BUF_LEN)))
+		if (!(buf = mem_malloc(MEM_HTTPD, BUF_LEN)))
 			return 0;
 		buf[0] = 0;
 
 		for (i = 0; i < FAN_COUNT; i++) {
 			rpm = st->fan_freq[i] * 60 / cfg->fans[i].rpm_factor;
-			snprintf(row, sizeof(row), "fan%d,\"%s\",%.0lf,%.2f,%.1f\n",
+			snprintf(row, sizeof(row), "fan%d,\"%s\",%s,%s,%s\n",
 				i+1,
 				cfg->fans[i].name,
-				rpm,
-				st->fan_freq[i],
-				st->fan_duty[i]);
+				float_to_str(s1, sizeof(s1), rpm, 0, 0),
+				float_to_str(s2, sizeof(s2), st->fan_freq[i], 0, 2),
+				float_to_str(s3, sizeof(s3), st->fan_duty[i], 0, 1));
 			strncatenate(buf, row, BUF_LEN);
 		}
 		for (i = 0; i < MBFAN_COUNT; i++) {
 			rpm = st->mbfan_freq[i] * 60 / cfg->mbfans[i].rpm_factor;
-			snprintf(row, sizeof(row), "mbfan%d,\"%s\",%.0lf,%.2f,%.1f\n",
+			snprintf(row, sizeof(row), "mbfan%d,\"%s\",%s,%s,%s\n",
 				i+1,
 				cfg->mbfans[i].name,
-				rpm,
-				st->mbfan_freq[i],
-				st->mbfan_duty[i]);
+				float_to_str(s1, sizeof(s1), rpm, 0, 0),
+				float_to_str(s2, sizeof(s2), st->mbfan_freq[i], 0, 2),
+				float_to_str(s3, sizeof(s3), st->mbfan_duty[i], 0, 1));
 			strncatenate(buf, row, BUF_LEN);
 		}
 		for (i = 0; i < SENSOR_COUNT; i++) {
 			pwm = sensor_get_duty(&cfg->sensors[i].map, st->temp[i]);
-			snprintf(row, sizeof(row), "sensor%d,\"%s\",%.1lf,%.1lf\n",
+			snprintf(row, sizeof(row), "sensor%d,\"%s\",%s,%s\n",
 				i+1,
 				cfg->sensors[i].name,
-				st->temp[i],
-				pwm);
+				float_to_str(s1, sizeof(s1), st->temp[i], 0, 1),
+				float_to_str(s2, sizeof(s2), pwm, 0, 1));
 			strncatenate(buf, row, BUF_LEN);
 		}
 		for (i = 0; i < VSENSOR_COUNT; i++) {
 			pwm = sensor_get_duty(&cfg->vsensors[i].map, st->vtemp[i]);
-			snprintf(row, sizeof(row), "vsensor%d,\"%s\",%.1lf,%.1lf\n",
+			snprintf(row, sizeof(row), "vsensor%d,\"%s\",%s,%s\n",
 				i+1,
 				cfg->vsensors[i].name,
-				st->vtemp[i],
-				pwm);
+				float_to_str(s1, sizeof(s1), st->vtemp[i], 0, 1),
+				float_to_str(s2, sizeof(s2), pwm, 0, 1));
 			strncatenate(buf, row, BUF_LEN);
 		}
 
@@ -105,7 +105,7 @@ u16_t csv_stats(char *insert, int insertlen, u16_t current_tag_part, u16_t *next
 	if (buf_left > 0) {
 		*next_tag_part = part++;
 	} else {
-		free(buf);
+		mem_free(MEM_HTTPD, buf);
 		buf = p = NULL;
 	}
 
@@ -128,6 +128,15 @@ u16_t json_stats(char *insert, int insertlen, u16_t current_tag_part, u16_t *nex
 		/* Generate 'output' into a buffer that then will be fed in chunks to LwIP... */
 		cJSON *array, *o;
 
+		/* JSON is generated in httpd arena, that is released once output
+		   has been sent (or if previous response was not completed). */
+		if (buf) {
+			mem_free(MEM_HTTPD, buf);
+			mem_arena_release(MEM_HTTPD);
+			buf = NULL;
+		}
+		mem_arena_claim(MEM_HTTPD);
+
 		if (!(json = cJSON_CreateObject()))
 			goto panic;
 
@@ -199,7 +208,7 @@ u16_t json_stats(char *insert, int insertlen, u16_t current_tag_part, u16_t *nex
 		}
 		cJSON_AddItemToObject(json, "vsensors", array);
 
-		if (!(buf = cJSON_Print(json)))
+		if (!(buf = mem_json_print(json)))
 			goto panic;
 		cJSON_Delete(json);
 		json = NULL;
@@ -220,8 +229,9 @@ u16_t json_stats(char *insert, int insertlen, u16_t current_tag_part, u16_t *nex
 	if (buf_left > 0) {
 		*next_tag_part = part++;
 	} else {
-		free(buf);
+		mem_free(MEM_HTTPD, buf);
 		buf = p = NULL;
+		mem_arena_release(MEM_HTTPD);
 	}
 
 	return printed;
@@ -229,15 +239,72 @@ u16_t json_stats(char *insert, int insertlen, u16_t current_tag_part, u16_t *nex
 panic:
 	if (json)
 		cJSON_Delete(json);
+	mem_arena_release(MEM_HTTPD);
 	return 0;
 }
 
 
+u16_t json_perf(char *insert, int insertlen, u16_t current_tag_part, u16_t *next_tag_part)
+{
+	static char *buf = NULL;
+	static char *p;
+	static u16_t part;
+	static size_t buf_left;
+	size_t printed, count;
+
+	if (current_tag_part == 0) {
+		/* Generate 'output' into a buffer that then will be fed in chunks to LwIP... */
+		cJSON *json;
+
+		if (buf) {
+			mem_free(MEM_HTTPD, buf);
+			mem_arena_release(MEM_HTTPD);
+			buf = NULL;
+		}
+		mem_arena_claim(MEM_HTTPD);
+		json = perf_to_json();
+		buf = mem_json_print(json);
+		cJSON_Delete(json);
+		if (!buf) {
+			mem_arena_release(MEM_HTTPD);
+			return 0;
+		}
+
+		p = buf;
+		buf_left = strlen(buf);
+		part = 1;
+	}
+
+	/* Copy a part of the multi-part response into LwIP buffer ...*/
+	count = (buf_left < insertlen - 1 ? buf_left : insertlen - 1);
+	memcpy(insert, p, count);
+
+	p += count;
+	printed = count;
+	buf_left -= count;
+
+	if (buf_left > 0) {
+		*next_tag_part = part++;
+	} else {
+		mem_free(MEM_HTTPD, buf);
+		buf = p = NULL;
+		mem_arena_release(MEM_HTTPD);
+	}
+
+	return printed;
+}
+
+
 u16_t fanpico_ssi_handler(const char *tag, char *insert, int insertlen,
 			u16_t current_tag_part, u16_t *next_tag_part)
 {
 	const struct fanpico_state *st = fanpico_state;
+	enum mem_subsystems owner;
 	size_t printed = 0;
+	char s1[16], s2[16];
+
+	/* Attribute memory allocated for JSON output to httpd... */
+	owner = mem_set_owner(MEM_HTTPD);
 
 	/* printf("ssi_handler(\"%s\",%lx,%d,%u,%u)\n", tag, (uint32_t)insert, insertlen, current_tag_part, *next_tag_part); */
 
@@ -277,40 +344,40 @@ u16_t fanpico_ssi_handler(const char *tag, char *insert, int insertlen,
 		uint8_t i = tag[6] - '1';
 		if (i < FAN_COUNT) {
 			double rpm = st->fan_freq[i] * 60 / cfg->fans[i].rpm_factor;
-			printed = snprintf(insert, insertlen, "<td>%d<td>%s<td>%0.0f<td align=\"right\">%0.0f %%",
+			printed = snprintf(insert, insertlen, "<td>%d<td>%s<td>%s<td align=\"right\">%s %%",
 					i + 1,
 					cfg->fans[i].name,
-					rpm,
-					st->fan_duty[i]);
+					float_to_str(s1, sizeof(s1), rpm, 0, 0),
+					float_to_str(s2, sizeof(s2), st->fan_duty[i], 0, 0));
 		}
 	}
 	else if (!strncmp(tag, "mfanrow", 7)) {
 		uint8_t i = tag[7] - '1';
 		if (i < MBFAN_COUNT) {
 			double rpm = st->mbfan_freq[i] * 60 / cfg->mbfans[i].rpm_factor;
-			printed = snprintf(insert, insertlen, "<td>%d<td>%s<td>%0.0f<td align=\"right\">%0.0f %%",
+			printed = snprintf(insert, insertlen, "<td>%d<td>%s<td>%s<td align=\"right\">%s %%",
 					i + 1,
 					cfg->mbfans[i].name,
-					rpm,
-					st->mbfan_duty[i]);
+					float_to_str(s1, sizeof(s1), rpm, 0, 0),
+					float_to_str(s2, sizeof(s2), st->mbfan_duty[i], 0, 0));
 		}
 	}
 	else if (!strncmp(tag, "sensrow", 7)) {
 		uint8_t i = tag[7] - '1';
 		if (i < SENSOR_COUNT) {
-			printed = snprintf(insert, insertlen, "<td>%d<td>%s<td align=\"right\">%0.1f &#x2103;",
+			printed = snprintf(insert, insertlen, "<td>%d<td>%s<td align=\"right\">%s &#x2103;",
 					i + 1,
 					cfg->sensors[i].name,
-					st->temp[i]);
+					float_to_str(s1, sizeof(s1), st->temp[i], 0, 1));
 		}
 	}
 	else if (!strncmp(tag, "vsenrow", 7)) {
 		uint8_t i = tag[7] - '1';
 		if (i < VSENSOR_COUNT) {
-			printed = snprintf(insert, insertlen, "<td>%d<td>%s<td align=\"right\">%0.1f &#x2103;",
+			printed = snprintf(insert, insertlen, "<td>%d<td>%s<td align=\"right\">%s &#x2103;",
 					i + 1,
 					cfg->vsensors[i].name,
-					st->vtemp[i]);
+					float_to_str(s1, sizeof(s1), st->vtemp[i], 0, 1));
 		}
 	}
 	else if (!strncmp(tag, "csvstat", 7)) {
@@ -319,6 +386,9 @@ u16_t fanpico_ssi_handler(const char *tag, char *insert, int insertlen,
 	else if (!strncmp(tag, "jsonstat", 8)) {
 		printed = json_stats(insert, insertlen, current_tag_part, next_tag_part);
 	}
+	else if (!strncmp(tag, "jsonperf", 8)) {
+		printed = json_perf(insert, insertlen, current_tag_part, next_tag_part);
+	}
 	else if (!strncmp(tag, "refresh", 8)) {
 		/* generate "random" refresh time for a page, to help spread out the load... */
 		printed = snprintf(insert, insertlen, "%u", (uint)(30 + ((double)rand() / RAND_MAX) * 30));
@@ -329,6 +399,7 @@ u16_t fanpico_ssi_handler(const char *tag, char *insert, int insertlen,
 	printed = (printed >= insertlen ? insertlen - 1 : printed);
 	/* printf("printed=%u\n", printed); */
 
+	mem_set_owner(owner);
 	return printed;
 }
 
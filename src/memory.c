@@ -0,0 +1,366 @@
+/* memory.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "cJSON.h"
+#ifdef LIB_PICO_CYW43_ARCH
+#include "lwip/stats.h"
+#endif
+
+#include "fanpico.h"
+
+#if defined(WIFI_SUPPORT) && TLS_SUPPORT
+#include "mbedtls/platform.h"
+#endif
+
+
+/*
+ * Heap usage accounting by subsystem.
+ *
+ * Allocations are counted using the (usable) size of the allocated block
+ * as reported by malloc_usable_size(), so no extra header is needed and
+ * a block must be freed using the same subsystem it was allocated for.
+ *
+ * Memory allocated by cJSON is attributed to the current "owner"
+ * (of the core), which is cJSON by default. Subsystems that generate
+ * JSON can temporarily set themselves as the owner using mem_set_owner().
+ *
+ * Subsystems that generate JSON have an arena (bump allocator) that is
+ * claimed for the duration of an operation. While owner's arena is claimed,
+ * cJSON allocations are served from the arena, and freeing them is
+ * a no-op. All memory is released in one step when arena is released.
+ * If arena runs out of space, allocations fall back to the heap.
+ *
+ * Arena can be claimed by multiple (overlapping) operations, for example
+ * when httpd is sending multiple JSON responses, and it is reset only
+ * once all of them have released it.
+ *
+ * Arenas are only used from core0 (main loop and lwIP callbacks) and
+ * each subsystem has its own arena, so no locking is needed for these.
+ */
+
+#define MEM_ARENA_ALIGN 8
+
+/* Arena sizes (worst case usage, measured using maximum number of
+   fans/sensors, plus some margin). Arena memory is allocated from heap
+   only when arena is in use. */
+#define MEM_ARENA_CONFIG_SIZE (48 * 1024)
+#define MEM_ARENA_HTTPD_SIZE (16 * 1024)
+#define MEM_ARENA_MQTT_SIZE (6 * 1024)
+
+struct mem_arena {
+	uint8_t *buf;
+	size_t size;
+	size_t used;
+	size_t peak;
+	uint32_t claims;
+	uint32_t overflows;
+	uint16_t users;
+};
+
+struct mem_stats {
+	uint32_t live;
+	uint32_t peak;
+	uint32_t allocs;
+	uint32_t frees;
+	uint32_t failures;
+};
+
+static const char *mem_subsystem_names[MEM_SUBSYSTEM_COUNT] = {
+	"cJSON",
+	"config",
+	"filters",
+	"httpd",
+	"MQTT",
+	"TLS",
+};
+
+static struct mem_stats mem_stats[MEM_SUBSYSTEM_COUNT];
+static spin_lock_t *mem_lock = NULL;
+static enum mem_subsystems mem_owner[2] = { MEM_CJSON, MEM_CJSON };
+
+static struct mem_arena mem_arenas[MEM_SUBSYSTEM_COUNT] = {
+	[MEM_CONFIG] = { .size = MEM_ARENA_CONFIG_SIZE },
+	[MEM_HTTPD] = { .size = MEM_ARENA_HTTPD_SIZE },
+	[MEM_MQTT] = { .size = MEM_ARENA_MQTT_SIZE },
+};
+
+
+static void mem_account(enum mem_subsystems sys, void *ptr, size_t size, bool alloc)
+{
+	struct mem_stats *s = &mem_stats[sys];
+	uint32_t irq = 0;
+	size_t len = (ptr ? malloc_usable_size(ptr) : 0);
+
+	if (mem_lock)
+		irq = spin_lock_blocking(mem_lock);
+
+	if (alloc) {
+		if (ptr) {
+			s->allocs++;
+			s->live += len;
+			if (s->live > s->peak)
+				s->peak = s->live;
+		} else if (size > 0) {
+			s->failures++;
+		}
+	} else if (ptr) {
+		s->frees++;
+		s->live = (s->live > len ? s->live - len : 0);
+	}
+
+	if (mem_lock)
+		spin_unlock(mem_lock, irq);
+}
+
+
+void* mem_malloc(enum mem_subsystems sys, size_t size)
+{
+	void *ptr = malloc(size);
+
+	mem_account(sys, ptr, size, true);
+	return ptr;
+}
+
+
+void* mem_calloc(enum mem_subsystems sys, size_t nmemb, size_t size)
+{
+	void *ptr = calloc(nmemb, size);
+
+	mem_account(sys, ptr, nmemb * size, true);
+	return ptr;
+}
+
+
+static bool mem_arena_owns(const void *ptr)
+{
+	for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+		const struct mem_arena *a = &mem_arenas[i];
+
+		if (a->buf && (uint8_t*)ptr >= a->buf && (uint8_t*)ptr < a->buf + a->size)
+			return true;
+	}
+	return false;
+}
+
+
+void mem_free(enum mem_subsystems sys, void *ptr)
+{
+	if (!ptr || mem_arena_owns(ptr))
+		return;
+
+	mem_account(sys, ptr, 0, false);
+	free(ptr);
+}
+
+
+enum mem_subsystems mem_set_owner(enum mem_subsystems sys)
+{
+	uint core = get_core_num();
+	enum mem_subsystems prev = mem_owner[core];
+
+	mem_owner[core] = sys;
+	return prev;
+}
+
+
+/* Claim arena of a subsystem for an operation. Each claim must be
+ * matched by a call to mem_arena_release(). Returns false if subsystem
+ * has no arena (or memory for it is not available), in which case
+ * heap is used instead. */
+bool mem_arena_claim(enum mem_subsystems sys)
+{
+	struct mem_arena *a = &mem_arenas[sys];
+
+	if (a->size < 1)
+		return false;
+	a->claims++;
+	a->users++;
+	if (!a->buf)
+		a->buf = mem_malloc(sys, a->size);
+
+	return (a->buf ? true : false);
+}
+
+
+/* Release arena claim. Once all claims are released, all memory allocated
+ * from the arena is released in one step. */
+void mem_arena_release(enum mem_subsystems sys)
+{
+	struct mem_arena *a = &mem_arenas[sys];
+	void *buf = a->buf;
+
+	if (a->users < 1 || --a->users > 0)
+		return;
+	a->used = 0;
+	a->buf = NULL;
+	mem_free(sys, buf);
+}
+
+
+static void* mem_arena_alloc(struct mem_arena *a, size_t size)
+{
+	size_t len = (size + MEM_ARENA_ALIGN - 1) & ~(MEM_ARENA_ALIGN - 1);
+	void *ptr;
+
+	if (a->size - a->used < len) {
+		a->overflows++;
+		return NULL;
+	}
+	ptr = a->buf + a->used;
+	a->used += len;
+	if (a->used > a->peak)
+		a->peak = a->used;
+
+	return ptr;
+}
+
+
+/* Generate (formatted) JSON output. If arena is active, output
+ * buffer is allocated using all of the remaining space in the arena,
+ * to avoid buffer growing (and copying) while printing. Unused space
+ * is returned to the arena once output has been generated. */
+char* mem_json_print(const cJSON *item)
+{
+	struct mem_arena *a = &mem_arenas[mem_owner[get_core_num()]];
+	size_t used = a->used;
+	size_t peak = a->peak;
+	char *out;
+	int len;
+
+	if (!item)
+		return NULL;
+	if (!a->buf)
+		return cJSON_Print(item);
+
+	len = (a->size - a->used) & ~(MEM_ARENA_ALIGN - 1);
+	out = cJSON_PrintBuffered(item, (len > 256 ? len : 256), 1);
+
+	/* Shrink output buffer to the space actually used (so that arena
+	   can still be used by other claims) and only count that in arena
+	   peak usage, so that peak usage can be used to size the arena. */
+	if (out && (uint8_t*)out == a->buf + used) {
+		used += (strlen(out) + 1 + MEM_ARENA_ALIGN - 1) & ~(MEM_ARENA_ALIGN - 1);
+		a->used = used;
+		a->peak = (used > peak ? used : peak);
+	}
+
+	return out;
+}
+
+
+static void* mem_cjson_malloc(size_t size)
+{
+	enum mem_subsystems sys = mem_owner[get_core_num()];
+	void *ptr;
+
+	if (mem_arenas[sys].buf) {
+		if ((ptr = mem_arena_alloc(&mem_arenas[sys], size)))
+			return ptr;
+	}
+	return mem_malloc(sys, size);
+}
+
+static void mem_cjson_free(void *ptr)
+{
+	mem_free(mem_owner[get_core_num()], ptr);
+}
+
+#if defined(WIFI_SUPPORT) && TLS_SUPPORT
+static void* mem_tls_calloc(size_t nmemb, size_t size)
+{
+	return mem_calloc(MEM_TLS, nmemb, size);
+}
+
+static void mem_tls_free(void *ptr)
+{
+	mem_free(MEM_TLS, ptr);
+}
+#endif
+
+
+/* Install memory allocation hooks for libraries. This must be called
+ * before any memory is allocated by these libraries. */
+void mem_init()
+{
+	cJSON_Hooks hooks = {
+		.malloc_fn = mem_cjson_malloc,
+		.free_fn = mem_cjson_free,
+	};
+
+	mem_lock = spin_lock_instance(spin_lock_claim_unused(true));
+	memset(mem_stats, 0, sizeof(mem_stats));
+
+	cJSON_InitHooks(&hooks);
+#if defined(WIFI_SUPPORT) && TLS_SUPPORT
+	mbedtls_platform_set_calloc_free(mem_tls_calloc, mem_tls_free);
+#endif
+}
+
+
+void mem_print_stats()
+{
+	struct mem_stats stats[MEM_SUBSYSTEM_COUNT];
+	struct mallinfo mi = mallinfo();
+	uint32_t irq = 0, total = 0;
+
+	if (mem_lock)
+		irq = spin_lock_blocking(mem_lock);
+	memcpy(stats, mem_stats, sizeof(stats));
+	if (mem_lock)
+		spin_unlock(mem_lock, irq);
+
+	printf("%-10s %8s %8s %8s %8s %8s\n", "Subsystem", "Live", "Peak",
+		"Allocs", "Frees", "Failed");
+	for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+		const struct mem_stats *s = &stats[i];
+
+		printf("%-10s %8lu %8lu %8lu %8lu %8lu\n", mem_subsystem_names[i],
+			s->live, s->peak, s->allocs, s->frees, s->failures);
+		total += s->live;
+	}
+	printf("%-10s %8lu\n", "other",
+		(mi.uordblks > total ? mi.uordblks - total : 0));
+#if defined(WIFI_SUPPORT) && MEM_STATS
+	/* lwIP uses its own (static) heap... */
+	printf("%-10s %8lu %8lu %8s %8s %8lu (of %lu)\n", "lwIP",
+		(uint32_t)lwip_stats.mem.used, (uint32_t)lwip_stats.mem.max,
+		"", "", (uint32_t)lwip_stats.mem.err, (uint32_t)lwip_stats.mem.avail);
+#endif
+
+	printf("\n%-10s %8s %8s %8s %8s\n", "Arena", "Size", "Peak", "Claims", "Overflow");
+	for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+		const struct mem_arena *a = &mem_arenas[i];
+
+		if (a->size < 1)
+			continue;
+		printf("%-10s %8u %8u %8lu %8lu\n", mem_subsystem_names[i],
+			a->size, a->peak, a->claims, a->overflows);
+	}
+}
+
+
+/* eof :-) */
@@ -37,14 +37,66 @@
 
 #include "fanpico.h"
 
-#ifdef WIFI_SUPPORT
 
-#define MQTT_CMD_MAX_LEN 100
+/* Parse SCPI command from a MQTT command topic message payload.
+ * Optional "CMD:" prefix is skipped, and anything after ';' is ignored.
+ * Returns 0 if valid (and allowed) command was copied into 'cmd'. */
+int mqtt_parse_command(const uint8_t *data, size_t len, bool allow_scpi,
+		char *cmd, size_t cmd_size)
+{
+	const uint8_t *end, *start;
+	size_t l;
+
+	if (!data || len < 1 || !cmd || cmd_size < 2)
+		return -1;
+
+	/* Check for command prefix, if found skip past prefix */
+	if (len >= 4 && !memcmp(data, "CMD:", 4)) {
+		start = data + 4;
+		l = len - 4;
+		if (l < 1)
+			return -1;
+	} else {
+		start = data;
+		l = len;
+	}
+	/* Check for command suffix, if found ignore anything past it */
+	if (!(end = memchr(start, ';', l)))
+		end = start + l;
+	while (end > start && (end[-1] == '\n' || end[-1] == '\r'))
+		end--;
+	if ((l = end - start) < 1)
+		return -1;
+	if (l >= cmd_size)
+		l = cmd_size - 1;
+	for (size_t i = 0; i < l; i++) {
+		if (start[i] < 0x20 || start[i] > 0x7e) {
+			log_msg(LOG_NOTICE, "MQTT command contains invalid characters");
+			return -1;
+		}
+	}
+	memcpy(cmd, start, l);
+	cmd[l] = 0;
+
+	/* Check if should be command allowed */
+	if (!allow_scpi) {
+		if (strncasecmp(cmd, "WRITE:", 6)) {
+			log_msg(LOG_NOTICE, "MQTT SCPI commands not allowed: '%s'", cmd);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+#ifdef WIFI_SUPPORT
 
 mqtt_client_t *mqtt_client = NULL;
 ip_addr_t mqtt_server_ip = IPADDR4_INIT_BYTES(0, 0, 0, 0);
 u16_t mqtt_server_port = 0;
 int incoming_topic = 0;
+u32_t incoming_len = 0;
 int mqtt_qos = 1;
 char mqtt_scpi_cmd[MQTT_CMD_MAX_LEN];
 bool mqtt_scpi_cmd_queued = false;
@@ -115,7 +167,7 @@ char* json_response_message(const char *cmd, int result, const char *msg)
 	cJSON_AddItemToObject(json, "result", cJSON_CreateString(result == 0 ? "OK" : "ERROR"));
 	cJSON_AddItemToObject(json, "message", cJSON_CreateString(msg));
 
-	if (!(buf = cJSON_Print(json)))
+	if (!(buf = mem_json_print(json)))
 		goto panic;
 	cJSON_Delete(json);
 	return buf;
@@ -128,19 +180,26 @@ panic:
 
 void send_mqtt_command_response(const char *cmd, int result, const char *msg)
 {
+	enum mem_subsystems owner;
 	char *buf = NULL;
 
 	if (!cmd || !msg || !mqtt_client || strlen(cfg->mqtt_resp_topic) < 1)
 		return;
 
-	/* Generate status message */
-	if (!(buf = json_response_message(cmd, result, msg))) {
+	/* Generate status message (in MQTT arena) */
+	owner = mem_set_owner(MEM_MQTT);
+	mem_arena_claim(MEM_MQTT);
+	buf = json_response_message(cmd, result, msg);
+	mem_set_owner(owner);
+	if (!buf) {
 		log_msg(LOG_WARNING,"json_response_message(): failed");
+		mem_arena_release(MEM_MQTT);
 		return;
 	}
 	mqtt_publish_message(cfg->mqtt_resp_topic, buf, strlen(buf), mqtt_qos, 0,
 			cfg->mqtt_resp_topic);
-	free(buf);
+	mem_free(MEM_MQTT, buf);
+	mem_arena_release(MEM_MQTT);
 }
 
 static void mqtt_incoming_publish_cb(void *arg, const char *topic, u32_t tot_len)
@@ -152,50 +211,31 @@ static void mqtt_incoming_publish_cb(void *arg, const char *topic, u32_t tot_len
 	} else {
 		incoming_topic = 0;
 	}
+	incoming_len = tot_len;
 }
 
 static void mqtt_incoming_data_cb(void *arg, const u8_t *data, u16_t len, u8_t flags)
 {
 	char cmd[MQTT_CMD_MAX_LEN];
-	const u8_t *end, *start;
-	int l;
 
 
 	log_msg(LOG_DEBUG, "MQTT incoming publish payload with length %d, flags %u\n",
 		len, (unsigned int)flags);
 
-	if (incoming_topic != 1 || len < 1)
+	if (incoming_topic != 1 || !data || len < 1)
 		return;
 
-	/* Check for command prefix, if found skip past prefix */
-	if ((start = memmem(data, len, "CMD:", 4))) {
-		start += 4;
-		l = len - (start - data);
-		if (l < 1)
-			return;
-	} else {
-		start = data;
-		l = len;
-	}
-	/* Check for command suffix, if found ignore anything past it */
-	if (!(end = memchr(start, ';', l)))
-		end = start + l;
-	if ((l = end - start) < 1)
+	/* Ignore payloads split into multiple fragments (too long for a command) */
+	if (len != incoming_len || !(flags & MQTT_DATA_FLAG_LAST)) {
+		log_msg(LOG_NOTICE, "MQTT ignoring fragmented payload (%u bytes)",
+			(unsigned int)incoming_len);
+		incoming_topic = 0;
 		return;
-	if (l >= sizeof(cmd))
-		l = sizeof(cmd) - 1;
-	memcpy(cmd, start, l);
-	cmd[l] = 0;
-
-
-	/* Check if should be command allowed */
-	if (!cfg->mqtt_allow_scpi) {
-		if (strncasecmp(cmd, "WRITE:", 6)) {
-			log_msg(LOG_NOTICE, "MQTT SCPI commands not allowed: '%s'", cmd);
-			return;
-		}
 	}
 
+	if (mqtt_parse_command(data, len, cfg->mqtt_allow_scpi, cmd, sizeof(cmd)))
+		return;
+
 	if (mqtt_scpi_cmd_queued) {
 		log_msg(LOG_NOTICE, "MQTT SCPI command queue full: '%s'", cmd);
 		send_mqtt_command_response(cmd, 1, "SCPI command queue full");
@@ -428,7 +468,7 @@ char* json_status_message()
 	}
 
 
-	if (!(buf = cJSON_Print(json)))
+	if (!(buf = mem_json_print(json)))
 		goto panic;
 	cJSON_Delete(json);
 	return buf;
@@ -441,19 +481,26 @@ panic:
 
 void fanpico_mqtt_publish()
 {
+	enum mem_subsystems owner;
 	char *buf = NULL;
 
 	if (!mqtt_client || strlen(cfg->mqtt_status_topic) < 1)
 		return;
 
-	/* Generate status message */
-	if (!(buf = json_status_message())) {
+	/* Generate status message (in MQTT arena) */
+	owner = mem_set_owner(MEM_MQTT);
+	mem_arena_claim(MEM_MQTT);
+	buf = json_status_message();
+	mem_set_owner(owner);
+	if (!buf) {
 		log_msg(LOG_WARNING,"json_status_message(): failed");
+		mem_arena_release(MEM_MQTT);
 		return;
 	}
 	mqtt_publish_message(cfg->mqtt_status_topic, buf, strlen(buf), mqtt_qos, 0,
 			cfg->mqtt_status_topic);
-	free(buf);
+	mem_free(MEM_MQTT, buf);
+	mem_arena_release(MEM_MQTT);
 }
 
 void fanpico_mqtt_publish_temp()
@@ -468,7 +515,7 @@ void fanpico_mqtt_publish_temp()
 	for (int i = 0; i < SENSOR_COUNT; i++) {
 		if (cfg->mqtt_temp_mask & (1 << i)) {
 			snprintf(topic, sizeof(topic), cfg->mqtt_temp_topic, i + 1);
-			snprintf(buf, sizeof(buf), "%.1f", st->temp[i]);
+			float_to_str(buf, sizeof(buf), st->temp[i], 0, 1);
 			mqtt_publish_message(topic, buf, strlen(buf), mqtt_qos, 0,
 					cfg->mqtt_temp_topic);
 		}
@@ -489,7 +536,7 @@ void fanpico_mqtt_publish_rpm()
 			if (cfg->mqtt_fan_rpm_mask & (1 << i)) {
 				float rpm = st->fan_freq[i] * 60 / cfg->fans[i].rpm_factor;
 				snprintf(topic, sizeof(topic), cfg->mqtt_fan_rpm_topic, i + 1);
-				snprintf(buf, sizeof(buf), "%.0f", rpm);
+				float_to_str(buf, sizeof(buf), rpm, 0, 0);
 				mqtt_publish_message(topic, buf, strlen(buf), mqtt_qos, 0,
 						cfg->mqtt_fan_rpm_topic);
 			}
@@ -500,7 +547,7 @@ void fanpico_mqtt_publish_rpm()
 			if (cfg->mqtt_mbfan_rpm_mask & (1 << i)) {
 				float rpm = st->mbfan_freq[i] * 60 / cfg->mbfans[i].rpm_factor;
 				snprintf(topic, sizeof(topic), cfg->mqtt_mbfan_rpm_topic, i + 1);
-				snprintf(buf, sizeof(buf), "%.0f", rpm);
+				float_to_str(buf, sizeof(buf), rpm, 0, 0);
 				mqtt_publish_message(topic, buf, strlen(buf), mqtt_qos, 0,
 						cfg->mqtt_mbfan_rpm_topic);
 			}
@@ -521,7 +568,7 @@ void fanpico_mqtt_publish_duty()
 		for (int i = 0; i < FAN_COUNT; i++) {
 			if (cfg->mqtt_fan_duty_mask & (1 << i)) {
 				snprintf(topic, sizeof(topic), cfg->mqtt_fan_duty_topic, i + 1);
-				snprintf(buf, sizeof(buf), "%.1f", st->fan_duty[i]);
+				float_to_str(buf, sizeof(buf), st->fan_duty[i], 0, 1);
 				mqtt_publish_message(topic, buf, strlen(buf), mqtt_qos, 0,
 						cfg->mqtt_fan_duty_topic);
 			}
@@ -531,7 +578,7 @@ void fanpico_mqtt_publish_duty()
 		for (int i = 0; i < MBFAN_COUNT; i++) {
 			if (cfg->mqtt_mbfan_duty_mask & (1 << i)) {
 				snprintf(topic, sizeof(topic), cfg->mqtt_mbfan_duty_topic, i + 1);
-				snprintf(buf, sizeof(buf), "%.1f", st->mbfan_duty[i]);
+				float_to_str(buf, sizeof(buf), st->mbfan_duty[i], 0, 1);
 				mqtt_publish_message(topic, buf, strlen(buf), mqtt_qos, 0,
 						cfg->mqtt_mbfan_duty_topic);
 			}
@@ -0,0 +1,303 @@
+/* perf.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/mutex.h"
+#include "cJSON.h"
+
+#include "fanpico.h"
+
+
+/*
+ * Always-on performance counters for the control loops.
+ *
+ * Each stage keeps count, total and maximum execution time, and
+ * a histogram of execution times in power of two (microsecond) buckets.
+ * Stages are only updated from one core (core1 control loop stages,
+ * or core0 main loop stages), so no locking is needed. Readers may see
+ * slightly inconsistent values while counters are being updated.
+ * Mutex counters are updated from both cores without locking, so
+ * (rarely) an update may get lost.
+ */
+
+struct perf_stage_stats {
+	uint32_t count;
+	uint64_t total_us;
+	uint32_t max_us;
+	uint32_t hist[PERF_HIST_BUCKETS];
+};
+
+struct perf_mutex_stats {
+	uint32_t locks;
+	uint32_t contended;
+	uint32_t timeouts;
+	uint64_t wait_us;
+	uint32_t max_wait_us;
+};
+
+static const char *perf_stage_names[PERF_STAGE_COUNT] = {
+	"core1_loop",
+	"tacho_read",
+	"pwm_input",
+	"temp_read",
+	"vsensors",
+	"outputs",
+	"config_sync",
+	"state_publish",
+	"core0_loop",
+	"network",
+	"display",
+	"command",
+};
+
+static const char *perf_mutex_names[PERF_MUTEX_COUNT] = {
+	"config",
+	"state",
+	"fancal",
+};
+
+static struct perf_stage_stats perf_stages[PERF_STAGE_COUNT];
+static struct perf_mutex_stats perf_mutexes[PERF_MUTEX_COUNT];
+static uint64_t perf_reset_t = 0;
+
+volatile uint32_t perf_tacho_irqs[FAN_MAX_COUNT];
+
+
+void perf_reset()
+{
+	memset(perf_stages, 0, sizeof(perf_stages));
+	memset(perf_mutexes, 0, sizeof(perf_mutexes));
+	for (int i = 0; i < FAN_MAX_COUNT; i++)
+		perf_tacho_irqs[i] = 0;
+	perf_reset_t = time_us_64();
+}
+
+
+const char* perf_stage_name(enum perf_stages stage)
+{
+	return perf_stage_names[stage];
+}
+
+
+const char* perf_mutex_name(enum perf_mutexes id)
+{
+	return perf_mutex_names[id];
+}
+
+
+void perf_add(enum perf_stages stage, uint32_t us)
+{
+	struct perf_stage_stats *s = &perf_stages[stage];
+	uint b = (us > 0 ? 32 - __builtin_clz(us) : 0);
+
+	s->count++;
+	s->total_us += us;
+	if (us > s->max_us)
+		s->max_us = us;
+	s->hist[(b < PERF_HIST_BUCKETS ? b : PERF_HIST_BUCKETS - 1)]++;
+}
+
+
+uint32_t perf_begin(enum perf_stages stage)
+{
+	TRACE_BEGIN(stage, 0);
+	return time_us_32();
+}
+
+
+void perf_end(enum perf_stages stage, uint32_t t_start)
+{
+	perf_add(stage, time_us_32() - t_start);
+	TRACE_END(stage, 0);
+}
+
+
+static void perf_mutex_wait(enum perf_mutexes id, uint32_t t_start, bool acquired)
+{
+	struct perf_mutex_stats *m = &perf_mutexes[id];
+	uint32_t wait = time_us_32() - t_start;
+
+	m->contended++;
+	m->wait_us += wait;
+	if (wait > m->max_wait_us)
+		m->max_wait_us = wait;
+	if (acquired)
+		m->locks++;
+	else
+		m->timeouts++;
+}
+
+
+/* mutex_enter_blocking() that keeps track of lock contention. */
+void perf_mutex_enter_blocking(mutex_t *mtx, enum perf_mutexes id)
+{
+	uint32_t t_start;
+
+	if (mutex_try_enter(mtx, NULL)) {
+		perf_mutexes[id].locks++;
+		return;
+	}
+	TRACE_BEGIN(TRACE_MUTEX_WAIT + id, 0);
+	t_start = time_us_32();
+	mutex_enter_blocking(mtx);
+	perf_mutex_wait(id, t_start, true);
+	TRACE_END(TRACE_MUTEX_WAIT + id, 0);
+}
+
+
+/* mutex_enter_timeout_us() that keeps track of lock contention. */
+bool perf_mutex_enter_timeout_us(mutex_t *mtx, uint32_t timeout_us, enum perf_mutexes id)
+{
+	uint32_t t_start;
+	bool res;
+
+	if (mutex_try_enter(mtx, NULL)) {
+		perf_mutexes[id].locks++;
+		return true;
+	}
+	TRACE_BEGIN(TRACE_MUTEX_WAIT + id, 0);
+	t_start = time_us_32();
+	res = mutex_enter_timeout_us(mtx, timeout_us);
+	perf_mutex_wait(id, t_start, res);
+	TRACE_END(TRACE_MUTEX_WAIT + id, res ? 0 : 1);
+
+	return res;
+}
+
+
+static double perf_elapsed()
+{
+	return (time_us_64() - perf_reset_t) / 1000000.0;
+}
+
+
+void perf_print()
+{
+	double elapsed = perf_elapsed();
+	char s1[16], s2[16];
+	int i, j;
+
+	printf("Elapsed: %ss\n\n", float_to_str(s1, sizeof(s1), elapsed, 0, 1));
+
+	printf("%-14s %10s %10s %8s %10s\n", "Stage", "Count", "Avg(us)", "Max(us)", "Rate(/s)");
+	for (i = 0; i < PERF_STAGE_COUNT; i++) {
+		const struct perf_stage_stats *s = &perf_stages[i];
+
+		printf("%-14s %10lu %s %8lu %s\n", perf_stage_names[i],
+			s->count,
+			fixed_to_str(s1, sizeof(s1),
+				(s->count > 0 ? (s->total_us * 10 + s->count / 2) / s->count : 0), 1, 10, 1),
+			s->max_us,
+			float_to_str(s2, sizeof(s2),
+				(elapsed > 0 ? s->count / elapsed : 0.0), 10, 1));
+	}
+
+	printf("\nHistogram (us): 0");
+	for (j = 1; j < PERF_HIST_BUCKETS; j++)
+		printf(",%s%u", (j < PERF_HIST_BUCKETS - 1 ? "<" : ">="),
+			(j < PERF_HIST_BUCKETS - 1 ? 1 << j : 1 << (j - 1)));
+	printf("\n");
+	for (i = 0; i < PERF_STAGE_COUNT; i++) {
+		printf("%-14s ", perf_stage_names[i]);
+		for (j = 0; j < PERF_HIST_BUCKETS; j++)
+			printf("%s%lu", (j > 0 ? "," : ""), perf_stages[i].hist[j]);
+		printf("\n");
+	}
+
+	printf("\n%-14s %10s %10s %8s %10s %8s\n", "Mutex", "Locks", "Contended",
+		"Timeouts", "Wait(us)", "Max(us)");
+	for (i = 0; i < PERF_MUTEX_COUNT; i++) {
+		const struct perf_mutex_stats *m = &perf_mutexes[i];
+
+		printf("%-14s %10lu %10lu %8lu %s %8lu\n", perf_mutex_names[i],
+			m->locks, m->contended, m->timeouts,
+			fixed_to_str(s1, sizeof(s1),
+				(m->contended > 0 ? (m->wait_us * 10 + m->contended / 2) / m->contended : 0), 1, 10, 1),
+			m->max_wait_us);
+	}
+
+	printf("\nTacho IRQs:");
+	for (i = 0; i < FAN_COUNT; i++)
+		printf("%s%lu", (i > 0 ? "," : " "), perf_tacho_irqs[i]);
+	printf("\n");
+}
+
+
+cJSON *perf_to_json()
+{
+	cJSON *json, *array, *o, *h;
+	int i, j;
+
+	if (!(json = cJSON_CreateObject()))
+		return NULL;
+
+	cJSON_AddItemToObject(json, "elapsed", cJSON_CreateNumber(round_decimal(perf_elapsed(), 3)));
+
+	if ((array = cJSON_CreateArray())) {
+		for (i = 0; i < PERF_STAGE_COUNT; i++) {
+			const struct perf_stage_stats *s = &perf_stages[i];
+
+			if (!(o = cJSON_CreateObject()))
+				break;
+			cJSON_AddItemToObject(o, "stage", cJSON_CreateString(perf_stage_names[i]));
+			cJSON_AddItemToObject(o, "count", cJSON_CreateNumber(s->count));
+			cJSON_AddItemToObject(o, "total_us", cJSON_CreateNumber(s->total_us));
+			cJSON_AddItemToObject(o, "max_us", cJSON_CreateNumber(s->max_us));
+			if ((h = cJSON_CreateArray())) {
+				for (j = 0; j < PERF_HIST_BUCKETS; j++)
+					cJSON_AddItemToArray(h, cJSON_CreateNumber(s->hist[j]));
+				cJSON_AddItemToObject(o, "histogram", h);
+			}
+			cJSON_AddItemToArray(array, o);
+		}
+		cJSON_AddItemToObject(json, "stages", array);
+	}
+
+	if ((array = cJSON_CreateArray())) {
+		for (i = 0; i < PERF_MUTEX_COUNT; i++) {
+			const struct perf_mutex_stats *m = &perf_mutexes[i];
+
+			if (!(o = cJSON_CreateObject()))
+				break;
+			cJSON_AddItemToObject(o, "mutex", cJSON_CreateString(perf_mutex_names[i]));
+			cJSON_AddItemToObject(o, "locks", cJSON_CreateNumber(m->locks));
+			cJSON_AddItemToObject(o, "contended", cJSON_CreateNumber(m->contended));
+			cJSON_AddItemToObject(o, "timeouts", cJSON_CreateNumber(m->timeouts));
+			cJSON_AddItemToObject(o, "wait_us", cJSON_CreateNumber(m->wait_us));
+			cJSON_AddItemToObject(o, "max_wait_us", cJSON_CreateNumber(m->max_wait_us));
+			cJSON_AddItemToArray(array, o);
+		}
+		cJSON_AddItemToObject(json, "mutexes", array);
+	}
+
+	if ((array = cJSON_CreateArray())) {
+		for (i = 0; i < FAN_COUNT; i++)
+			cJSON_AddItemToArray(array, cJSON_CreateNumber(perf_tacho_irqs[i]));
+		cJSON_AddItemToObject(json, "tacho_irqs", array);
+	}
+
+	return json;
+}
+
+
+/* eof :-) */
@@ -22,6 +22,8 @@
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
 
+#include "fanpico.h"
+
 
 /*
  * Functions for measuring pulses on GPIO pins.
@@ -104,6 +106,7 @@ void __time_critical_func(pulse_measure_callback)(uint gpio, uint32_t events)
 	if (gpio != pulse_pin || pulse_counter > 1)
 		return;
 
+	TRACE_BEGIN(TRACE_IRQ_PULSE, gpio);
 	if (pulse_counter == 0) {
 		pulse_start = get_absolute_time();
 		pulse_counter++;
@@ -113,6 +116,7 @@ void __time_critical_func(pulse_measure_callback)(uint gpio, uint32_t events)
 		measure_complete = true;
 		pulse_counter++;
 	}
+	TRACE_END(TRACE_IRQ_PULSE, gpio);
 }
 
 /* Setup a GPIO pin to be used for measurements */
@@ -20,16 +20,20 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
+#include "hardware/dma.h"
 #include "hardware/clocks.h"
 
 #include "fanpico.h"
 
 #define PWM_IN_CLOCK_DIVIDER 100
 #define PWM_IN_SAMPLE_INTERVAL 10 /* milliseconds */
+#define PWM_DITHER_STEPS 16       /* length of dithering sequence (PWM periods) */
+#define PWM_OUT_SLICES (FAN_MAX_COUNT / 2)
 
 
 /*
@@ -69,14 +73,178 @@ float mbfan_pwm_duty[MBFAN_MAX_COUNT];
 uint pwm_out_top = 0;
 float pwm_in_count_rate = 0;
 
+/* Requested output levels (in PWM counter steps, with fractional part). */
+static float fan_pwm_level[FAN_MAX_COUNT];
+
+/* Outputs with inverted polarity (pulse centered half period later). */
+static bool fan_pwm_inverted[FAN_MAX_COUNT];
+
+/* Current phase offsets of output PWM slices (in counter steps). */
+static uint pwm_slice_phase[PWM_OUT_SLICES];
+
+
+/*
+ * PWM output dithering.
+ *
+ * Compare values of all output PWM slices are updated on every PWM period
+ * by DMA from a sequence of PWM_DITHER_STEPS levels per output. Sequence
+ * is generated using (first order) sigma-delta modulation, so that average
+ * output level has resolution of 1/PWM_DITHER_STEPS of hardware PWM step.
+ *
+ * Only two DMA channels are used: data channel writes a compare value
+ * to a PWM slice, and control channel reprograms data channel from a list
+ * of control blocks. First block of each period is paced by PWM (wrap)
+ * DREQ, and last block in the list restarts the control channel.
+ */
+
+struct pwm_dither_block {
+	const volatile void *read_addr;
+	volatile void *write_addr;
+	uint32_t transfer_count;
+	uint32_t ctrl_trig;
+};
+
+static struct pwm_dither_block dither_blocks[PWM_DITHER_STEPS * PWM_OUT_SLICES + 1];
+static uint32_t dither_levels[PWM_DITHER_STEPS][PWM_OUT_SLICES];
+static const struct pwm_dither_block *dither_start = dither_blocks;
+static int dither_data_ch = -1;
+static int dither_ctrl_ch = -1;
+static bool dither_active = false;
+static bool dither_failed = false;
+
+
+/* Generate dithering sequence for outputs of a PWM slice. */
+static void pwm_dither_update(uint slice)
+{
+	uint32_t words[PWM_DITHER_STEPS];
+	int i, s;
+
+	memset(words, 0, sizeof(words));
+	for (i = slice * 2; i < slice * 2 + 2; i++) {
+		uint shift = (pwm_gpio_to_channel(fan_gpio_pwm_map[i]) ? 16 : 0);
+		uint base = fan_pwm_level[i];
+		float frac = fan_pwm_level[i] - base;
+		float err = 0.0;
+
+		for (s = 0; s < PWM_DITHER_STEPS; s++) {
+			uint level = base;
+
+			err += frac;
+			if (err >= 0.5) {
+				level++;
+				err -= 1.0;
+			}
+			words[s] |= level << shift;
+		}
+	}
+
+	for (s = 0; s < PWM_DITHER_STEPS; s++)
+		dither_levels[s][slice] = words[s];
+}
+
+
+static bool pwm_dither_start()
+{
+	struct pwm_dither_block *b = dither_blocks;
+	dma_channel_config c;
+	uint slice;
+	int s, k;
+
+	if (dither_data_ch < 0) {
+		if ((dither_data_ch = dma_claim_unused_channel(false)) < 0)
+			return false;
+		if ((dither_ctrl_ch = dma_claim_unused_channel(false)) < 0) {
+			dma_channel_unclaim(dither_data_ch);
+			dither_data_ch = -1;
+			return false;
+		}
+	}
+
+	for (k = 0; k < FAN_COUNT / 2; k++)
+		pwm_dither_update(k);
+
+	for (s = 0; s < PWM_DITHER_STEPS; s++) {
+		for (k = 0; k < FAN_COUNT / 2; k++) {
+			slice = pwm_gpio_to_slice_num(fan_gpio_pwm_map[k * 2]);
+			c = dma_channel_get_default_config(dither_data_ch);
+			channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+			channel_config_set_read_increment(&c, false);
+			channel_config_set_write_increment(&c, false);
+			channel_config_set_dreq(&c, (k == 0 ? pwm_get_dreq(slice) : DREQ_FORCE));
+			channel_config_set_chain_to(&c, dither_ctrl_ch);
+			b->read_addr = &dither_levels[s][k];
+			b->write_addr = &pwm_hw->slice[slice].cc;
+			b->transfer_count = 1;
+			b->ctrl_trig = channel_config_get_ctrl_value(&c);
+			b++;
+		}
+	}
+
+	/* Last block restarts control channel from the first block */
+	c = dma_channel_get_default_config(dither_data_ch);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_chain_to(&c, dither_ctrl_ch);
+	b->read_addr = &dither_start;
+	b->write_addr = &dma_hw->ch[dither_ctrl_ch].read_addr;
+	b->transfer_count = 1;
+	b->ctrl_trig = channel_config_get_ctrl_value(&c);
+
+	/* Control channel writes a block to data channel registers
+	   (read_addr, write_addr, transfer_count, ctrl_trig) */
+	c = dma_channel_get_default_config(dither_ctrl_ch);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, true);
+	channel_config_set_write_increment(&c, true);
+	channel_config_set_ring(&c, true, 4);
+	dma_channel_configure(dither_ctrl_ch, &c, &dma_hw->ch[dither_data_ch].read_addr,
+			dither_start, sizeof(struct pwm_dither_block) / sizeof(uint32_t), true);
+
+	return true;
+}
+
+
+static void pwm_dither_stop()
+{
+	/* Stop control channel first, so that it won't restart data channel */
+	dma_channel_abort(dither_ctrl_ch);
+	dma_channel_abort(dither_data_ch);
+	dma_channel_abort(dither_ctrl_ch);
+
+	for (int i = 0; i < FAN_COUNT; i++)
+		pwm_set_gpio_level(fan_gpio_pwm_map[i], fan_pwm_level[i]);
+}
+
+
+/* Enable/disable dithering of PWM output signals.
+ */
+void set_pwm_dither(bool enabled)
+{
+	if (enabled == dither_active || dither_failed)
+		return;
+
+	if (dither_active) {
+		pwm_dither_stop();
+		dither_active = false;
+		log_msg(LOG_INFO, "PWM output dithering disabled");
+	} else if (pwm_dither_start()) {
+		dither_active = true;
+		log_msg(LOG_INFO, "PWM output dithering enabled");
+	} else {
+		dither_failed = true;
+		log_msg(LOG_WARNING, "PWM output dithering not available (no free DMA channels)");
+	}
+}
+
+
 /* Set PMW output signal duty cycle.
  */
 void set_pwm_duty_cycle(uint fan, float duty)
 {
-	uint level, pin;
+	float level;
 
 	assert(fan < FAN_COUNT);
-	pin = fan_gpio_pwm_map[fan];
 	if (duty >= 100.0) {
 		level = pwm_out_top + 1;
 	} else if (duty > 0.0) {
@@ -84,7 +252,86 @@ void set_pwm_duty_cycle(uint fan, float duty)
 	} else {
 		level = 0;
 	}
-	pwm_set_gpio_level(pin, level);
+	if (fan_pwm_inverted[fan])
+		level = pwm_out_top + 1 - level;
+
+	if (level == fan_pwm_level[fan])
+		return;
+	fan_pwm_level[fan] = level;
+
+	if (dither_active)
+		pwm_dither_update(fan / 2);
+	else
+		pwm_set_gpio_level(fan_gpio_pwm_map[fan], level);
+}
+
+
+/* Phase offset (in degrees) of an output PWM slice.
+ */
+static uint pwm_slice_phase_deg(const struct fanpico_config *config, int k)
+{
+	/* Spread slices evenly over half period, as channel B outputs
+	   are inverted to cover the other half. */
+	if (config->pwm_phase_auto)
+		return k * 180 / (FAN_COUNT / 2);
+
+	return config->pwm_phase[k];
+}
+
+
+/* Set polarity of channel B outputs. Output levels are inverted
+ * as well, so that duty cycles of the outputs do not change.
+ */
+static void set_pwm_polarity(bool invert_b)
+{
+	for (int k = 0; k < FAN_COUNT / 2; k++) {
+		uint pin1 = fan_gpio_pwm_map[k * 2];
+		uint slice = pwm_gpio_to_slice_num(pin1);
+		int i = (pwm_gpio_to_channel(pin1) ? k * 2 : k * 2 + 1);
+
+		if (fan_pwm_inverted[i] == invert_b)
+			continue;
+		log_msg(LOG_INFO, "PWM slice %u: channel B polarity %s", slice,
+			(invert_b ? "inverted" : "normal"));
+		fan_pwm_inverted[i] = invert_b;
+		fan_pwm_level[i] = pwm_out_top + 1 - fan_pwm_level[i];
+		pwm_set_output_polarity(slice, false, invert_b);
+		if (dither_active)
+			pwm_dither_update(k);
+		else
+			pwm_set_gpio_level(fan_gpio_pwm_map[i], fan_pwm_level[i]);
+	}
+}
+
+
+/* Apply configured phase offsets to output PWM slices.
+ *
+ * Phase is shifted by retarding slice counter (one count at a time),
+ * which only stretches current PWM period, so no glitches (runt pulses)
+ * are generated on outputs.
+ *
+ * In AUTO mode channel B outputs are inverted, so switching to/from
+ * AUTO mode also changes their polarity.
+ */
+void set_pwm_phases(const struct fanpico_config *config)
+{
+	uint period = (pwm_out_top + 1) * 2;  /* phase-correct PWM */
+	uint slice, phase, delta;
+
+	set_pwm_polarity(config->pwm_phase_auto);
+
+	for (int k = 0; k < FAN_COUNT / 2; k++) {
+		slice = pwm_gpio_to_slice_num(fan_gpio_pwm_map[k * 2]);
+		phase = period * pwm_slice_phase_deg(config, k) / 360;
+		delta = (phase + period - pwm_slice_phase[k]) % period;
+		if (delta == 0)
+			continue;
+		log_msg(LOG_INFO, "PWM slice %u: phase offset %u --> %u", slice,
+			pwm_slice_phase[k], phase);
+		for (uint c = 0; c < delta; c++)
+			pwm_retard_count(slice);
+		pwm_slice_phase[k] = phase;
+	}
 }
 
 
@@ -192,6 +439,7 @@ void setup_pwm_outputs()
 	uint32_t sys_clock = clock_get_hz(clk_sys);
 	pwm_config config = pwm_get_default_config();
 	uint pwm_freq = 25000;
+	uint32_t mask = 0;
 	uint slice_num;
 	int i;
 
@@ -215,9 +463,23 @@ void setup_pwm_outputs()
 		slice_num = pwm_gpio_to_slice_num(pin1);
 		/* two consecutive pins must belong to same PWM slice... */
 		assert(slice_num == pwm_gpio_to_slice_num(pin2));
-		pwm_init(slice_num, &config, true);
+		pwm_init(slice_num, &config, false);
+		mask |= (1 << slice_num);
 	}
 
+	/* Start outputs at 0% duty cycle */
+	for (i = 0; i < FAN_COUNT; i++) {
+		fan_pwm_inverted[i] = false;
+		fan_pwm_level[i] = 0;
+		pwm_set_gpio_level(fan_gpio_pwm_map[i], fan_pwm_level[i]);
+	}
+
+	/* Start all slices simultaneously and then stagger their phases
+	   to avoid all fans drawing current at the same time (in AUTO mode
+	   channel B outputs are also inverted to move their pulses half
+	   period away from channel A pulses) */
+	pwm_set_mask_enabled(mask);
+	set_pwm_phases(cfg);
 }
 
 
@@ -276,46 +538,296 @@ double pwm_map(const struct pwm_map *map, double val)
 }
 
 
-double calculate_pwm_duty(struct fanpico_state *state, const struct fanpico_config *config, int i)
+/* Limit rate of change of fan output duty cycle (separately for increase
+ * and decrease). Optionally, hold output after an increase for minimum
+ * dwell time before allowing it to decrease.
+ */
+double fan_output_limits(struct fanpico_state *state, const struct fanpico_config *config,
+			int i, double duty)
 {
-	const struct fan_output *fan;
-	double val = 0;
+	const struct fan_output *fan = &config->fans[i];
+	absolute_time_t t_now = get_absolute_time();
+	double prev = state->fan_duty_slew[i];
+	double dt;
+
+	if (to_us_since_boot(state->fan_slew_t[i]) == 0) {
+		/* First update, no limits... */
+		state->fan_slew_t[i] = t_now;
+		state->fan_duty_slew[i] = duty;
+		return duty;
+	}
+	dt = absolute_time_diff_us(state->fan_slew_t[i], t_now) / 1000000.0;
+	state->fan_slew_t[i] = t_now;
+
+	if (duty > prev) {
+		if (fan->slew_up > 0.0 && duty - prev > fan->slew_up * dt)
+			duty = prev + fan->slew_up * dt;
+		state->fan_up_t[i] = t_now;
+	} else if (duty < prev) {
+		if (fan->min_dwell > 0 && absolute_time_diff_us(state->fan_up_t[i], t_now)
+			< (int64_t)fan->min_dwell * 1000000)
+			duty = prev;
+		else if (fan->slew_down > 0.0 && prev - duty > fan->slew_down * dt)
+			duty = prev - fan->slew_down * dt;
+	}
 
-	fan = &config->fans[i];
+	state->fan_duty_slew[i] = duty;
+	return duty;
+}
 
-	/* Get source value  */
-	switch (fan->s_type) {
+
+/* Check if two fans belong to same group: same fan zone, or (if not
+ * in any zone) same non-fixed source (for example same MB fan input).
+ */
+static bool fan_same_group(const struct fanpico_config *config, int a, int b)
+{
+	const struct fan_output *fa = &config->fans[a];
+	const struct fan_output *fb = &config->fans[b];
+
+	if (fa->zone >= 0 || fb->zone >= 0)
+		return (fa->zone == fb->zone);
+
+	return (fa->s_type != PWM_FIXED && fa->s_type == fb->s_type
+		&& fa->s_id == fb->s_id);
+}
+
+
+/* Detect failed (stalled) fans: no tacho signal while fan is driven
+ * above the configured duty cycle threshold.
+ */
+void update_fan_failures(struct fanpico_state *state, const struct fanpico_config *config)
+{
+	absolute_time_t t_now = get_absolute_time();
+	int64_t t;
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		if (config->fan_fail_duty == 0 || fancal_active(i)
+			|| state->fan_duty[i] < config->fan_fail_duty
+			|| state->fan_freq[i] > 0.0) {
+			if (state->fan_failed[i]) {
+				log_msg(LOG_NOTICE, "fan%d: recovered, failure compensation removed",
+					i + 1);
+				state->fan_failed[i] = false;
+			}
+			state->fan_fail_t[i] = from_us_since_boot(0);
+			continue;
+		}
+
+		if (to_us_since_boot(state->fan_fail_t[i]) == 0) {
+			state->fan_fail_t[i] = t_now;
+			continue;
+		}
+		t = absolute_time_diff_us(state->fan_fail_t[i], t_now) / 1000;
+		if (!state->fan_failed[i] && t >= FAN_FAIL_TIME) {
+			char duty[16];
+
+			state->fan_failed[i] = true;
+			log_msg(LOG_ALERT, "fan%d: failure detected (no tacho signal at %s%% duty cycle), compensating in %lld ms",
+				i + 1, float_to_str(duty, sizeof(duty), state->fan_duty[i], 0, 1), t);
+		}
+	}
+}
+
+
+/* Boost fan output if another fan in the same group has failed. */
+double fan_failure_boost(const struct fanpico_state *state, const struct fanpico_config *config,
+			int i, double duty)
+{
+	const struct fan_output *fan = &config->fans[i];
+
+	if (config->fan_fail_duty == 0 || state->fan_failed[i])
+		return duty;
+
+	for (int j = 0; j < FAN_COUNT; j++) {
+		if (j == i || !state->fan_failed[j] || !fan_same_group(config, i, j))
+			continue;
+		if (config->fan_fail_boost >= 100)
+			duty = 100.0;
+		else
+			duty += config->fan_fail_boost;
+		if (duty > fan->max_pwm)
+			duty = fan->max_pwm;
+		break;
+	}
+
+	return duty;
+}
+
+
+const char* fan_start_state2str(enum fan_start_states state)
+{
+	if (state == FAN_START_KICK)
+		return "KICK";
+	else if (state == FAN_START_STALLED)
+		return "STALLED";
+
+	return "OK";
+}
+
+
+/* Start assist for fans that don't start reliably at low duty cycle.
+ * When stopped (or stalled) fan is set to duty cycle below kick duty,
+ * kick duty is applied until tacho confirms fan is spinning (or kick time
+ * expires). If fan fails to start, kick is retried periodically.
+ */
+double fan_start_assist(struct fanpico_state *state, const struct fanpico_config *config,
+			int i, double duty)
+{
+	const struct fan_output *fan = &config->fans[i];
+	enum fan_start_states *fs = &state->fan_start_state[i];
+	absolute_time_t t_now = get_absolute_time();
+	int64_t t = absolute_time_diff_us(state->fan_start_t[i], t_now) / 1000;
+	bool spinning = (state->fan_freq[i] > 0.0);
+
+	if (fan->kick_duty == 0 || duty < 1.0 || duty >= fan->kick_duty) {
+		*fs = FAN_START_IDLE;
+		state->fan_start_t[i] = t_now;
+		return duty;
+	}
+
+	switch (*fs) {
+	case FAN_START_IDLE:
+		if (spinning) {
+			state->fan_start_t[i] = t_now;
+			break;
+		}
+		/* Kick immediately if fan was turned off, otherwise wait
+		   to see if fan has really stalled. */
+		if (state->fan_duty_prev[i] >= 1.0) {
+			char buf[16];
+
+			if (t < FAN_STALL_TIME)
+				break;
+			state->fan_stalls[i]++;
+			log_msg(LOG_WARNING, "fan%d: stalled at %s%% duty cycle",
+				i + 1, float_to_str(buf, sizeof(buf), duty, 0, 1));
+		}
+		*fs = FAN_START_KICK;
+		state->fan_start_t[i] = t_now;
+		return fan->kick_duty;
+
+	case FAN_START_KICK:
+		if (spinning && t >= FAN_KICK_MIN_TIME) {
+			log_msg(LOG_INFO, "fan%d: started (%lld ms)", i + 1, t);
+			*fs = FAN_START_IDLE;
+			state->fan_start_t[i] = t_now;
+			break;
+		}
+		if (t < fan->kick_time)
+			return fan->kick_duty;
+		log_msg(LOG_WARNING, "fan%d: failed to start", i + 1);
+		state->fan_stalls[i]++;
+		*fs = FAN_START_STALLED;
+		state->fan_start_t[i] = t_now;
+		break;
+
+	case FAN_START_STALLED:
+		if (spinning) {
+			*fs = FAN_START_IDLE;
+			state->fan_start_t[i] = t_now;
+			break;
+		}
+		if (t < fan->kick_retry * 1000)
+			break;
+		*fs = FAN_START_KICK;
+		state->fan_start_t[i] = t_now;
+		return fan->kick_duty;
+	}
+
+	return duty;
+}
+
+
+static double pwm_source_value(const struct fanpico_state *state,
+			const struct fanpico_config *config,
+			enum pwm_source_types s_type, uint16_t s_id)
+{
+	double val = 0;
+
+	switch (s_type) {
 	case PWM_FIXED:
-		val = fan->s_id;
+		val = s_id;
 		break;
 	case PWM_MB:
-		val = state->mbfan_duty[fan->s_id];
+		val = state->mbfan_duty[s_id];
 		break;
 	case PWM_SENSOR:
-		val = sensor_get_duty(&config->sensors[fan->s_id].map, state->temp[fan->s_id]);
+		val = sensor_get_duty(&config->sensors[s_id].map, state->temp_hyst[s_id]);
+		val += sensor_feed_forward(state->temp_rate[s_id],
+					config->sensors[s_id].ff_gain,
+					config->sensors[s_id].ff_max);
+		if (val > 100.0)
+			val = 100.0;
 		break;
 	case PWM_VSENSOR:
-		val = sensor_get_duty(&config->vsensors[fan->s_id].map, state->vtemp[fan->s_id]);
+		val = sensor_get_duty(&config->vsensors[s_id].map, state->vtemp_hyst[s_id]);
+		val += sensor_feed_forward(state->vtemp_rate[s_id],
+					config->vsensors[s_id].ff_gain,
+					config->vsensors[s_id].ff_max);
+		if (val > 100.0)
+			val = 100.0;
 		break;
 	case PWM_FAN:
-		val = state->fan_duty[fan->s_id];
+		val = state->fan_duty[s_id];
 		break;
 	}
 
-	/* Apply filter */
-	if (fan->filter != FILTER_NONE) {
-		double f_val = filter(fan->filter, fan->filter_ctx, val);
+	return val;
+}
+
+
+/* Calculate (shared) control signal for a fan zone. This is evaluated
+ * once per update, and then used by all fans that are members of the zone.
+ */
+double calculate_zone_duty(struct fanpico_state *state, const struct fanpico_config *config, int z)
+{
+	const struct fan_zone *zone = &config->zones[z];
+	double val;
+
+	val = pwm_source_value(state, config, zone->s_type, zone->s_id);
+
+	if (zone->filter != FILTER_NONE) {
+		double f_val = filter(zone->filter, zone->filter_ctx, val);
 		if (f_val != val) {
-			log_msg(LOG_DEBUG, "filter fan%d: %lf -> %lf\n", i+1, val, f_val);
+			log_msg(LOG_DEBUG, "filter zone%d: %lf -> %lf\n", z+1, val, f_val);
 			val = f_val;
 		}
 	}
 
+	return val;
+}
+
+
+double calculate_pwm_duty(struct fanpico_state *state, const struct fanpico_config *config, int i)
+{
+	const struct fan_output *fan;
+	double val = 0;
+
+	fan = &config->fans[i];
+
+	if (fan->zone >= 0 && fan->zone < ZONE_COUNT) {
+		/* Use zone control signal (already filtered) */
+		val = state->zone_duty[fan->zone];
+	} else {
+		/* Get source value  */
+		val = pwm_source_value(state, config, fan->s_type, fan->s_id);
+
+		/* Apply filter */
+		if (fan->filter != FILTER_NONE) {
+			double f_val = filter(fan->filter, fan->filter_ctx, val);
+			if (f_val != val) {
+				log_msg(LOG_DEBUG, "filter fan%d: %lf -> %lf\n", i+1, val, f_val);
+				val = f_val;
+			}
+		}
+	}
+
 	/* Apply mapping */
 	val = pwm_map(&fan->map, val);
 
-	/* Apply coefficient */
+	/* Apply coefficient and offset */
 	val *= fan->pwm_coefficient;
+	val += fan->offset;
 
 	/* Final step to enforce min/max limits for output */
 	if (val < fan->min_pwm) val = fan->min_pwm;
@@ -0,0 +1,172 @@
+/* sched.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "fanpico.h"
+
+
+/*
+ * Cooperative (run-to-completion) task scheduler for core0.
+ *
+ * Each call to sched_run() runs (at most) one task: the highest priority
+ * task that is due (tasks with same priority are run in order of
+ * their due time). So, a task can only delay higher priority tasks
+ * by its own (single) execution time.
+ *
+ * Long running jobs should be split into slices: task function returns
+ * true if it has more work pending, and it is then run again as soon as
+ * no higher priority tasks are due. Task is considered to be finished
+ * once it returns false, and it becomes due again after its period
+ * (measured from the previous due time).
+ *
+ * Task is "late" if it starts later than its deadline (after becoming due).
+ */
+
+#define SCHED_MAX_TASKS 12
+
+struct sched_task {
+	const char *name;
+	sched_task_func_t func;
+	uint8_t priority;
+	uint32_t period_us;
+	uint32_t deadline_us;
+	uint64_t t_due;
+	bool pending;
+	/* statistics */
+	uint32_t runs;
+	uint32_t slices;
+	uint64_t total_us;
+	uint32_t max_us;
+	uint32_t late;
+	uint32_t max_late_us;
+};
+
+static struct sched_task sched_tasks[SCHED_MAX_TASKS];
+static int sched_task_count = 0;
+
+
+int sched_add_task(const char *name, sched_task_func_t func, uint8_t priority,
+		uint32_t period_ms, uint32_t deadline_ms)
+{
+	struct sched_task *t;
+
+	if (!name || !func || sched_task_count >= SCHED_MAX_TASKS)
+		return -1;
+
+	t = &sched_tasks[sched_task_count];
+	memset(t, 0, sizeof(*t));
+	t->name = name;
+	t->func = func;
+	t->priority = priority;
+	t->period_us = period_ms * 1000;
+	t->deadline_us = deadline_ms * 1000;
+	t->t_due = time_us_64();
+
+	return sched_task_count++;
+}
+
+
+/* Run highest priority task that is due. Returns true if a task was run. */
+bool sched_run()
+{
+	struct sched_task *t = NULL;
+	uint64_t t_now = time_us_64();
+	uint64_t t_start, t_end;
+	uint32_t us;
+
+	for (int i = 0; i < sched_task_count; i++) {
+		struct sched_task *c = &sched_tasks[i];
+
+		if (!c->pending && c->t_due > t_now)
+			continue;
+		if (!t || c->priority < t->priority ||
+			(c->priority == t->priority && c->t_due < t->t_due))
+			t = c;
+	}
+	if (!t)
+		return false;
+
+	t_start = time_us_64();
+	if (!t->pending) {
+		/* New run (not a continuation of a sliced run) */
+		us = t_start - t->t_due;
+		if (us > t->deadline_us)
+			t->late++;
+		if (us > t->max_late_us)
+			t->max_late_us = us;
+		t->runs++;
+	}
+	t->slices++;
+
+	t->pending = t->func();
+
+	t_end = time_us_64();
+	us = t_end - t_start;
+	t->total_us += us;
+	if (us > t->max_us)
+		t->max_us = us;
+
+	if (!t->pending) {
+		t->t_due += t->period_us;
+		/* Do not try to "catch up" if we have fallen behind... */
+		if (t->t_due <= t_end)
+			t->t_due = t_end + t->period_us;
+	}
+
+	return true;
+}
+
+
+void sched_reset_stats()
+{
+	for (int i = 0; i < sched_task_count; i++) {
+		struct sched_task *t = &sched_tasks[i];
+
+		t->runs = t->slices = t->late = 0;
+		t->total_us = 0;
+		t->max_us = t->max_late_us = 0;
+	}
+}
+
+
+void sched_print()
+{
+	char avg[16];
+
+	printf("%-14s %4s %10s %8s %8s %8s %8s %6s %8s\n", "Task", "Prio",
+		"Period(ms)", "Runs", "Slices", "Avg(us)", "Max(us)", "Late", "MaxLate");
+	for (int i = 0; i < sched_task_count; i++) {
+		const struct sched_task *t = &sched_tasks[i];
+
+		printf("%-14s %4u %10lu %8lu %8lu %s %8lu %6lu %8lu\n", t->name,
+			t->priority, t->period_us / 1000, t->runs, t->slices,
+			fixed_to_str(avg, sizeof(avg),
+				(t->slices > 0 ? (t->total_us * 10 + t->slices / 2) / t->slices : 0),
+				1, 8, 1),
+			t->max_us, t->late, t->max_late_us);
+	}
+}
+
+
+/* eof :-) */
@@ -119,6 +119,77 @@ double sensor_get_duty(const struct temp_map *map, double temp)
 }
 
 
+/* Apply hysteresis to temperature used for temp_map evaluation:
+ * rising temperature is followed immediately, but falling temperature
+ * only after it has dropped more than 'band' degrees.
+ */
+double temp_hysteresis(double prev, double temp, double band)
+{
+	if (band <= 0.0 || temp > prev)
+		return temp;
+	if (temp < prev - band)
+		return temp + band;
+
+	return prev;
+}
+
+
+void temp_slope_add(struct temp_slope *s, double temp, uint32_t t_ms)
+{
+	s->temp[s->head] = temp;
+	s->t[s->head] = t_ms;
+	s->head = (s->head + 1) % TEMP_SLOPE_SAMPLES;
+	if (s->count < TEMP_SLOPE_SAMPLES)
+		s->count++;
+}
+
+
+/* Estimate temperature rate of change (C/min) using least squares
+ * linear regression over recent samples.
+ */
+double temp_slope_rate(const struct temp_slope *s)
+{
+	double t_mean = 0.0, y_mean = 0.0, sxy = 0.0, sxx = 0.0;
+	uint32_t t0;
+	int i, n;
+
+	if (s->count < 3)
+		return 0.0;
+
+	i = (s->head + TEMP_SLOPE_SAMPLES - s->count) % TEMP_SLOPE_SAMPLES;
+	t0 = s->t[i];
+	for (n = 0; n < s->count; n++) {
+		t_mean += (s->t[(i + n) % TEMP_SLOPE_SAMPLES] - t0) / 60000.0;
+		y_mean += s->temp[(i + n) % TEMP_SLOPE_SAMPLES];
+	}
+	t_mean /= s->count;
+	y_mean /= s->count;
+
+	for (n = 0; n < s->count; n++) {
+		double dt = (s->t[(i + n) % TEMP_SLOPE_SAMPLES] - t0) / 60000.0 - t_mean;
+		sxy += dt * (s->temp[(i + n) % TEMP_SLOPE_SAMPLES] - y_mean);
+		sxx += dt * dt;
+	}
+
+	return (sxx > 0.0 ? sxy / sxx : 0.0);
+}
+
+
+/* Calculate feed-forward term (duty cycle headroom) from temperature
+ * rate of change. Only rising temperature adds headroom.
+ */
+double sensor_feed_forward(double rate, double gain, double max)
+{
+	double val;
+
+	if (gain <= 0.0 || rate <= 0.0)
+		return 0.0;
+	val = rate * gain;
+
+	return (val > max ? max : val);
+}
+
+
 double get_vsensor(uint8_t i, struct fanpico_config *config,
 		struct fanpico_state *state)
 {
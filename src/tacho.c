@@ -26,7 +26,7 @@
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
 #include "hardware/pio.h"
-#include "square_wave_gen.h"
+#include "tacho_gen.h"
 #include "pulse_len.h"
 #include "fanpico.h"
 
@@ -119,9 +119,13 @@ void multiplexer_select(uint8_t port)
 void __time_critical_func(fan_tacho_read_callback)(uint gpio, uint32_t events)
 {
 	uint fan = gpio_fan_tacho_map[(gpio & 0x1f)];
+
+	TRACE_BEGIN(TRACE_IRQ_TACHO, fan);
 	if (fan > 0) {
 		fan_tacho_counters[fan-1]++;
+		perf_tacho_irqs[fan-1]++;
 	}
+	TRACE_END(TRACE_IRQ_TACHO, fan);
 }
 
 
@@ -235,10 +239,12 @@ void update_tacho_input_freq(struct fanpico_state *st)
 	for (int i = 0; i < FAN_COUNT; i++) {
 		st->fan_freq[i] = roundf(fan_tacho_freq[i]*100)/100.0;
 		if (check_for_change(st->fan_freq_prev[i], st->fan_freq[i], 1.0)) {
-			log_msg(LOG_INFO, "fan%d: Input Tacho change %.2fHz --> %.2fHz",
+			char prev[16], new[16];
+
+			log_msg(LOG_INFO, "fan%d: Input Tacho change %sHz --> %sHz",
 				i+1,
-				st->fan_freq_prev[i],
-				st->fan_freq[i]);
+				float_to_str(prev, sizeof(prev), st->fan_freq_prev[i], 0, 2),
+				float_to_str(new, sizeof(new), st->fan_freq[i], 0, 2));
 			st->fan_freq_prev[i] = st->fan_freq[i];
 		}
 	}
@@ -303,10 +309,10 @@ void setup_tacho_input_interrupts()
 
 /* Function to set output frequency for tachometer output pin.
  */
-void set_tacho_output_freq(uint fan, double frequency)
+void set_tacho_output_freq(uint fan, double frequency, uint8_t duty)
 {
 	assert(fan < MBFAN_COUNT);
-	square_wave_gen_set_freq(pio, fan, frequency);
+	tacho_gen_set_freq(pio, fan, frequency, duty);
 }
 
 
@@ -318,16 +324,15 @@ void setup_tacho_outputs()
 
 	log_msg(LOG_NOTICE, "Setting up Tacho Output pins...");
 
-	/* Load square wave generator program to PIO */
-	uint pio_program_addr = square_wave_gen_load_program(pio);
+	/* Load tachometer generator program to PIO */
+	uint pio_program_addr = tacho_gen_load_program(pio);
 
 	/* Initialize PIO State machines for each tachometer output pin. */
 	for (i = 0; i < MBFAN_COUNT; i++) {
 		uint pin = mbfan_gpio_tacho_map[i];
 		uint sm = i;
-		square_wave_gen_program_init(pio, sm, pio_program_addr, pin);
-		square_wave_gen_set_period(pio, sm, 0);
-		square_wave_gen_enabled(pio, sm, true);
+		tacho_gen_program_init(pio, sm, pio_program_addr, pin);
+		tacho_gen_enabled(pio, sm, true);
 	}
 
 }
@@ -359,15 +364,99 @@ double tacho_map(const struct tacho_map *map, double val)
 }
 
 
+/* Expected fan RPM at given duty cycle (from fan calibration results).
+ * Returns 0 if fan has not been calibrated.
+ */
+static double fan_expected_rpm(const struct fan_output *fan, double duty)
+{
+	const struct fan_cal *cal = &fan->cal;
+	int i;
+
+	if (cal->points < FAN_CAL_POINTS)
+		return 0.0;
+	if (duty <= 0.0)
+		return cal->rpm[0];
+	if (duty >= 100.0)
+		return cal->rpm[FAN_CAL_POINTS - 1];
+
+	i = duty / FAN_CAL_STEP;
+	return cal->rpm[i] + (cal->rpm[i + 1] - cal->rpm[i])
+		* (duty - i * FAN_CAL_STEP) / FAN_CAL_STEP;
+}
+
+
+static bool fan_has_failed(const struct fanpico_state *state, int i)
+{
+	return (state->fan_failed[i] || state->fan_start_state[i] == FAN_START_STALLED);
+}
+
+
+/* Find worst performing fan from a group of fans: fan that is furthest
+ * below its expected speed (if fan has been calibrated), or below average
+ * speed of the group. Returns RPM of the worst fan.
+ */
+static double worst_fan_rpm(const struct fanpico_state *state, const struct fanpico_config *config,
+			const uint8_t *sources)
+{
+	double rpm[FAN_MAX_COUNT];
+	double avg = 0.0, worst = 0.0, score, worst_score = -1.0, expected;
+	int count = 0;
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		if (!sources[i])
+			continue;
+		rpm[i] = (fan_has_failed(state, i) ? 0.0 :
+			state->fan_freq[i] * 60.0 / config->fans[i].rpm_factor);
+		avg += rpm[i];
+		count++;
+	}
+	if (count < 1)
+		return 0.0;
+	avg /= count;
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		if (!sources[i])
+			continue;
+		expected = fan_expected_rpm(&config->fans[i], state->fan_duty[i]);
+		if (expected <= 0.0)
+			expected = avg;
+		score = (expected > 0.0 ? rpm[i] / expected : 0.0);
+		if (worst_score < 0.0 || score < worst_score) {
+			worst_score = score;
+			worst = rpm[i];
+		}
+	}
+
+	return worst;
+}
+
+
 double calculate_tacho_freq(struct fanpico_state *state, const struct fanpico_config *config, int i)
 {
 	const struct mb_input *mbfan;
+	absolute_time_t t_now;
+	bool failed = false;
 	int count = 0;
 	double val = 0;
 	double sum = 0;
 
 	mbfan = &config->mbfans[i];
 
+	/* Check for failed source fans */
+	if (mbfan->s_type == TACHO_FAN) {
+		failed = fan_has_failed(state, mbfan->s_id);
+	} else if (mbfan->s_type != TACHO_FIXED) {
+		for (int j = 0; j < FAN_COUNT; j++) {
+			if (mbfan->sources[j] && fan_has_failed(state, j))
+				failed = true;
+		}
+	}
+	if (failed && mbfan->stall_alarm) {
+		/* Report stalled fan to trigger motherboard fan alarm */
+		state->mbfan_hold_rpm[i] = 0.0;
+		return 0.0;
+	}
+
 	switch (mbfan->s_type) {
 	case TACHO_FIXED:
 		val = mbfan->s_id;
@@ -407,6 +496,24 @@ double calculate_tacho_freq(struct fanpico_state *state, const struct fanpico_co
 			}
 		}
 		break;
+	case TACHO_WORST:
+		val = worst_fan_rpm(state, config, mbfan->sources);
+		break;
+	}
+
+	/* Hold last good value over transient tacho signal dropouts */
+	if (mbfan->hold_time > 0 && mbfan->s_type != TACHO_FIXED) {
+		t_now = get_absolute_time();
+		if (val > 0.0 || failed) {
+			state->mbfan_hold_rpm[i] = val;
+			state->mbfan_hold_t[i] = t_now;
+		} else if (state->mbfan_hold_rpm[i] > 0.0) {
+			if (absolute_time_diff_us(state->mbfan_hold_t[i], t_now)
+				< (int64_t)mbfan->hold_time * 1000)
+				val = state->mbfan_hold_rpm[i];
+			else
+				state->mbfan_hold_rpm[i] = 0.0;
+		}
 	}
 
 
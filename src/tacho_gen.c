@@ -0,0 +1,211 @@
+/* tacho_gen.c
+   Copyright (C) 2021-2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+
+#include "tacho_gen.h"
+
+// Include the assembled PIO program
+#include "tacho_gen.pio.h"
+
+
+/*
+ * Functions for PIO (and DMA) based tachometer signal generator.
+ *
+ * Each state machine is fed from a ring buffer (by DMA) that contains
+ * high/low phase lengths for TACHO_GEN_CYCLES output cycles. Cycle
+ * lengths are calculated using fixed-point phase accumulator, so that
+ * average frequency over the buffer is accurate to a fraction of a clock
+ * cycle (instead of being quantized to full clock cycles per half period).
+ *
+ * Buffer can be updated at any time, state machine always completes
+ * current output cycle, so no runt pulses are generated.
+ */
+
+#define TACHO_GEN_HI_CYCLES  2   /* fixed overhead of high phase (clock cycles) */
+#define TACHO_GEN_LO_CYCLES  6   /* fixed overhead of low phase (clock cycles) */
+
+#define TACHO_GEN_BUF_WORDS  (TACHO_GEN_CYCLES * 2)
+#define TACHO_GEN_BUF_SIZE   (TACHO_GEN_BUF_WORDS * sizeof(uint32_t))
+
+struct tacho_gen_sm {
+	int data_ch;            /* DMA channel feeding PIO TX FIFO */
+	int ctrl_ch;            /* DMA channel restarting data channel */
+	uint32_t *buf_addr;     /* read by ctrl_ch */
+	double freq;
+	uint8_t duty;
+	absolute_time_t updated;
+	struct tacho_gen_stats stats;
+};
+
+static uint32_t tacho_gen_buf[NUM_PIO_STATE_MACHINES][TACHO_GEN_BUF_WORDS]
+	__attribute__((aligned(TACHO_GEN_BUF_SIZE)));
+static struct tacho_gen_sm tacho_gen_sm[NUM_PIO_STATE_MACHINES];
+
+
+/* Function for loading tachometer generator program into a PIO.
+ */
+uint tacho_gen_load_program(PIO pio)
+{
+	return pio_add_program(pio, &tacho_gen_program);
+}
+
+
+/* Calculate high/low phase lengths for output cycles into buffer.
+ */
+static void tacho_gen_fill(uint32_t *buf, double freq, uint8_t duty)
+{
+	uint32_t sys_clock = clock_get_hz(clk_sys);
+	uint64_t period, acc = 0;
+	uint32_t len, hi, prev = 0;
+
+	/* Period (in clock cycles) must fit in 32bits, so very low frequencies
+	   (below ~0.03Hz at 125MHz) cannot be generated. Treat anything below
+	   TACHO_GEN_MIN_FREQ as no output. */
+	if (freq < TACHO_GEN_MIN_FREQ || sys_clock / freq >= UINT32_MAX) {
+		/* No output, just keep state machine idle (low) in 1ms cycles */
+		for (int i = 0; i < TACHO_GEN_CYCLES; i++) {
+			buf[i * 2] = 0;
+			buf[i * 2 + 1] = sys_clock / 1000 - TACHO_GEN_LO_CYCLES;
+		}
+		return;
+	}
+
+	/* Period in clock cycles, in 48.16 fixed-point */
+	period = (uint64_t)(sys_clock * 65536.0 / freq);
+	for (int i = 0; i < TACHO_GEN_CYCLES; i++) {
+		acc += period;
+		len = (acc >> 16) - prev;
+		prev = acc >> 16;
+
+		hi = (uint64_t)len * duty / 100;
+		if (hi < TACHO_GEN_HI_CYCLES + 1)
+			hi = TACHO_GEN_HI_CYCLES + 1;
+		if (len < hi + TACHO_GEN_LO_CYCLES)
+			len = hi + TACHO_GEN_LO_CYCLES;
+
+		/* Update low phase first, as state machine reads high phase first */
+		buf[i * 2 + 1] = len - hi - TACHO_GEN_LO_CYCLES;
+		buf[i * 2] = hi - TACHO_GEN_HI_CYCLES;
+	}
+}
+
+
+/* Function to initialize PIO state machine (and DMA channels) to run
+ * tachometer generator program. Output is initially off (low).
+ */
+void tacho_gen_program_init(PIO pio, uint sm, uint offset, uint pin)
+{
+	struct tacho_gen_sm *g = &tacho_gen_sm[sm];
+	pio_sm_config config = tacho_gen_program_get_default_config(offset);
+	dma_channel_config c;
+
+	pio_gpio_init(pio, pin);
+	pio_sm_set_consecutive_pindirs(pio, sm, pin, 1, true);
+	sm_config_set_sideset_pins(&config, pin);
+	sm_config_set_out_shift(&config, false, false, 32);
+	sm_config_set_clkdiv(&config, 1.0);
+	pio_sm_init(pio, sm, offset, &config);
+
+	g->freq = 0;
+	g->duty = TACHO_GEN_DEFAULT_DUTY;
+	g->updated = get_absolute_time();
+	memset(&g->stats, 0, sizeof(g->stats));
+	g->buf_addr = tacho_gen_buf[sm];
+	tacho_gen_fill(g->buf_addr, 0, g->duty);
+	g->data_ch = dma_claim_unused_channel(true);
+	g->ctrl_ch = dma_claim_unused_channel(true);
+
+	/* Control channel: restart data channel from beginning of buffer */
+	c = dma_channel_get_default_config(g->ctrl_ch);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, false);
+	dma_channel_configure(g->ctrl_ch, &c,
+			&dma_hw->ch[g->data_ch].al3_read_addr_trig,
+			&g->buf_addr, 1, false);
+
+	/* Data channel: feed ring buffer into state machine TX FIFO */
+	c = dma_channel_get_default_config(g->data_ch);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, true);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_ring(&c, false, __builtin_ctz(TACHO_GEN_BUF_SIZE));
+	channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+	channel_config_set_chain_to(&c, g->ctrl_ch);
+	dma_channel_configure(g->data_ch, &c, &pio->txf[sm], g->buf_addr,
+			0xffffffff, true);
+}
+
+
+/* Function to enable/disable a tachometer generator.
+ */
+void tacho_gen_enabled(PIO pio, uint sm, bool enabled)
+{
+	pio_sm_set_enabled(pio, sm, enabled);
+}
+
+
+/* Function to set output signal frequency (and pulse width) of
+ * a tachometer generator.
+ *
+ * This never blocks: buffer is simply overwritten (latest value wins).
+ * If previous setting had not yet been output for full buffer length,
+ * the update is counted as coalesced.
+ */
+void tacho_gen_set_freq(PIO pio, uint sm, double freq, uint8_t duty)
+{
+	struct tacho_gen_sm *g = &tacho_gen_sm[sm];
+	absolute_time_t t_now = get_absolute_time();
+
+	if (duty < 1 || duty > 99)
+		duty = TACHO_GEN_DEFAULT_DUTY;
+	if (freq < TACHO_GEN_MIN_FREQ)
+		freq = 0;
+	if (freq == g->freq && duty == g->duty) {
+		g->stats.unchanged++;
+		return;
+	}
+
+	if (g->freq > 0 && absolute_time_diff_us(g->updated, t_now)
+		< TACHO_GEN_CYCLES * 1000000.0 / g->freq)
+		g->stats.coalesced++;
+	tacho_gen_fill(g->buf_addr, freq, duty);
+	g->freq = freq;
+	g->duty = duty;
+	g->updated = t_now;
+	g->stats.updates++;
+}
+
+
+/* Function to get update statistics of a tachometer generator.
+ */
+void tacho_gen_get_stats(uint sm, struct tacho_gen_stats *stats)
+{
+	*stats = tacho_gen_sm[sm].stats;
+}
+
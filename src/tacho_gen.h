@@ -0,0 +1,41 @@
+/* tacho_gen.h
+   Copyright (C) 2021-2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TACHO_GEN_H
+#define TACHO_GEN_H 1
+
+#define TACHO_GEN_CYCLES        16  /* output cycles in DMA ring buffer */
+#define TACHO_GEN_DEFAULT_DUTY  50  /* default pulse width (%) */
+#define TACHO_GEN_MIN_FREQ      0.1 /* lower frequencies are output as 0 Hz (no pulses) */
+
+struct tacho_gen_stats {
+	uint32_t updates;    /* buffer updates */
+	uint32_t coalesced;  /* updates that replaced previous setting before it was fully output */
+	uint32_t unchanged;  /* updates skipped as setting did not change */
+};
+
+uint tacho_gen_load_program(PIO pio);
+void tacho_gen_program_init(PIO pio, uint sm, uint offset, uint pin);
+void tacho_gen_enabled(PIO pio, uint sm, bool enabled);
+void tacho_gen_set_freq(PIO pio, uint sm, double freq, uint8_t duty);
+void tacho_gen_get_stats(uint sm, struct tacho_gen_stats *stats);
+
+#endif /* TACHO_GEN_H */
@@ -78,6 +78,8 @@ const display_field_t theme_default_480x320_fg[] = {
 	{ DATE, OTHER, 0, 300, 90, RGB565(0xff9900), RGB565(0x000000), FONT_12x16 },
 	{ TIME, OTHER, 0, 300, 118, RGB565(0xffcc66), RGB565(0x000000), FONT_16x32 },
 
+	{ SENSOR, TREND, 0, 292, 156, RGB565(0x6688cc), RGB565(0x000000), -1, 176, 24, 20, 50 },
+
 	{ 0, 0, -1, -1, -1, 0, 0, -1 }
 };
 
@@ -91,4 +93,5 @@ const struct display_theme theme_default_480x320 = {
 	"%14s", 14, /* mbfan label */
 	"%14s", 14, /* sensor label */
 	"%14s", 14, /* vsensor label */
+	600, /* trend graph time span (seconds) */
 };
@@ -0,0 +1,252 @@
+/* trace.c
+   Copyright (C) 2024 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "b64/cencode.h"
+
+#include "fanpico.h"
+
+#if TRACE_SUPPORT
+
+/*
+ * Event trace recorder.
+ *
+ * Begin/end events are recorded into a (per core) ring buffer, that
+ * always holds the most recent events. Timestamps are from the
+ * (microsecond) system timer, that is shared by both cores, so
+ * events from both cores are on the same timeline.
+ *
+ * Trace is dumped in binary format (encoded as base64 so that it
+ * passes safely through the console/telnet connection). Use
+ * contrib/trace2json.py to convert dump to Chrome/Perfetto trace format.
+ */
+
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 1024  /* events per core (must be power of two) */
+#endif
+
+#define TRACE_MAGIC "FPTR"
+#define TRACE_VERSION 1
+#define TRACE_LINE_LEN 48  /* bytes per line in dump (64 chars in base64) */
+
+struct trace_event {
+	uint32_t t;
+	uint8_t id;
+	uint8_t type;
+	uint16_t arg;
+};
+
+struct trace_buffer {
+	struct trace_event events[TRACE_BUFFER_SIZE];
+	uint32_t head;
+};
+
+static const char *trace_event_names[] = {
+	"flash_prog",
+	"flash_erase",
+	"irq_tacho",
+	"irq_pulse",
+};
+
+static struct trace_buffer trace_buffers[2];
+static uint32_t trace_active_mask = 0;
+volatile uint32_t trace_mask = 0;
+
+
+void trace_record(enum trace_types type, uint8_t id, uint16_t arg)
+{
+	struct trace_buffer *b = &trace_buffers[get_core_num()];
+	struct trace_event *e;
+	uint32_t irq;
+
+	/* Events are also recorded from interrupt handlers... */
+	irq = save_and_disable_interrupts();
+	e = &b->events[b->head++ & (TRACE_BUFFER_SIZE - 1)];
+	e->t = time_us_32();
+	e->id = id;
+	e->type = type;
+	e->arg = arg;
+	restore_interrupts(irq);
+}
+
+
+static const char* trace_event_name(uint8_t id, char *buf, size_t len)
+{
+	if (id < PERF_STAGE_COUNT)
+		snprintf(buf, len, "%s", perf_stage_name(id));
+	else if (id < TRACE_MUTEX_WAIT)
+		snprintf(buf, len, "%s", trace_event_names[id - PERF_STAGE_COUNT]);
+	else if (id < TRACE_EVENT_COUNT)
+		snprintf(buf, len, "mutex_%s", perf_mutex_name(id - TRACE_MUTEX_WAIT));
+	else
+		snprintf(buf, len, "unknown");
+
+	return buf;
+}
+
+
+void trace_start(uint32_t mask)
+{
+	trace_mask = 0;
+	sleep_us(100);
+	memset(trace_buffers, 0, sizeof(trace_buffers));
+	trace_active_mask = mask & ((1UL << TRACE_EVENT_COUNT) - 1);
+	trace_mask = trace_active_mask;
+}
+
+
+void trace_stop()
+{
+	trace_mask = 0;
+}
+
+
+void trace_print_status()
+{
+	char name[32];
+
+	printf("State: %s\n", (trace_mask ? "Running" : "Stopped"));
+	printf("Mask: 0x%08lx\n", trace_active_mask);
+	printf("Buffer: %u events/core\n", TRACE_BUFFER_SIZE);
+	for (int i = 0; i < 2; i++) {
+		uint32_t head = trace_buffers[i].head;
+
+		printf("core%d: %lu events (%lu lost)\n", i, head,
+			(head > TRACE_BUFFER_SIZE ? head - TRACE_BUFFER_SIZE : 0));
+	}
+	printf("Events:\n");
+	for (int i = 0; i < TRACE_EVENT_COUNT; i++) {
+		printf("%2d %s\n", i, trace_event_name(i, name, sizeof(name)));
+	}
+}
+
+
+static uint8_t trace_line[TRACE_LINE_LEN];
+static size_t trace_line_len;
+
+static void trace_dump_flush()
+{
+	base64_encodestate ctx;
+	char out[TRACE_LINE_LEN * 2];
+	int len;
+
+	if (trace_line_len < 1)
+		return;
+
+	base64_init_encodestate(&ctx);
+	len = base64_encode_block((const char*)trace_line, trace_line_len, out, &ctx);
+	len += base64_encode_blockend(out + len, &ctx);
+	while (len > 0 && (out[len - 1] == '\n' || out[len - 1] == '\r'))
+		len--;
+	out[len] = 0;
+	printf("%s\n", out);
+
+	trace_line_len = 0;
+}
+
+static void trace_dump_write(const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	while (len-- > 0) {
+		trace_line[trace_line_len++] = *p++;
+		if (trace_line_len >= TRACE_LINE_LEN)
+			trace_dump_flush();
+	}
+}
+
+static void trace_dump_u8(uint8_t val)
+{
+	trace_dump_write(&val, 1);
+}
+
+static void trace_dump_u16(uint16_t val)
+{
+	uint8_t b[2] = { val & 0xff, val >> 8 };
+
+	trace_dump_write(b, 2);
+}
+
+static void trace_dump_u32(uint32_t val)
+{
+	trace_dump_u16(val & 0xffff);
+	trace_dump_u16(val >> 16);
+}
+
+
+void trace_dump()
+{
+	uint32_t saved_mask = trace_mask;
+	uint64_t t_now;
+	char name[32];
+
+	/* Pause tracing while dumping the buffers... */
+	trace_mask = 0;
+	sleep_us(100);
+	t_now = time_us_64();
+
+	trace_line_len = 0;
+	printf("-----BEGIN FANPICO TRACE-----\n");
+
+	/* Header */
+	trace_dump_write(TRACE_MAGIC, 4);
+	trace_dump_u16(TRACE_VERSION);
+	trace_dump_u8(2);
+	trace_dump_u8(TRACE_EVENT_COUNT);
+	trace_dump_u32(t_now & 0xffffffff);
+	trace_dump_u32(t_now >> 32);
+
+	/* Event names */
+	for (int i = 0; i < TRACE_EVENT_COUNT; i++) {
+		trace_event_name(i, name, sizeof(name));
+		trace_dump_u8(strlen(name));
+		trace_dump_write(name, strlen(name));
+	}
+
+	/* Events from each core (oldest first) */
+	for (int i = 0; i < 2; i++) {
+		const struct trace_buffer *b = &trace_buffers[i];
+		uint32_t count = (b->head > TRACE_BUFFER_SIZE ? TRACE_BUFFER_SIZE : b->head);
+
+		trace_dump_u8(i);
+		trace_dump_u32(b->head);
+		trace_dump_u32(count);
+		for (uint32_t j = b->head - count; j != b->head; j++) {
+			const struct trace_event *e = &b->events[j & (TRACE_BUFFER_SIZE - 1)];
+
+			trace_dump_u32(e->t);
+			trace_dump_u8(e->id);
+			trace_dump_u8(e->type);
+			trace_dump_u16(e->arg);
+		}
+	}
+	trace_dump_flush();
+
+	printf("-----END FANPICO TRACE-----\n");
+
+	trace_mask = saved_mask;
+}
+
+#endif /* TRACE_SUPPORT */
+
+/* eof :-) */
@@ -304,6 +304,136 @@ double round_decimal(double val, unsigned int decimal)
 }
 
 
+/*
+ * Fast fixed decimal number formatting.
+ *
+ * float_to_str() produces same output as snprintf("%*.*f"), but it only
+ * uses integer arithmetic, so it avoids (soft-float) printf formatting
+ * code and its stack usage. Rounding is done using the exact binary
+ * value (round-half-even), like printf does.
+ *
+ * fixed_to_str() formats fixed-point (scaled integer) values, rounding
+ * half away from zero.
+ */
+
+#define FMT_MAX_DECIMALS 3
+
+static const uint32_t pow10_u32[] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static inline char* fmt_digit(char *p, uint32_t digit, int *digits, int decimals)
+{
+	if (decimals > 0 && *digits == decimals)
+		*--p = '.';
+	*--p = '0' + digit;
+	(*digits)++;
+
+	return p;
+}
+
+/* Format (scaled) value that has been multiplied by 10^decimals. */
+static char* fmt_scaled(char *buf, size_t size, bool neg, uint64_t val,
+			int width, int decimals)
+{
+	char tmp[48];
+	char *end = tmp + sizeof(tmp) - 1;
+	char *p = end;
+	int digits = 0;
+	uint32_t v;
+
+	*end = 0;
+
+	/* Use 64bit division only when needed (it is slow on Cortex-M0+)... */
+	while (val > UINT32_MAX) {
+		p = fmt_digit(p, val % 10, &digits, decimals);
+		val /= 10;
+	}
+	v = val;
+	do {
+		p = fmt_digit(p, v % 10, &digits, decimals);
+		v /= 10;
+	} while (v > 0 || digits <= decimals);
+
+	if (neg)
+		*--p = '-';
+	while (end - p < width && p > tmp)
+		*--p = ' ';
+
+	return strncopy(buf, p, size);
+}
+
+
+char* float_to_str(char *buf, size_t size, double val, int width, int decimals)
+{
+	uint64_t bits, m, q, r, half;
+	bool neg;
+	int e, s;
+
+	memcpy(&bits, &val, sizeof(bits));
+	neg = (bits >> 63 ? true : false);
+	e = (bits >> 52) & 0x7ff;
+	m = bits & ((1ULL << 52) - 1);
+
+	if (e == 0x7ff || decimals < 0 || decimals > FMT_MAX_DECIMALS)
+		goto fallback;
+
+	/* val = m * 2^e */
+	if (e > 0)
+		m |= (1ULL << 52);
+	else
+		e = 1;
+	e -= 1075;
+
+	/* This cannot overflow as m < 2^53 and 10^FMT_MAX_DECIMALS < 2^10 */
+	m *= pow10_u32[decimals];
+
+	if (e >= 0) {
+		if (e > 0 && (e >= 63 || (m >> (63 - e))))
+			goto fallback;
+		q = m << e;
+	} else if ((s = -e) < 64) {
+		q = m >> s;
+		r = m & ((1ULL << s) - 1);
+		half = 1ULL << (s - 1);
+		if (r > half || (r == half && (q & 1)))
+			q++;
+	} else {
+		q = 0;
+	}
+
+	return fmt_scaled(buf, size, neg, q, width, decimals);
+
+fallback:
+	snprintf(buf, size, "%*.*f", width, decimals, val);
+	return buf;
+}
+
+
+char* fixed_to_str(char *buf, size_t size, int64_t val, int scale, int width, int decimals)
+{
+	uint64_t u = (val < 0 ? -(uint64_t)val : val);
+	uint32_t d;
+	uint64_t q;
+
+	if (scale < 0 || decimals < 0 || scale > 9 || decimals > 9)
+		return strncopy(buf, "", size);
+
+	if (decimals >= scale) {
+		q = u * pow10_u32[decimals - scale];
+	} else {
+		d = pow10_u32[scale - decimals];
+		/* Avoid (slow) 64bit division when value fits in 32bits */
+		if (u <= UINT32_MAX)
+			q = (uint32_t)u / d + ((uint32_t)u % d >= (d + 1) / 2 ? 1 : 0);
+		else
+			q = u / d + (u % d >= (d + 1) / 2 ? 1 : 0);
+	}
+
+	return fmt_scaled(buf, size, (val < 0 && q > 0), q, width, decimals);
+}
+
+
 char* base64encode(const char *input)
 {
 	base64_encodestate ctx;
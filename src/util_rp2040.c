@@ -61,12 +61,47 @@ inline uint32_t get_stack_free()
 	return (sp > end ? sp - end : 0);
 }
 
+#define STACK_PAINT_PATTERN 0x5ca1ab1e
+#define STACK_GUARD_SIZE 64  /* leave (MPU) stack guard at bottom of stack alone */
+
+static bool stack_painted[2] = { false, false };
+
+/* Fill unused part of the stack of the current core with a known pattern,
+ * so that maximum stack usage can be determined later. */
+void stack_paint()
+{
+	uint core = get_core_num();
+	uint32_t *p = (uint32_t*)((core ? &__StackOneBottom : &__StackBottom) + STACK_GUARD_SIZE);
+	uint32_t *end = (uint32_t*)((get_stack_pointer() - 64) & ~3);
+
+	while (p < end)
+		*p++ = STACK_PAINT_PATTERN;
+	stack_painted[core] = true;
+}
+
+/* Return maximum stack usage (high-water mark) for given core. */
+uint32_t stack_used_max(uint core)
+{
+	uint32_t *top = (uint32_t*)(core ? &__StackOneTop : &__StackTop);
+	uint32_t *p = (uint32_t*)((core ? &__StackOneBottom : &__StackBottom) + STACK_GUARD_SIZE);
+
+	if (!stack_painted[core & 1])
+		return 0;
+
+	while (p < top && *p == STACK_PAINT_PATTERN)
+		p++;
+
+	return (top - p) * sizeof(uint32_t);
+}
+
 void print_rp2040_meminfo()
 {
 	printf("Core0 stack size:                      %d\n",
 		&__StackTop - &__StackBottom);
+	printf("Core0 stack used (max):                %lu\n", stack_used_max(0));
 	printf("Core1 stack size:                      %d\n",
 		&__StackOneTop - &__StackOneBottom);
+	printf("Core1 stack used (max):                %lu\n", stack_used_max(1));
 	printf("Heap size:                             %d\n",
 		&__StackLimit - &__end__);
 }